@@ -27,17 +27,34 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endregion
 
 using System;
+using System.Buffers;
 using System.IO;
 using System.Net.WebSockets;
 using System.Threading;
+using System.Threading.Tasks;
 
 namespace RemoteViewing.AspNetCore
 {
     /// <summary>
     /// A <see cref="Stream"/> which sends and receives data using a <see cref="WebSocket"/>.
     /// </summary>
+    /// <remarks>
+    /// Data which is written to this stream is buffered, and sent as a single binary WebSocket message when
+    /// the stream is flushed. The VNC server flushes the stream once per protocol message, so a framebuffer
+    /// update with many rectangles results in a single WebSocket message, instead of one message for each
+    /// rectangle header and each block of pixel data.
+    /// </remarks>
     public class WebSocketStream : Stream
     {
+        /// <summary>
+        /// The initial size of the write buffer.
+        /// </summary>
+        private const int InitialBufferSize = 4096;
+
+        private byte[] buffer;
+        private int length;
+        private Task pendingSend = Task.CompletedTask;
+
         /// <summary>
         /// Initializes a new instance of the <see cref="WebSocketStream"/> class.
         /// </summary>
@@ -80,34 +97,145 @@ namespace RemoteViewing.AspNetCore
         /// <inheritdoc/>
         public override void Flush()
         {
-            throw new NotImplementedException();
+            this.FlushAsync(CancellationToken.None).GetAwaiter().GetResult();
+        }
+
+        /// <inheritdoc/>
+        public override async Task FlushAsync(CancellationToken cancellationToken)
+        {
+            if (this.length == 0)
+            {
+                return;
+            }
+
+            var segment = new ArraySegment<byte>(this.buffer, 0, this.length);
+            this.length = 0;
+
+            var send = this.WebSocket.SendAsync(segment, WebSocketMessageType.Binary, true, cancellationToken);
+            Volatile.Write(ref this.pendingSend, send);
+            await send.ConfigureAwait(false);
         }
 
         /// <inheritdoc/>
         public override int Read(byte[] buffer, int offset, int count)
+        {
+            return this.ReadAsync(buffer, offset, count, CancellationToken.None).GetAwaiter().GetResult();
+        }
+
+        /// <inheritdoc/>
+        public override async Task<int> ReadAsync(byte[] buffer, int offset, int count, CancellationToken cancellationToken)
         {
             ArraySegment<byte> segment = new ArraySegment<byte>(buffer, offset, count);
-            var result = this.WebSocket.ReceiveAsync(segment, CancellationToken.None).GetAwaiter().GetResult();
-            return result.Count;
+            var result = await this.WebSocket.ReceiveAsync(segment, cancellationToken).ConfigureAwait(false);
+
+            // A close message marks the end of the stream.
+            return result.MessageType == WebSocketMessageType.Close ? 0 : result.Count;
         }
 
         /// <inheritdoc/>
         public override void Write(byte[] buffer, int offset, int count)
         {
-            ArraySegment<byte> segment = new ArraySegment<byte>(buffer, offset, count);
-            this.WebSocket.SendAsync(segment, WebSocketMessageType.Binary, true, CancellationToken.None).Wait();
+            if (buffer == null)
+            {
+                throw new ArgumentNullException(nameof(buffer));
+            }
+
+            this.Append(new ReadOnlySpan<byte>(buffer, offset, count));
+        }
+
+        /// <inheritdoc/>
+        public override Task WriteAsync(byte[] buffer, int offset, int count, CancellationToken cancellationToken)
+        {
+            if (cancellationToken.IsCancellationRequested)
+            {
+                return Task.FromCanceled(cancellationToken);
+            }
+
+            // Writes only copy the data to the buffer; the data is sent when the stream is flushed.
+            this.Write(buffer, offset, count);
+            return Task.CompletedTask;
+        }
+
+#if NET5_0_OR_GREATER
+        /// <inheritdoc/>
+        public override async ValueTask<int> ReadAsync(Memory<byte> buffer, CancellationToken cancellationToken = default)
+        {
+            var result = await this.WebSocket.ReceiveAsync(buffer, cancellationToken).ConfigureAwait(false);
+            return result.MessageType == WebSocketMessageType.Close ? 0 : result.Count;
+        }
+
+        /// <inheritdoc/>
+        public override ValueTask WriteAsync(ReadOnlyMemory<byte> buffer, CancellationToken cancellationToken = default)
+        {
+            if (cancellationToken.IsCancellationRequested)
+            {
+                return ValueTask.FromCanceled(cancellationToken);
+            }
+
+            this.Append(buffer.Span);
+            return default;
         }
+#endif
 
         /// <inheritdoc/>
         public override long Seek(long offset, SeekOrigin origin)
         {
-            throw new NotImplementedException();
+            throw new NotSupportedException();
         }
 
         /// <inheritdoc/>
         public override void SetLength(long value)
         {
-            throw new NotImplementedException();
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        protected override void Dispose(bool disposing)
+        {
+            if (disposing && this.buffer != null)
+            {
+                var buffer = this.buffer;
+                var pendingSend = Volatile.Read(ref this.pendingSend);
+                this.buffer = null;
+                this.length = 0;
+
+                // The stream may be disposed of while a flush is still sending the contents of the buffer, so only
+                // return the buffer to the pool once the send has completed.
+                if (pendingSend.IsCompleted)
+                {
+                    ArrayPool<byte>.Shared.Return(buffer);
+                }
+                else
+                {
+                    pendingSend.ContinueWith(
+                        (task, state) => ArrayPool<byte>.Shared.Return((byte[])state),
+                        buffer,
+                        CancellationToken.None,
+                        TaskContinuationOptions.ExecuteSynchronously,
+                        TaskScheduler.Default);
+                }
+            }
+
+            base.Dispose(disposing);
+        }
+
+        private void Append(ReadOnlySpan<byte> data)
+        {
+            if (this.buffer == null || this.length + data.Length > this.buffer.Length)
+            {
+                var buffer = ArrayPool<byte>.Shared.Rent(Math.Max(InitialBufferSize, Math.Max(this.length + data.Length, 2 * this.length)));
+
+                if (this.buffer != null)
+                {
+                    Buffer.BlockCopy(this.buffer, 0, buffer, 0, this.length);
+                    ArrayPool<byte>.Shared.Return(this.buffer);
+                }
+
+                this.buffer = buffer;
+            }
+
+            data.CopyTo(new Span<byte>(this.buffer, this.length, data.Length));
+            this.length += data.Length;
         }
     }
 }
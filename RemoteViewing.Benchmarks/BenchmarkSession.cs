@@ -0,0 +1,192 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Microsoft.Extensions.Logging;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// A <see cref="IVncServerSession"/> which is not connected to a client. It provides the client settings used
+    /// by encoders, and records the framebuffer updates which are queued.
+    /// </summary>
+    public class BenchmarkSession : IVncServerSession
+    {
+        /// <summary>
+        /// Initializes a new instance of the <see cref="BenchmarkSession"/> class.
+        /// </summary>
+        /// <param name="clientEncodings">
+        /// The encodings supported by the client.
+        /// </param>
+        public BenchmarkSession(params VncEncoding[] clientEncodings)
+        {
+            this.ClientEncodings = clientEncodings;
+        }
+
+        /// <inheritdoc/>
+        event EventHandler<KeyChangedEventArgs> IVncServerSession.KeyChanged
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        event EventHandler<PointerChangedEventArgs> IVncServerSession.PointerChanged
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        event EventHandler IVncServerSession.Connected
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        event EventHandler IVncServerSession.ConnectionFailed
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        event EventHandler IVncServerSession.Closed
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        event EventHandler<PasswordProvidedEventArgs> IVncServerSession.PasswordProvided
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        public ILogger Logger { get; set; }
+
+        /// <inheritdoc/>
+        public IVncPasswordChallenge PasswordChallenge { get; set; }
+
+        /// <inheritdoc/>
+        public double MaxUpdateRate { get; set; }
+
+        /// <inheritdoc/>
+        public Func<VncFramebuffer, ILogger, IVncFramebufferCache> CreateFramebufferCache { get; set; }
+
+        /// <inheritdoc/>
+        public FramebufferUpdateRequest FramebufferUpdateRequest { get; set; }
+
+        /// <inheritdoc/>
+        public object FramebufferUpdateRequestLock { get; } = new object();
+
+        /// <inheritdoc/>
+        public IReadOnlyList<VncEncoding> ClientEncodings { get; set; }
+
+        /// <summary>
+        /// Gets the number of pixels which have been invalidated since the last call to <see cref="Reset"/>.
+        /// </summary>
+        public long InvalidatedPixels { get; private set; }
+
+        /// <summary>
+        /// Gets the number of pixels which have been copied since the last call to <see cref="Reset"/>.
+        /// </summary>
+        public long CopiedPixels { get; private set; }
+
+        /// <summary>
+        /// Resets the <see cref="InvalidatedPixels"/> and <see cref="CopiedPixels"/> counters.
+        /// </summary>
+        public void Reset()
+        {
+            this.InvalidatedPixels = 0;
+            this.CopiedPixels = 0;
+        }
+
+        /// <inheritdoc/>
+        public void Connect(Stream stream, VncServerSessionOptions options = null)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void Close()
+        {
+        }
+
+        /// <inheritdoc/>
+        public void SetFramebufferSource(IVncFramebufferSource source)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualBeginUpdate()
+        {
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualCopyRegion(VncRectangle target, int sourceX, int sourceY)
+        {
+            this.CopiedPixels += target.Width * target.Height;
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualInvalidate(VncRectangle region)
+        {
+            this.InvalidatedPixels += region.Width * region.Height;
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualInvalidate(VncRectangle[] regions)
+        {
+            foreach (var region in regions)
+            {
+                this.FramebufferManualInvalidate(region);
+            }
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualInvalidateAll()
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public bool FramebufferManualEndUpdate()
+        {
+            return true;
+        }
+    }
+}
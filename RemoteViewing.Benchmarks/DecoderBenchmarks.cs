@@ -0,0 +1,149 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using BenchmarkDotNet.Attributes;
+using RemoteViewing.Vnc;
+using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// Measures how fast the client decoders decode an entire frame.
+    /// </summary>
+    /// <remarks>
+    /// The frame is encoded once by a server encoder. The decoder is reset before every invocation, so every invocation
+    /// decodes the same data.
+    /// </remarks>
+    [Config(typeof(BenchmarkConfig))]
+    public class DecoderBenchmarks : IWorkloadBenchmark, IDisposable
+    {
+        private readonly VncInflater zlibInflater = new VncInflater();
+        private readonly ZrleDecoder zrleDecoder = new ZrleDecoder();
+        private readonly TightDecoder tightDecoder = new TightDecoder();
+        private readonly MemoryStream input = new MemoryStream();
+        private VncStream stream;
+        private List<FramebufferRectangle> rectangles;
+        private VncPixelFormat pixelFormat;
+        private byte[] pixels;
+        private long frameSize;
+
+        /// <summary>
+        /// Gets or sets the content of the frame which is decoded.
+        /// </summary>
+        [ParamsAllValues]
+        public WorkloadKind Workload { get; set; }
+
+        /// <summary>
+        /// Gets or sets the encoding of the frame.
+        /// </summary>
+        [Params(EncoderKind.Zlib, EncoderKind.Zrle, EncoderKind.TightBasic, EncoderKind.TightJpeg)]
+        public EncoderKind Encoder { get; set; }
+
+        /// <inheritdoc/>
+        [GlobalSetup]
+        public void Setup()
+        {
+            var framebuffer = Workloads.CreateFrames(this.Workload, 1)[0];
+            this.pixelFormat = framebuffer.PixelFormat;
+            this.frameSize = framebuffer.GetBuffer().Length;
+            this.pixels = new byte[this.frameSize];
+
+            var encoder = Encoders.Create(this.Encoder);
+            this.rectangles = Workloads.Split(framebuffer, encoder);
+
+            this.input.SetLength(0);
+
+            foreach (var rectangle in this.rectangles)
+            {
+                encoder.Send(this.input, this.pixelFormat, rectangle.Region, rectangle.Contents);
+            }
+
+            this.stream = new VncStream(this.input);
+        }
+
+        /// <summary>
+        /// Decodes the frame.
+        /// </summary>
+        /// <returns>
+        /// The number of bytes which have been read.
+        /// </returns>
+        [Benchmark]
+        public long Decode()
+        {
+            this.input.Position = 0;
+            this.zlibInflater.Reset();
+            this.zrleDecoder.Reset();
+            this.tightDecoder.Reset();
+
+            foreach (var rectangle in this.rectangles)
+            {
+                int width = rectangle.Region.Width;
+                int height = rectangle.Region.Height;
+
+                switch (this.Encoder)
+                {
+                    case EncoderKind.Zlib:
+                        int size = (int)this.stream.ReceiveUInt32BE();
+                        this.zlibInflater.Receive(this.stream, size);
+                        this.zlibInflater.Read(this.pixels, 0, width * height * this.pixelFormat.BytesPerPixel);
+                        break;
+
+                    case EncoderKind.Zrle:
+                        this.zrleDecoder.Decode(this.stream, this.pixelFormat, width, height);
+                        break;
+
+                    case EncoderKind.TightBasic:
+                    case EncoderKind.TightJpeg:
+                        this.tightDecoder.Decode(this.stream, this.pixelFormat, width, height);
+                        break;
+
+                    default:
+                        throw new NotSupportedException();
+                }
+            }
+
+            return this.input.Position;
+        }
+
+        /// <inheritdoc/>
+        public WorkloadMetrics Measure()
+        {
+            return new WorkloadMetrics(this.frameSize, this.Decode());
+        }
+
+        /// <inheritdoc/>
+        public void Dispose()
+        {
+            this.zlibInflater.Dispose();
+            this.zrleDecoder.Dispose();
+            this.tightDecoder.Dispose();
+        }
+    }
+}
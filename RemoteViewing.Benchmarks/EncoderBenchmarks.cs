@@ -0,0 +1,114 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using BenchmarkDotNet.Attributes;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// Measures how fast the server encoders encode entire frames, and how well they compress them.
+    /// </summary>
+    [Config(typeof(BenchmarkConfig))]
+    public class EncoderBenchmarks : IWorkloadBenchmark
+    {
+        private const int FrameCount = 8;
+
+        private readonly MemoryStream output = new MemoryStream();
+        private List<FramebufferRectangle>[] frames;
+        private VncPixelFormat pixelFormat;
+        private long frameSize;
+        private VncEncoder encoder;
+        private int frame;
+
+        /// <summary>
+        /// Gets or sets the content of the frames which are encoded.
+        /// </summary>
+        [ParamsAllValues]
+        public WorkloadKind Workload { get; set; }
+
+        /// <summary>
+        /// Gets or sets the encoder to use.
+        /// </summary>
+        [ParamsAllValues]
+        public EncoderKind Encoder { get; set; }
+
+        /// <inheritdoc/>
+        [GlobalSetup]
+        public void Setup()
+        {
+            var framebuffers = Workloads.CreateFrames(this.Workload, FrameCount);
+            this.pixelFormat = framebuffers[0].PixelFormat;
+            this.frameSize = framebuffers[0].GetBuffer().Length;
+
+            // Encoders which use zlib keep their dictionary across frames, like they do in a session.
+            this.encoder = Encoders.Create(this.Encoder);
+            this.frames = framebuffers.Select(f => Workloads.Split(f, this.encoder)).ToArray();
+            this.frame = 0;
+        }
+
+        /// <summary>
+        /// Encodes the next frame.
+        /// </summary>
+        /// <returns>
+        /// The number of bytes which have been written.
+        /// </returns>
+        [Benchmark]
+        public long Encode()
+        {
+            var rectangles = this.frames[this.frame];
+            this.frame = (this.frame + 1) % this.frames.Length;
+
+            this.output.SetLength(0);
+
+            foreach (var rectangle in rectangles)
+            {
+                this.encoder.Send(this.output, this.pixelFormat, rectangle.Region, rectangle.Contents);
+            }
+
+            return this.output.Length;
+        }
+
+        /// <inheritdoc/>
+        public WorkloadMetrics Measure()
+        {
+            long encoded = 0;
+
+            for (int i = 0; i < this.frames.Length; i++)
+            {
+                encoded += this.Encode();
+            }
+
+            return new WorkloadMetrics(this.frameSize, encoded / this.frames.Length);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// Creates the encoders which are benchmarked.
+    /// </summary>
+    public static class Encoders
+    {
+        /// <summary>
+        /// The JPEG quality level used by <see cref="EncoderKind.TightJpeg"/>.
+        /// </summary>
+        public const int JpegQualityLevel = 6;
+
+        /// <summary>
+        /// Creates a new encoder.
+        /// </summary>
+        /// <param name="kind">
+        /// The type of encoder to create.
+        /// </param>
+        /// <returns>
+        /// A new <see cref="VncEncoder"/>, which has not sent any data yet.
+        /// </returns>
+        public static VncEncoder Create(EncoderKind kind)
+        {
+            switch (kind)
+            {
+                case EncoderKind.Raw:
+                    return new RawEncoder();
+
+                case EncoderKind.Zlib:
+                    return new ZlibEncoder();
+
+                case EncoderKind.Zrle:
+                    return new ZrleEncoder();
+
+                case EncoderKind.TightBasic:
+                    return new TightEncoder(new BenchmarkSession(VncEncoding.Tight)) { Compression = TightCompression.Basic };
+
+                case EncoderKind.TightJpeg:
+                    return new TightEncoder(new BenchmarkSession(VncEncoding.Tight, VncEncoding.TightQualityLevel0 + JpegQualityLevel)) { Compression = TightCompression.Jpeg };
+
+                default:
+                    throw new ArgumentOutOfRangeException(nameof(kind));
+            }
+        }
+    }
+}
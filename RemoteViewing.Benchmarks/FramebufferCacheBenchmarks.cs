@@ -0,0 +1,116 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using BenchmarkDotNet.Attributes;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// Measures how fast <see cref="VncFramebufferCache"/> finds the regions of the framebuffer which have changed.
+    /// </summary>
+    /// <remarks>
+    /// Every invocation copies the next frame into the framebuffer, and responds to an incremental update request for
+    /// the entire framebuffer. The compression ratio is the size of the framebuffer, divided by the size of the
+    /// regions which have been invalidated.
+    /// </remarks>
+    [Config(typeof(BenchmarkConfig))]
+    public class FramebufferCacheBenchmarks : IWorkloadBenchmark
+    {
+        private const int FrameCount = 8;
+
+        private VncFramebuffer[] frames;
+        private VncFramebuffer framebuffer;
+        private VncFramebufferCache cache;
+        private BenchmarkSession session;
+        private int frame;
+
+        /// <summary>
+        /// Gets or sets the content of the frames.
+        /// </summary>
+        [ParamsAllValues]
+        public WorkloadKind Workload { get; set; }
+
+        /// <inheritdoc/>
+        [GlobalSetup]
+        public void Setup()
+        {
+            this.frames = Workloads.CreateFrames(this.Workload, FrameCount);
+
+            var first = this.frames[0];
+            this.framebuffer = new VncFramebuffer(first.Name, first.Width, first.Height, first.PixelFormat);
+            this.cache = new VncFramebufferCache(this.framebuffer, null);
+
+            // The client supports CopyRect, so scrolling can be detected.
+            this.session = new BenchmarkSession(VncEncoding.CopyRect, VncEncoding.Raw);
+            this.session.FramebufferUpdateRequest = new FramebufferUpdateRequest(false, new VncRectangle(0, 0, first.Width, first.Height));
+            this.cache.RespondToUpdateRequest(this.session);
+
+            this.session.FramebufferUpdateRequest = new FramebufferUpdateRequest(true, new VncRectangle(0, 0, first.Width, first.Height));
+            this.frame = 0;
+        }
+
+        /// <summary>
+        /// Updates the framebuffer, and responds to an incremental update request.
+        /// </summary>
+        /// <returns>
+        /// The number of pixels which have been invalidated.
+        /// </returns>
+        [Benchmark]
+        public long RespondToUpdateRequest()
+        {
+            this.frame = (this.frame + 1) % this.frames.Length;
+            var source = this.frames[this.frame].GetBuffer();
+
+            lock (this.framebuffer.SyncRoot)
+            {
+                Buffer.BlockCopy(source, 0, this.framebuffer.GetBuffer(), 0, source.Length);
+            }
+
+            this.session.Reset();
+            this.cache.RespondToUpdateRequest(this.session);
+            return this.session.InvalidatedPixels;
+        }
+
+        /// <inheritdoc/>
+        public WorkloadMetrics Measure()
+        {
+            long invalidated = 0;
+
+            for (int i = 0; i < this.frames.Length; i++)
+            {
+                invalidated += this.RespondToUpdateRequest();
+            }
+
+            int bpp = this.framebuffer.PixelFormat.BytesPerPixel;
+            return new WorkloadMetrics(this.framebuffer.GetBuffer().Length, invalidated * bpp / this.frames.Length);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// A rectangle of a framebuffer, and a copy of its pixels.
+    /// </summary>
+    public class FramebufferRectangle
+    {
+        /// <summary>
+        /// Initializes a new instance of the <see cref="FramebufferRectangle"/> class.
+        /// </summary>
+        /// <param name="region">
+        /// The region of the framebuffer.
+        /// </param>
+        /// <param name="contents">
+        /// The pixels in the region.
+        /// </param>
+        public FramebufferRectangle(VncRectangle region, byte[] contents)
+        {
+            this.Region = region;
+            this.Contents = contents;
+        }
+
+        /// <summary>
+        /// Gets the region of the framebuffer.
+        /// </summary>
+        public VncRectangle Region { get; }
+
+        /// <summary>
+        /// Gets the pixels in the region.
+        /// </summary>
+        public byte[] Contents { get; }
+    }
+}
@@ -0,0 +1,122 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using BenchmarkDotNet.Attributes;
+using RemoteViewing.Vnc;
+using System.Collections.Generic;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// Measures how fast <see cref="VncPixelFormat.Copy(byte[], int, int, VncPixelFormat, VncRectangle, byte[], int, int, VncPixelFormat, int, int)"/>
+    /// converts an entire frame between common pixel formats.
+    /// </summary>
+    [Config(typeof(BenchmarkConfig))]
+    public class PixelFormatBenchmarks : IWorkloadBenchmark
+    {
+        private static readonly VncPixelFormat Bgr32 = new VncPixelFormat(32, 24, 8, 0, 8, 8, 8, 16);
+        private static readonly VncPixelFormat Rgb32BigEndian = new VncPixelFormat(32, 24, 8, 16, 8, 8, 8, 0, isLittleEndian: false);
+        private static readonly VncPixelFormat Rgb565 = new VncPixelFormat(16, 16, 5, 11, 6, 5, 5, 0);
+        private static readonly VncPixelFormat Bgr233 = new VncPixelFormat(8, 8, 3, 0, 3, 3, 2, 6);
+
+        private byte[] source;
+        private byte[] target;
+        private VncRectangle region;
+
+        /// <summary>
+        /// Gets the pixel format conversions which are benchmarked.
+        /// </summary>
+        public static IEnumerable<PixelFormatPair> FormatPairs
+        {
+            get
+            {
+                yield return new PixelFormatPair("RGB32 to RGB32", VncPixelFormat.RGB32, VncPixelFormat.RGB32);
+                yield return new PixelFormatPair("RGB32 to BGR32", VncPixelFormat.RGB32, Bgr32);
+                yield return new PixelFormatPair("RGB32 to RGB32 (BE)", VncPixelFormat.RGB32, Rgb32BigEndian);
+                yield return new PixelFormatPair("RGB32 to RGB565", VncPixelFormat.RGB32, Rgb565);
+                yield return new PixelFormatPair("RGB32 to BGR233", VncPixelFormat.RGB32, Bgr233);
+                yield return new PixelFormatPair("RGB565 to RGB32", Rgb565, VncPixelFormat.RGB32);
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the source and target pixel formats.
+        /// </summary>
+        [ParamsSource(nameof(FormatPairs))]
+        public PixelFormatPair Formats { get; set; }
+
+        /// <inheritdoc/>
+        [GlobalSetup]
+        public void Setup()
+        {
+            var framebuffer = Workloads.CreateFrames(WorkloadKind.Text, 1)[0];
+            int width = framebuffer.Width;
+            int height = framebuffer.Height;
+            this.region = new VncRectangle(0, 0, width, height);
+
+            this.source = new byte[width * height * this.Formats.Source.BytesPerPixel];
+            this.target = new byte[width * height * this.Formats.Target.BytesPerPixel];
+
+            VncPixelFormat.Copy(
+                framebuffer.GetBuffer(),
+                width,
+                framebuffer.Stride,
+                framebuffer.PixelFormat,
+                this.region,
+                this.source,
+                width,
+                width * this.Formats.Source.BytesPerPixel,
+                this.Formats.Source);
+        }
+
+        /// <summary>
+        /// Converts the frame to the target pixel format.
+        /// </summary>
+        [Benchmark]
+        public void Copy()
+        {
+            VncPixelFormat.Copy(
+                this.source,
+                this.region.Width,
+                this.region.Width * this.Formats.Source.BytesPerPixel,
+                this.Formats.Source,
+                this.region,
+                this.target,
+                this.region.Width,
+                this.region.Width * this.Formats.Target.BytesPerPixel,
+                this.Formats.Target);
+        }
+
+        /// <inheritdoc/>
+        public WorkloadMetrics Measure()
+        {
+            this.Copy();
+            return new WorkloadMetrics(this.source.Length, 0);
+        }
+    }
+}
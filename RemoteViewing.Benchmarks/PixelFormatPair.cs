@@ -0,0 +1,78 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// A source and target pixel format, used to benchmark pixel format conversions.
+    /// </summary>
+    public class PixelFormatPair
+    {
+        /// <summary>
+        /// Initializes a new instance of the <see cref="PixelFormatPair"/> class.
+        /// </summary>
+        /// <param name="name">
+        /// The name of the conversion, which is displayed in the benchmark results.
+        /// </param>
+        /// <param name="source">
+        /// The source pixel format.
+        /// </param>
+        /// <param name="target">
+        /// The target pixel format.
+        /// </param>
+        public PixelFormatPair(string name, VncPixelFormat source, VncPixelFormat target)
+        {
+            this.Name = name;
+            this.Source = source;
+            this.Target = target;
+        }
+
+        /// <summary>
+        /// Gets the name of the conversion.
+        /// </summary>
+        public string Name { get; }
+
+        /// <summary>
+        /// Gets the source pixel format.
+        /// </summary>
+        public VncPixelFormat Source { get; }
+
+        /// <summary>
+        /// Gets the target pixel format.
+        /// </summary>
+        public VncPixelFormat Target { get; }
+
+        /// <inheritdoc/>
+        public override string ToString()
+        {
+            return this.Name;
+        }
+    }
+}
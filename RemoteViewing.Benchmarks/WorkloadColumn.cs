@@ -0,0 +1,159 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using BenchmarkDotNet.Columns;
+using BenchmarkDotNet.Reports;
+using BenchmarkDotNet.Running;
+using System;
+using System.Collections.Concurrent;
+using System.Globalization;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// A column which reports a value derived from the <see cref="WorkloadMetrics"/> of a <see cref="IWorkloadBenchmark"/>.
+    /// </summary>
+    /// <remarks>
+    /// The benchmarks run in a separate process, so the metrics are measured again, in the host process, by running
+    /// the benchmark once with the same parameters.
+    /// </remarks>
+    public class WorkloadColumn : IColumn
+    {
+        /// <summary>
+        /// A column which reports the number of megabytes of pixel data processed per second.
+        /// </summary>
+        public static readonly IColumn Throughput = new WorkloadColumn(
+            "Throughput",
+            "Pixel data processed per second, in MB/s",
+            (metrics, nanoseconds) => metrics.PixelBytes * 1000d / nanoseconds,
+            "N1");
+
+        /// <summary>
+        /// A column which reports the size of the pixel data, divided by the size of the encoded data.
+        /// </summary>
+        public static readonly IColumn CompressionRatio = new WorkloadColumn(
+            "Compression",
+            "Size of the pixel data, divided by the size of the encoded data",
+            (metrics, nanoseconds) => metrics.EncodedBytes == 0 ? (double?)null : (double)metrics.PixelBytes / metrics.EncodedBytes,
+            "N2");
+
+        private static readonly ConcurrentDictionary<BenchmarkCase, WorkloadMetrics?> Metrics = new ConcurrentDictionary<BenchmarkCase, WorkloadMetrics?>();
+
+        private readonly Func<WorkloadMetrics, double, double?> getValue;
+        private readonly string format;
+
+        private WorkloadColumn(string columnName, string legend, Func<WorkloadMetrics, double, double?> getValue, string format)
+        {
+            this.ColumnName = columnName;
+            this.Legend = legend;
+            this.getValue = getValue;
+            this.format = format;
+        }
+
+        /// <inheritdoc/>
+        public string Id => nameof(WorkloadColumn) + "." + this.ColumnName;
+
+        /// <inheritdoc/>
+        public string ColumnName { get; }
+
+        /// <inheritdoc/>
+        public bool AlwaysShow => true;
+
+        /// <inheritdoc/>
+        public ColumnCategory Category => ColumnCategory.Custom;
+
+        /// <inheritdoc/>
+        public int PriorityInCategory => 0;
+
+        /// <inheritdoc/>
+        public bool IsNumeric => true;
+
+        /// <inheritdoc/>
+        public UnitType UnitType => UnitType.Dimensionless;
+
+        /// <inheritdoc/>
+        public string Legend { get; }
+
+        /// <inheritdoc/>
+        public string GetValue(Summary summary, BenchmarkCase benchmarkCase)
+        {
+            return this.GetValue(summary, benchmarkCase, SummaryStyle.Default);
+        }
+
+        /// <inheritdoc/>
+        public string GetValue(Summary summary, BenchmarkCase benchmarkCase, SummaryStyle style)
+        {
+            var statistics = summary[benchmarkCase]?.ResultStatistics;
+            var metrics = Metrics.GetOrAdd(benchmarkCase, Measure);
+
+            if (statistics == null || metrics == null)
+            {
+                return "-";
+            }
+
+            var value = this.getValue(metrics.Value, statistics.Mean);
+            return value.HasValue ? value.Value.ToString(this.format, style.CultureInfo ?? CultureInfo.InvariantCulture) : "-";
+        }
+
+        /// <inheritdoc/>
+        public bool IsAvailable(Summary summary) => true;
+
+        /// <inheritdoc/>
+        public bool IsDefault(Summary summary, BenchmarkCase benchmarkCase) => false;
+
+        /// <inheritdoc/>
+        public override string ToString() => this.ColumnName;
+
+        private static WorkloadMetrics? Measure(BenchmarkCase benchmarkCase)
+        {
+            var type = benchmarkCase.Descriptor.Type;
+
+            if (!typeof(IWorkloadBenchmark).IsAssignableFrom(type))
+            {
+                return null;
+            }
+
+            var benchmark = (IWorkloadBenchmark)Activator.CreateInstance(type);
+
+            try
+            {
+                foreach (var parameter in benchmarkCase.Parameters.Items)
+                {
+                    type.GetProperty(parameter.Name)?.SetValue(benchmark, parameter.Value);
+                }
+
+                benchmark.Setup();
+                return benchmark.Measure();
+            }
+            finally
+            {
+                (benchmark as IDisposable)?.Dispose();
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// Describes the amount of data processed by a single invocation of a benchmark.
+    /// </summary>
+    public struct WorkloadMetrics
+    {
+        /// <summary>
+        /// Initializes a new instance of the <see cref="WorkloadMetrics"/> struct.
+        /// </summary>
+        /// <param name="pixelBytes">
+        /// The size, in bytes, of the pixel data which was processed.
+        /// </param>
+        /// <param name="encodedBytes">
+        /// The size, in bytes, of the encoded data which was produced or consumed, or 0 if the benchmark
+        /// does not encode data.
+        /// </param>
+        public WorkloadMetrics(long pixelBytes, long encodedBytes)
+        {
+            this.PixelBytes = pixelBytes;
+            this.EncodedBytes = encodedBytes;
+        }
+
+        /// <summary>
+        /// Gets the size, in bytes, of the pixel data which was processed.
+        /// </summary>
+        public long PixelBytes { get; }
+
+        /// <summary>
+        /// Gets the size, in bytes, of the encoded data which was produced or consumed.
+        /// </summary>
+        public long EncodedBytes { get; }
+    }
+}
@@ -0,0 +1,260 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.VMware;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.InteropServices;
+
+namespace RemoteViewing.Benchmarks
+{
+    /// <summary>
+    /// Creates the framebuffers which are used as input for the benchmarks.
+    /// </summary>
+    /// <remarks>
+    /// The synthetic workloads are generated using a fixed seed, so every run processes the same pixels.
+    /// </remarks>
+    public static class Workloads
+    {
+        /// <summary>
+        /// The width of the synthetic framebuffers.
+        /// </summary>
+        public const int Width = 1280;
+
+        /// <summary>
+        /// The height of the synthetic framebuffers.
+        /// </summary>
+        public const int Height = 720;
+
+        private const string RecordingPath = "VMware/VS2k5DebugDemo-01.avi";
+        private const int GlyphWidth = 8;
+        private const int GlyphHeight = 16;
+        private const int ScrollStep = 12;
+        private const int CharactersPerFrame = 4;
+        private const uint Background = 0xF0F0F0;
+        private const uint Foreground = 0x202020;
+
+        /// <summary>
+        /// Creates a sequence of frames.
+        /// </summary>
+        /// <param name="kind">
+        /// The type of content of the frames.
+        /// </param>
+        /// <param name="count">
+        /// The number of frames to create.
+        /// </param>
+        /// <returns>
+        /// The frames. Each frame is stored in its own <see cref="VncFramebuffer"/>.
+        /// </returns>
+        public static VncFramebuffer[] CreateFrames(WorkloadKind kind, int count)
+        {
+            switch (kind)
+            {
+                case WorkloadKind.Recorded:
+                    return ReadRecording(count);
+
+                case WorkloadKind.Scrolling:
+                    return CreateScrolling(count);
+
+                case WorkloadKind.Text:
+                    return CreateText(count);
+
+                case WorkloadKind.Noise:
+                    return CreateNoise(count);
+
+                default:
+                    throw new ArgumentOutOfRangeException(nameof(kind));
+            }
+        }
+
+        /// <summary>
+        /// Splits a framebuffer in rectangles which can be sent by an encoder, and copies the contents of each
+        /// rectangle.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The framebuffer to split.
+        /// </param>
+        /// <param name="encoder">
+        /// The encoder which will send the rectangles.
+        /// </param>
+        /// <returns>
+        /// The rectangles which make up the framebuffer.
+        /// </returns>
+        public static List<FramebufferRectangle> Split(VncFramebuffer framebuffer, VncEncoder encoder)
+        {
+            var rectangles = new List<FramebufferRectangle>();
+            int bpp = framebuffer.PixelFormat.BytesPerPixel;
+            int width = Math.Min(framebuffer.Width, encoder.MaximumRectangleWidth);
+            int height = Math.Max(1, Math.Min(framebuffer.Height, encoder.MaximumRectangleArea / width));
+
+            for (int y = 0; y < framebuffer.Height; y += height)
+            {
+                for (int x = 0; x < framebuffer.Width; x += width)
+                {
+                    var region = new VncRectangle(x, y, Math.Min(width, framebuffer.Width - x), Math.Min(height, framebuffer.Height - y));
+                    var contents = new byte[region.Width * region.Height * bpp];
+                    VncPixelFormat.Copy(
+                        framebuffer.GetBuffer(),
+                        framebuffer.Width,
+                        framebuffer.Stride,
+                        framebuffer.PixelFormat,
+                        region,
+                        contents,
+                        region.Width,
+                        region.Width * bpp,
+                        framebuffer.PixelFormat);
+
+                    rectangles.Add(new FramebufferRectangle(region, contents));
+                }
+            }
+
+            return rectangles;
+        }
+
+        private static VncFramebuffer[] ReadRecording(int count)
+        {
+            var path = Path.Combine(Path.GetDirectoryName(typeof(Workloads).Assembly.Location), RecordingPath);
+            var frames = new VncFramebuffer[count];
+
+            using (var reader = VncAviReader.Open(path))
+            {
+                // Spread the frames over the entire recording.
+                for (int i = 0; i < count; i++)
+                {
+                    reader.Seek((int)((long)i * reader.FrameCount / count));
+
+                    var source = reader.Framebuffer;
+                    frames[i] = new VncFramebuffer("Recorded", source.Width, source.Height, source.PixelFormat);
+                    Buffer.BlockCopy(source.GetBuffer(), 0, frames[i].GetBuffer(), 0, source.GetBuffer().Length);
+                }
+            }
+
+            return frames;
+        }
+
+        private static VncFramebuffer[] CreateScrolling(int count)
+        {
+            // Render a document which is large enough to scroll through all frames, and show a different part of it in
+            // every frame.
+            int documentHeight = Height + (count * ScrollStep);
+            var document = new uint[Width * documentHeight];
+            DrawText(document, Width, documentHeight, new Random(1), int.MaxValue);
+
+            var frames = new VncFramebuffer[count];
+
+            for (int i = 0; i < count; i++)
+            {
+                frames[i] = CreateFramebuffer("Scrolling");
+                document.AsSpan(i * ScrollStep * Width, Width * Height).CopyTo(GetPixels(frames[i]));
+            }
+
+            return frames;
+        }
+
+        private static VncFramebuffer[] CreateText(int count)
+        {
+            // Start with a half-filled page of text, and type a few characters in every frame.
+            int columns = Width / GlyphWidth;
+            int characters = columns * (Height / GlyphHeight) / 2;
+            var frames = new VncFramebuffer[count];
+
+            for (int i = 0; i < count; i++)
+            {
+                frames[i] = CreateFramebuffer("Text");
+                DrawText(GetPixels(frames[i]), Width, Height, new Random(2), characters + (i * CharactersPerFrame));
+            }
+
+            return frames;
+        }
+
+        private static VncFramebuffer[] CreateNoise(int count)
+        {
+            var random = new Random(3);
+            var frames = new VncFramebuffer[count];
+
+            for (int i = 0; i < count; i++)
+            {
+                frames[i] = CreateFramebuffer("Noise");
+                random.NextBytes(frames[i].GetBuffer());
+            }
+
+            return frames;
+        }
+
+        private static VncFramebuffer CreateFramebuffer(string name)
+        {
+            return new VncFramebuffer(name, Width, Height, VncPixelFormat.RGB32);
+        }
+
+        private static Span<uint> GetPixels(VncFramebuffer framebuffer)
+        {
+            return MemoryMarshal.Cast<byte, uint>(framebuffer.GetBuffer().AsSpan());
+        }
+
+        private static void DrawText(Span<uint> pixels, int width, int height, Random random, int characters)
+        {
+            pixels.Fill(Background);
+
+            // Each glyph is a random 6x10 bitmap; glyph 0 is a space.
+            var glyphs = new ulong[64];
+
+            for (int i = 1; i < glyphs.Length; i++)
+            {
+                glyphs[i] = ((ulong)random.Next() << 31) ^ (ulong)random.Next();
+            }
+
+            int columns = width / GlyphWidth;
+            int rows = height / GlyphHeight;
+
+            for (int i = 0; i < characters && i < columns * rows; i++)
+            {
+                // Short words, separated by spaces, and a few empty lines.
+                int column = i % columns;
+                int row = i / columns;
+                bool isSpace = random.Next(6) == 0 || row % 7 == 6;
+                var glyph = isSpace ? glyphs[0] : glyphs[1 + random.Next(glyphs.Length - 1)];
+
+                for (int y = 0; y < 10; y++)
+                {
+                    var line = pixels.Slice((((row * GlyphHeight) + 3 + y) * width) + (column * GlyphWidth) + 1, 6);
+
+                    for (int x = 0; x < 6; x++)
+                    {
+                        if ((glyph & (1UL << ((y * 6) + x))) != 0)
+                        {
+                            line[x] = Foreground;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -32,6 +32,11 @@
 // As a workaround, this library defines a function which takes care
 // of message formatting in C and then invokes a delegate (which can
 // be in managed code) with the formatted message.
+//
+// Messages are not passed to the delegate on the libvncserver thread which
+// logs them. Instead, they are formatted into a preallocated ring buffer,
+// which the managed side drains on its own thread by calling LogDrain. If
+// the ring buffer is full, the message is dropped and counted.
 
 #if defined (WIN32)
 #define _CRT_SECURE_NO_WARNINGS
@@ -44,40 +49,155 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include "rfb/rfb.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SSE2 is part of the x64 baseline and NEON is part of the arm64 baseline, so no
+// additional compiler flags are required to use them.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VNCLOGGER_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VNCLOGGER_NEON
+#include <arm_neon.h>
+#endif
+
+// The number of entries in the log ring buffer. Must be a power of two.
+#define LOG_RING_SIZE 512
+
+// The maximum length of a single log message, including the terminating null character.
+// Longer messages are truncated.
+#define LOG_MESSAGE_SIZE 256
+
 typedef void (*LogProc)(int level, char* message, int length);
 
+typedef struct
+{
+    // The sequence number of this entry, relative to its index in the ring buffer (so that
+    // a zero-initialized ring buffer is valid). An entry at index i is free for the producer
+    // at position p when sequence + i == p, and holds a message for the consumer at position
+    // p when sequence + i == p + 1.
+    volatile long sequence;
+    int level;
+    int length;
+    char message[LOG_MESSAGE_SIZE];
+} LogEntry;
+
 DllExport LogProc logCallback = NULL;
 
-static void Log(int level, const char* format, va_list args)
+// Messages with a level below this value are discarded before they are formatted.
+// 0 logs all messages, 1 only logs errors and 2 disables logging.
+DllExport volatile int logMinimumLevel = 0;
+
+static LogEntry logRing[LOG_RING_SIZE];
+static volatile long logEnqueuePosition = 0;
+static volatile long logDroppedCount = 0;
+static unsigned long logDequeuePosition = 0;
+
+static long
+AtomicLoad(volatile long* value)
+{
+#if defined(_MSC_VER)
+    return _InterlockedOr(value, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void
+AtomicStore(volatile long* value, long newValue)
 {
 #if defined(_MSC_VER)
-    int length = vsnprintf(NULL, 0, format, args) + 1;
+    _InterlockedExchange(value, newValue);
+#else
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+#endif
+}
 
-    char* buffer = (char*)malloc(length * sizeof(char));
+static int
+AtomicCompareExchange(volatile long* value, long expected, long newValue)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange(value, newValue, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(value, &expected, newValue, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
 
-    if (buffer != NULL)
+static void
+AtomicIncrement(volatile long* value)
+{
+#if defined(_MSC_VER)
+    _InterlockedIncrement(value);
+#else
+    __atomic_fetch_add(value, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static void Log(int level, const char* format, va_list args)
+{
+    unsigned long position;
+    unsigned long index;
+    LogEntry* entry;
+    int length;
+
+    if (level < logMinimumLevel)
     {
-        vsprintf(buffer, format, args);
+        return;
+    }
 
-        logCallback(level, buffer, length - 1);
+    // Claim an entry. This is safe for multiple producers: the position is only advanced
+    // by the thread which wins the compare-exchange.
+    for (;;)
+    {
+        long distance;
+
+        position = (unsigned long)AtomicLoad(&logEnqueuePosition);
+        index = position & (LOG_RING_SIZE - 1);
+        entry = &logRing[index];
+        distance = (long)((unsigned long)AtomicLoad(&entry->sequence) + index - position);
+
+        if (distance == 0)
+        {
+            if (AtomicCompareExchange(&logEnqueuePosition, (long)position, (long)(position + 1)))
+            {
+                break;
+            }
+        }
+        else if (distance < 0)
+        {
+            // The consumer has not yet drained this entry; drop the message rather than block.
+            AtomicIncrement(&logDroppedCount);
+            return;
+        }
+    }
+
+    length = vsnprintf(entry->message, LOG_MESSAGE_SIZE, format, args);
 
-        free(buffer);
+    if (length < 0)
+    {
+        length = 0;
+        entry->message[0] = '\0';
+    }
+    else if (length >= LOG_MESSAGE_SIZE)
+    {
+        length = LOG_MESSAGE_SIZE - 1;
     }
-#else
-   char* buffer = NULL;
-   int length = 0;
 
-   length = vasprintf(&buffer, format, args);
+    // libvncserver terminates most messages with a newline
+    if (length > 0 && entry->message[length - 1] == '\n')
+    {
+        entry->message[--length] = '\0';
+    }
 
-   if (buffer != NULL)
-   {
-       logCallback(level, buffer, length);
+    entry->level = level;
+    entry->length = length;
 
-       free(buffer);
-   }
-#endif
+    AtomicStore(&entry->sequence, (long)(position + 1 - index));
 }
 
 DllExport void
@@ -102,6 +222,45 @@ LogError(const char* format, ...)
     va_end(args);
 }
 
+// Passes at most maxCount queued messages to logCallback, on the calling thread.
+// Returns the number of messages which were drained. This function must not be
+// called by more than one thread at a time.
+DllExport int
+LogDrain(int maxCount)
+{
+    int count = 0;
+
+    while (count < maxCount)
+    {
+        unsigned long index = logDequeuePosition & (LOG_RING_SIZE - 1);
+        LogEntry* entry = &logRing[index];
+
+        if ((unsigned long)AtomicLoad(&entry->sequence) + index != logDequeuePosition + 1)
+        {
+            break;
+        }
+
+        if (logCallback != NULL)
+        {
+            logCallback(entry->level, entry->message, entry->length);
+        }
+
+        // Release the entry to the producer which will claim it on the next lap.
+        AtomicStore(&entry->sequence, (long)(logDequeuePosition + LOG_RING_SIZE - index));
+        logDequeuePosition++;
+        count++;
+    }
+
+    return count;
+}
+
+// Returns the number of messages which were dropped because the ring buffer was full.
+DllExport int
+LogGetDroppedCount()
+{
+    return (int)AtomicLoad(&logDroppedCount);
+}
+
 DllExport int
 rfbScreenInfo_get_width(rfbScreenInfoPtr rfbScreen)
 {
@@ -319,3 +478,210 @@ rfbClient_get_authChallenge(rfbClientPtr rfbClient, uint8_t* authChallenge)
 {
     memcpy(authChallenge, rfbClient->authChallenge, CHALLENGESIZE);
 }
+
+DllExport int
+rfbClient_get_preferredEncoding(rfbClientPtr rfbClient)
+{
+    return rfbClient->preferredEncoding;
+}
+
+DllExport int
+rfbClient_get_bytesSent(rfbClientPtr rfbClient)
+{
+    return rfbStatGetSentBytes(rfbClient);
+}
+
+DllExport int
+rfbClient_get_framebufferUpdatesSent(rfbClientPtr rfbClient)
+{
+    return rfbStatGetMessageCountSent(rfbClient, rfbFramebufferUpdate);
+}
+
+// The number of bytes in the update buffer which have not yet been written to the socket.
+DllExport int
+rfbClient_get_pendingOutput(rfbClientPtr rfbClient)
+{
+    return rfbClient->ublen;
+}
+
+typedef struct
+{
+    uint32_t encoding;
+    uint32_t rectangles;
+    uint32_t bytesSent;
+    uint32_t bytesSentIfRaw;
+} rfbEncodingStatistics;
+
+// Copies the statistics of at most count encodings which were sent to the client into
+// statistics, and returns the total number of encodings for which statistics are available.
+DllExport int
+rfbClient_get_encodingStatistics(rfbClientPtr rfbClient, rfbEncodingStatistics* statistics, int count)
+{
+    rfbStatList* entry;
+    int total = 0;
+
+    for (entry = rfbClient->statEncList; entry != NULL; entry = entry->Next)
+    {
+        if (total < count)
+        {
+            statistics[total].encoding = entry->type;
+            statistics[total].rectangles = entry->sentCount;
+            statistics[total].bytesSent = entry->bytesSent;
+            statistics[total].bytesSentIfRaw = entry->bytesSentIfRaw;
+        }
+
+        total++;
+    }
+
+    return total;
+}
+
+// Returns a non-zero value if the first length bytes of a and b are equal.
+static int
+SpanEquals(const char* a, const char* b, int length)
+{
+    int i = 0;
+
+#if defined(VNCLOGGER_SSE2)
+    for (; i + 32 <= length; i += 32)
+    {
+        __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 16)), _mm_loadu_si128((const __m128i*)(b + i + 16)));
+
+        if (_mm_movemask_epi8(_mm_and_si128(eq0, eq1)) != 0xFFFF)
+        {
+            return 0;
+        }
+    }
+
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+        {
+            return 0;
+        }
+    }
+#elif defined(VNCLOGGER_NEON)
+    for (; i + 32 <= length; i += 32)
+    {
+        uint8x16_t diff0 = veorq_u8(vld1q_u8((const uint8_t*)(a + i)), vld1q_u8((const uint8_t*)(b + i)));
+        uint8x16_t diff1 = veorq_u8(vld1q_u8((const uint8_t*)(a + i + 16)), vld1q_u8((const uint8_t*)(b + i + 16)));
+
+        if (vmaxvq_u8(vorrq_u8(diff0, diff1)) != 0)
+        {
+            return 0;
+        }
+    }
+
+    for (; i + 16 <= length; i += 16)
+    {
+        uint8x16_t diff = veorq_u8(vld1q_u8((const uint8_t*)(a + i)), vld1q_u8((const uint8_t*)(b + i)));
+
+        if (vmaxvq_u8(diff) != 0)
+        {
+            return 0;
+        }
+    }
+#endif
+
+    return memcmp(a + i, b + i, length - i) == 0;
+}
+
+// Copies the frame in source into the framebuffer of rfbScreen, but only those
+// tileSize x tileSize tiles which have actually changed. Each horizontal run of
+// changed tiles is marked as modified, so libvncserver only re-encodes those regions.
+// The source frame must have the same size and pixel format as the framebuffer.
+// Returns the number of changed tiles, or -1 if the arguments are invalid.
+DllExport int
+rfbScreenInfo_update_frameBuffer(rfbScreenInfoPtr rfbScreen, const char* source, int stride, int tileSize)
+{
+    int bytesPerPixel = rfbScreen->serverFormat.bitsPerPixel / 8;
+    int targetStride = rfbScreen->paddedWidthInBytes;
+    int width = rfbScreen->width;
+    int height = rfbScreen->height;
+    int tilesX;
+    int changed = 0;
+    int tileY;
+    char* dirty;
+
+    if (source == NULL || rfbScreen->frameBuffer == NULL || tileSize <= 0 || bytesPerPixel == 0 || stride < width * bytesPerPixel)
+    {
+        return -1;
+    }
+
+    tilesX = (width + tileSize - 1) / tileSize;
+    dirty = (char*)malloc(tilesX);
+
+    if (dirty == NULL)
+    {
+        return -1;
+    }
+
+    for (tileY = 0; tileY < height; tileY += tileSize)
+    {
+        int tileHeight = height - tileY < tileSize ? height - tileY : tileSize;
+        int remaining = tilesX;
+        int tile;
+        int y;
+
+        memset(dirty, 0, tilesX);
+
+        // Walk the band row by row, so both buffers are read sequentially; tiles which are
+        // already known to have changed are skipped.
+        for (y = tileY; y < tileY + tileHeight && remaining > 0; y++)
+        {
+            const char* sourceRow = source + (size_t)y * stride;
+            const char* targetRow = rfbScreen->frameBuffer + (size_t)y * targetStride;
+
+            for (tile = 0; tile < tilesX; tile++)
+            {
+                int x = tile * tileSize;
+                int tileWidth = width - x < tileSize ? width - x : tileSize;
+                int offset = x * bytesPerPixel;
+
+                if (!dirty[tile] && !SpanEquals(sourceRow + offset, targetRow + offset, tileWidth * bytesPerPixel))
+                {
+                    dirty[tile] = 1;
+                    remaining--;
+                }
+            }
+        }
+
+        for (tile = 0; tile < tilesX;)
+        {
+            int first = tile;
+            int x1;
+            int x2;
+
+            if (!dirty[tile])
+            {
+                tile++;
+                continue;
+            }
+
+            while (tile < tilesX && dirty[tile])
+            {
+                tile++;
+            }
+
+            x1 = first * tileSize;
+            x2 = tile * tileSize < width ? tile * tileSize : width;
+
+            for (y = tileY; y < tileY + tileHeight; y++)
+            {
+                memcpy(
+                    rfbScreen->frameBuffer + (size_t)y * targetStride + x1 * bytesPerPixel,
+                    source + (size_t)y * stride + x1 * bytesPerPixel,
+                    (size_t)(x2 - x1) * bytesPerPixel);
+            }
+
+            rfbMarkRectAsModified(rfbScreen, x1, tileY, x2, tileY + tileHeight);
+            changed += tile - first;
+        }
+    }
+
+    free(dirty);
+    return changed;
+}
@@ -31,6 +31,7 @@ using Microsoft.Extensions.Logging;
 using System;
 using System.Reflection;
 using System.Runtime.InteropServices;
+using System.Threading;
 
 namespace RemoteViewing.LibVnc.Interop
 {
@@ -56,6 +57,11 @@ namespace RemoteViewing.LibVnc.Interop
         /// </summary>
         public const CallingConvention LibraryCallingConvention = CallingConvention.Cdecl;
 
+        /// <summary>
+        /// The maximum number of messages which are drained from the <c>vnclogger</c> ring buffer at once.
+        /// </summary>
+        private const int DrainBatchSize = 64;
+
         /// <summary>
         /// The address of the <c>rfblog</c> field in the <c>vncserver</c> library.
         /// </summary>
@@ -86,6 +92,11 @@ namespace RemoteViewing.LibVnc.Interop
         /// </summary>
         public static readonly IntPtr LogCallback;
 
+        /// <summary>
+        /// The address of the <c>logMinimumLevel</c> field in the <c>vnclogger</c> library.
+        /// </summary>
+        public static readonly IntPtr LogMinimumLevel;
+
         /// <summary>
         /// An instance of the delegate which will be used by the <c>vnclogger</c> library.
         /// </summary>
@@ -96,6 +107,16 @@ namespace RemoteViewing.LibVnc.Interop
         /// </summary>
         public static readonly IntPtr LogCallbackPtr;
 
+        /// <summary>
+        /// The time to wait before draining the <c>vnclogger</c> ring buffer again, once it is empty.
+        /// </summary>
+        private static readonly TimeSpan DrainInterval = TimeSpan.FromMilliseconds(50);
+
+        private static readonly Thread DrainThread;
+
+        private static ILogger logger;
+        private static int droppedCount;
+
         /// <summary>
         /// Initializes static members of the <see cref="NativeLogging"/> class.
         /// </summary>
@@ -111,6 +132,7 @@ namespace RemoteViewing.LibVnc.Interop
             LogMessage = NativeLibrary.GetExport(LoggerLibrary, "LogMessage");
             LogError = NativeLibrary.GetExport(LoggerLibrary, "LogError");
             LogCallback = NativeLibrary.GetExport(LoggerLibrary, "logCallback");
+            LogMinimumLevel = NativeLibrary.GetExport(LoggerLibrary, "logMinimumLevel");
 
             var vncServer = NativeLibraryLoader.ResolveDll(ServerLibraryName, typeof(LibVncServer).Assembly, null);
 
@@ -135,6 +157,14 @@ namespace RemoteViewing.LibVnc.Interop
             LogCallbackDelegate = new LogCallbackDelegateDefinition(RfbLogCallback);
             LogCallbackPtr = Marshal.GetFunctionPointerForDelegate(LogCallbackDelegate);
             Marshal.WriteIntPtr(NativeLogging.LogCallback, LogCallbackPtr);
+            UpdateMinimumLevel();
+
+            // vnclogger only queues log messages; they are passed to the logger on a dedicated thread,
+            // so that logging never blocks the libvncserver threads.
+            DrainThread = new Thread(DrainLoop);
+            DrainThread.Name = "vnclogger";
+            DrainThread.IsBackground = true;
+            DrainThread.Start();
         }
 
         /// <summary>
@@ -152,25 +182,88 @@ namespace RemoteViewing.LibVnc.Interop
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         public delegate void LogCallbackDelegateDefinition(int level, IntPtr message, int length);
 
-        public static ILogger Logger { get; set; }
+        /// <summary>
+        /// Gets or sets the logger to which libvncserver log messages are written. Messages at levels which
+        /// are not enabled for this logger are discarded by libvncserver before they are formatted.
+        /// </summary>
+        public static ILogger Logger
+        {
+            get
+            {
+                return logger;
+            }
+
+            set
+            {
+                logger = value;
+                UpdateMinimumLevel();
+            }
+        }
+
+        private static void UpdateMinimumLevel()
+        {
+            var current = Logger;
+            int level;
+
+            if (current != null && current.IsEnabled(LogLevel.Information))
+            {
+                level = 0;
+            }
+            else if (current != null && current.IsEnabled(LogLevel.Error))
+            {
+                level = 1;
+            }
+            else
+            {
+                level = 2;
+            }
+
+            Marshal.WriteInt32(LogMinimumLevel, level);
+        }
+
+        private static void DrainLoop()
+        {
+            while (true)
+            {
+                // The logger configuration may have changed since the last iteration.
+                UpdateMinimumLevel();
+
+                int drained = NativeMethods.LogDrain(DrainBatchSize);
+
+                int dropped = NativeMethods.LogGetDroppedCount();
+
+                if (dropped != droppedCount)
+                {
+                    Logger?.LogWarning($"{dropped - droppedCount} libvncserver log messages were dropped because the log buffer was full.");
+                    droppedCount = dropped;
+                }
+
+                if (drained < DrainBatchSize)
+                {
+                    Thread.Sleep(DrainInterval);
+                }
+            }
+        }
 
         private static void RfbLogCallback(int level, IntPtr message, int length)
         {
-            if (Logger == null)
+            var current = Logger;
+
+            if (current == null)
             {
                 return;
             }
 
-            // Skip the terminating terminating newline character
-            var text = Marshal.PtrToStringAnsi(message, length - 1);
+            // vnclogger has already stripped the terminating newline character
+            var text = Marshal.PtrToStringAnsi(message, length);
 
             if (level == 1)
             {
-                Logger.LogError(text);
+                current.LogError(text);
             }
             else
             {
-                Logger.LogInformation(text);
+                current.LogInformation(text);
             }
         }
     }
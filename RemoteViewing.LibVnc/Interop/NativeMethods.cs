@@ -419,6 +419,15 @@ namespace RemoteViewing.LibVnc.Interop
         [DllImport(LibraryName, CallingConvention = LibraryCallingConvention, EntryPoint = "rfbReverseConnection")]
         public static extern void* rfbReverseConnection(RfbScreenInfoPtr rfbScreen, byte* host, int port);
 
+        /// <summary>
+        /// Closes the connection with a client.
+        /// </summary>
+        /// <param name="cl">
+        /// The client to disconnect.
+        /// </param>
+        [DllImport(LibraryName, CallingConvention = LibraryCallingConvention, EntryPoint = "rfbCloseClient")]
+        public static extern void rfbCloseClient(IntPtr cl);
+
         [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
         public static extern int rfbScreenInfo_get_width(IntPtr rfbScreen);
 
@@ -520,5 +529,64 @@ namespace RemoteViewing.LibVnc.Interop
 
         [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
         public static extern void rfbClient_get_authChallenge(IntPtr rfbClient, void* authChallenge);
+
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int rfbClient_get_preferredEncoding(IntPtr rfbClient);
+
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int rfbClient_get_bytesSent(IntPtr rfbClient);
+
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int rfbClient_get_framebufferUpdatesSent(IntPtr rfbClient);
+
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int rfbClient_get_pendingOutput(IntPtr rfbClient);
+
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int rfbClient_get_encodingStatistics(IntPtr rfbClient, RfbEncodingStatistics* statistics, int count);
+
+        /// <summary>
+        /// Passes the log messages which are queued in the <c>vnclogger</c> ring buffer to the <c>logCallback</c>
+        /// delegate, on the calling thread.
+        /// </summary>
+        /// <param name="maxCount">
+        /// The maximum number of messages to drain.
+        /// </param>
+        /// <returns>
+        /// The number of messages which were drained.
+        /// </returns>
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int LogDrain(int maxCount);
+
+        /// <summary>
+        /// Gets the number of log messages which were dropped because the <c>vnclogger</c> ring buffer was full.
+        /// </summary>
+        /// <returns>
+        /// The number of dropped log messages.
+        /// </returns>
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int LogGetDroppedCount();
+
+        /// <summary>
+        /// Copies the tiles of a frame which differ from the server framebuffer into that framebuffer,
+        /// and marks only those tiles as modified.
+        /// </summary>
+        /// <param name="rfbScreen">
+        /// The server structure.
+        /// </param>
+        /// <param name="source">
+        /// The new frame. It must have the same size and pixel format as the server framebuffer.
+        /// </param>
+        /// <param name="stride">
+        /// The number of bytes between one row of <paramref name="source"/> and the next.
+        /// </param>
+        /// <param name="tileSize">
+        /// The width and height of the tiles which are compared, in pixels.
+        /// </param>
+        /// <returns>
+        /// The number of tiles which have changed, or -1 if the arguments are invalid.
+        /// </returns>
+        [DllImport(InteropLibraryName, CallingConvention = LibraryCallingConvention)]
+        public static extern int rfbScreenInfo_update_frameBuffer(RfbScreenInfoPtr rfbScreen, byte* source, int stride, int tileSize);
     }
 }
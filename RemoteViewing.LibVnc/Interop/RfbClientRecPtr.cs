@@ -189,7 +189,7 @@ namespace RemoteViewing.LibVnc.Interop
         /// </summary>
         public VncEncoding PreferredEncoding
         {
-            get { throw new NotImplementedException(); }
+            get { return (VncEncoding)NativeMethods.rfbClient_get_preferredEncoding(this.handle); }
         }
 
         /// <summary>
@@ -237,6 +237,49 @@ namespace RemoteViewing.LibVnc.Interop
             }
         }
 
+        /// <summary>
+        /// Gets the total number of bytes which were sent to the client.
+        /// </summary>
+        public int BytesSent
+        {
+            get { return NativeMethods.rfbClient_get_bytesSent(this.handle); }
+        }
+
+        /// <summary>
+        /// Gets the number of framebuffer updates which were sent to the client.
+        /// </summary>
+        public int FramebufferUpdatesSent
+        {
+            get { return NativeMethods.rfbClient_get_framebufferUpdatesSent(this.handle); }
+        }
+
+        /// <summary>
+        /// Gets the number of bytes in the update buffer which have not yet been sent to the client.
+        /// </summary>
+        public int PendingOutput
+        {
+            get { return NativeMethods.rfbClient_get_pendingOutput(this.handle); }
+        }
+
+        /// <summary>
+        /// Gets statistics about the rectangles which were sent to the client, for each encoding.
+        /// </summary>
+        public unsafe RfbEncodingStatistics[] EncodingStatistics
+        {
+            get
+            {
+                var statistics = new RfbEncodingStatistics[NativeMethods.rfbClient_get_encodingStatistics(this.handle, null, 0)];
+
+                fixed (RfbEncodingStatistics* statisticsPtr = statistics)
+                {
+                    // libvncserver may have started using a new encoding in the meantime; that encoding is not included.
+                    NativeMethods.rfbClient_get_encodingStatistics(this.handle, statisticsPtr, statistics.Length);
+                }
+
+                return statistics;
+            }
+        }
+
         /// <summary>
         /// Gets or sets a pointer to a <see cref="NativeMethods.ClientFramebufferUpdateRequestHookPtr"/> delegate which is invoked
         /// when the client requests a framebuffer update.
@@ -0,0 +1,59 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System.Runtime.InteropServices;
+
+namespace RemoteViewing.LibVnc.Interop
+{
+    /// <summary>
+    /// Statistics about the rectangles which were sent to a client using a single encoding.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct RfbEncodingStatistics
+    {
+        /// <summary>
+        /// The encoding (or pseudo-encoding) which was used.
+        /// </summary>
+        public uint Encoding;
+
+        /// <summary>
+        /// The number of rectangles which were sent using this encoding.
+        /// </summary>
+        public uint Rectangles;
+
+        /// <summary>
+        /// The number of bytes which were sent using this encoding.
+        /// </summary>
+        public uint BytesSent;
+
+        /// <summary>
+        /// The number of bytes which would have been sent if the rectangles were sent using the raw encoding.
+        /// </summary>
+        public uint BytesSentIfRaw;
+    }
+}
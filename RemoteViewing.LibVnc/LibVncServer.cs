@@ -45,6 +45,11 @@ namespace RemoteViewing.LibVnc
 {
     public unsafe class LibVncServer : IVncServer
     {
+        /// <summary>
+        /// The size of the tiles, in pixels, in which the framebuffer is compared with the previous frame.
+        /// </summary>
+        private const int TileSize = 32;
+
         private readonly ILogger logger;
         private readonly IVncPasswordChallenge passwordChallenge;
 
@@ -66,7 +71,15 @@ namespace RemoteViewing.LibVnc
         private readonly IntPtr rfbPtrAddEventProcPtr;
         private readonly IntPtr rfbPasswordCheckProcPtr;
 
+        private readonly object sessionsLock = new object();
+        private readonly List<LibVncServerSession> sessions = new List<LibVncServerSession>();
+
         private readonly MemoryPool<byte> memoryPool = MemoryPool<byte>.Shared;
+
+        // The damage reported by the framebuffer source, if it is an IVncFramebufferDamageSource.
+        private readonly List<VncRectangle> damage = new List<VncRectangle>();
+        private long damageSequence = -1;
+
         private IMemoryOwner<byte> currentFramebuffer = null;
         private MemoryHandle currentFramebufferHandle = default;
 
@@ -118,7 +131,16 @@ namespace RemoteViewing.LibVnc
         public event EventHandler<PasswordProvidedEventArgs> PasswordProvided;
 
         /// <inheritdoc/>
-        public IReadOnlyList<IVncServerSession> Sessions => throw new NotImplementedException();
+        public IReadOnlyList<IVncServerSession> Sessions
+        {
+            get
+            {
+                lock (this.sessionsLock)
+                {
+                    return this.sessions.ToArray();
+                }
+            }
+        }
 
         /// <inheritdoc/>
         public Task StartAsync(IPEndPoint endPoint, CancellationToken cancellationToken)
@@ -232,6 +254,15 @@ namespace RemoteViewing.LibVnc
                 client.ClientFramebufferUpdateRequestHook = this.clientFramebufferUpdateRequestHookPtr;
             }
 
+            var session = new LibVncServerSession(client, this.sessionsLock, this.logger);
+
+            lock (this.sessionsLock)
+            {
+                this.sessions.Add(session);
+            }
+
+            LibVncServerEventSource.Instance.AddSession(session);
+
             this.Connected?.Invoke(this, EventArgs.Empty);
 
             return RfbNewClientAction.RFB_CLIENT_ACCEPT;
@@ -248,6 +279,19 @@ namespace RemoteViewing.LibVnc
             RfbClientRecPtr client = new RfbClientRecPtr(cl, false);
             this.logger.LogInformation("A client disconnected.");
 
+            var session = this.FindSession(cl);
+
+            if (session != null)
+            {
+                lock (this.sessionsLock)
+                {
+                    this.sessions.Remove(session);
+                }
+
+                LibVncServerEventSource.Instance.RemoveSession(session);
+                session.OnClosed();
+            }
+
             this.Closed?.Invoke(this, EventArgs.Empty);
         }
 
@@ -256,11 +300,12 @@ namespace RemoteViewing.LibVnc
             RfbClientRecPtr client = new RfbClientRecPtr(cl, false);
             this.logger.LogInformation($"Pressed button {keySym}");
 
-            this.keyboard?.HandleKeyEvent(
-                this,
-                new KeyChangedEventArgs(
-                    keysym: keySym,
-                    pressed: down == 1));
+            var e = new KeyChangedEventArgs(
+                keysym: keySym,
+                pressed: down == 1);
+
+            this.keyboard?.HandleKeyEvent(this, e);
+            this.FindSession(cl)?.OnKeyChanged(e);
         }
 
         protected void RfbPtrAddEventHook(int buttonMask, int x, int y, IntPtr cl)
@@ -268,9 +313,10 @@ namespace RemoteViewing.LibVnc
             RfbClientRecPtr client = new RfbClientRecPtr(cl, false);
             this.logger.LogInformation($"Mouse event at ({x},{y})");
 
-            this.controller?.HandleTouchEvent(
-                this,
-                new PointerChangedEventArgs(x, y, buttonMask));
+            var e = new PointerChangedEventArgs(x, y, buttonMask);
+
+            this.controller?.HandleTouchEvent(this, e);
+            this.FindSession(cl)?.OnPointerChanged(e);
         }
 
         protected bool RfbPasswordCheckHook(IntPtr cl, sbyte* encryptedPassWord, int len)
@@ -318,11 +364,78 @@ namespace RemoteViewing.LibVnc
 
                 oldFramebufferHandle.Dispose();
                 oldFramebuffer.Dispose();
+
+                this.damageSequence = -1;
+            }
+            else if (this.fbSource is IVncFramebufferDamageSource damageSource && this.TryCopyDamage(damageSource, fb))
+            {
+                // Only the regions which the source reported as changed have been copied.
             }
             else
             {
-                fb.GetBuffer().CopyTo(this.currentFramebuffer.Memory);
-                NativeMethods.rfbMarkRectAsModified(server, 0, 0, fb.Width, fb.Height);
+                // Only copy and re-encode the tiles which have actually changed.
+                fixed (byte* buffer = fb.GetBuffer())
+                {
+                    if (NativeMethods.rfbScreenInfo_update_frameBuffer(server, buffer, fb.Stride, TileSize) < 0)
+                    {
+                        fb.GetBuffer().CopyTo(this.currentFramebuffer.Memory);
+                        NativeMethods.rfbMarkRectAsModified(server, 0, 0, fb.Width, fb.Height);
+                    }
+                }
+            }
+        }
+
+        private bool TryCopyDamage(IVncFramebufferDamageSource source, VncFramebuffer fb)
+        {
+            lock (fb.SyncRoot)
+            {
+                long sequence = source.FrameSequence;
+
+                if (sequence == this.damageSequence)
+                {
+                    return true;
+                }
+
+                this.damage.Clear();
+                bool isKnown = this.damageSequence >= 0 && source.TryGetDamage(this.damageSequence, this.damage);
+                this.damageSequence = sequence;
+
+                if (!isKnown)
+                {
+                    return false;
+                }
+
+                var buffer = fb.GetBuffer();
+                var target = this.currentFramebuffer.Memory.Span;
+                int bpp = fb.PixelFormat.BytesPerPixel;
+                int stride = fb.Width * bpp;
+
+                foreach (var damage in this.damage)
+                {
+                    var region = VncRectangle.Intersect(damage, new VncRectangle(0, 0, fb.Width, fb.Height));
+
+                    if (region.IsEmpty)
+                    {
+                        continue;
+                    }
+
+                    for (int y = region.Y; y < region.Y + region.Height; y++)
+                    {
+                        buffer.AsSpan((y * fb.Stride) + (region.X * bpp), region.Width * bpp).CopyTo(target.Slice((y * stride) + (region.X * bpp)));
+                    }
+
+                    NativeMethods.rfbMarkRectAsModified(this.server, region.X, region.Y, region.X + region.Width, region.Y + region.Height);
+                }
+
+                return true;
+            }
+        }
+
+        private LibVncServerSession FindSession(IntPtr cl)
+        {
+            lock (this.sessionsLock)
+            {
+                return this.sessions.Find(s => s.Represents(cl));
             }
         }
 
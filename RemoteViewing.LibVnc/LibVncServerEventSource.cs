@@ -1,4 +1,6 @@
-﻿using System.Diagnostics.Tracing;
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics.Tracing;
 using System.Threading;
 
 namespace RemoteViewing.LibVnc
@@ -19,6 +21,8 @@ namespace RemoteViewing.LibVnc
         private readonly PollingCounter updateFramebufferCounter;
         private readonly PollingCounter processServerEventsCounter;
 
+        private readonly Dictionary<LibVncServerSession, DiagnosticCounter[]> sessionCounters = new Dictionary<LibVncServerSession, DiagnosticCounter[]>();
+
         private int updateFramebufferCount;
         private int processServerEventsCount;
 #endif
@@ -98,6 +102,70 @@ namespace RemoteViewing.LibVnc
 #if NET5_0_OR_GREATER
             this.processServerEventsDurationCounter.WriteMetric(elapsedMilliseconds);
             Interlocked.Increment(ref this.processServerEventsCount);
+#endif
+        }
+
+        /// <summary>
+        /// Starts publishing the counters of a session: the rate at which bytes and framebuffer updates are sent
+        /// to the client, and the number of bytes which are waiting to be sent.
+        /// </summary>
+        /// <param name="session">
+        /// The session for which to publish counters.
+        /// </param>
+        public void AddSession(LibVncServerSession session)
+        {
+#if NET5_0_OR_GREATER
+            var counters = new DiagnosticCounter[]
+            {
+                new IncrementingPollingCounter($"session-{session.Id}-bytes-sent", this, () => session.BytesSent)
+                {
+                    DisplayName = $"Bytes sent to {session.Host}",
+                    DisplayUnits = "B",
+                    DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+                },
+                new IncrementingPollingCounter($"session-{session.Id}-update-framebuffer-count", this, () => session.FramebufferUpdatesSent)
+                {
+                    DisplayName = $"Framebuffer updates sent to {session.Host}",
+                    DisplayUnits = "#",
+                    DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+                },
+                new PollingCounter($"session-{session.Id}-pending-output", this, () => session.PendingOutput)
+                {
+                    DisplayName = $"Bytes waiting to be sent to {session.Host}",
+                    DisplayUnits = "B",
+                },
+            };
+
+            lock (this.sessionCounters)
+            {
+                this.sessionCounters.Add(session, counters);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Stops publishing the counters of a session.
+        /// </summary>
+        /// <param name="session">
+        /// The session for which to stop publishing counters.
+        /// </param>
+        public void RemoveSession(LibVncServerSession session)
+        {
+#if NET5_0_OR_GREATER
+            DiagnosticCounter[] counters;
+
+            lock (this.sessionCounters)
+            {
+                if (!this.sessionCounters.Remove(session, out counters))
+                {
+                    return;
+                }
+            }
+
+            foreach (var counter in counters)
+            {
+                counter.Dispose();
+            }
 #endif
         }
     }
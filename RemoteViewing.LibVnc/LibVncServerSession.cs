@@ -0,0 +1,379 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Microsoft.Extensions.Logging;
+using RemoteViewing.LibVnc.Interop;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+
+namespace RemoteViewing.LibVnc
+{
+    /// <summary>
+    /// Represents a client which is connected to a <see cref="LibVncServer"/>.
+    /// </summary>
+    /// <remarks>
+    /// The connection is managed by libvncserver, so this class mainly exposes the state and statistics
+    /// which libvncserver maintains for the client. Members which only apply to the managed VNC server
+    /// throw a <see cref="NotSupportedException"/>.
+    /// </remarks>
+    public class LibVncServerSession : IVncServerSession
+    {
+        private static int lastId;
+
+        private readonly RfbClientRecPtr client;
+        private readonly object syncRoot;
+        private readonly object framebufferUpdateRequestLock = new object();
+
+        private bool isClosed;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="LibVncServerSession"/> class.
+        /// </summary>
+        /// <param name="client">
+        /// The libvncserver client.
+        /// </param>
+        /// <param name="syncRoot">
+        /// The lock which is held by the <see cref="LibVncServer"/> while the client disconnects.
+        /// </param>
+        /// <param name="logger">
+        /// The logger to use when logging.
+        /// </param>
+        internal LibVncServerSession(RfbClientRecPtr client, object syncRoot, ILogger logger)
+        {
+            this.client = client ?? throw new ArgumentNullException(nameof(client));
+            this.syncRoot = syncRoot ?? throw new ArgumentNullException(nameof(syncRoot));
+            this.Logger = logger;
+            this.Id = Interlocked.Increment(ref lastId);
+            this.Host = client.Host;
+        }
+
+        /// <inheritdoc/>
+        public event EventHandler<KeyChangedEventArgs> KeyChanged;
+
+        /// <inheritdoc/>
+        public event EventHandler<PointerChangedEventArgs> PointerChanged;
+
+        /// <inheritdoc/>
+        public event EventHandler Closed;
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// Sessions are only created once libvncserver has accepted the client, so this event is never raised.
+        /// </remarks>
+        public event EventHandler Connected
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// Sessions are only created once libvncserver has accepted the client, so this event is never raised.
+        /// </remarks>
+        public event EventHandler ConnectionFailed
+        {
+            add { }
+            remove { }
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// Passwords are validated by the <see cref="LibVncServer.PasswordProvided"/> event.
+        /// </remarks>
+        public event EventHandler<PasswordProvidedEventArgs> PasswordProvided
+        {
+            add { }
+            remove { }
+        }
+
+        /// <summary>
+        /// Gets a number which uniquely identifies this session within the current process.
+        /// </summary>
+        public int Id
+        {
+            get;
+        }
+
+        /// <summary>
+        /// Gets the name or IP address of the remote host.
+        /// </summary>
+        public string Host
+        {
+            get;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether the client has disconnected.
+        /// </summary>
+        public bool IsClosed
+        {
+            get
+            {
+                lock (this.syncRoot)
+                {
+                    return this.isClosed;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gets the encoding which libvncserver uses to send framebuffer updates to the client.
+        /// </summary>
+        public VncEncoding PreferredEncoding
+        {
+            get { return this.Read(c => c.PreferredEncoding, VncEncoding.Raw); }
+        }
+
+        /// <summary>
+        /// Gets the total number of bytes which were sent to the client.
+        /// </summary>
+        public long BytesSent
+        {
+            get { return this.Read(c => (long)(uint)c.BytesSent, 0); }
+        }
+
+        /// <summary>
+        /// Gets the number of framebuffer updates which were sent to the client.
+        /// </summary>
+        public long FramebufferUpdatesSent
+        {
+            get { return this.Read(c => (long)(uint)c.FramebufferUpdatesSent, 0); }
+        }
+
+        /// <summary>
+        /// Gets the number of bytes which are waiting to be sent to the client.
+        /// </summary>
+        public int PendingOutput
+        {
+            get { return this.Read(c => c.PendingOutput, 0); }
+        }
+
+        /// <summary>
+        /// Gets a snapshot of the statistics about the rectangles which were sent to the client, for each encoding.
+        /// </summary>
+        public Dictionary<VncEncoding, EncoderStatistics> Statistics
+        {
+            get
+            {
+                var statistics = new Dictionary<VncEncoding, EncoderStatistics>();
+
+                foreach (var entry in this.Read(c => c.EncodingStatistics, Array.Empty<RfbEncodingStatistics>()))
+                {
+                    statistics[(VncEncoding)entry.Encoding] = new EncoderStatistics()
+                    {
+                        Rectangles = entry.Rectangles,
+                        RawBytes = entry.BytesSentIfRaw,
+                        EncodedBytes = entry.BytesSent,
+                    };
+                }
+
+                return statistics;
+            }
+        }
+
+        /// <inheritdoc/>
+        public ILogger Logger
+        {
+            get;
+            set;
+        }
+
+        /// <inheritdoc/>
+        public IVncPasswordChallenge PasswordChallenge
+        {
+            get;
+            set;
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// libvncserver sends framebuffer updates as soon as the client requests them.
+        /// </remarks>
+        public double MaxUpdateRate
+        {
+            get { throw new NotSupportedException(); }
+            set { throw new NotSupportedException(); }
+        }
+
+        /// <inheritdoc/>
+        public Func<VncFramebuffer, ILogger, IVncFramebufferCache> CreateFramebufferCache
+        {
+            get { throw new NotSupportedException(); }
+            set { throw new NotSupportedException(); }
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// libvncserver tracks framebuffer update requests itself, so this value is always <see langword="null"/>.
+        /// </remarks>
+        public FramebufferUpdateRequest FramebufferUpdateRequest
+        {
+            get { return null; }
+        }
+
+        /// <inheritdoc/>
+        public object FramebufferUpdateRequestLock
+        {
+            get { return this.framebufferUpdateRequestLock; }
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// libvncserver does not keep the list of encodings which the client supports, so this list only contains
+        /// the <see cref="PreferredEncoding"/>.
+        /// </remarks>
+        public IReadOnlyList<VncEncoding> ClientEncodings
+        {
+            get { return new VncEncoding[] { this.PreferredEncoding }; }
+        }
+
+        /// <inheritdoc/>
+        public void Connect(Stream stream, VncServerSessionOptions options = null)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void Close()
+        {
+            lock (this.syncRoot)
+            {
+                if (!this.isClosed)
+                {
+                    NativeMethods.rfbCloseClient(this.client.DangerousGetHandle());
+                }
+            }
+        }
+
+        /// <inheritdoc/>
+        public void SetFramebufferSource(IVncFramebufferSource source)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualBeginUpdate()
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualCopyRegion(VncRectangle target, int sourceX, int sourceY)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualInvalidate(VncRectangle region)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualInvalidate(VncRectangle[] regions)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public void FramebufferManualInvalidateAll()
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public bool FramebufferManualEndUpdate()
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <summary>
+        /// Determines whether this session represents a libvncserver client.
+        /// </summary>
+        /// <param name="cl">
+        /// A pointer to the libvncserver client.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if this session represents <paramref name="cl"/>; otherwise, <see langword="false"/>.
+        /// </returns>
+        internal bool Represents(IntPtr cl)
+        {
+            return this.client.DangerousGetHandle() == cl;
+        }
+
+        /// <summary>
+        /// Marks this session as closed and raises the <see cref="Closed"/> event, once libvncserver has
+        /// disconnected the client. The client is not accessed after this method returns.
+        /// </summary>
+        internal void OnClosed()
+        {
+            lock (this.syncRoot)
+            {
+                this.isClosed = true;
+            }
+
+            this.Closed?.Invoke(this, EventArgs.Empty);
+        }
+
+        /// <summary>
+        /// Raises the <see cref="KeyChanged"/> event.
+        /// </summary>
+        /// <param name="e">
+        /// The event arguments.
+        /// </param>
+        internal void OnKeyChanged(KeyChangedEventArgs e)
+        {
+            this.KeyChanged?.Invoke(this, e);
+        }
+
+        /// <summary>
+        /// Raises the <see cref="PointerChanged"/> event.
+        /// </summary>
+        /// <param name="e">
+        /// The event arguments.
+        /// </param>
+        internal void OnPointerChanged(PointerChangedEventArgs e)
+        {
+            this.PointerChanged?.Invoke(this, e);
+        }
+
+        private T Read<T>(Func<RfbClientRecPtr, T> read, T closedValue)
+        {
+            // libvncserver frees the client once it has disconnected, so hold the lock to
+            // make sure that doesn't happen while the client is being read.
+            lock (this.syncRoot)
+            {
+                return this.isClosed ? closedValue : read(this.client);
+            }
+        }
+    }
+}
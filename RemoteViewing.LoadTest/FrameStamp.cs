@@ -0,0 +1,188 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using System;
+using System.Diagnostics;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// Embeds the time at which a frame was captured in the pixels of the frame itself, so clients can
+    /// measure the time it took for the frame to be displayed.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// The timestamp is a 48-bit number of microseconds on the <see cref="Stopwatch"/> clock, followed by a
+    /// 16-bit checksum. Each bit is drawn as a black or white <see cref="BlockSize"/> by <see cref="BlockSize"/>
+    /// block in the top-left corner of the framebuffer; this survives lossy (JPEG) compression.
+    /// </para>
+    /// <para>
+    /// The <see cref="Stopwatch"/> clock is monotonic and shared by all processes on the machine, so the server
+    /// and the clients can run in different processes.
+    /// </para>
+    /// </remarks>
+    public static class FrameStamp
+    {
+        /// <summary>
+        /// The size of the block used to draw a single bit.
+        /// </summary>
+        public const int BlockSize = 8;
+
+        /// <summary>
+        /// The width of the area which contains the stamp.
+        /// </summary>
+        public const int Width = BlockSize * Bits;
+
+        /// <summary>
+        /// The height of the area which contains the stamp.
+        /// </summary>
+        public const int Height = BlockSize;
+
+        private const int Bits = 64;
+        private const long TimestampMask = (1L << 48) - 1;
+
+        /// <summary>
+        /// Gets the current time, in microseconds.
+        /// </summary>
+        public static long Now => (long)(Stopwatch.GetTimestamp() * (1000000.0 / Stopwatch.Frequency)) & TimestampMask;
+
+        /// <summary>
+        /// Gets the number of microseconds which have elapsed since a timestamp.
+        /// </summary>
+        /// <param name="timestamp">
+        /// A timestamp obtained from <see cref="Now"/>.
+        /// </param>
+        /// <returns>
+        /// The number of microseconds which have elapsed since <paramref name="timestamp"/>.
+        /// </returns>
+        public static long Elapsed(long timestamp)
+        {
+            return (Now - timestamp) & TimestampMask;
+        }
+
+        /// <summary>
+        /// Draws a timestamp in a <see cref="VncPixelFormat.RGB32"/> framebuffer.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The framebuffer in which to draw the timestamp.
+        /// </param>
+        /// <param name="timestamp">
+        /// The timestamp to draw.
+        /// </param>
+        public static void Write(VncFramebuffer framebuffer, long timestamp)
+        {
+            if (framebuffer == null)
+            {
+                throw new ArgumentNullException(nameof(framebuffer));
+            }
+
+            var value = Encode(timestamp);
+            var buffer = framebuffer.GetBuffer();
+
+            for (int bit = 0; bit < Bits; bit++)
+            {
+                var color = ((value >> bit) & 1) == 1 ? 0xFFFFFF : 0;
+
+                for (int y = 0; y < BlockSize; y++)
+                {
+                    var offset = (y * framebuffer.Stride) + (bit * BlockSize * 4);
+
+                    for (int x = 0; x < BlockSize; x++, offset += 4)
+                    {
+                        buffer[offset] = (byte)color;
+                        buffer[offset + 1] = (byte)(color >> 8);
+                        buffer[offset + 2] = (byte)(color >> 16);
+                        buffer[offset + 3] = 0;
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Reads the timestamp from a framebuffer.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The framebuffer from which to read the timestamp. The framebuffer can use any true color pixel format.
+        /// </param>
+        /// <param name="timestamp">
+        /// When this method returns <see langword="true"/>, the timestamp.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the framebuffer contains a valid timestamp; otherwise, <see langword="false"/>.
+        /// </returns>
+        public static bool TryRead(VncFramebuffer framebuffer, out long timestamp)
+        {
+            if (framebuffer == null)
+            {
+                throw new ArgumentNullException(nameof(framebuffer));
+            }
+
+            timestamp = 0;
+
+            if (framebuffer.Width < Width || framebuffer.Height < Height)
+            {
+                return false;
+            }
+
+            var format = framebuffer.PixelFormat;
+            var buffer = framebuffer.GetBuffer();
+            ulong value = 0;
+
+            for (int bit = 0; bit < Bits; bit++)
+            {
+                // Sample the center of the block.
+                var offset = (BlockSize / 2 * framebuffer.Stride) + (((bit * BlockSize) + (BlockSize / 2)) * format.BytesPerPixel);
+                uint pixel = 0;
+
+                for (int i = 0; i < format.BytesPerPixel; i++)
+                {
+                    var shift = 8 * (format.IsLittleEndian ? i : format.BytesPerPixel - 1 - i);
+                    pixel |= (uint)buffer[offset + i] << shift;
+                }
+
+                var green = (pixel >> format.GreenShift) & format.GreenMax;
+
+                if (green > format.GreenMax / 2)
+                {
+                    value |= 1UL << bit;
+                }
+            }
+
+            timestamp = (long)value & TimestampMask;
+            return Encode(timestamp) == value;
+        }
+
+        private static ulong Encode(long timestamp)
+        {
+            var value = (ulong)(timestamp & TimestampMask);
+            var checksum = (ushort)(value ^ (value >> 16) ^ (value >> 32) ^ 0xA5A5);
+            return value | ((ulong)checksum << 48);
+        }
+    }
+}
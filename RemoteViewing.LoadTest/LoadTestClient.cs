@@ -0,0 +1,200 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using System;
+using System.Collections.Generic;
+using System.Net;
+using System.Net.Sockets;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// A <see cref="VncClient"/> which measures the latency, frame rate and bandwidth of the framebuffer updates
+    /// it receives.
+    /// </summary>
+    public sealed class LoadTestClient : IDisposable
+    {
+        /// <summary>
+        /// The password used by the load test clients. The load test server accepts any password.
+        /// </summary>
+        internal const string Password = "loadtest";
+
+        private readonly object syncRoot = new object();
+        private readonly VncClient client = new VncClient();
+        private readonly List<double> latencies = new List<double>();
+        private TcpClient tcpClient;
+        private CountingStream stream;
+        private long lastTimestamp = -1;
+        private long bytesAtReset;
+        private int frames;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="LoadTestClient"/> class.
+        /// </summary>
+        public LoadTestClient()
+        {
+            this.client.FramebufferChanged += this.OnFramebufferChanged;
+        }
+
+        /// <summary>
+        /// Gets the number of distinct frames which have been displayed since the last call to <see cref="Reset"/>.
+        /// </summary>
+        public int Frames
+        {
+            get
+            {
+                lock (this.syncRoot)
+                {
+                    return this.frames;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gets the number of bytes which have been received since the last call to <see cref="Reset"/>.
+        /// </summary>
+        public long BytesReceived => this.stream == null ? 0 : this.stream.BytesRead - this.bytesAtReset;
+
+        /// <summary>
+        /// Connects to the load test server.
+        /// </summary>
+        /// <param name="endPoint">
+        /// The end point of the server.
+        /// </param>
+        /// <param name="encoding">
+        /// The encoding which the server should use.
+        /// </param>
+        /// <param name="maxUpdateRate">
+        /// The maximum number of updates to request per second.
+        /// </param>
+        public void Connect(IPEndPoint endPoint, LoadTestEncoding encoding, double maxUpdateRate)
+        {
+            var options = new VncClientConnectOptions()
+            {
+                Password = Password.ToCharArray(),
+            };
+
+            switch (encoding)
+            {
+                case LoadTestEncoding.Raw:
+                    options.Encodings = new VncEncoding[] { VncEncoding.CopyRect, VncEncoding.Raw };
+                    break;
+
+                case LoadTestEncoding.Zrle:
+                    options.Encodings = new VncEncoding[] { VncEncoding.Zrle, VncEncoding.CopyRect, VncEncoding.Raw };
+                    break;
+
+                case LoadTestEncoding.Tight:
+                    options.Encodings = new VncEncoding[] { VncEncoding.Tight, VncEncoding.CopyRect, VncEncoding.Raw };
+                    break;
+
+                case LoadTestEncoding.TightJpeg:
+                    options.Encodings = new VncEncoding[] { VncEncoding.Tight, VncEncoding.CopyRect, VncEncoding.Raw };
+                    options.JpegQualityLevel = 6;
+                    break;
+
+                default:
+                    throw new ArgumentOutOfRangeException(nameof(encoding));
+            }
+
+            this.tcpClient = new TcpClient();
+            this.tcpClient.NoDelay = true;
+            this.tcpClient.Connect(endPoint);
+            this.stream = new CountingStream(this.tcpClient.GetStream());
+
+            this.client.MaxUpdateRate = maxUpdateRate;
+            this.client.Connect(this.stream, options);
+        }
+
+        /// <summary>
+        /// Starts a new measurement.
+        /// </summary>
+        public void Reset()
+        {
+            lock (this.syncRoot)
+            {
+                this.latencies.Clear();
+                this.frames = 0;
+                this.bytesAtReset = this.stream == null ? 0 : this.stream.BytesRead;
+            }
+        }
+
+        /// <summary>
+        /// Gets the latencies, in milliseconds, of all frames which have been displayed since the last call to
+        /// <see cref="Reset"/>.
+        /// </summary>
+        /// <returns>
+        /// The latency of each frame, in the order in which the frames were displayed.
+        /// </returns>
+        public double[] GetLatencies()
+        {
+            lock (this.syncRoot)
+            {
+                return this.latencies.ToArray();
+            }
+        }
+
+        /// <inheritdoc/>
+        public void Dispose()
+        {
+            this.client.FramebufferChanged -= this.OnFramebufferChanged;
+            this.client.Dispose();
+            this.stream?.Dispose();
+            this.tcpClient?.Dispose();
+        }
+
+        private void OnFramebufferChanged(object sender, FramebufferChangedEventArgs e)
+        {
+            var framebuffer = this.client.Framebuffer;
+            long timestamp;
+
+            lock (framebuffer.SyncRoot)
+            {
+                if (!FrameStamp.TryRead(framebuffer, out timestamp))
+                {
+                    return;
+                }
+            }
+
+            // The stamp is only redrawn when the content of the frame changes; updates which don't touch it
+            // belong to a frame which has already been displayed.
+            var elapsed = FrameStamp.Elapsed(timestamp);
+
+            lock (this.syncRoot)
+            {
+                if (timestamp != this.lastTimestamp)
+                {
+                    this.lastTimestamp = timestamp;
+                    this.latencies.Add(elapsed / 1000.0);
+                    this.frames++;
+                }
+            }
+        }
+    }
+}
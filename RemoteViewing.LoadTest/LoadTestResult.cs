@@ -0,0 +1,155 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Linq;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// The results of a single load test scenario: one encoding and one number of sessions.
+    /// </summary>
+    public class LoadTestResult
+    {
+        /// <summary>
+        /// Initializes a new instance of the <see cref="LoadTestResult"/> class.
+        /// </summary>
+        /// <param name="encoding">
+        /// The encoding used by the clients.
+        /// </param>
+        /// <param name="sessions">
+        /// The number of sessions.
+        /// </param>
+        /// <param name="duration">
+        /// The duration of the measurement.
+        /// </param>
+        /// <param name="latencies">
+        /// The capture-to-display latencies of all frames displayed by all clients, in milliseconds.
+        /// </param>
+        /// <param name="frames">
+        /// The total number of frames displayed by all clients.
+        /// </param>
+        /// <param name="bytes">
+        /// The total number of bytes received by all clients.
+        /// </param>
+        /// <param name="serverProcessorTime">
+        /// The processor time used by the server.
+        /// </param>
+        public LoadTestResult(LoadTestEncoding encoding, int sessions, TimeSpan duration, IEnumerable<double> latencies, long frames, long bytes, TimeSpan serverProcessorTime)
+        {
+            this.Encoding = encoding;
+            this.Sessions = sessions;
+            this.Duration = duration;
+            this.Latencies = latencies.OrderBy(l => l).ToArray();
+            this.FramesPerSecond = frames / duration.TotalSeconds / sessions;
+            this.BytesPerSecond = bytes / duration.TotalSeconds / sessions;
+            this.ServerCpu = serverProcessorTime.TotalSeconds / duration.TotalSeconds;
+        }
+
+        /// <summary>
+        /// Gets the header of the table written by <see cref="ToString"/>.
+        /// </summary>
+        public static string Header => "| Encoding  | Sessions | p50 (ms) | p90 (ms) | p99 (ms) | Max (ms) | Frames/s | KB/s     | Server CPU |";
+
+        /// <summary>
+        /// Gets the encoding used by the clients.
+        /// </summary>
+        public LoadTestEncoding Encoding { get; }
+
+        /// <summary>
+        /// Gets the number of sessions.
+        /// </summary>
+        public int Sessions { get; }
+
+        /// <summary>
+        /// Gets the duration of the measurement.
+        /// </summary>
+        public TimeSpan Duration { get; }
+
+        /// <summary>
+        /// Gets the capture-to-display latencies of all frames displayed by all clients, in milliseconds, sorted in
+        /// ascending order.
+        /// </summary>
+        public IReadOnlyList<double> Latencies { get; }
+
+        /// <summary>
+        /// Gets the average number of frames displayed per second by each client.
+        /// </summary>
+        public double FramesPerSecond { get; }
+
+        /// <summary>
+        /// Gets the average number of bytes received per second by each client.
+        /// </summary>
+        public double BytesPerSecond { get; }
+
+        /// <summary>
+        /// Gets the processor usage of the server, where 1 represents one fully used core.
+        /// </summary>
+        public double ServerCpu { get; }
+
+        /// <summary>
+        /// Gets a latency percentile.
+        /// </summary>
+        /// <param name="percentile">
+        /// The percentile, from 0 to 100.
+        /// </param>
+        /// <returns>
+        /// The latency, in milliseconds, or <see cref="double.NaN"/> if no frames were displayed.
+        /// </returns>
+        public double GetLatency(double percentile)
+        {
+            if (this.Latencies.Count == 0)
+            {
+                return double.NaN;
+            }
+
+            // Nearest-rank method.
+            var rank = (int)Math.Ceiling(percentile / 100 * this.Latencies.Count);
+            return this.Latencies[Math.Max(0, Math.Min(this.Latencies.Count - 1, rank - 1))];
+        }
+
+        /// <inheritdoc/>
+        public override string ToString()
+        {
+            return string.Format(
+                CultureInfo.InvariantCulture,
+                "| {0,-9} | {1,8} | {2,8:F1} | {3,8:F1} | {4,8:F1} | {5,8:F1} | {6,8:F1} | {7,8:F0} | {8,10:P0} |",
+                this.Encoding,
+                this.Sessions,
+                this.GetLatency(50),
+                this.GetLatency(90),
+                this.GetLatency(99),
+                this.GetLatency(100),
+                this.FramesPerSecond,
+                this.BytesPerSecond / 1024,
+                this.ServerCpu);
+        }
+    }
+}
@@ -0,0 +1,117 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Threading.Tasks;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// Runs load test scenarios.
+    /// </summary>
+    public static class LoadTestRunner
+    {
+        /// <summary>
+        /// Runs a single scenario: starts a new server, connects a number of clients to it, and measures the
+        /// performance of the sessions.
+        /// </summary>
+        /// <param name="settings">
+        /// The load test settings.
+        /// </param>
+        /// <param name="encoding">
+        /// The encoding which the clients request.
+        /// </param>
+        /// <param name="sessions">
+        /// The number of clients to connect.
+        /// </param>
+        /// <returns>
+        /// The results of the scenario.
+        /// </returns>
+        public static async Task<LoadTestResult> RunAsync(LoadTestSettings settings, LoadTestEncoding encoding, int sessions)
+        {
+            if (settings == null)
+            {
+                throw new ArgumentNullException(nameof(settings));
+            }
+
+            if (sessions <= 0)
+            {
+                throw new ArgumentOutOfRangeException(nameof(sessions));
+            }
+
+            var clients = new List<LoadTestClient>();
+
+            using (var server = ServerProcess.Start(settings))
+            {
+                try
+                {
+                    for (int i = 0; i < sessions; i++)
+                    {
+                        var client = new LoadTestClient();
+                        clients.Add(client);
+                        client.Connect(server.EndPoint, encoding, settings.MaxUpdateRate);
+                    }
+
+                    await Task.Delay(settings.Warmup).ConfigureAwait(false);
+
+                    foreach (var client in clients)
+                    {
+                        client.Reset();
+                    }
+
+                    var processorTime = server.TotalProcessorTime;
+                    var stopwatch = Stopwatch.StartNew();
+
+                    await Task.Delay(settings.Duration).ConfigureAwait(false);
+
+                    processorTime = server.TotalProcessorTime - processorTime;
+                    var duration = stopwatch.Elapsed;
+
+                    return new LoadTestResult(
+                        encoding,
+                        sessions,
+                        duration,
+                        clients.SelectMany(c => c.GetLatencies()),
+                        clients.Sum(c => (long)c.Frames),
+                        clients.Sum(c => c.BytesReceived),
+                        processorTime);
+                }
+                finally
+                {
+                    foreach (var client in clients)
+                    {
+                        client.Dispose();
+                    }
+                }
+            }
+        }
+    }
+}
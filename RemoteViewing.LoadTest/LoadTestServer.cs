@@ -0,0 +1,80 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Microsoft.Extensions.Logging.Abstractions;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.Net;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// Hosts a <see cref="VncServer"/> which serves a <see cref="ScriptedFramebufferSource"/>.
+    /// </summary>
+    /// <remarks>
+    /// The server runs in a process of its own, so its processor usage can be measured separately from the
+    /// processor usage of the clients.
+    /// </remarks>
+    public static class LoadTestServer
+    {
+        /// <summary>
+        /// The message which is written to the standard output once the server is listening.
+        /// </summary>
+        internal const string ListeningMessage = "Listening";
+
+        /// <summary>
+        /// Runs the server until the standard input is closed.
+        /// </summary>
+        /// <param name="port">
+        /// The loopback port on which to listen.
+        /// </param>
+        /// <param name="settings">
+        /// The load test settings.
+        /// </param>
+        /// <returns>
+        /// A <see cref="Task"/> which represents the asynchronous operation.
+        /// </returns>
+        public static async Task RunAsync(int port, LoadTestSettings settings)
+        {
+            var source = new ScriptedFramebufferSource(settings.Width, settings.Height, settings.FrameRate);
+            var server = new VncServer(source, null, null, NullLogger.Instance);
+
+            server.PasswordProvided += (sender, e) => e.Accept();
+            server.Connected += (sender, e) => ((IVncServerSession)sender).MaxUpdateRate = settings.MaxUpdateRate;
+
+            await server.StartAsync(new IPEndPoint(IPAddress.Loopback, port), CancellationToken.None).ConfigureAwait(false);
+            Console.WriteLine(ListeningMessage);
+
+            // The parent process closes the standard input when the scenario has completed.
+            await Console.In.ReadToEndAsync().ConfigureAwait(false);
+            await server.StopAsync(CancellationToken.None).ConfigureAwait(false);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// Settings which apply to all scenarios of a load test.
+    /// </summary>
+    public class LoadTestSettings
+    {
+        /// <summary>
+        /// Gets or sets the width of the framebuffer.
+        /// </summary>
+        public int Width { get; set; } = 1280;
+
+        /// <summary>
+        /// Gets or sets the height of the framebuffer.
+        /// </summary>
+        public int Height { get; set; } = 720;
+
+        /// <summary>
+        /// Gets or sets the number of frames per second at which the scripted animation advances.
+        /// </summary>
+        public double FrameRate { get; set; } = 30;
+
+        /// <summary>
+        /// Gets or sets the maximum number of updates per second which the server sends to, and the clients request
+        /// from, each session.
+        /// </summary>
+        public double MaxUpdateRate { get; set; } = 60;
+
+        /// <summary>
+        /// Gets or sets the amount of time during which the clients are connected before measurements start.
+        /// </summary>
+        public TimeSpan Warmup { get; set; } = TimeSpan.FromSeconds(2);
+
+        /// <summary>
+        /// Gets or sets the amount of time during which measurements are taken.
+        /// </summary>
+        public TimeSpan Duration { get; set; } = TimeSpan.FromSeconds(10);
+    }
+}
@@ -0,0 +1,145 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.CommandLine;
+using System.CommandLine.Builder;
+using System.CommandLine.Parsing;
+using System.Text.RegularExpressions;
+using System.Threading.Tasks;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// Connects a number of <see cref="Vnc.VncClient"/> instances to a <see cref="Vnc.Server.VncServer"/> over
+    /// loopback, and reports the latency and throughput of each session, and the processor usage of the server.
+    /// </summary>
+    internal class Program
+    {
+        public static Task<int> Main(string[] args)
+        {
+            var sessionsOption = new Option<int[]>("--sessions", () => new int[] { 1, 4, 16 }, "The numbers of concurrent sessions to test.")
+            {
+                AllowMultipleArgumentsPerToken = true,
+            };
+
+            var encodingsOption = new Option<LoadTestEncoding[]>("--encodings", () => (LoadTestEncoding[])Enum.GetValues(typeof(LoadTestEncoding)), "The encodings to test.")
+            {
+                AllowMultipleArgumentsPerToken = true,
+            };
+
+            var durationOption = new Option<double>("--duration", () => 10, "The duration of each measurement, in seconds.");
+            var warmupOption = new Option<double>("--warmup", () => 2, "The time to wait before each measurement starts, in seconds.");
+            var widthOption = new Option<int>("--width", () => 1280, "The width of the framebuffer.");
+            var heightOption = new Option<int>("--height", () => 720, "The height of the framebuffer.");
+            var frameRateOption = new Option<double>("--frame-rate", () => 30, "The number of frames per second at which the framebuffer content changes.");
+            var maxUpdateRateOption = new Option<double>("--max-update-rate", () => 60, "The maximum number of updates per second for each session.");
+            var portOption = new Option<int>("--port", "The loopback port on which the server listens.")
+            {
+                IsRequired = true,
+            };
+
+            var serveCommand = new Command("serve", "Runs the load test server. The load test starts the server in a separate process.");
+            serveCommand.IsHidden = true;
+            serveCommand.AddOption(portOption);
+            serveCommand.AddOption(widthOption);
+            serveCommand.AddOption(heightOption);
+            serveCommand.AddOption(frameRateOption);
+            serveCommand.AddOption(maxUpdateRateOption);
+            serveCommand.SetHandler(
+                (int port, int width, int height, double frameRate, double maxUpdateRate) =>
+                    LoadTestServer.RunAsync(
+                        port,
+                        new LoadTestSettings()
+                        {
+                            Width = width,
+                            Height = height,
+                            FrameRate = frameRate,
+                            MaxUpdateRate = maxUpdateRate,
+                        }),
+                portOption,
+                widthOption,
+                heightOption,
+                frameRateOption,
+                maxUpdateRateOption);
+
+            var rootCommand = new RootCommand();
+            rootCommand.Description = "Remote Viewing VNC Server Load Test";
+            rootCommand.AddOption(sessionsOption);
+            rootCommand.AddOption(encodingsOption);
+            rootCommand.AddOption(durationOption);
+            rootCommand.AddOption(warmupOption);
+            rootCommand.AddOption(widthOption);
+            rootCommand.AddOption(heightOption);
+            rootCommand.AddOption(frameRateOption);
+            rootCommand.AddOption(maxUpdateRateOption);
+            rootCommand.AddCommand(serveCommand);
+            rootCommand.SetHandler(
+                (int[] sessions, LoadTestEncoding[] encodings, double duration, double warmup, int width, int height, double frameRate, double maxUpdateRate) =>
+                    RunAsync(
+                        sessions,
+                        encodings,
+                        new LoadTestSettings()
+                        {
+                            Width = width,
+                            Height = height,
+                            FrameRate = frameRate,
+                            MaxUpdateRate = maxUpdateRate,
+                            Warmup = TimeSpan.FromSeconds(warmup),
+                            Duration = TimeSpan.FromSeconds(duration),
+                        }),
+                sessionsOption,
+                encodingsOption,
+                durationOption,
+                warmupOption,
+                widthOption,
+                heightOption,
+                frameRateOption,
+                maxUpdateRateOption);
+
+            var builder = new CommandLineBuilder(rootCommand);
+            builder.UseDefaults();
+            return builder.Build().InvokeAsync(args);
+        }
+
+        private static async Task RunAsync(int[] sessions, LoadTestEncoding[] encodings, LoadTestSettings settings)
+        {
+            Console.WriteLine(LoadTestResult.Header);
+            Console.WriteLine(Regex.Replace(LoadTestResult.Header, "[^|]", "-"));
+
+            foreach (var encoding in encodings)
+            {
+                foreach (var count in sessions)
+                {
+                    var result = await LoadTestRunner.RunAsync(settings, encoding, count).ConfigureAwait(false);
+                    Console.WriteLine(result);
+                }
+            }
+        }
+    }
+}
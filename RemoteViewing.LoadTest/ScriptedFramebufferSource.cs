@@ -0,0 +1,183 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using System;
+using System.Diagnostics;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// A framebuffer source which plays a scripted animation: a page of text which scrolls at a fixed rate.
+    /// Every frame is stamped with the time at which it was first captured, using <see cref="FrameStamp"/>.
+    /// </summary>
+    /// <remarks>
+    /// The content is generated using a fixed seed, so every run sends the same pixels.
+    /// </remarks>
+    public class ScriptedFramebufferSource : IVncFramebufferSource
+    {
+        private const int GlyphWidth = 8;
+        private const int GlyphHeight = 16;
+        private const int LineHeight = 20;
+        private const int ScrollStep = 4;
+        private const uint Background = 0xF0F0F0;
+        private const uint Foreground = 0x202020;
+
+        private readonly VncFramebuffer framebuffer;
+        private readonly uint[] page;
+        private readonly int pageHeight;
+        private readonly double frameRate;
+        private readonly Stopwatch clock = Stopwatch.StartNew();
+        private long frame = -1;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="ScriptedFramebufferSource"/> class.
+        /// </summary>
+        /// <param name="width">
+        /// The width of the framebuffer.
+        /// </param>
+        /// <param name="height">
+        /// The height of the framebuffer.
+        /// </param>
+        /// <param name="frameRate">
+        /// The number of frames per second at which the animation advances.
+        /// </param>
+        public ScriptedFramebufferSource(int width, int height, double frameRate)
+        {
+            if (width < FrameStamp.Width)
+            {
+                throw new ArgumentOutOfRangeException(nameof(width));
+            }
+
+            if (height <= FrameStamp.Height)
+            {
+                throw new ArgumentOutOfRangeException(nameof(height));
+            }
+
+            if (frameRate <= 0)
+            {
+                throw new ArgumentOutOfRangeException(nameof(frameRate));
+            }
+
+            this.frameRate = frameRate;
+            this.framebuffer = new VncFramebuffer("RemoteViewing Load Test", width, height, VncPixelFormat.RGB32);
+
+            // The page is twice as high as the framebuffer, and wraps around when the end has been reached.
+            this.pageHeight = 2 * height;
+            this.page = CreatePage(width, this.pageHeight);
+        }
+
+        /// <inheritdoc/>
+        public bool SupportsResizing => false;
+
+        /// <summary>
+        /// Gets the number of distinct frames which have been captured.
+        /// </summary>
+        public long FrameCount => this.frame + 1;
+
+        /// <inheritdoc/>
+        public VncFramebuffer Capture()
+        {
+            lock (this.framebuffer.SyncRoot)
+            {
+                long next = (long)(this.clock.Elapsed.TotalSeconds * this.frameRate);
+
+                if (next != this.frame)
+                {
+                    this.frame = next;
+                    this.Render(next);
+                    FrameStamp.Write(this.framebuffer, FrameStamp.Now);
+                }
+            }
+
+            return this.framebuffer;
+        }
+
+        /// <inheritdoc/>
+        public ExtendedDesktopSizeStatus SetDesktopSize(int width, int height)
+        {
+            return ExtendedDesktopSizeStatus.Prohibited;
+        }
+
+        private static uint[] CreatePage(int width, int height)
+        {
+            var random = new Random(0);
+            var page = new uint[width * height];
+
+            for (int i = 0; i < page.Length; i++)
+            {
+                page[i] = Background;
+            }
+
+            for (int line = 0; line < height / LineHeight; line++)
+            {
+                // Lines of random length, with an occasional blank line.
+                int length = random.Next(10) == 0 ? 0 : random.Next(width / GlyphWidth / 4, (width / GlyphWidth) - 2);
+
+                for (int column = 1; column <= length; column++)
+                {
+                    // Leave some spaces between words.
+                    if (random.Next(6) == 0)
+                    {
+                        continue;
+                    }
+
+                    for (int y = 2; y < GlyphHeight - 2; y++)
+                    {
+                        int bits = random.Next(1 << (GlyphWidth - 2));
+
+                        for (int x = 1; x < GlyphWidth - 1; x++)
+                        {
+                            if ((bits & (1 << (x - 1))) != 0)
+                            {
+                                page[(((line * LineHeight) + y) * width) + (column * GlyphWidth) + x] = Foreground;
+                            }
+                        }
+                    }
+                }
+            }
+
+            return page;
+        }
+
+        private void Render(long frame)
+        {
+            var buffer = this.framebuffer.GetBuffer();
+            var width = this.framebuffer.Width;
+            var stride = this.framebuffer.Stride;
+            var top = (int)((frame * ScrollStep) % this.pageHeight);
+
+            // The rows which contain the stamp are not part of the scrolling area.
+            for (int y = FrameStamp.Height; y < this.framebuffer.Height; y++)
+            {
+                var row = (top + y) % this.pageHeight;
+                Buffer.BlockCopy(this.page, row * width * 4, buffer, y * stride, width * 4);
+            }
+        }
+    }
+}
@@ -0,0 +1,154 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Net;
+using System.Net.Sockets;
+using System.Reflection;
+
+namespace RemoteViewing.LoadTest
+{
+    /// <summary>
+    /// Runs a <see cref="LoadTestServer"/> in a child process.
+    /// </summary>
+    public sealed class ServerProcess : IDisposable
+    {
+        private readonly Process process;
+
+        private ServerProcess(Process process, IPEndPoint endPoint)
+        {
+            this.process = process;
+            this.EndPoint = endPoint;
+        }
+
+        /// <summary>
+        /// Gets the end point at which the server is listening.
+        /// </summary>
+        public IPEndPoint EndPoint { get; }
+
+        /// <summary>
+        /// Gets the total processor time used by the server so far.
+        /// </summary>
+        public TimeSpan TotalProcessorTime
+        {
+            get
+            {
+                this.process.Refresh();
+                return this.process.TotalProcessorTime;
+            }
+        }
+
+        /// <summary>
+        /// Starts a new server process.
+        /// </summary>
+        /// <param name="settings">
+        /// The load test settings.
+        /// </param>
+        /// <returns>
+        /// A <see cref="ServerProcess"/> which represents the server, once it is listening.
+        /// </returns>
+        public static ServerProcess Start(LoadTestSettings settings)
+        {
+            if (settings == null)
+            {
+                throw new ArgumentNullException(nameof(settings));
+            }
+
+            var port = GetFreePort();
+
+            var startInfo = new ProcessStartInfo()
+            {
+                FileName = Environment.ProcessPath,
+                RedirectStandardInput = true,
+                RedirectStandardOutput = true,
+                UseShellExecute = false,
+            };
+
+            // When launched through the dotnet host, the host needs the path to the entry assembly.
+            if (string.Equals(Path.GetFileNameWithoutExtension(Environment.ProcessPath), "dotnet", StringComparison.OrdinalIgnoreCase))
+            {
+                startInfo.ArgumentList.Add(Assembly.GetEntryAssembly().Location);
+            }
+
+            startInfo.ArgumentList.Add("serve");
+            startInfo.ArgumentList.Add("--port");
+            startInfo.ArgumentList.Add(port.ToString(CultureInfo.InvariantCulture));
+            startInfo.ArgumentList.Add("--width");
+            startInfo.ArgumentList.Add(settings.Width.ToString(CultureInfo.InvariantCulture));
+            startInfo.ArgumentList.Add("--height");
+            startInfo.ArgumentList.Add(settings.Height.ToString(CultureInfo.InvariantCulture));
+            startInfo.ArgumentList.Add("--frame-rate");
+            startInfo.ArgumentList.Add(settings.FrameRate.ToString(CultureInfo.InvariantCulture));
+            startInfo.ArgumentList.Add("--max-update-rate");
+            startInfo.ArgumentList.Add(settings.MaxUpdateRate.ToString(CultureInfo.InvariantCulture));
+
+            var process = Process.Start(startInfo);
+            var line = process.StandardOutput.ReadLine();
+
+            if (line != LoadTestServer.ListeningMessage)
+            {
+                process.Kill();
+                process.Dispose();
+                throw new InvalidOperationException($"The server process failed to start: {line}");
+            }
+
+            return new ServerProcess(process, new IPEndPoint(IPAddress.Loopback, port));
+        }
+
+        /// <inheritdoc/>
+        public void Dispose()
+        {
+            this.process.StandardInput.Close();
+
+            if (!this.process.WaitForExit(5000))
+            {
+                this.process.Kill();
+            }
+
+            this.process.Dispose();
+        }
+
+        private static int GetFreePort()
+        {
+            var listener = new TcpListener(IPAddress.Loopback, 0);
+            listener.Start();
+
+            try
+            {
+                return ((IPEndPoint)listener.LocalEndpoint).Port;
+            }
+            finally
+            {
+                listener.Stop();
+            }
+        }
+    }
+}
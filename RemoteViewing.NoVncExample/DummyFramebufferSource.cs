@@ -1,6 +1,7 @@
 ﻿using RemoteViewing.Vnc;
 using RemoteViewing.Windows.Forms;
 using System;
+using System.Collections.Generic;
 using System.Drawing;
 
 namespace RemoteViewing.NoVncExample
@@ -9,9 +10,10 @@ namespace RemoteViewing.NoVncExample
     /// A dummy framebuffer source, which shows a rectangle with changing colors. Used to verify the noVNC middleware is
     /// working correctly.
     /// </summary>
-    public class DummyFramebufferSource : IVncFramebufferSource, IVncRemoteKeyboard, IVncRemoteController
+    public class DummyFramebufferSource : IVncFramebufferDamageSource, IVncRemoteKeyboard, IVncRemoteController
     {
         private readonly Random random = new Random();
+        private readonly VncDamageHistory damage = new VncDamageHistory();
 
         private byte[] colors = new byte[3];
         private sbyte[] increments = new sbyte[3] { 5, 5, 5 };
@@ -22,6 +24,10 @@ namespace RemoteViewing.NoVncExample
         // instead.
         private Color color = Color.Transparent;
 
+        // The color and text which are currently displayed; the framebuffer is only redrawn when they change.
+        private Color drawnColor;
+        private string drawnText;
+
         /// <summary>
         /// Initializes a new instance of the <see cref="DummyFramebufferSource"/> class.
         /// </summary>
@@ -32,6 +38,9 @@ namespace RemoteViewing.NoVncExample
         /// <inheritdoc/>
         public bool SupportsResizing => true;
 
+        /// <inheritdoc/>
+        public long FrameSequence => this.damage.Sequence;
+
         // The width and height of the framebuffer source.
         // These values can be changed by the client
 
@@ -83,6 +92,16 @@ namespace RemoteViewing.NoVncExample
             this.colors[colorIndex] = (byte)(this.colors[colorIndex] + this.increments[colorIndex]);
 
             var color = this.color == Color.Transparent ? Color.FromArgb(this.colors[0], this.colors[1], this.colors[2]) : this.color;
+            var text = $"RemoteViewing {ThisAssembly.AssemblyInformationalVersion}. {this.TextSuffix}";
+
+            if (this.framebuffer != null
+                && this.framebuffer.Width == this.Width
+                && this.framebuffer.Height == this.Height
+                && color == this.drawnColor
+                && text == this.drawnText)
+            {
+                return this.framebuffer;
+            }
 
             using (Bitmap image = new Bitmap(this.Width, this.Height))
             using (Graphics gfx = Graphics.FromImage(image))
@@ -91,7 +110,6 @@ namespace RemoteViewing.NoVncExample
             {
                 gfx.FillRectangle(brush, 0, 0, image.Width, image.Height);
 
-                var text = $"RemoteViewing {ThisAssembly.AssemblyInformationalVersion}. {this.TextSuffix}";
                 var size = gfx.MeasureString(text, font);
 
                 var position = new PointF((image.Width - size.Width) / 2.0f, (image.Height - size.Height) / 2.0f);
@@ -117,12 +135,23 @@ namespace RemoteViewing.NoVncExample
                         this.framebuffer,
                         0,
                         0);
+
+                    this.damage.Add(new VncRectangle(0, 0, image.Width, image.Height));
                 }
 
+                this.drawnColor = color;
+                this.drawnText = text;
+
                 return this.framebuffer;
             }
         }
 
+        /// <inheritdoc/>
+        public bool TryGetDamage(long sequence, ICollection<VncRectangle> damage)
+        {
+            return this.damage.TryGetDamage(sequence, damage);
+        }
+
         /// <inheritdoc/>
         public void HandleTouchEvent(object sender, PointerChangedEventArgs e)
         {
@@ -0,0 +1,295 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Moq;
+using RemoteViewing.VMware;
+using RemoteViewing.Vnc;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+using System.Threading.Tasks;
+using Xunit;
+
+namespace RemoteViewing.Tests.VMware
+{
+    /// <summary>
+    /// Tests the <see cref="VncAviReader"/> class.
+    /// </summary>
+    public class VncAviReaderTests
+    {
+        /// <summary>
+        /// Tests replaying a file which has been recorded by VMware Workstation.
+        /// </summary>
+        [Fact]
+        public void ReadVMwareRecordingTest()
+        {
+            using (var reader = VncAviReader.Open("VMware/VS2k5DebugDemo-01.avi"))
+            {
+                Assert.Equal(318, reader.FrameCount);
+                Assert.Equal(TimeSpan.FromMilliseconds(200), reader.FrameDuration);
+                Assert.Equal(-1, reader.CurrentFrame);
+
+                reader.RealTime = false;
+
+                var framebuffer = reader.Capture();
+                Assert.Equal(0, reader.CurrentFrame);
+                Assert.Equal(0x4f4, framebuffer.Width);
+                Assert.Equal(0x3c1, framebuffer.Height);
+                Assert.Equal(VncPixelFormat.RGB32, framebuffer.PixelFormat);
+                var firstFrame = (byte[])framebuffer.GetBuffer().Clone();
+
+                while (!reader.EndOfStream)
+                {
+                    Assert.Same(framebuffer, reader.Capture());
+                }
+
+                Assert.Equal(317, reader.CurrentFrame);
+
+                // Once the end has been reached, the last frame is repeated.
+                Assert.Same(framebuffer, reader.Capture());
+                Assert.Equal(317, reader.CurrentFrame);
+                Assert.NotEqual(firstFrame, framebuffer.GetBuffer());
+
+                // Seeking back restores the first frame.
+                reader.Seek(0);
+                Assert.Equal(firstFrame, framebuffer.GetBuffer());
+            }
+        }
+
+        /// <summary>
+        /// Tests replaying a recording made by the <see cref="VncAviWriter"/>, and seeking in that recording.
+        /// </summary>
+        /// <param name="encoding">
+        /// The encoding used by the <see cref="VncAviWriter"/>.
+        /// </param>
+        /// <returns>A <see cref="Task"/> representing the asynchronous unit test.</returns>
+        [Theory]
+        [InlineData(VncEncoding.Raw)]
+        [InlineData(VncEncoding.Zlib)]
+        [InlineData(VncEncoding.Zrle)]
+        public async Task ReadRecordingTest(VncEncoding encoding)
+        {
+            var snapshots = new List<byte[]>();
+
+            using (var output = new MemoryStream())
+            {
+                await Record(output, encoding, snapshots).ConfigureAwait(false);
+
+                output.Position = 0;
+                using (var reader = new VncAviReader(output))
+                {
+                    Assert.Equal(snapshots.Count, reader.FrameCount);
+                    Assert.Equal(TimeSpan.FromMilliseconds(1), reader.FrameDuration);
+
+                    reader.RealTime = false;
+
+                    for (int i = 0; i < snapshots.Count; i++)
+                    {
+                        Assert.Equal(snapshots[i], reader.Capture().GetBuffer());
+                        Assert.Equal(i, reader.CurrentFrame);
+                    }
+
+                    Assert.True(reader.EndOfStream);
+
+                    // Seek to a delta frame, before and after the current frame.
+                    reader.Seek(5);
+                    Assert.Equal(snapshots[5], reader.Framebuffer.GetBuffer());
+                    reader.Seek(7);
+                    Assert.Equal(snapshots[7], reader.Framebuffer.GetBuffer());
+                    reader.Seek(2);
+                    Assert.Equal(snapshots[2], reader.Framebuffer.GetBuffer());
+
+                    // Playback continues from the frame that was seeked to.
+                    Assert.Equal(snapshots[3], reader.Capture().GetBuffer());
+
+                    // Playback restarts when looping.
+                    reader.Loop = true;
+                    reader.Seek(snapshots.Count - 1);
+                    Assert.Equal(snapshots[0], reader.Capture().GetBuffer());
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests replaying a recording which was written to a stream which can't seek, and which therefore has
+        /// no index.
+        /// </summary>
+        /// <returns>A <see cref="Task"/> representing the asynchronous unit test.</returns>
+        [Fact]
+        public async Task ReadUnindexedRecordingTest()
+        {
+            var snapshots = new List<byte[]>();
+
+            using (var output = new MemoryStream())
+            {
+                await Record(new TestStream(new MemoryStream(), output), VncEncoding.Zlib, snapshots).ConfigureAwait(false);
+
+                using (var reader = new VncAviReader(new MemoryStream(output.ToArray())))
+                {
+                    Assert.Equal(snapshots.Count, reader.FrameCount);
+
+                    reader.Seek(6);
+                    Assert.Equal(snapshots[6], reader.Framebuffer.GetBuffer());
+
+                    reader.RealTime = false;
+                    Assert.Equal(snapshots[7], reader.Capture().GetBuffer());
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests playing back a recording in real time.
+        /// </summary>
+        [Fact]
+        public void RealTimePlaybackTest()
+        {
+            using (var reader = VncAviReader.Open("VMware/VS2k5DebugDemo-01.avi"))
+            {
+                reader.Capture();
+                Assert.Equal(0, reader.CurrentFrame);
+
+                // Frames are displayed for 200 ms.
+                Thread.Sleep(450);
+                reader.Capture();
+                Assert.InRange(reader.CurrentFrame, 2, 4);
+            }
+        }
+
+        /// <summary>
+        /// Tests that <see cref="VncAviReader"/> reports the regions which were decoded as damage, and that pixels
+        /// outside these regions don't change.
+        /// </summary>
+        [Fact]
+        public void DamageTest()
+        {
+            using (var reader = VncAviReader.Open("VMware/VS2k5DebugDemo-01.avi"))
+            {
+                reader.RealTime = false;
+
+                var framebuffer = reader.Capture();
+                var previous = (byte[])framebuffer.GetBuffer().Clone();
+                var damage = new List<VncRectangle>();
+                int damagedFrames = 0;
+
+                for (int i = 0; i < 30; i++)
+                {
+                    var sequence = reader.FrameSequence;
+                    Assert.Same(framebuffer, reader.Capture());
+
+                    damage.Clear();
+                    Assert.True(reader.TryGetDamage(sequence, damage));
+                    Assert.Equal(damage.Count == 0 ? sequence : sequence + 1, reader.FrameSequence);
+
+                    if (damage.Count > 0)
+                    {
+                        damagedFrames++;
+                    }
+
+                    var buffer = framebuffer.GetBuffer();
+
+                    for (int y = 0; y < framebuffer.Height; y++)
+                    {
+                        for (int x = 0; x < framebuffer.Width; x++)
+                        {
+                            int offset = (y * framebuffer.Stride) + (x * 4);
+
+                            if (BitConverter.ToInt32(buffer, offset) != BitConverter.ToInt32(previous, offset))
+                            {
+                                Assert.Contains(damage, (r) => x >= r.X && x < r.X + r.Width && y >= r.Y && y < r.Y + r.Height);
+                            }
+                        }
+                    }
+
+                    Buffer.BlockCopy(buffer, 0, previous, 0, buffer.Length);
+                }
+
+                Assert.NotEqual(0, damagedFrames);
+            }
+        }
+
+        /// <summary>
+        /// Tests opening a stream which does not contain an AVI file.
+        /// </summary>
+        [Fact]
+        public void ReadInvalidFileTest()
+        {
+            Assert.Throws<InvalidDataException>(() => new VncAviReader(new MemoryStream(new byte[0x100])));
+        }
+
+        private static async Task Record(Stream output, VncEncoding encoding, List<byte[]> snapshots)
+        {
+            var framebuffer = new VncFramebuffer("test", 256, 128, VncPixelFormat.RGB32);
+
+            for (int y = 0; y < framebuffer.Height; y++)
+            {
+                for (int x = 0; x < framebuffer.Width; x++)
+                {
+                    framebuffer.SetPixel(x, y, ((x * 31) ^ (y * 7919)) & 0xFFFFFF);
+                }
+            }
+
+            int frame = 0;
+
+            var framebufferSource = new Mock<IVncFramebufferSource>();
+            framebufferSource
+                .Setup(f => f.Capture())
+                .Returns(
+                () =>
+                {
+                    // The first call is used to create the header.
+                    if (frame > 10)
+                    {
+                        return null;
+                    }
+
+                    if (frame > 1)
+                    {
+                        for (int i = 0; i < 20; i++)
+                        {
+                            framebuffer.SetPixel((frame * 23) + i, frame * 11, 0x00FF00 * frame);
+                        }
+                    }
+
+                    if (frame > 0)
+                    {
+                        snapshots.Add((byte[])framebuffer.GetBuffer().Clone());
+                    }
+
+                    frame++;
+                    return framebuffer;
+                });
+
+            var writer = new VncAviWriter(framebufferSource.Object);
+            writer.Scale = 1000;
+            writer.Encoding = encoding;
+            writer.KeyframeInterval = 4;
+            await writer.WriteAsync(output, CancellationToken.None).ConfigureAwait(false);
+        }
+    }
+}
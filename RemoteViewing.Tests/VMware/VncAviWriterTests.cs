@@ -29,6 +29,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 using Moq;
 using RemoteViewing.VMware;
 using RemoteViewing.Vnc;
+using System;
+using System.Buffers.Binary;
+using System.Collections.Generic;
 using System.IO;
 using System.Threading;
 using System.Threading.Tasks;
@@ -42,7 +45,8 @@ namespace RemoteViewing.Tests.VMware
     public class VncAviWriterTests
     {
         /// <summary>
-        /// Test writing the header of an AVI file.
+        /// Test writing the header of an AVI file. The header is compared to that of a file recorded by
+        /// VMware Workstation; the sizes, frame counts and index are updated to reflect an empty recording.
         /// </summary>
         /// <returns>A <see cref="Task"/> representing the asynchronous unit test.</returns>
         [Fact]
@@ -55,6 +59,28 @@ namespace RemoteViewing.Tests.VMware
                 stream.Read(expected, 0, expected.Length);
             }
 
+            // RIFF size
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x04), 0x4804);
+
+            // avih: MaxBytesPerSec, TotalFrames, SuggestedBufferSize
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x24), 0);
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x30), 0);
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x3c), 0);
+
+            // strh: Length, SuggestedBufferSize
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x8c), 0);
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x90), 0);
+
+            // indx: EntriesInUse and the first super index entry
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0xe0), 0);
+            expected.AsSpan(0xf4, 0x10).Clear();
+
+            // dmlh: total frames
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x43b8), 0);
+
+            // movi size
+            BinaryPrimitives.WriteInt32LittleEndian(expected.AsSpan(0x4804), 4);
+
             bool isFirst = true;
 
             using (MemoryStream output = new MemoryStream())
@@ -83,10 +109,229 @@ namespace RemoteViewing.Tests.VMware
                 await aviWriter.WriteAsync(output, CancellationToken.None).ConfigureAwait(false);
 
                 byte[] actual = output.ToArray();
-                File.WriteAllBytes("actual.bin", actual);
-
                 Assert.Equal(expected, actual);
             }
         }
+
+        /// <summary>
+        /// Tests recording multiple frames. Only the first frame and every key frame contain the entire
+        /// framebuffer, and all frames are indexed.
+        /// </summary>
+        /// <param name="encoding">
+        /// The encoding to use.
+        /// </param>
+        /// <returns>A <see cref="Task"/> representing the asynchronous unit test.</returns>
+        [Theory]
+        [InlineData(VncEncoding.Raw)]
+        [InlineData(VncEncoding.Zlib)]
+        [InlineData(VncEncoding.Zrle)]
+        public async Task WriteDeltaFramesTest(VncEncoding encoding)
+        {
+            var framebuffer = new VncFramebuffer("My Framebuffer", width: 512, height: 256, pixelFormat: VncPixelFormat.RGB32);
+            var framebufferSource = CreateFramebufferSource(framebuffer, frames: 7);
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                VncAviWriter aviWriter = new VncAviWriter(framebufferSource);
+                aviWriter.Scale = 1000;
+                aviWriter.Encoding = encoding;
+                aviWriter.KeyframeInterval = 4;
+                await aviWriter.WriteAsync(output, CancellationToken.None).ConfigureAwait(false);
+
+                byte[] actual = output.ToArray();
+
+                // The RIFF list spans the entire file.
+                Assert.Equal(actual.Length - 8, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x04)));
+
+                // avih: TotalFrames; strh: Length; dmlh: total frames
+                Assert.Equal(7, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x30)));
+                Assert.Equal(7, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x8c)));
+                Assert.Equal(7, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x43b8)));
+
+                var chunks = ReadChunks(actual, 0x480c, actual.Length);
+                var frames = chunks.FindAll(c => c.Item1 == "00dc");
+                Assert.Equal(7, frames.Count);
+
+                var keyframeSize = frames[0].Item3;
+                Assert.True(keyframeSize > 1000);
+
+                for (int i = 0; i < frames.Count; i++)
+                {
+                    bool isKeyframe = i % 4 == 0;
+
+                    if (isKeyframe)
+                    {
+                        Assert.True(frames[i].Item3 > keyframeSize / 2);
+                    }
+                    else
+                    {
+                        Assert.True(frames[i].Item3 < keyframeSize / 8);
+                    }
+                }
+
+                // The super index points to a single standard index, which points to all frames.
+                Assert.Equal(1, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0xe0)));
+                var entries = ReadIndex(actual, BinaryPrimitives.ReadInt64LittleEndian(actual.AsSpan(0xf4)));
+                Assert.Equal(7, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x100)));
+                Assert.Equal(7, entries.Count);
+
+                for (int i = 0; i < frames.Count; i++)
+                {
+                    Assert.Equal(frames[i].Item2, entries[i].Item1);
+                    Assert.Equal((uint)frames[i].Item3 | (i % 4 == 0 ? 0 : 0x80000000), entries[i].Item2);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests recording a file which is split in multiple RIFF lists, and which uses multiple standard indexes.
+        /// </summary>
+        /// <returns>A <see cref="Task"/> representing the asynchronous unit test.</returns>
+        [Fact]
+        public async Task WriteSegmentsTest()
+        {
+            var framebuffer = new VncFramebuffer("My Framebuffer", width: 64, height: 64, pixelFormat: VncPixelFormat.RGB32);
+            var framebufferSource = CreateFramebufferSource(framebuffer, frames: 20);
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                VncAviWriter aviWriter = new VncAviWriter(framebufferSource);
+                aviWriter.Scale = 1000;
+                aviWriter.KeyframeInterval = 1;
+                aviWriter.MaximumSegmentSize = 0x10000;
+                aviWriter.StandardIndexCapacity = 2;
+                await aviWriter.WriteAsync(output, CancellationToken.None).ConfigureAwait(false);
+
+                byte[] actual = output.ToArray();
+
+                // Each frame is 16 kB, so the first RIFF list holds 2 frames, and the next ones 3 frames.
+                var segments = ReadChunks(actual, 0, actual.Length);
+                Assert.Equal(7, segments.Count);
+                Assert.All(segments, (s) => Assert.Equal("RIFF", s.Item1));
+                Assert.All(segments, (s) => Assert.True(s.Item3 <= 0x10000));
+                Assert.Equal(actual.Length, segments[segments.Count - 1].Item2 + segments[segments.Count - 1].Item3);
+
+                Assert.Equal(2, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x30)));
+                Assert.Equal(20, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x8c)));
+                Assert.Equal(20, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x43b8)));
+
+                var frames = new List<Tuple<string, long, int>>();
+                foreach (var segment in segments)
+                {
+                    // Skip the RIFF type, the LIST header and the movi type.
+                    int start = (int)segment.Item2 + (segment.Item2 == 8 ? 0x4804 : 16);
+                    frames.AddRange(ReadChunks(actual, start, (int)(segment.Item2 + segment.Item3)).FindAll(c => c.Item1 == "00dc"));
+                }
+
+                Assert.Equal(20, frames.Count);
+
+                // Read all standard indexes using the super index. Each index holds at most 2 frames, and
+                // indexes don't span RIFF lists.
+                int superIndexCount = BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0xe0));
+                Assert.Equal(13, superIndexCount);
+
+                var entries = new List<Tuple<long, uint>>();
+                for (int i = 0; i < superIndexCount; i++)
+                {
+                    var index = ReadIndex(actual, BinaryPrimitives.ReadInt64LittleEndian(actual.AsSpan(0xf4 + (i * 16))));
+                    Assert.Equal(index.Count, BinaryPrimitives.ReadInt32LittleEndian(actual.AsSpan(0x100 + (i * 16))));
+                    entries.AddRange(index);
+                }
+
+                Assert.Equal(20, entries.Count);
+
+                for (int i = 0; i < frames.Count; i++)
+                {
+                    Assert.Equal(frames[i].Item2, entries[i].Item1);
+                    Assert.Equal((uint)frames[i].Item3, entries[i].Item2);
+                }
+            }
+        }
+
+        private static IVncFramebufferSource CreateFramebufferSource(VncFramebuffer framebuffer, int frames)
+        {
+            for (int y = 0; y < framebuffer.Height; y++)
+            {
+                for (int x = 0; x < framebuffer.Width; x++)
+                {
+                    framebuffer.SetPixel(x, y, ((x * 31) ^ (y * 7919)) & 0xFFFFFF);
+                }
+            }
+
+            int frame = 0;
+
+            var framebufferSource = new Mock<IVncFramebufferSource>();
+            framebufferSource
+                .Setup(f => f.Capture())
+                .Returns(
+                () =>
+                {
+                    // The first call is used to create the header; stop after the requested number of frames.
+                    if (frame > frames)
+                    {
+                        return null;
+                    }
+
+                    // Change a single pixel in every frame.
+                    if (frame > 1)
+                    {
+                        framebuffer.SetPixel(frame, frame, 0xFFFFFF);
+                    }
+
+                    frame++;
+                    return framebuffer;
+                });
+
+            return framebufferSource.Object;
+        }
+
+        /// <summary>
+        /// Reads the chunks in a region of a RIFF file.
+        /// </summary>
+        /// <returns>
+        /// The FourCC, the offset of the data and the size of each chunk.
+        /// </returns>
+        private static List<Tuple<string, long, int>> ReadChunks(byte[] data, int start, int end)
+        {
+            var chunks = new List<Tuple<string, long, int>>();
+
+            for (int offset = start; offset < end;)
+            {
+                var fourCC = System.Text.Encoding.ASCII.GetString(data, offset, 4);
+                var size = BinaryPrimitives.ReadInt32LittleEndian(data.AsSpan(offset + 4));
+                chunks.Add(Tuple.Create(fourCC, (long)offset + 8, size));
+                offset += 8 + size + (size & 1);
+            }
+
+            return chunks;
+        }
+
+        /// <summary>
+        /// Reads a standard index.
+        /// </summary>
+        /// <returns>
+        /// The absolute offset and the size (including flags) of each entry.
+        /// </returns>
+        private static List<Tuple<long, uint>> ReadIndex(byte[] data, long offset)
+        {
+            var index = data.AsSpan((int)offset);
+            Assert.Equal("ix00", System.Text.Encoding.ASCII.GetString(data, (int)offset, 4));
+            Assert.Equal("00dc", System.Text.Encoding.ASCII.GetString(data, (int)offset + 16, 4));
+
+            int count = BinaryPrimitives.ReadInt32LittleEndian(index.Slice(12));
+            long baseOffset = BinaryPrimitives.ReadInt64LittleEndian(index.Slice(20));
+
+            var entries = new List<Tuple<long, uint>>();
+
+            for (int i = 0; i < count; i++)
+            {
+                entries.Add(
+                    Tuple.Create(
+                        baseOffset + BinaryPrimitives.ReadUInt32LittleEndian(index.Slice(32 + (i * 8))),
+                        BinaryPrimitives.ReadUInt32LittleEndian(index.Slice(36 + (i * 8)))));
+            }
+
+            return entries;
+        }
     }
 }
@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using RemoteViewing.Vnc;
 using RemoteViewing.Vnc.Server;
+using System;
 using System.IO;
 using Xunit;
 
@@ -50,7 +51,7 @@ namespace RemoteViewing.Tests.Vnc.Server
         }
 
         /// <summary>
-        /// Tests the <see cref="RawEncoder.Send"/> method.
+        /// Tests the <see cref="RawEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/> method.
         /// </summary>
         [Fact]
         public void SendTest()
@@ -66,5 +67,24 @@ namespace RemoteViewing.Tests.Vnc.Server
                 Assert.Equal(content, stream.ToArray());
             }
         }
+
+        /// <summary>
+        /// Tests the <see cref="RawEncoder.Send(Stream, VncPixelFormat, VncRectangle, ReadOnlySpan{byte})"/> method,
+        /// using a slice of a larger buffer.
+        /// </summary>
+        [Fact]
+        public void SendSpanTest()
+        {
+            RawEncoder encoder = new RawEncoder();
+            byte[] buffer = { 0xFF, 0x01, 0x02, 0x03, 0x04, 0xFF };
+
+            using (MemoryStream stream = new MemoryStream())
+            {
+                var sent = encoder.Send(stream, new VncPixelFormat(), default(VncRectangle), new ReadOnlySpan<byte>(buffer, 1, 4));
+
+                Assert.Equal(4, sent);
+                Assert.Equal(new byte[] { 0x01, 0x02, 0x03, 0x04 }, stream.ToArray());
+            }
+        }
     }
 }
@@ -93,7 +93,8 @@ namespace RemoteViewing.Tests.Vnc.Server
             // - Reset stream 0
             Assert.Equal(0b0000_0001, raw[0]);
 
-            byte[] expectedZlibData = new byte[] { 0x78, 0x9c, 0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0x28, 0xcf, 0x2f, 0xca, 0x49, 0xe1, 0x02, 0x00, 0x21, 0xe7, 0x04, 0x93 };
+            // The zlib stream is flushed, not finished, so that it can be used for the next rectangle.
+            byte[] expectedZlibData = new byte[] { 0x78, 0x9c, 0xca, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0x28, 0xcf, 0x2f, 0xca, 0x49, 0xe1, 0x02, 0x00, 0x00, 0x00, 0xff, 0xff };
             byte[] actualZlibData = new byte[raw.Length - 2];
             Array.Copy(raw, 2, actualZlibData, 0, raw.Length - 2);
 
@@ -117,17 +118,10 @@ namespace RemoteViewing.Tests.Vnc.Server
 
             using (MemoryStream output = new MemoryStream())
             {
-                var contents = new byte[]
-                {
-                    // A 2x2 framebuffer in
-                    // BGRX format
-                    0x01, 0x02, 0x03, 0x04,
-                    0x01, 0x02, 0x03, 0x04,
-                    0x01, 0x02, 0x03, 0x04,
-                    0x01, 0x02, 0x03, 0x04,
-                };
+                // A 4x2 framebuffer in BGRX format, with a different color for each pixel
+                var contents = CreateNoise();
 
-                encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 2, 2), contents);
+                encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents);
                 raw = output.ToArray();
             }
 
@@ -137,7 +131,11 @@ namespace RemoteViewing.Tests.Vnc.Server
             // - Reset stream 0
             Assert.Equal(0b0000_0001, raw[0]);
 
-            byte[] expectedZlibData = new byte[] { 0x78, 0x9c, 0x62, 0x66, 0x62, 0x64, 0x86, 0x20, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x62, 0x02, 0x00, 0x00, 0x00, 0xff, 0xff, 0x62, 0x04, 0x00, 0x00, 0x00, 0xff, 0xff };
+            byte[] expectedZlibData = new byte[]
+            {
+                0x78, 0x9c, 0xfa, 0xd0, 0x20, 0xe0, 0xa0, 0xf0, 0x60, 0xc2, 0x05, 0x03, 0x86, 0x84, 0x05, 0x07,
+                0x18, 0x0a, 0x02, 0x36, 0x30, 0x2c, 0x70, 0x38, 0xa0, 0xf0, 0x21, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff,
+            };
 
             byte[] actualZlibData = new byte[raw.Length - 2];
             Array.Copy(raw, 2, actualZlibData, 0, raw.Length - 2);
@@ -149,20 +147,10 @@ namespace RemoteViewing.Tests.Vnc.Server
             using (var compressedStream = new MemoryStream(actualZlibData))
             using (var stream = new ZlibStream(compressedStream, CompressionMode.Decompress))
             {
-                byte[] decompressed = new byte[0x09];
-                Assert.Equal(9, stream.Read(decompressed, 0, 9));
-
-                // Make sure all data was read
-                Assert.Equal(0, stream.Read(decompressed, 0, 0));
+                byte[] decompressed = new byte[24];
+                Assert.Equal(24, stream.Read(decompressed, 0, 24));
 
-                var expectedDecompressedData = new byte[]
-                {
-                    0x03, 0x02, 0x01,
-                    0x03, 0x02, 0x01,
-                    0x03, 0x02, 0x01,
-                };
-
-                Assert.Equal(expectedDecompressedData, decompressed);
+                Assert.Equal(CreateNoiseTightPixels(), decompressed);
             }
         }
 
@@ -182,24 +170,297 @@ namespace RemoteViewing.Tests.Vnc.Server
 
             using (MemoryStream output = new MemoryStream())
             {
-                var contents = new byte[] { 0x01, 0x02, 0x03, 0x04 };
-                encoder.Send(output, new VncPixelFormat(), default, contents);
+                var contents = new byte[] { 0x01, 0x02, 0x03, 0x00, 0x04, 0x05, 0x06, 0x00, 0x07, 0x08, 0x09, 0x00 };
+                Assert.Equal(10, encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 3, 1), contents));
                 raw = output.ToArray();
             }
 
-            // First byte:
-            // - Basic compression
-            // - Use stream 0
-            // - Reset stream 0
-            Assert.Equal(0b0000_0000, raw[0]);
+            // The first byte is the basic compression control byte, without any stream flags.
+            // The data is not compressed, so it is sent as is, without a length and using TPIXELs.
+            Assert.Equal(new byte[] { 0b0000_0000, 0x03, 0x02, 0x01, 0x06, 0x05, 0x04, 0x09, 0x08, 0x07 }, raw);
+        }
 
-            byte[] expectedZlibData = new byte[] { 0x01, 0x02, 0x03, 0x04 };
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.Send(Stream, VncPixelFormat, byte[])"/> method in a scenario where the
+        /// rectangle consists of a single color, causing the encoder to use fill compression.
+        /// </summary>
+        [Fact]
+        public void SendFillTest()
+        {
+            TightEncoder encoder = new TightEncoder(Mock.Of<IVncServerSession>());
 
-            byte[] actualZlibData = new byte[raw.Length - 2];
-            Array.Copy(raw, 2, actualZlibData, 0, raw.Length - 2);
+            using (MemoryStream output = new MemoryStream())
+            {
+                // The padding byte is not part of the color.
+                var contents = new byte[] { 0x01, 0x02, 0x03, 0x04, 0x01, 0x02, 0x03, 0x05 };
+                Assert.Equal(4, encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 2, 1), contents));
+                Assert.Equal(new byte[] { (byte)TightCompressionControl.FillCompression, 0x03, 0x02, 0x01 }, output.ToArray());
+            }
+        }
 
-            Assert.Equal((byte)expectedZlibData.Length, raw[1]);
-            Assert.Equal(expectedZlibData, actualZlibData);
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.Send(Stream, VncPixelFormat, byte[])"/> method in a scenario where the
+        /// rectangle consists of two colors, causing the encoder to use the palette filter with a 1-bit bitmap.
+        /// </summary>
+        [Fact]
+        public void SendMonoPaletteTest()
+        {
+            TightEncoder encoder = new TightEncoder(Mock.Of<IVncServerSession>());
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                // A 4x2 checkerboard
+                var contents = new byte[]
+                {
+                    0x01, 0x02, 0x03, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0x03, 0x00, 0xFF, 0xFF, 0xFF, 0x00,
+                    0xFF, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0x03, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0x03, 0x00,
+                };
+
+                Assert.Equal(11, encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents));
+
+                var expected = new byte[]
+                {
+                    0b0101_0000, // Basic compression with a filter, using stream 1. The data is too small to be compressed.
+                    0x01, // Palette filter
+                    0x01, // 2 colors
+                    0x03, 0x02, 0x01, // Color 0
+                    0xFF, 0xFF, 0xFF, // Color 1
+                    0b0101_0000, // Row 0
+                    0b1010_0000, // Row 1
+                };
+
+                Assert.Equal(expected, output.ToArray());
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.Send(Stream, VncPixelFormat, byte[])"/> method in a scenario where the
+        /// rectangle consists of a few colors, causing the encoder to use the palette filter.
+        /// </summary>
+        [Fact]
+        public void SendIndexedPaletteTest()
+        {
+            TightEncoder encoder = new TightEncoder(Mock.Of<IVncServerSession>());
+
+            // A 4x4 rectangle with 3 colors.
+            var contents = new byte[4 * 4 * 4];
+
+            for (int i = 0; i < 16; i++)
+            {
+                contents[4 * i] = (byte)(0x40 * (i % 3));
+            }
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                int sent = encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 4), contents);
+                var raw = output.ToArray();
+                Assert.Equal(raw.Length, sent);
+
+                // Basic compression with a filter, using and resetting stream 2.
+                Assert.Equal(0b0110_0100, raw[0]);
+                Assert.Equal((byte)TightFilter.Palette, raw[1]);
+                Assert.Equal(2, raw[2]);
+                Assert.Equal(new byte[] { 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x80 }, raw.AsSpan(3, 9).ToArray());
+                Assert.Equal(raw.Length - 13, raw[12]);
+
+                using (var stream = new ZlibStream(new MemoryStream(raw, 13, raw.Length - 13), CompressionMode.Decompress))
+                {
+                    byte[] decompressed = new byte[16];
+                    Assert.Equal(16, stream.Read(decompressed, 0, 16));
+
+                    for (int i = 0; i < 16; i++)
+                    {
+                        Assert.Equal(i % 3, decompressed[i]);
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.Send(Stream, VncPixelFormat, byte[])"/> method in a scenario where the
+        /// rectangle contains a smooth gradient, causing the encoder to use the gradient filter.
+        /// </summary>
+        [Fact]
+        public void SendGradientTest()
+        {
+            TightEncoder encoder = new TightEncoder(Mock.Of<IVncServerSession>())
+            {
+                Compression = TightCompression.Basic,
+            };
+
+            var contents = new byte[16 * 16 * 4];
+
+            for (int y = 0; y < 16; y++)
+            {
+                for (int x = 0; x < 16; x++)
+                {
+                    contents[(((y * 16) + x) * 4) + 1] = (byte)(x * 8);
+                    contents[(((y * 16) + x) * 4) + 2] = (byte)(y * 8);
+                }
+            }
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                int sent = encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 16, 16), contents);
+                var raw = output.ToArray();
+                Assert.Equal(raw.Length, sent);
+
+                // Basic compression with a filter, using and resetting stream 3.
+                Assert.Equal(0b0111_1000, raw[0]);
+                Assert.Equal((byte)TightFilter.Gradient, raw[1]);
+
+                int length = raw[2];
+                Assert.Equal(raw.Length - 3, length);
+
+                byte[] decompressed = new byte[16 * 16 * 3];
+
+                using (var stream = new ZlibStream(new MemoryStream(raw, 3, length), CompressionMode.Decompress))
+                {
+                    Assert.Equal(decompressed.Length, stream.Read(decompressed, 0, decompressed.Length));
+                }
+
+                // Undo the gradient filter, and make sure the original pixels are restored.
+                for (int i = 0; i < decompressed.Length; i++)
+                {
+                    int x = (i / 3) % 16;
+                    int left = x > 0 ? decompressed[i - 3] : 0;
+                    int above = i >= 48 ? decompressed[i - 48] : 0;
+                    int aboveLeft = x > 0 && i >= 48 ? decompressed[i - 51] : 0;
+                    int predicted = Math.Min(255, Math.Max(0, left + above - aboveLeft));
+
+                    decompressed[i] = (byte)(decompressed[i] + predicted);
+                }
+
+                for (int i = 0; i < 256; i++)
+                {
+                    Assert.Equal(contents[(4 * i) + 2], decompressed[3 * i]);
+                    Assert.Equal(contents[(4 * i) + 1], decompressed[(3 * i) + 1]);
+                    Assert.Equal(contents[4 * i], decompressed[(3 * i) + 2]);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.Send(Stream, VncPixelFormat, byte[])"/> method in a scenario where
+        /// multiple rectangles are sent, and the zlib stream is reused across rectangles.
+        /// </summary>
+        [Fact]
+        public void SendReusesStreamTest()
+        {
+            TightEncoder encoder = new TightEncoder(Mock.Of<IVncServerSession>())
+            {
+                Compression = TightCompression.Basic,
+            };
+
+            var contents = CreateNoise();
+
+            using (MemoryStream output = new MemoryStream())
+            using (MemoryStream zlibData = new MemoryStream())
+            {
+                int length = encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents);
+                Assert.Equal(output.Length, length);
+
+                byte[] first = output.ToArray();
+                Assert.Equal(0b0000_0001, first[0]);
+                zlibData.Write(first, 2, first[1]);
+
+                output.SetLength(0);
+                length = encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents);
+                Assert.Equal(output.Length, length);
+
+                // The second rectangle uses stream 0, but does not reset it.
+                byte[] second = output.ToArray();
+                Assert.Equal(0b0000_0000, second[0]);
+                Assert.Equal(second.Length - 2, second[1]);
+                zlibData.Write(second, 2, second[1]);
+
+                // A single inflater can decode both rectangles.
+                zlibData.Position = 0;
+
+                using (var stream = new ZlibStream(zlibData, CompressionMode.Decompress))
+                {
+                    byte[] decompressed = new byte[48];
+                    Assert.Equal(48, stream.Read(decompressed, 0, 48));
+                    Assert.Equal(CreateNoiseTightPixels(), decompressed.AsSpan(0, 24).ToArray());
+                    Assert.Equal(CreateNoiseTightPixels(), decompressed.AsSpan(24, 24).ToArray());
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.Send(Stream, VncPixelFormat, byte[])"/> method in a scenario where the
+        /// client requests a different compression level, causing the zlib stream to be reset.
+        /// </summary>
+        [Fact]
+        public void SendResetsStreamOnCompressionLevelChangeTest()
+        {
+            var encodings = new Collection<VncEncoding>() { VncEncoding.Tight, VncEncoding.TightCompressionLevel1 };
+
+            var session = new Mock<IVncServerSession>();
+            session
+                .Setup(m => m.ClientEncodings)
+                .Returns(encodings);
+
+            TightEncoder encoder = new TightEncoder(session.Object)
+            {
+                Compression = TightCompression.Basic,
+            };
+
+            var contents = CreateNoise();
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents);
+                Assert.Equal(0b0000_0001, output.ToArray()[0]);
+
+                output.SetLength(0);
+                encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents);
+                Assert.Equal(0b0000_0000, output.ToArray()[0]);
+
+                encodings[1] = VncEncoding.TightCompressionLevel9;
+
+                output.SetLength(0);
+                encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents);
+                Assert.Equal(0b0000_0001, output.ToArray()[0]);
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.PackTightPixels(ReadOnlySpan{byte}, Span{byte}, VncPixelFormat)"/> method
+        /// for both little-endian and big-endian pixel formats.
+        /// </summary>
+        /// <param name="isLittleEndian">
+        /// A value indicating whether the pixel format is little-endian.
+        /// </param>
+        [Theory]
+        [InlineData(true)]
+        [InlineData(false)]
+        public void PackTightPixelsTest(bool isLittleEndian)
+        {
+            var pixelFormat = new VncPixelFormat(32, 24, 8, 16, 8, 8, 8, 0, isLittleEndian: isLittleEndian);
+
+            // Use a pixel count which is not a multiple of 4, so that both the vectorized and the scalar code run.
+            byte[] source = new byte[37 * 4];
+            new Random(0).NextBytes(source);
+
+            byte[] target = new byte[(37 * 3) + 16];
+            TightEncoder.PackTightPixels(source, target, pixelFormat);
+
+            for (int i = 0; i < 37; i++)
+            {
+                if (isLittleEndian)
+                {
+                    Assert.Equal(source[(4 * i) + 2], target[3 * i]);
+                    Assert.Equal(source[(4 * i) + 1], target[(3 * i) + 1]);
+                    Assert.Equal(source[4 * i], target[(3 * i) + 2]);
+                }
+                else
+                {
+                    Assert.Equal(source[(4 * i) + 1], target[3 * i]);
+                    Assert.Equal(source[(4 * i) + 2], target[(3 * i) + 1]);
+                    Assert.Equal(source[(4 * i) + 3], target[(3 * i) + 2]);
+                }
+            }
         }
 
         /// <summary>
@@ -276,6 +537,25 @@ namespace RemoteViewing.Tests.Vnc.Server
             Assert.Equal(expectedQualityLevel, compressionLevel);
         }
 
+        /// <summary>
+        /// Tests the <see cref="TightEncoder.GetRequestedQualityLevel(IVncServerSession)"/> method.
+        /// </summary>
+        [Fact]
+        public void GetRequestedQualityLevelTest()
+        {
+            var encodings = new Collection<VncEncoding>() { VncEncoding.Tight };
+
+            var mock = new Mock<IVncServerSession>();
+            mock
+                .Setup(m => m.ClientEncodings)
+                .Returns(encodings);
+
+            Assert.Null(TightEncoder.GetRequestedQualityLevel(mock.Object));
+
+            encodings.Add(VncEncoding.TightQualityLevel3);
+            Assert.Equal(3, TightEncoder.GetRequestedQualityLevel(mock.Object));
+        }
+
         /// <summary>
         /// Tests the <see cref="TightEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/> method in a scenario
         /// where the data will be compressed using a JPEG encoder.
@@ -297,20 +577,23 @@ namespace RemoteViewing.Tests.Vnc.Server
             };
 
             byte[] raw = null;
+            int sent;
 
             using (MemoryStream output = new MemoryStream())
             {
                 var contents = new byte[512];
 
-                // An entirely blue picture
-                Array.Copy(new byte[] { 0xFF, 0x00, 0x00, 0x00 }, 0, contents, 0, 4);
-                Array.Copy(new byte[] { 0xFF, 0x00, 0x00, 0x00 }, 0, contents, 4, 4);
-                Array.Copy(new byte[] { 0xFF, 0x00, 0x00, 0x00 }, 0, contents, 8, 4);
-                Array.Copy(new byte[] { 0xFF, 0x00, 0x00, 0x00 }, 0, contents, 12, 4);
-                encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle() { Width = 2, Height = 2 }, contents);
+                // A blue picture, with enough variation in the blue channel not to be sent using a palette.
+                for (int i = 0; i < 128; i++)
+                {
+                    contents[4 * i] = (byte)(0xFF - (i % 32));
+                }
+
+                sent = encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle() { Width = 16, Height = 8 }, contents);
                 raw = output.ToArray();
             }
 
+            Assert.Equal(raw.Length, sent);
             Assert.Equal((byte)TightCompressionControl.JpegCompression, raw[0]);
 
             // Make sure the compressed image is a valid JPEG image,
@@ -326,21 +609,46 @@ namespace RemoteViewing.Tests.Vnc.Server
             using (var bitmap = new Bitmap(stream))
             {
                 Assert.Equal(PixelFormat.Format24bppRgb, bitmap.PixelFormat);
-                Assert.Equal(2, bitmap.Width);
-                Assert.Equal(2, bitmap.Height);
+                Assert.Equal(16, bitmap.Width);
+                Assert.Equal(8, bitmap.Height);
 
-                for (int i = 0; i < 2; i++)
+                for (int i = 0; i < 16; i++)
                 {
-                    for (int j = 0; j < 2; j++)
+                    for (int j = 0; j < 8; j++)
                     {
                         var color = bitmap.GetPixel(i, j);
-                        Assert.Equal(0, color.R);
-                        Assert.Equal(0, color.G);
-                        Assert.True(color.B > 250);
+                        Assert.True(color.R < 8);
+                        Assert.True(color.G < 8);
+                        Assert.True(color.B > 216);
                         Assert.Equal(255, color.A);
                     }
                 }
             }
         }
+
+        private static byte[] CreateNoise()
+        {
+            // A 4x2 framebuffer in BGRX format, in which each pixel has a different color.
+            return new byte[]
+            {
+                0x10, 0x80, 0xF0, 0x00, 0xE0, 0x20, 0x40, 0x00, 0x30, 0xD0, 0x90, 0x00, 0xA0, 0x60, 0x00, 0x00,
+                0x70, 0x00, 0xC0, 0x00, 0x00, 0xB0, 0x50, 0x00, 0xC0, 0x40, 0xA0, 0x00, 0x50, 0xF0, 0x20, 0x00,
+            };
+        }
+
+        private static byte[] CreateNoiseTightPixels()
+        {
+            var noise = CreateNoise();
+            var tpixels = new byte[24];
+
+            for (int i = 0; i < 8; i++)
+            {
+                tpixels[3 * i] = noise[(4 * i) + 2];
+                tpixels[(3 * i) + 1] = noise[(4 * i) + 1];
+                tpixels[(3 * i) + 2] = noise[4 * i];
+            }
+
+            return tpixels;
+        }
     }
-}
+}
\ No newline at end of file
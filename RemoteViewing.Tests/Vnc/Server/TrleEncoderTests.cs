@@ -0,0 +1,262 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.IO;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="TrleEncoder"/> class.
+    /// </summary>
+    public class TrleEncoderTests
+    {
+        /// <summary>
+        /// Tests the <see cref="TrleEncoder.Encoding"/> property.
+        /// </summary>
+        [Fact]
+        public void EncodingTest()
+        {
+            var encoder = new TrleEncoder();
+            Assert.Equal(VncEncoding.TRLE, encoder.Encoding);
+            Assert.Equal(16, encoder.TileSize);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TrleEncoder.GetCompressedPixelFormat(VncPixelFormat, out int, out int)"/> method.
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The index of the pixel format to test.
+        /// </param>
+        /// <param name="expectedSize">
+        /// The expected size of a CPIXEL.
+        /// </param>
+        /// <param name="expectedOffset">
+        /// The expected offset of a CPIXEL.
+        /// </param>
+        [Theory]
+        [InlineData(0, 3, 0)]
+        [InlineData(1, 3, 1)]
+        [InlineData(2, 3, 1)]
+        [InlineData(3, 1, 0)]
+        [InlineData(4, 4, 0)]
+        public void GetCompressedPixelFormatTest(int pixelFormat, int expectedSize, int expectedOffset)
+        {
+            var pixelFormats = new VncPixelFormat[]
+            {
+                VncPixelFormat.RGB32,
+                new VncPixelFormat(32, 24, 8, 24, 8, 16, 8, 8),
+                new VncPixelFormat(32, 24, 8, 16, 8, 8, 8, 0, isLittleEndian: false),
+                new VncPixelFormat(8, 6, 2, 4, 2, 2, 2, 0),
+                new VncPixelFormat(32, 24, 8, 24, 8, 12, 8, 0),
+            };
+
+            TrleEncoder.GetCompressedPixelFormat(pixelFormats[pixelFormat], out int size, out int offset);
+            Assert.Equal(expectedSize, size);
+            Assert.Equal(expectedOffset, offset);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TrleEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/> method for
+        /// a tile which contains a single color.
+        /// </summary>
+        [Fact]
+        public void SendSolidTileTest()
+        {
+            var encoder = new TrleEncoder();
+            var contents = Repeat(16 * 16, 0x01, 0x02, 0x03, 0x00);
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                Assert.Equal(4, encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 16, 16), contents));
+                Assert.Equal(new byte[] { 0x01, 0x01, 0x02, 0x03 }, output.ToArray());
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TrleEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/> method for
+        /// a tile which uses two colors, in a pattern which causes a packed palette to be used.
+        /// </summary>
+        [Fact]
+        public void SendPackedPaletteTileTest()
+        {
+            var encoder = new TrleEncoder();
+
+            // A 4x2 checkerboard
+            var contents = new byte[]
+            {
+                0x01, 0x02, 0x03, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0x03, 0x00, 0xFF, 0xFF, 0xFF, 0x00,
+                0xFF, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0x03, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0x03, 0x00,
+            };
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                Assert.Equal(9, encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 2), contents));
+
+                var expected = new byte[]
+                {
+                    0x02, // Packed palette with 2 colors
+                    0x01, 0x02, 0x03, // Color 0
+                    0xFF, 0xFF, 0xFF, // Color 1
+                    0b0101_0000, // Row 0
+                    0b1010_0000, // Row 1
+                };
+
+                Assert.Equal(expected, output.ToArray());
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TrleEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/> method for
+        /// a tile which consists of long runs of a few colors, causing palette RLE to be used.
+        /// </summary>
+        [Fact]
+        public void SendPaletteRleTileTest()
+        {
+            var encoder = new TrleEncoder();
+
+            var contents = Repeat(16 * 16, 0x00, 0x00, 0xFF, 0x00);
+            contents[4 * 4] = 0xFF;
+            contents[(4 * 4) + 2] = 0x00;
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 16, 16), contents);
+
+                var expected = new byte[]
+                {
+                    0x82, // Palette RLE with 2 colors
+                    0x00, 0x00, 0xFF, // Color 0
+                    0xFF, 0x00, 0x00, // Color 1
+                    0x80, 0x03, // 4 pixels of color 0
+                    0x01, // 1 pixel of color 1
+                    0x80, 0xFA, // 251 pixels of color 0
+                };
+
+                Assert.Equal(expected, output.ToArray());
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TrleEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/> method for
+        /// a tile in which every pixel has a different color, causing raw pixels to be sent.
+        /// </summary>
+        [Fact]
+        public void SendRawTileTest()
+        {
+            var encoder = new TrleEncoder();
+
+            var contents = new byte[16 * 16 * 4];
+
+            for (int i = 0; i < 256; i++)
+            {
+                contents[4 * i] = (byte)i;
+                contents[(4 * i) + 1] = (byte)(255 - i);
+                contents[(4 * i) + 2] = 0x80;
+            }
+
+            using (MemoryStream output = new MemoryStream())
+            {
+                Assert.Equal(1 + (256 * 3), encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, 16, 16), contents));
+
+                var raw = output.ToArray();
+                Assert.Equal(0, raw[0]);
+
+                for (int i = 0; i < 256; i++)
+                {
+                    Assert.Equal(contents[4 * i], raw[1 + (3 * i)]);
+                    Assert.Equal(contents[(4 * i) + 1], raw[2 + (3 * i)]);
+                    Assert.Equal(contents[(4 * i) + 2], raw[3 + (3 * i)]);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TrleEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/> method for
+        /// a rectangle which is large enough for the tiles to be encoded in parallel, and makes sure the tiles
+        /// are sent in order.
+        /// </summary>
+        [Fact]
+        public void SendParallelTest()
+        {
+            var encoder = new TrleEncoder();
+
+            int width = 100;
+            int height = 70;
+            var contents = new byte[width * height * 4];
+            var random = new Random(0);
+
+            for (int i = 0; i < contents.Length; i += 4)
+            {
+                // Use a few colors and runs, so that all subencodings are used.
+                contents[i] = (byte)(random.Next(i % 1000 < 500 ? 2 : 256) * 16);
+                contents[i + 1] = (byte)((i / 4) % width < 50 ? 0x00 : 0xFF);
+            }
+
+            using (MemoryStream output = new MemoryStream())
+            using (MemoryStream expected = new MemoryStream())
+            {
+                int sent = encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, width, height), contents);
+                Assert.Equal(output.Length, sent);
+
+                for (int y = 0; y < height; y += 16)
+                {
+                    for (int x = 0; x < width; x += 16)
+                    {
+                        var tile = new VncRectangle(x, y, Math.Min(16, width - x), Math.Min(16, height - y));
+                        var tileContents = new byte[tile.Width * tile.Height * 4];
+
+                        for (int row = 0; row < tile.Height; row++)
+                        {
+                            Array.Copy(contents, (((y + row) * width) + x) * 4, tileContents, row * tile.Width * 4, tile.Width * 4);
+                        }
+
+                        encoder.Send(expected, VncPixelFormat.RGB32, tile, tileContents);
+                    }
+                }
+
+                Assert.Equal(expected.ToArray(), output.ToArray());
+            }
+        }
+
+        private static byte[] Repeat(int count, params byte[] value)
+        {
+            byte[] buffer = new byte[count * value.Length];
+
+            for (int i = 0; i < count; i++)
+            {
+                Array.Copy(value, 0, buffer, i * value.Length, value.Length);
+            }
+
+            return buffer;
+        }
+    }
+}
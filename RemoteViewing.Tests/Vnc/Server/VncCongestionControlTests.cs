@@ -0,0 +1,104 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc.Server;
+using System;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncCongestionControl"/> class.
+    /// </summary>
+    public class VncCongestionControlTests
+    {
+        /// <summary>
+        /// Tests that the congestion window limits the amount of data in flight.
+        /// </summary>
+        [Fact]
+        public void IsCongestedTest()
+        {
+            var congestionControl = new VncCongestionControl();
+            Assert.False(congestionControl.IsCongested);
+
+            congestionControl.Sent(VncCongestionControl.InitialWindow);
+            var id = congestionControl.SentPing(TimeSpan.Zero);
+            Assert.True(congestionControl.IsCongested);
+            Assert.Equal(VncCongestionControl.InitialWindow, congestionControl.BytesInFlight);
+
+            Assert.True(congestionControl.ReceivedPong(id, TimeSpan.FromMilliseconds(10)));
+            Assert.False(congestionControl.IsCongested);
+            Assert.Equal(0, congestionControl.BytesInFlight);
+            Assert.Equal(TimeSpan.FromMilliseconds(10), congestionControl.RoundTripTime);
+
+            // Unknown responses are ignored.
+            Assert.False(congestionControl.ReceivedPong(id, TimeSpan.FromMilliseconds(20)));
+        }
+
+        /// <summary>
+        /// Tests that the congestion window grows while the round-trip time is stable, and shrinks
+        /// when the round-trip time increases.
+        /// </summary>
+        [Fact]
+        public void WindowTest()
+        {
+            var congestionControl = new VncCongestionControl();
+            var time = TimeSpan.Zero;
+
+            // Slow start: the window doubles each round trip.
+            for (int i = 0; i < 3; i++)
+            {
+                congestionControl.Sent(congestionControl.Window);
+                var id = congestionControl.SentPing(time);
+                time += TimeSpan.FromMilliseconds(50);
+                congestionControl.ReceivedPong(id, time);
+            }
+
+            Assert.Equal(8 * VncCongestionControl.InitialWindow, congestionControl.Window);
+            Assert.Equal(TimeSpan.FromMilliseconds(50), congestionControl.MinimumRoundTripTime);
+
+            // The round-trip time doubles, so data is queuing up.
+            var window = congestionControl.Window;
+            congestionControl.Sent(window);
+            var ping = congestionControl.SentPing(time);
+            time += TimeSpan.FromMilliseconds(100);
+            congestionControl.ReceivedPong(ping, time);
+
+            Assert.Equal(window * 3 / 4, congestionControl.Window);
+
+            // Afterwards, the window grows slowly.
+            window = congestionControl.Window;
+            congestionControl.Sent(window);
+            ping = congestionControl.SentPing(time);
+            time += TimeSpan.FromMilliseconds(50);
+            congestionControl.ReceivedPong(ping, time);
+
+            Assert.Equal(window + VncCongestionControl.MinimumWindow, congestionControl.Window);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Moq;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.IO;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncEncoder"/> class.
+    /// </summary>
+    public class VncEncoderTests
+    {
+        /// <summary>
+        /// Tests the <see cref="VncEncoder.Send(Stream, VncPixelFormat, VncRectangle, ReadOnlySpan{byte})"/> method
+        /// for an encoder which only implements the <see cref="VncEncoder.Send(Stream, VncPixelFormat, VncRectangle, byte[])"/>
+        /// overload.
+        /// </summary>
+        [Fact]
+        public void SendSpanCompatibilityTest()
+        {
+            var encoder = new ArrayEncoder();
+            byte[] buffer = { 0xFF, 0x01, 0x02, 0x03, 0x04, 0xFF };
+
+            using (MemoryStream stream = new MemoryStream())
+            {
+                var sent = encoder.Send(stream, new VncPixelFormat(), default(VncRectangle), new ReadOnlySpan<byte>(buffer, 1, 4));
+
+                Assert.Equal(4, sent);
+                Assert.Equal(new byte[] { 0x01, 0x02, 0x03, 0x04 }, encoder.Contents);
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncEncoder.GetSharedEncodingKey(VncPixelFormat, VncRectangle)"/> method; by default,
+        /// encoded data is not shared.
+        /// </summary>
+        [Fact]
+        public void GetSharedEncodingKeyTest()
+        {
+            var encoder = new ArrayEncoder();
+            Assert.Null(encoder.GetSharedEncodingKey(VncPixelFormat.RGB32, new VncRectangle(0, 0, 1, 1)));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncEncoder.MaximumRectangleWidth"/> and <see cref="VncEncoder.MaximumRectangleArea"/>
+        /// properties; by default, the size of a rectangle is not limited.
+        /// </summary>
+        [Fact]
+        public void MaximumRectangleSizeTest()
+        {
+            var encoder = new ArrayEncoder();
+            Assert.Equal(int.MaxValue, encoder.MaximumRectangleWidth);
+            Assert.Equal(int.MaxValue, encoder.MaximumRectangleArea);
+
+            var tight = new TightEncoder(Mock.Of<IVncServerSession>());
+            Assert.Equal(2048, tight.MaximumRectangleWidth);
+            Assert.Equal(65536, tight.MaximumRectangleArea);
+        }
+
+        private class ArrayEncoder : VncEncoder
+        {
+            public override VncEncoding Encoding => VncEncoding.Raw;
+
+            public byte[] Contents { get; private set; }
+
+            public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, byte[] contents)
+            {
+                this.Contents = contents;
+                return contents.Length;
+            }
+        }
+    }
+}
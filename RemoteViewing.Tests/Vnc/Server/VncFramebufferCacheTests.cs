@@ -0,0 +1,297 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Moq;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System.Collections.Generic;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncFramebufferCache"/> class.
+    /// </summary>
+    public class VncFramebufferCacheTests
+    {
+        /// <summary>
+        /// Tests the <see cref="VncFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// when a full (non-incremental) update is requested.
+        /// </summary>
+        [Fact]
+        public void RespondToFullUpdateRequestTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 200, 100, VncPixelFormat.RGB32);
+            var cache = new VncFramebufferCache(framebuffer, null);
+
+            var invalidated = this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(false, new VncRectangle(0, 0, 200, 100)));
+
+            Assert.Collection(
+                invalidated,
+                (r) => Assert.Equal(new VncRectangle(0, 0, 200, 100), r));
+
+            // The cache is now up to date, so an incremental update should not invalidate anything.
+            invalidated = this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, new VncRectangle(0, 0, 200, 100)));
+            Assert.Empty(invalidated);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// when a small number of pixels have changed; only the tiles which contain these pixels should be
+        /// invalidated.
+        /// </summary>
+        [Fact]
+        public void RespondToIncrementalUpdateRequestTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 200, 150, VncPixelFormat.RGB32);
+            var cache = new VncFramebufferCache(framebuffer, null);
+            var region = new VncRectangle(0, 0, 200, 150);
+
+            this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(false, region));
+
+            // A single pixel in the top-left tile, and a pixel in the bottom-right (partial) tile.
+            framebuffer.SetPixel(1, 1, 0xFFFFFF);
+            framebuffer.SetPixel(199, 149, 0xFFFFFF);
+
+            var invalidated = this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region));
+
+            Assert.Collection(
+                invalidated,
+                (r) => Assert.Equal(new VncRectangle(0, 0, 64, 64), r),
+                (r) => Assert.Equal(new VncRectangle(192, 128, 8, 22), r));
+
+            invalidated = this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region));
+            Assert.Empty(invalidated);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// when adjacent tiles have changed; the tiles should be merged into a single rectangle.
+        /// </summary>
+        [Fact]
+        public void RespondToIncrementalUpdateRequestMergesTilesTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 256, 256, VncPixelFormat.RGB32);
+            var cache = new VncFramebufferCache(framebuffer, null);
+            var region = new VncRectangle(0, 0, 256, 256);
+
+            this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(false, region));
+
+            // A 2x2 block of tiles, starting at tile (1, 1).
+            for (int y = 70; y < 190; y += 60)
+            {
+                for (int x = 70; x < 190; x += 60)
+                {
+                    framebuffer.SetPixel(x, y, 0x123456);
+                }
+            }
+
+            // And a lone tile on the last row.
+            framebuffer.SetPixel(10, 250, 0x123456);
+
+            var invalidated = this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region));
+
+            Assert.Collection(
+                invalidated,
+                (r) => Assert.Equal(new VncRectangle(64, 64, 128, 128), r),
+                (r) => Assert.Equal(new VncRectangle(0, 192, 64, 64), r));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// when the client requests only part of the framebuffer.
+        /// </summary>
+        [Fact]
+        public void RespondToIncrementalUpdateRequestSubregionTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 256, 256, VncPixelFormat.RGB32);
+            var cache = new VncFramebufferCache(framebuffer, null);
+
+            this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(false, new VncRectangle(0, 0, 256, 256)));
+
+            framebuffer.SetPixel(100, 100, 0x123456);
+            framebuffer.SetPixel(10, 10, 0x123456);
+
+            var invalidated = this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, new VncRectangle(90, 80, 50, 50)));
+
+            Assert.Collection(
+                invalidated,
+                (r) => Assert.Equal(new VncRectangle(90, 80, 38, 48), r));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// when the framebuffer has scrolled; the scrolled block should be sent as a copy, and only the
+        /// rows which have scrolled into view should be invalidated.
+        /// </summary>
+        [Fact]
+        public void RespondToIncrementalUpdateRequestScrollTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 128, 256, VncPixelFormat.RGB32);
+            var cache = new VncFramebufferCache(framebuffer, null);
+            var region = new VncRectangle(0, 0, 128, 256);
+            var moves = new List<VncFramebufferMove>();
+
+            DrawRows(framebuffer, 0);
+            this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(false, region), moves);
+
+            // Scroll up by 10 rows.
+            DrawRows(framebuffer, 10);
+            var invalidated = this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region), moves);
+
+            Assert.Collection(
+                moves,
+                (m) =>
+                {
+                    Assert.Equal(new VncRectangle(0, 0, 128, 246), m.Target);
+                    Assert.Equal(0, m.SourceX);
+                    Assert.Equal(10, m.SourceY);
+                });
+
+            Assert.Collection(
+                invalidated,
+                (r) => Assert.Equal(new VncRectangle(0, 192, 128, 64), r));
+
+            // The cache has been updated with the moves.
+            moves.Clear();
+            Assert.Empty(this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region), moves));
+            Assert.Empty(moves);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// when the framebuffer has scrolled, but the client doesn't support the CopyRect encoding.
+        /// </summary>
+        [Fact]
+        public void RespondToIncrementalUpdateRequestScrollWithoutCopyRectTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 128, 256, VncPixelFormat.RGB32);
+            var cache = new VncFramebufferCache(framebuffer, null);
+            var region = new VncRectangle(0, 0, 128, 256);
+
+            DrawRows(framebuffer, 0);
+            this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(false, region));
+
+            DrawRows(framebuffer, 10);
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region)),
+                (r) => Assert.Equal(region, r));
+        }
+
+        /// <summary>
+        /// Draws a pattern in which each row is unique.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The framebuffer in which to draw.
+        /// </param>
+        /// <param name="offset">
+        /// The row of the pattern to draw at the top of the framebuffer.
+        /// </param>
+        internal static void DrawRows(VncFramebuffer framebuffer, int offset)
+        {
+            for (int y = 0; y < framebuffer.Height; y++)
+            {
+                for (int x = 0; x < framebuffer.Width; x++)
+                {
+                    framebuffer.SetPixel(x, y, (((y + offset) * 7919) ^ (x * 31)) & 0xFFFFFF);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method when the
+        /// framebuffer source reports which regions have changed; only those regions should be compared.
+        /// </summary>
+        [Fact]
+        public void RespondToIncrementalUpdateRequestDamageTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 200, 150, VncPixelFormat.RGB32);
+            var history = new VncDamageHistory();
+            var source = new Mock<IVncFramebufferDamageSource>();
+            source
+                .Setup(s => s.FrameSequence)
+                .Returns(() => history.Sequence);
+            source
+                .Setup(s => s.TryGetDamage(It.IsAny<long>(), It.IsAny<ICollection<VncRectangle>>()))
+                .Returns<long, ICollection<VncRectangle>>((sequence, damage) => history.TryGetDamage(sequence, damage));
+
+            var cache = new VncFramebufferCache(framebuffer, null);
+            cache.DamageSource = source.Object;
+            var region = new VncRectangle(0, 0, 200, 150);
+
+            this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(false, region));
+
+            // Only the change in the top-left tile is reported by the source.
+            framebuffer.SetPixel(1, 1, 0xFFFFFF);
+            framebuffer.SetPixel(199, 149, 0xFFFFFF);
+            history.Add(new VncRectangle(0, 0, 2, 2));
+
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region)),
+                (r) => Assert.Equal(new VncRectangle(0, 0, 64, 64), r));
+            Assert.Empty(this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region)));
+
+            // Once the damage is unknown, the entire framebuffer is compared.
+            history.AddUnknown();
+
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache, new FramebufferUpdateRequest(true, region)),
+                (r) => Assert.Equal(new VncRectangle(192, 128, 8, 22), r));
+        }
+
+        private List<VncRectangle> RespondToUpdateRequest(VncFramebufferCache cache, FramebufferUpdateRequest request, List<VncFramebufferMove> moves = null)
+        {
+            var invalidated = new List<VncRectangle>();
+
+            var session = new Mock<IVncServerSession>();
+            session
+                .Setup(s => s.FramebufferUpdateRequest)
+                .Returns(request);
+
+            if (moves != null)
+            {
+                session
+                    .Setup(s => s.ClientEncodings)
+                    .Returns(new[] { VncEncoding.CopyRect, VncEncoding.Raw });
+                session
+                    .Setup(s => s.FramebufferManualCopyRegion(It.IsAny<VncRectangle>(), It.IsAny<int>(), It.IsAny<int>()))
+                    .Callback<VncRectangle, int, int>((r, x, y) => moves.Add(new VncFramebufferMove(r, x, y)));
+            }
+
+            session
+                .Setup(s => s.FramebufferManualInvalidate(It.IsAny<VncRectangle>()))
+                .Callback<VncRectangle>((r) => invalidated.Add(r));
+            session
+                .Setup(s => s.FramebufferManualEndUpdate())
+                .Returns(true);
+
+            Assert.True(cache.RespondToUpdateRequest(session.Object));
+            return invalidated;
+        }
+    }
+}
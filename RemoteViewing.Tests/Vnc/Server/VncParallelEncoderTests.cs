@@ -0,0 +1,104 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Moq;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.IO;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncParallelEncoder"/> class.
+    /// </summary>
+    public class VncParallelEncoderTests
+    {
+        /// <summary>
+        /// Tests that a rectangle which can be encoded independently is encoded on a worker, and yields the same
+        /// data as the encoder of the session.
+        /// </summary>
+        [Fact]
+        public void EncodeTest()
+        {
+            var encoder = new TightEncoder(new Mock<IVncServerSession>().Object);
+            var parallelEncoder = new VncParallelEncoder() { MaxThreads = 4 };
+            var region = new VncRectangle(0, 0, 128, 64);
+            var contents = new byte[region.Area * 4];
+            contents.AsSpan().Fill(0x42);
+
+            var task = parallelEncoder.Encode(encoder, VncPixelFormat.RGB32, region, contents);
+            Assert.NotNull(task);
+
+            using (var expected = new MemoryStream())
+            {
+                encoder.Send(expected, VncPixelFormat.RGB32, region, contents);
+                Assert.Equal(expected.ToArray(), task.Result.ToArray());
+            }
+        }
+
+        /// <summary>
+        /// Tests that a rectangle which depends on the state of the encoder is left to the encoder of the session.
+        /// </summary>
+        [Fact]
+        public void EncodeDependentTest()
+        {
+            var encoder = new TightEncoder(new Mock<IVncServerSession>().Object);
+            var parallelEncoder = new VncParallelEncoder() { MaxThreads = 4 };
+            var region = new VncRectangle(0, 0, 128, 64);
+            var contents = new byte[region.Area * 4];
+            new Random(0).NextBytes(contents);
+
+            var task = parallelEncoder.Encode(encoder, VncPixelFormat.RGB32, region, contents);
+            Assert.NotNull(task);
+            Assert.Null(task.Result);
+        }
+
+        /// <summary>
+        /// Tests that rectangles are not encoded on a worker when parallel encoding is disabled, when they are too small,
+        /// or when the encoder doesn't support it.
+        /// </summary>
+        [Fact]
+        public void EncodeNotSupportedTest()
+        {
+            var encoder = new TightEncoder(new Mock<IVncServerSession>().Object);
+            var parallelEncoder = new VncParallelEncoder();
+            var region = new VncRectangle(0, 0, 128, 64);
+            var contents = new byte[region.Area * 4];
+
+            Assert.Null(parallelEncoder.Encode(encoder, VncPixelFormat.RGB32, region, contents));
+
+            parallelEncoder.MaxThreads = 4;
+            Assert.Null(parallelEncoder.Encode(encoder, VncPixelFormat.RGB32, new VncRectangle(0, 0, 8, 8), contents));
+            Assert.Null(parallelEncoder.Encode(new ZrleEncoder(), VncPixelFormat.RGB32, region, contents));
+
+            Assert.Throws<ArgumentOutOfRangeException>(() => parallelEncoder.MaxThreads = 0);
+        }
+    }
+}
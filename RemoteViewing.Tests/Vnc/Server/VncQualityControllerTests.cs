@@ -0,0 +1,155 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc.Server;
+using System;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncQualityController"/> class.
+    /// </summary>
+    public class VncQualityControllerTests
+    {
+        /// <summary>
+        /// Tests that the quality level is lowered first, and the update rate afterwards, when the
+        /// connection can't keep up; and that both are restored once it can.
+        /// </summary>
+        [Fact]
+        public void SlowConnectionTest()
+        {
+            var controller = new VncQualityController();
+            controller.MaximumUpdateRate = 10;
+            controller.MaximumQualityLevel = 9;
+            Assert.Equal(9, controller.QualityLevel);
+            Assert.False(controller.IsConstrained);
+
+            // 100 kB updates over a 100 kB/s connection take 1 second each.
+            var now = TimeSpan.Zero;
+            controller.Queued(100_000, TimeSpan.FromMilliseconds(1), now);
+            controller.Drained(now + TimeSpan.FromSeconds(1));
+            Assert.Equal(100_000, controller.Bandwidth);
+
+            for (int level = 8; level >= 0; level--)
+            {
+                now += VncQualityController.AdjustInterval;
+                Assert.True(controller.Adjust(now));
+                Assert.Equal(level, controller.QualityLevel);
+                Assert.Equal(10, controller.UpdateRate);
+                Assert.True(controller.IsConstrained);
+            }
+
+            now += VncQualityController.AdjustInterval;
+            Assert.True(controller.Adjust(now));
+            Assert.Equal(0, controller.QualityLevel);
+            Assert.Equal(1, controller.UpdateRate);
+
+            // The connection is now fast enough: the update rate is restored first.
+            for (int i = 0; i < 20; i++)
+            {
+                controller.Queued(1_000, TimeSpan.FromMilliseconds(1), now);
+                controller.Drained(now + TimeSpan.FromMilliseconds(1));
+            }
+
+            now += VncQualityController.AdjustInterval;
+            Assert.True(controller.Adjust(now));
+            Assert.Equal(0, controller.QualityLevel);
+            Assert.Equal(10, controller.UpdateRate);
+
+            for (int level = 1; level <= 9; level++)
+            {
+                now += VncQualityController.AdjustInterval;
+                Assert.True(controller.Adjust(now));
+                Assert.Equal(level, controller.QualityLevel);
+            }
+
+            // The quality level never exceeds the level requested by the client.
+            now += VncQualityController.AdjustInterval;
+            Assert.False(controller.Adjust(now));
+            Assert.False(controller.IsConstrained);
+        }
+
+        /// <summary>
+        /// Tests that the update rate is lowered when encoding updates takes longer than the interval
+        /// between updates.
+        /// </summary>
+        [Fact]
+        public void SlowEncoderTest()
+        {
+            var controller = new VncQualityController();
+            controller.MaximumUpdateRate = 10;
+            controller.MaximumQualityLevel = 5;
+
+            controller.Queued(1_000, TimeSpan.FromMilliseconds(500), TimeSpan.Zero);
+            controller.Drained(TimeSpan.FromMilliseconds(1));
+
+            Assert.True(controller.Adjust(TimeSpan.FromSeconds(1)));
+            Assert.Equal(2, controller.UpdateRate);
+            Assert.Equal(5, controller.QualityLevel);
+        }
+
+        /// <summary>
+        /// Tests that only the update rate is adjusted when the client doesn't accept JPEG compression.
+        /// </summary>
+        [Fact]
+        public void NoJpegTest()
+        {
+            var controller = new VncQualityController();
+            controller.MaximumUpdateRate = 10;
+            Assert.Null(controller.QualityLevel);
+
+            controller.Queued(50_000, TimeSpan.Zero, TimeSpan.Zero);
+            controller.Drained(TimeSpan.FromSeconds(1));
+
+            Assert.True(controller.Adjust(TimeSpan.FromSeconds(1)));
+            Assert.Equal(1, controller.UpdateRate);
+            Assert.Null(controller.QualityLevel);
+        }
+
+        /// <summary>
+        /// Tests that adjustments are spaced at least <see cref="VncQualityController.AdjustInterval"/> apart.
+        /// </summary>
+        [Fact]
+        public void AdjustIntervalTest()
+        {
+            var controller = new VncQualityController();
+            controller.MaximumQualityLevel = 9;
+
+            // No data has been sent yet.
+            Assert.False(controller.Adjust(TimeSpan.Zero));
+
+            controller.Queued(100_000, TimeSpan.Zero, TimeSpan.Zero);
+            controller.Drained(TimeSpan.FromSeconds(1));
+
+            Assert.True(controller.Adjust(TimeSpan.FromSeconds(1)));
+            Assert.False(controller.Adjust(TimeSpan.FromSeconds(1) + VncQualityController.AdjustInterval - TimeSpan.FromTicks(1)));
+            Assert.True(controller.Adjust(TimeSpan.FromSeconds(1) + VncQualityController.AdjustInterval));
+        }
+    }
+}
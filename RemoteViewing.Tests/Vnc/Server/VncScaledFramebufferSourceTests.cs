@@ -0,0 +1,234 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Moq;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.Collections.Generic;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncScaledFramebufferSource"/> class.
+    /// </summary>
+    public class VncScaledFramebufferSourceTests
+    {
+        /// <summary>
+        /// Tests the <see cref="VncScaledFramebufferSource.Capture"/> method, which should average the pixels in
+        /// each box of the source framebuffer.
+        /// </summary>
+        [Fact]
+        public void CaptureTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 4, 4, VncPixelFormat.RGB32);
+            framebuffer.SetPixel(0, 0, 0xFFFFFF);
+            framebuffer.SetPixel(1, 1, 0x808080);
+            framebuffer.SetPixel(3, 3, 0x000400);
+
+            var scaledSource = new VncScaledFramebufferSource(framebuffer);
+
+            // The framebuffer is not scaled until a smaller size has been requested.
+            Assert.Same(framebuffer, scaledSource.Capture());
+
+            Assert.Equal(ExtendedDesktopSizeStatus.Success, scaledSource.SetDesktopSize(2, 2));
+            var scaled = scaledSource.Capture();
+
+            Assert.Equal("test", scaled.Name);
+            Assert.Equal(2, scaled.Width);
+            Assert.Equal(2, scaled.Height);
+            Assert.Equal(new byte[] { 0x60, 0x60, 0x60 }, new ArraySegment<byte>(scaled.GetBuffer(), 0, 3));
+            Assert.Equal(new byte[] { 0x00, 0x00, 0x00 }, new ArraySegment<byte>(scaled.GetBuffer(), 4, 3));
+            Assert.Equal(new byte[] { 0x00, 0x01, 0x00 }, new ArraySegment<byte>(scaled.GetBuffer(), scaled.Stride + 4, 3));
+
+            // Requesting the size of the source turns scaling off.
+            Assert.Equal(ExtendedDesktopSizeStatus.Success, scaledSource.SetDesktopSize(4, 4));
+            Assert.Same(framebuffer, scaledSource.Capture());
+        }
+
+        /// <summary>
+        /// Tests that <see cref="VncScaledFramebufferSource.SetDesktopSize(int, int)"/> passes sizes which are larger
+        /// than the source on to the source.
+        /// </summary>
+        [Fact]
+        public void SetDesktopSizeTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 100, 100, VncPixelFormat.RGB32);
+            var source = new Mock<IVncFramebufferSource>();
+            source.Setup(s => s.Capture()).Returns(framebuffer);
+            source.Setup(s => s.SetDesktopSize(200, 100)).Returns(ExtendedDesktopSizeStatus.Prohibited);
+
+            var scaledSource = new VncScaledFramebufferSource(source.Object);
+
+            Assert.Equal(ExtendedDesktopSizeStatus.InvalidScreenLayout, scaledSource.SetDesktopSize(0, 100));
+            Assert.Equal(ExtendedDesktopSizeStatus.Prohibited, scaledSource.SetDesktopSize(200, 100));
+            Assert.Equal(ExtendedDesktopSizeStatus.Success, scaledSource.SetDesktopSize(50, 20));
+
+            var scaled = scaledSource.Capture();
+            Assert.Equal(50, scaled.Width);
+            Assert.Equal(20, scaled.Height);
+        }
+
+        /// <summary>
+        /// Tests that only the regions which the source reports as damaged are scaled again, and that they are
+        /// reported as damage of the scaled framebuffer.
+        /// </summary>
+        [Fact]
+        public void DamageTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 200, 100, VncPixelFormat.RGB32);
+            var history = new VncDamageHistory();
+            var scaledSource = new VncScaledFramebufferSource(CreateDamageSource(framebuffer, history));
+            scaledSource.SetDesktopSize(100, 50);
+
+            var scaled = scaledSource.Capture();
+            var sequence = scaledSource.FrameSequence;
+
+            // Nothing has changed.
+            Assert.Same(scaled, scaledSource.Capture());
+            Assert.Equal(sequence, scaledSource.FrameSequence);
+
+            // The source hasn't reported this change, so it is not picked up.
+            framebuffer.SetPixel(150, 80, 0xFFFFFF);
+
+            framebuffer.SetPixel(10, 10, 0xFFFFFF);
+            framebuffer.SetPixel(11, 10, 0xFFFFFF);
+            framebuffer.SetPixel(10, 11, 0xFFFFFF);
+            framebuffer.SetPixel(11, 11, 0xFFFFFF);
+            history.Add(new VncRectangle(10, 10, 2, 2));
+
+            Assert.Same(scaled, scaledSource.Capture());
+
+            var damage = new List<VncRectangle>();
+            Assert.True(scaledSource.TryGetDamage(sequence, damage));
+            Assert.Equal(new VncRectangle(5, 5, 1, 1), Assert.Single(damage));
+
+            Assert.Equal(0xFF, scaled.GetBuffer()[(5 * scaled.Stride) + (5 * 4)]);
+            Assert.Equal(0, scaled.GetBuffer()[(40 * scaled.Stride) + (75 * 4)]);
+        }
+
+        /// <summary>
+        /// Tests that, when the scale ratio is not an integer, the target pixels whose box extends beyond the end of a
+        /// damaged region are scaled again.
+        /// </summary>
+        [Fact]
+        public void DamageNonIntegerRatioTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 192, 10, VncPixelFormat.RGB32);
+            var history = new VncDamageHistory();
+            var scaledSource = new VncScaledFramebufferSource(CreateDamageSource(framebuffer, history));
+            scaledSource.SetDesktopSize(128, 10);
+
+            var scaled = scaledSource.Capture();
+            var sequence = scaledSource.FrameSequence;
+
+            // Target pixel 85 averages source pixels 127 and 128.
+            framebuffer.SetPixel(127, 0, 0xFFFFFF);
+            history.Add(new VncRectangle(64, 0, 64, 10));
+
+            Assert.Same(scaled, scaledSource.Capture());
+
+            var damage = new List<VncRectangle>();
+            Assert.True(scaledSource.TryGetDamage(sequence, damage));
+            Assert.Equal(new VncRectangle(42, 0, 44, 10), Assert.Single(damage));
+
+            Assert.Equal(0x80, scaled.GetBuffer()[85 * 4]);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncScaledFramebufferSource.MapToSource(ref int, ref int)"/> method.
+        /// </summary>
+        [Fact]
+        public void MapToSourceTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 400, 300, VncPixelFormat.RGB32);
+            var scaledSource = new VncScaledFramebufferSource(framebuffer);
+
+            int x = 10, y = 20;
+            scaledSource.Capture();
+            scaledSource.MapToSource(ref x, ref y);
+            Assert.Equal(10, x);
+            Assert.Equal(20, y);
+
+            scaledSource.SetDesktopSize(100, 75);
+            scaledSource.Capture();
+            scaledSource.MapToSource(ref x, ref y);
+            Assert.Equal(42, x);
+            Assert.Equal(82, y);
+
+            x = 99;
+            y = 74;
+            scaledSource.MapToSource(ref x, ref y);
+            Assert.Equal(398, x);
+            Assert.Equal(298, y);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncScaledFramebufferSource.AddRow(byte[], int, uint[], int)"/> method, for rows
+        /// which are processed using vectors and rows which are not.
+        /// </summary>
+        /// <param name="count">
+        /// The number of bytes in the row.
+        /// </param>
+        [Theory]
+        [InlineData(3)]
+        [InlineData(64)]
+        [InlineData(203)]
+        public void AddRowTest(int count)
+        {
+            var random = new Random(0);
+            var source = new byte[count + 5];
+            random.NextBytes(source);
+
+            var sums = new uint[count];
+            VncScaledFramebufferSource.AddRow(source, 5, sums, count);
+            VncScaledFramebufferSource.AddRow(source, 5, sums, count);
+
+            for (int i = 0; i < count; i++)
+            {
+                Assert.Equal(2u * source[5 + i], sums[i]);
+            }
+        }
+
+        private static IVncFramebufferDamageSource CreateDamageSource(VncFramebuffer framebuffer, VncDamageHistory history)
+        {
+            var source = new Mock<IVncFramebufferDamageSource>();
+            source
+                .Setup(s => s.Capture())
+                .Returns(framebuffer);
+            source
+                .Setup(s => s.FrameSequence)
+                .Returns(() => history.Sequence);
+            source
+                .Setup(s => s.TryGetDamage(It.IsAny<long>(), It.IsAny<ICollection<VncRectangle>>()))
+                .Returns<long, ICollection<VncRectangle>>((sequence, damage) => history.TryGetDamage(sequence, damage));
+            return source.Object;
+        }
+    }
+}
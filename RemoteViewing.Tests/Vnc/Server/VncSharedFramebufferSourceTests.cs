@@ -0,0 +1,354 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Moq;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncSharedFramebufferSource"/> class.
+    /// </summary>
+    public class VncSharedFramebufferSourceTests
+    {
+        /// <summary>
+        /// Tests the <see cref="VncSharedFramebufferSource.Capture"/> method, and makes sure the underlying
+        /// framebuffer source is captured at most once per <see cref="VncSharedFramebufferSource.CaptureInterval"/>.
+        /// </summary>
+        [Fact]
+        public void CaptureOncePerIntervalTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 100, 100, VncPixelFormat.RGB32);
+            int captures = 0;
+
+            var source = new Mock<IVncFramebufferSource>();
+            source
+                .Setup(s => s.Capture())
+                .Callback(() => captures++)
+                .Returns(framebuffer);
+
+            var sharedSource = new VncSharedFramebufferSource(source.Object, null)
+            {
+                CaptureInterval = TimeSpan.FromHours(1),
+            };
+
+            var snapshot = sharedSource.Capture();
+            Assert.NotSame(framebuffer, snapshot);
+            Assert.Same(snapshot, sharedSource.Capture());
+            Assert.Equal(1, captures);
+            Assert.Equal(1, sharedSource.Generation);
+
+            sharedSource.CaptureInterval = TimeSpan.Zero;
+            Assert.Same(snapshot, sharedSource.Capture());
+            Assert.Equal(2, captures);
+
+            // Nothing has changed, so the generation should not have been incremented.
+            Assert.Equal(1, sharedSource.Generation);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncSharedFramebufferSource.Capture"/> method when the underlying source reports
+        /// which regions have changed; nothing is compared when the source hasn't changed.
+        /// </summary>
+        [Fact]
+        public void CaptureDamageTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 200, 100, VncPixelFormat.RGB32);
+            var history = new VncDamageHistory();
+            var source = new Mock<IVncFramebufferDamageSource>();
+            source
+                .Setup(s => s.Capture())
+                .Returns(framebuffer);
+            source
+                .Setup(s => s.FrameSequence)
+                .Returns(() => history.Sequence);
+            source
+                .Setup(s => s.TryGetDamage(It.IsAny<long>(), It.IsAny<ICollection<VncRectangle>>()))
+                .Returns<long, ICollection<VncRectangle>>((sequence, damage) => history.TryGetDamage(sequence, damage));
+
+            var sharedSource = new VncSharedFramebufferSource(source.Object, null)
+            {
+                CaptureInterval = TimeSpan.Zero,
+            };
+
+            var snapshot = sharedSource.Capture();
+            Assert.Equal(1, sharedSource.Generation);
+
+            // The source hasn't reported this change, so it is not picked up.
+            framebuffer.SetPixel(150, 80, 0xFFFFFF);
+            sharedSource.Capture();
+            Assert.Equal(1, sharedSource.Generation);
+            Assert.Equal(0, snapshot.GetBuffer()[(80 * snapshot.Stride) + (150 * 4)]);
+
+            framebuffer.SetPixel(1, 1, 0xFFFFFF);
+            history.Add(new VncRectangle(0, 0, 2, 2));
+            sharedSource.Capture();
+            Assert.Equal(2, sharedSource.Generation);
+            Assert.Equal(0xFF, snapshot.GetBuffer()[snapshot.Stride + 4]);
+            Assert.Equal(0, snapshot.GetBuffer()[(80 * snapshot.Stride) + (150 * 4)]);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncSharedFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// for two sessions which share a framebuffer, and request updates at different times.
+        /// </summary>
+        [Fact]
+        public void RespondToUpdateRequestTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 200, 100, VncPixelFormat.RGB32);
+            var sharedSource = new VncSharedFramebufferSource(framebuffer, null)
+            {
+                CaptureInterval = TimeSpan.Zero,
+            };
+
+            var snapshot = sharedSource.Capture();
+            var cache1 = sharedSource.CreateFramebufferCache(snapshot, null);
+            var cache2 = sharedSource.CreateFramebufferCache(snapshot, null);
+            Assert.IsType<VncSharedFramebufferCache>(cache1);
+
+            var region = new VncRectangle(0, 0, 200, 100);
+
+            // Initially, all tiles are invalid.
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache1, new FramebufferUpdateRequest(true, region)),
+                (r) => Assert.Equal(region, r));
+
+            framebuffer.SetPixel(1, 1, 0xFFFFFF);
+            sharedSource.Capture();
+
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache1, new FramebufferUpdateRequest(true, region)),
+                (r) => Assert.Equal(new VncRectangle(0, 0, 64, 64), r));
+            Assert.Empty(this.RespondToUpdateRequest(cache1, new FramebufferUpdateRequest(true, region)));
+
+            framebuffer.SetPixel(150, 80, 0xFFFFFF);
+            sharedSource.Capture();
+
+            // The second session hasn't sent anything yet, the first session only needs the latest change.
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache2, new FramebufferUpdateRequest(true, region)),
+                (r) => Assert.Equal(region, r));
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache1, new FramebufferUpdateRequest(true, region)),
+                (r) => Assert.Equal(new VncRectangle(128, 64, 64, 36), r));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncSharedFramebufferCache.RespondToUpdateRequest(IVncServerSession)"/> method
+        /// when the shared framebuffer has scrolled. Only sessions which are up to date with the previous frame
+        /// can send the scrolled block as a copy.
+        /// </summary>
+        [Fact]
+        public void RespondToUpdateRequestScrollTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 128, 256, VncPixelFormat.RGB32);
+            var sharedSource = new VncSharedFramebufferSource(framebuffer, null)
+            {
+                CaptureInterval = TimeSpan.Zero,
+            };
+
+            VncFramebufferCacheTests.DrawRows(framebuffer, 0);
+            var snapshot = sharedSource.Capture();
+            var cache1 = sharedSource.CreateFramebufferCache(snapshot, null);
+            var cache2 = sharedSource.CreateFramebufferCache(snapshot, null);
+            var region = new VncRectangle(0, 0, 128, 256);
+            var moves = new List<VncFramebufferMove>();
+
+            this.RespondToUpdateRequest(cache1, new FramebufferUpdateRequest(false, region), moves);
+
+            VncFramebufferCacheTests.DrawRows(framebuffer, 10);
+            sharedSource.Capture();
+
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache1, new FramebufferUpdateRequest(true, region), moves),
+                (r) => Assert.Equal(new VncRectangle(0, 192, 128, 64), r));
+            Assert.Collection(
+                moves,
+                (m) =>
+                {
+                    Assert.Equal(new VncRectangle(0, 0, 128, 246), m.Target);
+                    Assert.Equal(10, m.SourceY);
+                });
+
+            // The second session never received the previous frame.
+            moves.Clear();
+            Assert.Collection(
+                this.RespondToUpdateRequest(cache2, new FramebufferUpdateRequest(true, region), moves),
+                (r) => Assert.Equal(region, r));
+            Assert.Empty(moves);
+
+            // The moves are not sent twice.
+            Assert.Empty(this.RespondToUpdateRequest(cache1, new FramebufferUpdateRequest(true, region), moves));
+            Assert.Empty(moves);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncSharedFramebufferSource.CreateFramebufferCache(VncFramebuffer, Microsoft.Extensions.Logging.ILogger)"/>
+        /// method when the framebuffer is not the shared framebuffer.
+        /// </summary>
+        [Fact]
+        public void CreateFramebufferCacheOtherFramebufferTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 200, 100, VncPixelFormat.RGB32);
+            var sharedSource = new VncSharedFramebufferSource(framebuffer, null);
+
+            Assert.IsType<VncFramebufferCache>(sharedSource.CreateFramebufferCache(framebuffer, null));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncEncodedRectangleCache"/> class.
+        /// </summary>
+        [Fact]
+        public void EncodedRectanglesTest()
+        {
+            var cache = new VncEncodedRectangleCache();
+            var key1 = new VncEncodedRectangleKey(1, new VncRectangle(0, 0, 64, 64), VncEncoding.Tight, VncPixelFormat.RGB32, 5);
+            var key2 = new VncEncodedRectangleKey(2, new VncRectangle(0, 0, 64, 64), VncEncoding.Tight, VncPixelFormat.RGB32, 5);
+
+            cache.Add(key1, new byte[10]);
+            cache.Add(key2, new byte[20]);
+            Assert.Equal(30, cache.Size);
+
+            Assert.True(cache.TryGetValue(new VncEncodedRectangleKey(1, new VncRectangle(0, 0, 64, 64), VncEncoding.Tight, new VncPixelFormat(), 5), out byte[] data));
+            Assert.Equal(10, data.Length);
+            Assert.False(cache.TryGetValue(new VncEncodedRectangleKey(1, new VncRectangle(0, 0, 64, 64), VncEncoding.Tight, VncPixelFormat.RGB32, 6), out data));
+
+            cache.Trim(2);
+            Assert.False(cache.TryGetValue(key1, out data));
+            Assert.True(cache.TryGetValue(key2, out data));
+            Assert.Equal(20, cache.Size);
+        }
+
+        /// <summary>
+        /// Tests that sessions which share a framebuffer and use the same Tight JPEG settings encode a rectangle
+        /// only once.
+        /// </summary>
+        [Fact]
+        public void SendSharedJpegRectangleTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 64, 64, VncPixelFormat.RGB32);
+            var random = new Random(0);
+
+            for (int y = 0; y < framebuffer.Height; y++)
+            {
+                for (int x = 0; x < framebuffer.Width; x++)
+                {
+                    framebuffer.SetPixel(x, y, random.Next(0x1000000));
+                }
+            }
+
+            var sharedSource = new VncSharedFramebufferSource(framebuffer, null)
+            {
+                CaptureInterval = TimeSpan.FromHours(1),
+            };
+
+            var region = new VncRectangle(0, 0, 64, 64);
+
+            using (var stream1 = new TestStream())
+            using (var stream2 = new TestStream())
+            {
+                var session1 = this.SendTightUpdate(sharedSource, stream1);
+                var settings = session1.Encoder.GetIndependentEncodingKey(VncPixelFormat.RGB32, region);
+                Assert.NotNull(settings);
+
+                var key = new VncEncodedRectangleKey(sharedSource.Generation, region, VncEncoding.Tight, VncPixelFormat.RGB32, settings.Value);
+                Assert.True(sharedSource.EncodedRectangles.TryGetValue(key, out byte[] encoded));
+
+                // The rectangle is sent using JPEG compression, and is the last thing the first session sent.
+                Assert.Equal(0x90, encoded[0]);
+                var output1 = ((MemoryStream)stream1.Output).ToArray();
+                Assert.Equal(encoded, output1.Skip(output1.Length - encoded.Length));
+
+                // Overwrite the cached data, to detect whether the second session encodes the rectangle again.
+                encoded.AsSpan(1).Fill(0x42);
+
+                this.SendTightUpdate(sharedSource, stream2);
+                var output2 = ((MemoryStream)stream2.Output).ToArray();
+                Assert.Equal(encoded, output2.Skip(output2.Length - encoded.Length));
+            }
+        }
+
+        private VncServerSession SendTightUpdate(VncSharedFramebufferSource sharedSource, TestStream stream)
+        {
+            VncStream clientStream = new VncStream(stream.Input);
+            clientStream.SendByte(1); // Shared desktop
+            clientStream.SendByte((byte)VncMessageType.SetEncodings);
+            clientStream.SendByte(0); // padding
+            clientStream.SendUInt16BE(2);
+            clientStream.SendUInt32BE((uint)VncEncoding.Tight);
+            clientStream.SendUInt32BE(unchecked((uint)VncEncoding.TightQualityLevel5));
+            stream.Input.Position = 0;
+
+            var session = new VncServerSession();
+            session.SetFramebufferSource(sharedSource);
+            session.Connect(stream, null, startThread: false, forceConnected: true);
+            session.NegotiateDesktop();
+            session.HandleMessage();
+
+            session.FramebufferUpdateRequest = new FramebufferUpdateRequest(false, new VncRectangle(0, 0, 64, 64));
+            Assert.True(session.FramebufferSendChanges());
+            return session;
+        }
+
+        private List<VncRectangle> RespondToUpdateRequest(IVncFramebufferCache cache, FramebufferUpdateRequest request, List<VncFramebufferMove> moves = null)
+        {
+            var invalidated = new List<VncRectangle>();
+
+            var session = new Mock<IVncServerSession>();
+            session
+                .Setup(s => s.FramebufferUpdateRequest)
+                .Returns(request);
+
+            if (moves != null)
+            {
+                session
+                    .Setup(s => s.ClientEncodings)
+                    .Returns(new[] { VncEncoding.CopyRect, VncEncoding.Raw });
+                session
+                    .Setup(s => s.FramebufferManualCopyRegion(It.IsAny<VncRectangle>(), It.IsAny<int>(), It.IsAny<int>()))
+                    .Callback<VncRectangle, int, int>((r, x, y) => moves.Add(new VncFramebufferMove(r, x, y)));
+            }
+
+            session
+                .Setup(s => s.FramebufferManualInvalidate(It.IsAny<VncRectangle>()))
+                .Callback<VncRectangle>((r) => invalidated.Add(r));
+            session
+                .Setup(s => s.FramebufferManualEndUpdate())
+                .Returns(true);
+
+            Assert.True(cache.RespondToUpdateRequest(session.Object));
+            return invalidated;
+        }
+    }
+}
@@ -0,0 +1,158 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc.Server;
+using System;
+using System.Threading;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="VncUpdateScheduler"/> class.
+    /// </summary>
+    public class VncUpdateSchedulerTests
+    {
+        /// <summary>
+        /// Tests that a scheduled action runs repeatedly, and stops running once the registration
+        /// has been disposed of.
+        /// </summary>
+        [Fact]
+        public void ScheduleTest()
+        {
+            var scheduler = new VncUpdateScheduler(TimeSpan.FromMilliseconds(5));
+            int count = 0;
+
+            using (var ran = new CountdownEvent(3))
+            {
+                var registration = scheduler.Schedule(
+                    () =>
+                    {
+                        Interlocked.Increment(ref count);
+                        ran.Signal();
+                    },
+                    () => 50);
+
+                Assert.Equal(1, scheduler.Count);
+                Assert.True(ran.Wait(TimeSpan.FromSeconds(10)));
+
+                registration.Dispose();
+                Assert.Equal(0, scheduler.Count);
+            }
+
+            // Disposing of the registration waits for a running action to complete, and no new runs are started.
+            var stopped = Volatile.Read(ref count);
+            Thread.Sleep(100);
+            Assert.Equal(stopped, Volatile.Read(ref count));
+        }
+
+        /// <summary>
+        /// Tests that disposing of a registration waits until the action has completed, unless the action disposes
+        /// of its own registration.
+        /// </summary>
+        [Fact]
+        public void DisposeWhileRunningTest()
+        {
+            var scheduler = new VncUpdateScheduler(TimeSpan.FromMilliseconds(5));
+            VncUpdateScheduler.Registration registration = null;
+            bool completed = false;
+
+            using (var started = new ManualResetEventSlim())
+            using (var release = new ManualResetEventSlim())
+            {
+                registration = scheduler.Schedule(
+                    () =>
+                    {
+                        started.Set();
+                        release.Wait();
+                        Volatile.Write(ref completed, true);
+                    },
+                    () => 50);
+
+                Assert.True(started.Wait(TimeSpan.FromSeconds(10)));
+
+                var dispose = new Thread(() => registration.Dispose());
+                dispose.Start();
+
+                Assert.False(dispose.Join(100));
+                release.Set();
+                Assert.True(dispose.Join(TimeSpan.FromSeconds(10)));
+                Assert.True(Volatile.Read(ref completed));
+            }
+
+            using (var disposed = new ManualResetEventSlim())
+            {
+                registration = scheduler.Schedule(
+                    () =>
+                    {
+                        registration.Dispose();
+                        disposed.Set();
+                    },
+                    () => 50);
+
+                Assert.True(disposed.Wait(TimeSpan.FromSeconds(10)));
+                Assert.Equal(0, scheduler.Count);
+            }
+        }
+
+        /// <summary>
+        /// Tests that an action is not run more often than its update rate.
+        /// </summary>
+        [Fact]
+        public void UpdateRateTest()
+        {
+            var scheduler = new VncUpdateScheduler(TimeSpan.FromMilliseconds(5));
+            int count = 0;
+
+            using (var registration = scheduler.Schedule(() => Interlocked.Increment(ref count), () => 10))
+            {
+                for (int i = 0; i < 50; i++)
+                {
+                    registration.Signal();
+                    Thread.Sleep(10);
+                }
+            }
+
+            // 500 ms at 10 Hz, with some leeway for timer jitter.
+            Assert.InRange(Volatile.Read(ref count), 1, 7);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncUpdateScheduler.Schedule(Action, Func{double})"/> method when
+        /// invalid arguments are passed.
+        /// </summary>
+        [Fact]
+        public void ScheduleNullTest()
+        {
+            var scheduler = new VncUpdateScheduler(TimeSpan.FromMilliseconds(5));
+
+            Assert.Throws<ArgumentNullException>(() => scheduler.Schedule(null, () => 10));
+            Assert.Throws<ArgumentNullException>(() => scheduler.Schedule(() => { }, null));
+        }
+    }
+}
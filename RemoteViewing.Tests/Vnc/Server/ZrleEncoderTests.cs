@@ -0,0 +1,115 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using SharpCompress.Compressors;
+using SharpCompress.Compressors.Deflate;
+using System;
+using System.IO;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc.Server
+{
+    /// <summary>
+    /// Tests the <see cref="ZrleEncoder"/> class.
+    /// </summary>
+    public class ZrleEncoderTests
+    {
+        /// <summary>
+        /// Tests the <see cref="ZrleEncoder.Encoding"/> property.
+        /// </summary>
+        [Fact]
+        public void EncodingTest()
+        {
+            var encoder = new ZrleEncoder();
+            Assert.Equal(VncEncoding.Zrle, encoder.Encoding);
+            Assert.Equal(64, encoder.TileSize);
+            Assert.Null(encoder.GetSharedEncodingKey(VncPixelFormat.RGB32, new VncRectangle(0, 0, 64, 64)));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="ZrleEncoder.Send(Stream, VncPixelFormat, VncRectangle, ReadOnlySpan{byte})"/> method,
+        /// sending two rectangles which span multiple tiles.
+        /// </summary>
+        [Fact]
+        public void SendTest()
+        {
+            var encoder = new ZrleEncoder();
+
+            // A 100x70 rectangle spans 2x2 tiles; fill each tile with a different color.
+            int width = 100;
+            int height = 70;
+            var contents = new byte[width * height * 4];
+
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    contents[(((y * width) + x) * 4) + 2] = (byte)(((y / 64) * 2) + (x / 64) + 1);
+                }
+            }
+
+            using (MemoryStream output = new MemoryStream())
+            using (MemoryStream zlibData = new MemoryStream())
+            {
+                for (int i = 0; i < 2; i++)
+                {
+                    output.SetLength(0);
+                    int sent = encoder.Send(output, VncPixelFormat.RGB32, new VncRectangle(0, 0, width, height), contents);
+
+                    var raw = output.ToArray();
+                    Assert.Equal(raw.Length, sent);
+                    Assert.Equal(raw.Length - 4, (int)VncUtility.DecodeUInt32BE(raw, 0));
+                    zlibData.Write(raw, 4, raw.Length - 4);
+                }
+
+                // Both rectangles use the same zlib stream, and consist of 4 solid tiles.
+                zlibData.Position = 0;
+
+                using (var stream = new ZlibStream(zlibData, CompressionMode.Decompress))
+                {
+                    var expected = new byte[]
+                    {
+                        0x01, 0x00, 0x00, 0x01,
+                        0x01, 0x00, 0x00, 0x02,
+                        0x01, 0x00, 0x00, 0x03,
+                        0x01, 0x00, 0x00, 0x04,
+                    };
+
+                    for (int i = 0; i < 2; i++)
+                    {
+                        byte[] decompressed = new byte[16];
+                        Assert.Equal(16, stream.Read(decompressed, 0, 16));
+                        Assert.Equal(expected, decompressed);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,149 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Moq;
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System.IO;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc
+{
+    /// <summary>
+    /// Tests the <see cref="TightDecoder"/> class.
+    /// </summary>
+    public class TightDecoderTests
+    {
+        /// <summary>
+        /// Tests the <see cref="TightDecoder.Decode(VncStream, VncPixelFormat, int, int)"/> method, by decoding
+        /// rectangles which have been encoded by the <see cref="TightEncoder"/> using fill compression, the palette
+        /// filter, the gradient filter and basic compression.
+        /// </summary>
+        /// <param name="bitsPerPixel">
+        /// The number of bits per pixel.
+        /// </param>
+        /// <param name="isLittleEndian">
+        /// A value indicating whether the pixel format is little endian.
+        /// </param>
+        [Theory]
+        [InlineData(32, true)]
+        [InlineData(32, false)]
+        [InlineData(16, true)]
+        [InlineData(8, true)]
+        public void DecodeTest(int bitsPerPixel, bool isLittleEndian)
+        {
+            var pixelFormat = ZrleDecoderTests.CreatePixelFormat(bitsPerPixel, isLittleEndian);
+            var encoder = new TightEncoder(Mock.Of<IVncServerSession>())
+            {
+                Compression = TightCompression.Basic,
+            };
+
+            var decoder = new TightDecoder();
+
+            var full = ZrleDecoderTests.CreateImage(pixelFormat, 64, 32, 0);
+            var fill = ZrleDecoderTests.Slice(full, 64 * 4 * pixelFormat.BytesPerPixel);
+            var palette = ZrleDecoderTests.Slice(full, 64 * 16 * pixelFormat.BytesPerPixel);
+            var tiny = ZrleDecoderTests.Slice(ZrleDecoderTests.CreateImage(pixelFormat, 2, 2, 1), 2 * pixelFormat.BytesPerPixel);
+            var smooth = CreateGradient(pixelFormat, 64, 32);
+
+            var rectangles = new (byte[] Contents, int Width, int Height)[]
+            {
+                (fill, 8, 4),
+                (palette, 64, 16),
+                (full, 64, 32),
+                (tiny, 2, 1),
+                (smooth, 64, 32),
+                (full, 64, 32),
+            };
+
+            using (var output = new MemoryStream())
+            {
+                foreach (var rectangle in rectangles)
+                {
+                    encoder.Send(output, pixelFormat, new VncRectangle(0, 0, rectangle.Width, rectangle.Height), rectangle.Contents);
+                }
+
+                output.Position = 0;
+                var stream = new VncStream(output);
+
+                foreach (var rectangle in rectangles)
+                {
+                    int length = rectangle.Width * rectangle.Height * pixelFormat.BytesPerPixel;
+                    var decoded = decoder.Decode(stream, pixelFormat, rectangle.Width, rectangle.Height);
+
+                    Assert.Equal(ZrleDecoderTests.Slice(rectangle.Contents, length), ZrleDecoderTests.Slice(decoded, length));
+                }
+
+                Assert.Equal(output.Length, output.Position);
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="TightDecoder.ReceiveCompactLength(VncStream)"/> method.
+        /// </summary>
+        /// <param name="value">
+        /// The expected length.
+        /// </param>
+        /// <param name="encoded">
+        /// The compact representation of the length.
+        /// </param>
+        [Theory]
+        [InlineData(10, new byte[] { 0x0A })]
+        [InlineData(1000, new byte[] { 0xE8, 0x07 })]
+        [InlineData(4194303, new byte[] { 0xFF, 0xFF, 0xFF })]
+        public void ReceiveCompactLengthTest(int value, byte[] encoded)
+        {
+            var stream = new VncStream(new MemoryStream(encoded));
+            Assert.Equal(value, TightDecoder.ReceiveCompactLength(stream));
+        }
+
+        private static byte[] CreateGradient(VncPixelFormat pixelFormat, int width, int height)
+        {
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            var image = new byte[width * height * bytesPerPixel];
+
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    uint pixel = ((uint)((x * 3) & pixelFormat.RedMax) << pixelFormat.RedShift)
+                        | ((uint)((y * 5) & pixelFormat.GreenMax) << pixelFormat.GreenShift)
+                        | ((uint)((x + y) & pixelFormat.BlueMax) << pixelFormat.BlueShift);
+
+                    for (int i = 0; i < bytesPerPixel; i++)
+                    {
+                        int shift = pixelFormat.IsLittleEndian ? 8 * i : 8 * (bytesPerPixel - 1 - i);
+                        image[(((y * width) + x) * bytesPerPixel) + i] = (byte)(pixel >> shift);
+                    }
+                }
+            }
+
+            return image;
+        }
+    }
+}
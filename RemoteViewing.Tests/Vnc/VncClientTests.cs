@@ -28,8 +28,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endregion
 
 using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
 using System;
+using System.Diagnostics;
 using System.IO;
+using System.Linq;
+using System.Net;
+using System.Net.Sockets;
+using System.Threading;
 using Xunit;
 
 namespace RemoteViewing.Tests.Vnc
@@ -60,6 +66,77 @@ namespace RemoteViewing.Tests.Vnc
             Assert.Throws<ArgumentNullException>(() => client.Connect(null, null));
         }
 
+        /// <summary>
+        /// Tests that the client offers the encodings specified in <see cref="VncClientConnectOptions.Encodings"/>.
+        /// </summary>
+        [Fact]
+        public void ConnectEncodingsTest()
+        {
+            var listener = new TcpListener(IPAddress.Loopback, 0);
+            listener.Start();
+
+            try
+            {
+                using (var tcpClient = new TcpClient())
+                using (var client = new VncClient())
+                {
+                    tcpClient.Connect((IPEndPoint)listener.LocalEndpoint);
+
+                    var session = new VncServerSession();
+                    session.SetFramebufferSource(new VncFramebuffer("test", 64, 32, VncPixelFormat.RGB32));
+                    session.Connect(listener.AcceptTcpClient().GetStream(), null);
+
+                    client.Connect(
+                        tcpClient.GetStream(),
+                        new VncClientConnectOptions()
+                        {
+                            Encodings = new VncEncoding[] { VncEncoding.Zrle, VncEncoding.Raw },
+                        });
+
+                    // The session handles the SetEncodings message on its own thread.
+                    var stopwatch = Stopwatch.StartNew();
+                    while (!session.ClientEncodings.Contains(VncEncoding.PseudoDesktopSize) && stopwatch.Elapsed < TimeSpan.FromSeconds(10))
+                    {
+                        Thread.Sleep(10);
+                    }
+
+                    Assert.Equal(new VncEncoding[] { VncEncoding.Zrle, VncEncoding.Raw, VncEncoding.PseudoDesktopSize }, session.ClientEncodings);
+
+                    session.Close();
+                }
+            }
+            finally
+            {
+                listener.Stop();
+            }
+        }
+
+        /// <summary>
+        /// Tests that <see cref="VncClientConnectOptions.Encodings"/> rejects encodings which the client cannot decode.
+        /// </summary>
+        [Fact]
+        public void EncodingsUnsupportedTest()
+        {
+            var options = new VncClientConnectOptions();
+            Assert.Throws<ArgumentOutOfRangeException>(() => options.Encodings = new VncEncoding[] { VncEncoding.TRLE });
+            Assert.Null(options.Encodings);
+        }
+
+        /// <summary>
+        /// Tests that <see cref="VncClientConnectOptions.Encodings"/> holds a copy of the encodings, which can't
+        /// be changed once they have been validated.
+        /// </summary>
+        [Fact]
+        public void EncodingsCopyTest()
+        {
+            var encodings = new VncEncoding[] { VncEncoding.Zrle, VncEncoding.Raw };
+            var options = new VncClientConnectOptions() { Encodings = encodings };
+
+            encodings[0] = VncEncoding.TRLE;
+
+            Assert.Equal(new VncEncoding[] { VncEncoding.Zrle, VncEncoding.Raw }, options.Encodings);
+        }
+
         /// <summary>
         /// Tests the <see cref="VncClient.SendLocalClipboardChange(string)"/> methdo with invalid arguments.
         /// </summary>
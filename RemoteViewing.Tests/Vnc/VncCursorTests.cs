@@ -0,0 +1,132 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using System;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc
+{
+    /// <summary>
+    /// Tests the <see cref="VncCursor"/> class.
+    /// </summary>
+    public class VncCursorTests
+    {
+        // A 2x2 cursor: opaque red, transparent, half-transparent green and almost transparent blue,
+        // in B, G, R, A order.
+        private static readonly byte[] Pixels = new byte[]
+        {
+            0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00,
+            0x00, 0x80, 0x00, 0x80, 0xFF, 0x00, 0x00, 0x7F,
+        };
+
+        /// <summary>
+        /// Tests the argument validation of the <see cref="VncCursor"/> constructor.
+        /// </summary>
+        [Fact]
+        public void ConstructorInvalidArgumentsTest()
+        {
+            Assert.Throws<ArgumentOutOfRangeException>(() => new VncCursor(-1, 2, 0, 0, Pixels));
+            Assert.Throws<ArgumentOutOfRangeException>(() => new VncCursor(2, 2, 2, 0, Pixels));
+            Assert.Throws<ArgumentOutOfRangeException>(() => new VncCursor(2, 2, 0, 2, Pixels));
+            Assert.Throws<ArgumentNullException>(() => new VncCursor(2, 2, 0, 0, null));
+            Assert.Throws<ArgumentException>(() => new VncCursor(2, 3, 0, 0, Pixels));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncCursor.EncodeRichCursor(VncPixelFormat)"/> method, which should return the pixels
+        /// followed by a bitmask of the pixels which are at least half opaque.
+        /// </summary>
+        [Fact]
+        public void EncodeRichCursorTest()
+        {
+            var cursor = new VncCursor(2, 2, 1, 0, Pixels);
+            var data = cursor.EncodeRichCursor(VncPixelFormat.RGB32);
+
+            Assert.Equal((2 * 2 * 4) + 2, data.Length);
+            Assert.Equal(new byte[] { 0x00, 0x00, 0xFF }, new ArraySegment<byte>(data, 0, 3));
+            Assert.Equal(new byte[] { 0x00, 0x80, 0x00 }, new ArraySegment<byte>(data, 8, 3));
+            Assert.Equal(new byte[] { 0x80, 0x80 }, new ArraySegment<byte>(data, 16, 2));
+
+            Assert.Empty(VncCursor.Hidden.EncodeRichCursor(VncPixelFormat.RGB32));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncCursor.EncodeCursorWithAlpha"/> method, which should return the raw encoding
+        /// followed by the pixels in R, G, B, A order, with premultiplied alpha.
+        /// </summary>
+        [Fact]
+        public void EncodeCursorWithAlphaTest()
+        {
+            var cursor = new VncCursor(2, 2, 1, 0, Pixels);
+            var data = cursor.EncodeCursorWithAlpha();
+
+            Assert.Equal(
+                new byte[]
+                {
+                    0x00, 0x00, 0x00, 0x00, // Raw
+                    0xFF, 0x00, 0x00, 0xFF,
+                    0x00, 0x00, 0x00, 0x00,
+                    0x00, 0x40, 0x00, 0x80,
+                    0x00, 0x00, 0x7F, 0x7F,
+                },
+                data);
+
+            Assert.Equal(new byte[4], VncCursor.Hidden.EncodeCursorWithAlpha());
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncCursor.Draw(byte[], VncRectangle, int, VncPixelFormat, int, int)"/> method, which
+        /// should only draw the visible pixels of the cursor which overlap with the region.
+        /// </summary>
+        [Fact]
+        public void DrawTest()
+        {
+            var cursor = new VncCursor(2, 2, 1, 1, Pixels);
+            var region = new VncRectangle(1, 1, 2, 2);
+            var buffer = new byte[2 * 2 * 4];
+
+            // The cursor covers (2, 2) to (3, 3); only its top-left pixel overlaps with the region.
+            cursor.Draw(buffer, region, 2 * 4, VncPixelFormat.RGB32, 3, 3);
+
+            Assert.Equal(new byte[] { 0x00, 0x00, 0x00 }, new ArraySegment<byte>(buffer, 0, 3));
+            Assert.Equal(new byte[] { 0x00, 0x00, 0x00 }, new ArraySegment<byte>(buffer, 4, 3));
+            Assert.Equal(new byte[] { 0x00, 0x00, 0x00 }, new ArraySegment<byte>(buffer, 8, 3));
+            Assert.Equal(new byte[] { 0x00, 0x00, 0xFF }, new ArraySegment<byte>(buffer, 12, 3));
+
+            // The cursor covers the region; the pixels which are less than half opaque are not drawn.
+            buffer = new byte[2 * 2 * 4];
+            cursor.Draw(buffer, region, 2 * 4, VncPixelFormat.RGB32, 2, 2);
+
+            Assert.Equal(new byte[] { 0x00, 0x00, 0xFF }, new ArraySegment<byte>(buffer, 0, 3));
+            Assert.Equal(new byte[] { 0x00, 0x00, 0x00 }, new ArraySegment<byte>(buffer, 4, 3));
+            Assert.Equal(new byte[] { 0x00, 0x80, 0x00 }, new ArraySegment<byte>(buffer, 8, 3));
+            Assert.Equal(new byte[] { 0x00, 0x00, 0x00 }, new ArraySegment<byte>(buffer, 12, 3));
+        }
+    }
+}
@@ -0,0 +1,126 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using System;
+using System.Collections.Generic;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc
+{
+    /// <summary>
+    /// Tests the <see cref="VncDamageHistory"/> class.
+    /// </summary>
+    public class VncDamageHistoryTests
+    {
+        /// <summary>
+        /// Tests the <see cref="VncDamageHistory.TryGetDamage(long, ICollection{VncRectangle})"/> method, which
+        /// should return the regions of all frames which were added after a given frame.
+        /// </summary>
+        [Fact]
+        public void TryGetDamageTest()
+        {
+            var history = new VncDamageHistory();
+            var damage = new List<VncRectangle>();
+
+            Assert.Equal(0, history.Sequence);
+            Assert.True(history.TryGetDamage(0, damage));
+            Assert.Empty(damage);
+
+            history.Add(new VncRectangle(0, 0, 10, 10));
+            history.Add(new VncRectangle[] { new VncRectangle(20, 20, 5, 5), new VncRectangle(30, 30, 5, 5) });
+            Assert.Equal(2, history.Sequence);
+
+            Assert.True(history.TryGetDamage(0, damage));
+            Assert.Collection(
+                damage,
+                (r) => Assert.Equal(new VncRectangle(0, 0, 10, 10), r),
+                (r) => Assert.Equal(new VncRectangle(20, 20, 5, 5), r),
+                (r) => Assert.Equal(new VncRectangle(30, 30, 5, 5), r));
+
+            damage.Clear();
+            Assert.True(history.TryGetDamage(1, damage));
+            Assert.Equal(2, damage.Count);
+
+            damage.Clear();
+            Assert.True(history.TryGetDamage(2, damage));
+            Assert.Empty(damage);
+
+            // Sequence numbers from the future are unknown.
+            Assert.False(history.TryGetDamage(3, damage));
+        }
+
+        /// <summary>
+        /// Tests that <see cref="VncDamageHistory.Add(IEnumerable{VncRectangle})"/> doesn't record a frame
+        /// when nothing has changed.
+        /// </summary>
+        [Fact]
+        public void AddEmptyTest()
+        {
+            var history = new VncDamageHistory();
+
+            history.Add(new VncRectangle[] { });
+            history.Add(new VncRectangle(10, 10, 0, 0));
+
+            Assert.Equal(0, history.Sequence);
+        }
+
+        /// <summary>
+        /// Tests that the damage of frames which have been evicted from the history, or which were added
+        /// using <see cref="VncDamageHistory.AddUnknown"/>, is reported as unknown.
+        /// </summary>
+        [Fact]
+        public void UnknownDamageTest()
+        {
+            var history = new VncDamageHistory(2);
+            var damage = new List<VncRectangle>();
+
+            history.Add(new VncRectangle(0, 0, 1, 1));
+            history.Add(new VncRectangle(1, 1, 1, 1));
+            history.Add(new VncRectangle(2, 2, 1, 1));
+
+            Assert.False(history.TryGetDamage(0, damage));
+            Assert.True(history.TryGetDamage(1, damage));
+            Assert.Equal(2, damage.Count);
+
+            history.AddUnknown();
+            Assert.Equal(4, history.Sequence);
+            Assert.False(history.TryGetDamage(3, damage));
+            Assert.True(history.TryGetDamage(4, damage));
+        }
+
+        /// <summary>
+        /// Tests that the <see cref="VncDamageHistory"/> constructor validates the capacity.
+        /// </summary>
+        [Fact]
+        public void CapacityTest()
+        {
+            Assert.Throws<ArgumentOutOfRangeException>(() => new VncDamageHistory(0));
+        }
+    }
+}
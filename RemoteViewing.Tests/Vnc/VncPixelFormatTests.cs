@@ -76,9 +76,15 @@ namespace RemoteViewing.Tests.Vnc
             Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(4, 1, 1, 0, 1, 0, 1, 0));
             Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(24, 1, 1, 0, 1, 0, 1, 0));
 
-            // Only bit depth of 8 or 24
+            // Bit depth between 1 and 32, and large enough to hold the red, green and blue bits
+            Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(8, 0, 0, 0, 0, 0, 0, 0));
+            Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(32, 33, 8, 16, 8, 8, 8, 0));
             Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(8, 2, 1, 0, 1, 0, 1, 0));
-            Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(16, 16, 1, 0, 1, 0, 1, 0));
+            Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(16, 15, 5, 11, 6, 5, 5, 0));
+
+            // RGB565 and BGR233 are valid
+            new VncPixelFormat(16, 16, 5, 11, 6, 5, 5, 0);
+            new VncPixelFormat(8, 8, 3, 0, 3, 3, 2, 6);
 
             // Red: negative bits or shift, or bits or shift > bit depth
             Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(8, 24, -1, 0, 8, 0, 8, 0));
@@ -99,6 +105,124 @@ namespace RemoteViewing.Tests.Vnc
             Assert.Throws<ArgumentOutOfRangeException>(() => new VncPixelFormat(8, 24, 8, 0, 8, 0, 8, 25));
         }
 
+        /// <summary>
+        /// Tests the <see cref="VncPixelFormat.Copy(byte[], int, int, VncPixelFormat, VncRectangle, byte[], int, int, VncPixelFormat, int, int)"/>
+        /// method, when converting RGB32 pixels to another format. The width of the rectangle is not a multiple of 4, so that
+        /// both the vectorized and the scalar conversion are used.
+        /// </summary>
+        /// <param name="bitsPerPixel">
+        /// The number of bits per pixel of the target format.
+        /// </param>
+        /// <param name="bitDepth">
+        /// The bit depth of the target format.
+        /// </param>
+        /// <param name="redBits">
+        /// The number of red bits in the target format.
+        /// </param>
+        /// <param name="redShift">
+        /// The red shift of the target format.
+        /// </param>
+        /// <param name="greenBits">
+        /// The number of green bits in the target format.
+        /// </param>
+        /// <param name="greenShift">
+        /// The green shift of the target format.
+        /// </param>
+        /// <param name="blueBits">
+        /// The number of blue bits in the target format.
+        /// </param>
+        /// <param name="blueShift">
+        /// The blue shift of the target format.
+        /// </param>
+        /// <param name="isLittleEndian">
+        /// A value indicating whether the target format is little endian.
+        /// </param>
+        [Theory]
+        [InlineData(32, 24, 8, 0, 8, 8, 8, 16, true)]
+        [InlineData(32, 24, 8, 16, 8, 8, 8, 0, false)]
+        [InlineData(32, 30, 10, 20, 10, 10, 10, 0, true)]
+        [InlineData(32, 24, 7, 17, 7, 9, 7, 1, true)]
+        [InlineData(16, 16, 5, 11, 6, 5, 5, 0, true)]
+        [InlineData(16, 16, 5, 11, 6, 5, 5, 0, false)]
+        [InlineData(16, 15, 5, 0, 5, 5, 5, 10, true)]
+        [InlineData(8, 8, 3, 0, 3, 3, 2, 6, true)]
+        [InlineData(8, 6, 2, 4, 2, 2, 2, 0, true)]
+        public void CopyConvertTest(int bitsPerPixel, int bitDepth, int redBits, int redShift, int greenBits, int greenShift, int blueBits, int blueShift, bool isLittleEndian)
+        {
+            var targetFormat = new VncPixelFormat(bitsPerPixel, bitDepth, redBits, redShift, greenBits, greenShift, blueBits, blueShift, isLittleEndian);
+            int bpp = targetFormat.BytesPerPixel;
+
+            var random = new Random(0);
+            var source = new byte[40 * 4 * 4];
+            random.NextBytes(source);
+
+            // Copy a 37x2 rectangle to (2, 1) in a 40x4 target.
+            var rectangle = new VncRectangle(1, 1, 37, 2);
+            var target = new byte[40 * 4 * bpp];
+            VncPixelFormat.Copy(source, 40, 40 * 4, VncPixelFormat.RGB32, rectangle, target, 40, 40 * bpp, targetFormat, 2, 1);
+
+            var expected = new byte[target.Length];
+
+            for (int y = 0; y < rectangle.Height; y++)
+            {
+                for (int x = 0; x < rectangle.Width; x++)
+                {
+                    int sourceOffset = (((rectangle.Y + y) * 40) + rectangle.X + x) * 4;
+                    int targetOffset = (((1 + y) * 40) + 2 + x) * bpp;
+
+                    uint red = source[sourceOffset + 2];
+                    uint green = source[sourceOffset + 1];
+                    uint blue = source[sourceOffset];
+
+                    uint pixel = (Scale(red, redBits) << redShift)
+                        | (Scale(green, greenBits) << greenShift)
+                        | (Scale(blue, blueBits) << blueShift);
+
+                    for (int b = 0; b < bpp; b++)
+                    {
+                        int shift = isLittleEndian ? 8 * b : 8 * (bpp - 1 - b);
+                        expected[targetOffset + b] = (byte)(pixel >> shift);
+                    }
+                }
+            }
+
+            Assert.Equal(expected, target);
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncPixelFormat.Copy(byte[], int, int, VncPixelFormat, VncRectangle, byte[], int, int, VncPixelFormat, int, int)"/>
+        /// method, when converting big-endian RGB565 pixels to RGB32 pixels.
+        /// </summary>
+        [Fact]
+        public void CopyExpandTest()
+        {
+            var sourceFormat = new VncPixelFormat(16, 16, 5, 11, 6, 5, 5, 0, isLittleEndian: false);
+            var source = new byte[] { 0xF8, 0x00, 0x07, 0xE0, 0x00, 0x1F, 0x84, 0x10, 0xFF, 0xFF };
+            var target = new byte[20];
+
+            VncPixelFormat.Copy(source, 5, 10, sourceFormat, new VncRectangle(0, 0, 5, 1), target, 5, 20, VncPixelFormat.RGB32);
+
+            Assert.Equal(0xFF0000u, BitConverter.ToUInt32(target, 0));
+            Assert.Equal(0x00FF00u, BitConverter.ToUInt32(target, 4));
+            Assert.Equal(0x0000FFu, BitConverter.ToUInt32(target, 8));
+            Assert.Equal(0x848284u, BitConverter.ToUInt32(target, 12));
+            Assert.Equal(0xFFFFFFu, BitConverter.ToUInt32(target, 16));
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncPixelFormat.Copy(byte[], int, int, VncPixelFormat, VncRectangle, byte[], int, int, VncPixelFormat, int, int)"/>
+        /// method, when the source rectangle does not fit in the source buffer.
+        /// </summary>
+        [Fact]
+        public void CopyOutOfRangeTest()
+        {
+            var source = new byte[4 * 4 * 4];
+            var target = new byte[4 * 4 * 4];
+
+            Assert.Throws<ArgumentOutOfRangeException>(() => VncPixelFormat.Copy(source, 4, 16, VncPixelFormat.RGB32, new VncRectangle(1, 3, 4, 1), target, 4, 16, VncPixelFormat.RGB32));
+            Assert.Throws<ArgumentOutOfRangeException>(() => VncPixelFormat.Copy(source, 4, 16, VncPixelFormat.RGB32, new VncRectangle(0, 0, 4, 4), target, 4, 16, VncPixelFormat.RGB32, 0, 1));
+        }
+
         /// <summary>
         /// Tests the <see cref="VncPixelFormat.Encode(byte[], int)"/> method.
         /// </summary>
@@ -123,5 +247,10 @@ namespace RemoteViewing.Tests.Vnc
             var pixelFormat = VncPixelFormat.Decode(buffer, 0);
             Assert.Equal(VncPixelFormat.RGB32, pixelFormat);
         }
+
+        private static uint Scale(uint value, int bits)
+        {
+            return bits <= 8 ? value >> (8 - bits) : (value << (bits - 8)) | (value >> (16 - bits));
+        }
     }
 }
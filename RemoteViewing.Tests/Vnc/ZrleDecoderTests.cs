@@ -0,0 +1,200 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using RemoteViewing.Vnc.Server;
+using System;
+using System.IO;
+using Xunit;
+
+namespace RemoteViewing.Tests.Vnc
+{
+    /// <summary>
+    /// Tests the <see cref="ZrleDecoder"/> class.
+    /// </summary>
+    public class ZrleDecoderTests
+    {
+        /// <summary>
+        /// Tests the <see cref="ZrleDecoder.Decode(VncStream, VncPixelFormat, int, int)"/> method, by decoding rectangles
+        /// which have been encoded by the <see cref="ZrleEncoder"/>. The rectangles contain solid, palette, run-length
+        /// encoded and raw tiles, and share a single zlib stream.
+        /// </summary>
+        /// <param name="bitsPerPixel">
+        /// The number of bits per pixel.
+        /// </param>
+        /// <param name="isLittleEndian">
+        /// A value indicating whether the pixel format is little endian.
+        /// </param>
+        [Theory]
+        [InlineData(32, true)]
+        [InlineData(32, false)]
+        [InlineData(16, true)]
+        [InlineData(8, true)]
+        public void DecodeTest(int bitsPerPixel, bool isLittleEndian)
+        {
+            var pixelFormat = CreatePixelFormat(bitsPerPixel, isLittleEndian);
+            var encoder = new ZrleEncoder();
+            var decoder = new ZrleDecoder();
+
+            var rectangles = new byte[][]
+            {
+                CreateImage(pixelFormat, 150, 70, 0),
+                CreateImage(pixelFormat, 150, 70, 1),
+                CreateImage(pixelFormat, 30, 20, 2),
+            };
+
+            using (var output = new MemoryStream())
+            {
+                encoder.Send(output, pixelFormat, new VncRectangle(0, 0, 150, 70), rectangles[0]);
+                encoder.Send(output, pixelFormat, new VncRectangle(0, 0, 150, 70), rectangles[1]);
+                encoder.Send(output, pixelFormat, new VncRectangle(0, 0, 30, 20), rectangles[2]);
+
+                output.Position = 0;
+                var stream = new VncStream(output);
+
+                Assert.Equal(rectangles[0], Slice(decoder.Decode(stream, pixelFormat, 150, 70), rectangles[0].Length));
+                Assert.Equal(rectangles[1], Slice(decoder.Decode(stream, pixelFormat, 150, 70), rectangles[1].Length));
+                Assert.Equal(rectangles[2], Slice(decoder.Decode(stream, pixelFormat, 30, 20), rectangles[2].Length));
+                Assert.Equal(output.Length, output.Position);
+            }
+        }
+
+        /// <summary>
+        /// Tests that the <see cref="ZrleDecoder.Decode(VncStream, VncPixelFormat, int, int)"/> method rejects rectangles
+        /// whose size in bytes doesn't fit in an <see cref="int"/>, instead of overflowing.
+        /// </summary>
+        [Fact]
+        public void DecodeOverflowTest()
+        {
+            var decoder = new ZrleDecoder();
+
+            using (var output = new MemoryStream(new byte[4]))
+            {
+                var stream = new VncStream(output);
+                var exception = Assert.Throws<VncException>(() => decoder.Decode(stream, VncPixelFormat.RGB32, 0x7FFF, 0x7FFF));
+                Assert.Equal(VncFailureReason.SanityCheckFailed, exception.Reason);
+            }
+        }
+
+        /// <summary>
+        /// Creates a pixel format for use in the tests.
+        /// </summary>
+        /// <param name="bitsPerPixel">
+        /// The number of bits per pixel.
+        /// </param>
+        /// <param name="isLittleEndian">
+        /// A value indicating whether the pixel format is little endian.
+        /// </param>
+        /// <returns>
+        /// A RGB32, RGB565 or BGR233 pixel format.
+        /// </returns>
+        internal static VncPixelFormat CreatePixelFormat(int bitsPerPixel, bool isLittleEndian)
+        {
+            switch (bitsPerPixel)
+            {
+                case 8:
+                    return new VncPixelFormat(8, 8, 3, 0, 3, 3, 2, 6, isLittleEndian);
+
+                case 16:
+                    return new VncPixelFormat(16, 16, 5, 11, 6, 5, 5, 0, isLittleEndian);
+
+                default:
+                    return new VncPixelFormat(32, 24, 8, 16, 8, 8, 8, 0, isLittleEndian);
+            }
+        }
+
+        /// <summary>
+        /// Creates an image in which the top half consists of large blocks of a few colors, and the bottom half
+        /// is noise. The bits of a pixel which are not used by the pixel format are 0.
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The pixel format of the image.
+        /// </param>
+        /// <param name="width">
+        /// The width of the image.
+        /// </param>
+        /// <param name="height">
+        /// The height of the image.
+        /// </param>
+        /// <param name="seed">
+        /// The seed used to generate the noise.
+        /// </param>
+        /// <returns>
+        /// The raw pixel data.
+        /// </returns>
+        internal static byte[] CreateImage(VncPixelFormat pixelFormat, int width, int height, int seed)
+        {
+            var random = new Random(seed);
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            var image = new byte[width * height * bytesPerPixel];
+
+            uint mask = ((uint)pixelFormat.RedMax << pixelFormat.RedShift)
+                | ((uint)pixelFormat.GreenMax << pixelFormat.GreenShift)
+                | ((uint)pixelFormat.BlueMax << pixelFormat.BlueShift);
+
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    uint pixel = y < height / 2
+                        ? (uint)(((x / 16) + (y / 8) + seed) % 3) * 0x5A3C96
+                        : (uint)random.Next();
+
+                    pixel &= mask;
+
+                    for (int i = 0; i < bytesPerPixel; i++)
+                    {
+                        int shift = pixelFormat.IsLittleEndian ? 8 * i : 8 * (bytesPerPixel - 1 - i);
+                        image[(((y * width) + x) * bytesPerPixel) + i] = (byte)(pixel >> shift);
+                    }
+                }
+            }
+
+            return image;
+        }
+
+        /// <summary>
+        /// Gets the first bytes of a buffer.
+        /// </summary>
+        /// <param name="buffer">
+        /// The buffer.
+        /// </param>
+        /// <param name="length">
+        /// The number of bytes to get.
+        /// </param>
+        /// <returns>
+        /// The first <paramref name="length"/> bytes of <paramref name="buffer"/>.
+        /// </returns>
+        internal static byte[] Slice(byte[] buffer, int length)
+        {
+            var slice = new byte[length];
+            Array.Copy(buffer, slice, length);
+            return slice;
+        }
+    }
+}
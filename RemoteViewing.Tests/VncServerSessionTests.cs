@@ -1,4 +1,4 @@
-#region License
+﻿#region License
 /*
 RemoteViewing VNC Client/Server Library for .NET
 Copyright (c) 2019, 2020 Quamotion bvba
@@ -30,9 +30,13 @@ using Moq;
 using RemoteViewing.Vnc;
 using RemoteViewing.Vnc.Server;
 using System;
+using System.Buffers;
 using System.Collections.Generic;
 using System.IO;
+using System.Net;
+using System.Net.Sockets;
 using System.Text;
+using System.Threading;
 using Xunit;
 
 namespace RemoteViewing.Tests
@@ -268,7 +272,9 @@ namespace RemoteViewing.Tests
             var session = new VncServerSession();
             Assert.Collection(
                 session.Encoders,
-                (e) => Assert.IsType<TightEncoder>(e));
+                (e) => Assert.IsType<TightEncoder>(e),
+                (e) => Assert.IsType<ZrleEncoder>(e),
+                (e) => Assert.IsType<TrleEncoder>(e));
         }
 
         /// <summary>
@@ -431,5 +437,575 @@ namespace RemoteViewing.Tests
                 Assert.Equal(stream.Input.Length, stream.Input.Position);
             }
         }
+
+        /// <summary>
+        /// Tests the handling of the Fence and ContinuousUpdates pseudo-encodings: the server confirms support for both
+        /// extensions, sends updates without waiting for an update request once continuous updates are enabled, and
+        /// sends a fence after each update.
+        /// </summary>
+        [Fact]
+        public void ContinuousUpdatesTest()
+        {
+            var framebuffer = new VncFramebuffer("test", 16, 16, VncPixelFormat.RGB32);
+
+            var framebufferSourceMock = new Mock<IVncFramebufferSource>();
+            framebufferSourceMock
+                .Setup(m => m.Capture())
+                .Returns(framebuffer);
+
+            using (var stream = new TestStream())
+            {
+                VncStream clientStream = new VncStream(stream.Input);
+
+                // Negotiating the desktop
+                clientStream.SendByte(0); // share desktop setting
+
+                // SetEncodings
+                clientStream.SendByte((byte)VncMessageType.SetEncodings);
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt16BE(3); // 3 encodings are supported
+                clientStream.SendUInt32BE((uint)VncEncoding.Raw);
+                clientStream.SendUInt32BE(unchecked((uint)VncEncoding.Fence));
+                clientStream.SendUInt32BE(unchecked((uint)VncEncoding.ContinuousUpdates));
+
+                // EnableContinuousUpdates
+                clientStream.SendByte((byte)VncMessageType.EnableContinuousUpdates);
+                clientStream.SendByte(1); // enable
+                clientStream.SendRectangle(new VncRectangle(0, 0, 16, 16));
+
+                // Response to the first fence
+                clientStream.SendByte((byte)VncMessageType.ClientFence);
+                clientStream.Send(new byte[3]); // padding
+                clientStream.SendUInt32BE((uint)VncFenceFlags.BlockBefore);
+                clientStream.SendByte(4); // length
+                clientStream.SendUInt32BE(0); // payload
+
+                // Disable continuous updates
+                clientStream.SendByte((byte)VncMessageType.EnableContinuousUpdates);
+                clientStream.SendByte(0); // disable
+                clientStream.SendRectangle(new VncRectangle(0, 0, 16, 16));
+
+                stream.Input.Position = 0;
+
+                var session = new VncServerSession();
+                session.SetFramebufferSource(framebufferSourceMock.Object);
+                session.Connect(stream, null, startThread: false);
+                session.NegotiateDesktop();
+
+                session.HandleMessage();
+                session.HandleMessage();
+
+                // The client never requested an update.
+                framebuffer.SetPixel(1, 1, 0xFFFFFF);
+                Assert.True(session.FramebufferSendChanges());
+                Assert.False(session.FramebufferSendChanges());
+                Assert.Null(session.FramebufferUpdateRequest);
+
+                session.HandleMessage();
+                session.HandleMessage();
+
+                framebuffer.SetPixel(2, 2, 0xFFFFFF);
+                Assert.False(session.FramebufferSendChanges());
+
+                VncStream serverStream = new VncStream(stream.Output);
+                stream.Output.Position = 0;
+
+                // Desktop negotiation result
+                Assert.Equal(16, serverStream.ReceiveUInt16BE());
+                Assert.Equal(16, serverStream.ReceiveUInt16BE());
+                serverStream.Receive(16);
+                Assert.Equal("test", serverStream.ReceiveString());
+
+                // The server confirms support for fences and continuous updates.
+                Assert.Equal(248, serverStream.ReceiveByte()); // ServerFence
+                serverStream.Receive(3); // padding
+                Assert.Equal((uint)(VncFenceFlags.Request | VncFenceFlags.BlockBefore), serverStream.ReceiveUInt32BE());
+                Assert.Equal(4, serverStream.ReceiveByte()); // length
+                Assert.Equal(0u, serverStream.ReceiveUInt32BE()); // payload
+                Assert.Equal(150, serverStream.ReceiveByte()); // EndOfContinuousUpdates
+
+                // The update
+                Assert.Equal(0, serverStream.ReceiveUInt16BE()); // FramebufferUpdate
+                Assert.Equal(1, serverStream.ReceiveUInt16BE()); // 1 rectangle
+                Assert.Equal(new VncRectangle(0, 0, 16, 16), serverStream.ReceiveRectangle());
+                Assert.Equal((uint)VncEncoding.Raw, serverStream.ReceiveUInt32BE());
+                serverStream.Receive(16 * 16 * 4);
+
+                // A fence follows each update.
+                Assert.Equal(248, serverStream.ReceiveByte()); // ServerFence
+                serverStream.Receive(3); // padding
+                Assert.Equal((uint)(VncFenceFlags.Request | VncFenceFlags.BlockBefore), serverStream.ReceiveUInt32BE());
+                Assert.Equal(4, serverStream.ReceiveByte()); // length
+                Assert.Equal(1u, serverStream.ReceiveUInt32BE()); // payload
+
+                // Continuous updates were disabled.
+                Assert.Equal(150, serverStream.ReceiveByte()); // EndOfContinuousUpdates
+
+                Assert.Equal(stream.Output.Length, stream.Output.Position);
+                Assert.Equal(stream.Input.Length, stream.Input.Position);
+            }
+        }
+
+        /// <summary>
+        /// Tests the handling of a fence request sent by the client.
+        /// </summary>
+        [Fact]
+        public void ClientFenceTest()
+        {
+            using (var stream = new TestStream())
+            {
+                VncStream clientStream = new VncStream(stream.Input);
+                clientStream.SendByte((byte)VncMessageType.ClientFence);
+                clientStream.Send(new byte[3]); // padding
+                clientStream.SendUInt32BE((uint)(VncFenceFlags.Request | VncFenceFlags.BlockBefore | VncFenceFlags.SyncNext));
+                clientStream.SendByte(2); // length
+                clientStream.Send(new byte[] { 1, 2 }); // payload
+                stream.Input.Position = 0;
+
+                var session = new VncServerSession();
+                session.Connect(stream, null, startThread: false);
+                session.HandleMessage();
+
+                VncStream serverStream = new VncStream(stream.Output);
+                stream.Output.Position = 0;
+
+                // The response has the same payload, and only contains the flags which are supported.
+                Assert.Equal(248, serverStream.ReceiveByte()); // ServerFence
+                serverStream.Receive(3); // padding
+                Assert.Equal((uint)VncFenceFlags.BlockBefore, serverStream.ReceiveUInt32BE());
+                Assert.Equal(2, serverStream.ReceiveByte()); // length
+                Assert.Equal(new byte[] { 1, 2 }, serverStream.Receive(2));
+
+                Assert.Equal(stream.Output.Length, stream.Output.Position);
+            }
+        }
+
+        /// <summary>
+        /// Tests the <see cref="VncServerSession.TryGetMessageLength(ReadOnlySequence{byte}, out int)"/> method.
+        /// </summary>
+        /// <param name="message">
+        /// The data which has been received.
+        /// </param>
+        /// <param name="expectedLength">
+        /// The expected message length, or -1 if the message is incomplete.
+        /// </param>
+        [Theory]
+        [InlineData(new byte[] { }, -1)]
+        [InlineData(new byte[] { 0 }, 20)]
+        [InlineData(new byte[] { 2, 0 }, -1)]
+        [InlineData(new byte[] { 2, 0, 0, 2 }, 12)]
+        [InlineData(new byte[] { 3 }, 10)]
+        [InlineData(new byte[] { 4 }, 8)]
+        [InlineData(new byte[] { 5 }, 6)]
+        [InlineData(new byte[] { 6, 0, 0, 0, 0, 0, 1, 0 }, 264)]
+        [InlineData(new byte[] { 150 }, 10)]
+        [InlineData(new byte[] { 248, 0, 0, 0, 0, 0, 0, 0, 4 }, 13)]
+        [InlineData(new byte[] { 251, 0, 0, 0, 0, 0, 2 }, 40)]
+        public void TryGetMessageLengthTest(byte[] message, int expectedLength)
+        {
+            // Pad the message, so that complete messages can be recognized.
+            var data = new byte[Math.Max(message.Length, expectedLength)];
+            message.CopyTo(data, 0);
+
+            Assert.Equal(expectedLength != -1, VncServerSession.TryGetMessageLength(new ReadOnlySequence<byte>(data), out int length));
+
+            if (expectedLength != -1)
+            {
+                Assert.Equal(expectedLength, length);
+
+                // Partial messages are not complete.
+                Assert.False(VncServerSession.TryGetMessageLength(new ReadOnlySequence<byte>(data, 0, expectedLength - 1), out length));
+            }
+        }
+
+        /// <summary>
+        /// Tests that the <see cref="VncServerSession.TryGetMessageLength(ReadOnlySequence{byte}, out int)"/>
+        /// method rejects unknown messages.
+        /// </summary>
+        [Fact]
+        public void TryGetMessageLengthUnknownTest()
+        {
+            Assert.Throws<VncException>(() => VncServerSession.TryGetMessageLength(new ReadOnlySequence<byte>(new byte[] { 99 }), out int length));
+        }
+
+        /// <summary>
+        /// Tests a session which handles the connection in the background, over a TCP connection.
+        /// </summary>
+        [Fact]
+        public void ConnectTcpTest()
+        {
+            var listener = new TcpListener(IPAddress.Loopback, 0);
+            listener.Start();
+
+            try
+            {
+                using (var client = new TcpClient())
+                using (var closed = new ManualResetEventSlim())
+                {
+                    client.Connect((IPEndPoint)listener.LocalEndpoint);
+
+                    var session = new VncServerSession();
+                    session.SetFramebufferSource(new VncFramebuffer("test", 64, 32, VncPixelFormat.RGB32));
+                    session.Closed += (sender, e) => closed.Set();
+                    session.Connect(listener.AcceptTcpClient().GetStream(), null);
+
+                    var clientStream = new VncStream(client.GetStream());
+
+                    // Handshake
+                    Assert.Equal(new Version(3, 8), clientStream.ReceiveVersion());
+                    clientStream.SendVersion(new Version(3, 8));
+                    Assert.Equal(1, clientStream.ReceiveByte());
+                    Assert.Equal((byte)AuthenticationMethod.None, clientStream.ReceiveByte());
+                    clientStream.SendByte((byte)AuthenticationMethod.None);
+                    Assert.Equal(0u, clientStream.ReceiveUInt32BE());
+
+                    clientStream.SendByte(1); // Shared desktop
+                    Assert.Equal(64, clientStream.ReceiveUInt16BE());
+                    Assert.Equal(32, clientStream.ReceiveUInt16BE());
+                    clientStream.Receive(VncPixelFormat.Size);
+                    Assert.Equal("test", clientStream.ReceiveString());
+
+                    // Send a pointer event and a framebuffer update request in a single write.
+                    var messages = new byte[]
+                    {
+                        (byte)VncMessageType.PointerEvent, 0, 0, 1, 0, 1,
+                        (byte)VncMessageType.FrameBufferUpdateRequest, 0, 0, 0, 0, 0, 0, 64, 0, 32,
+                    };
+
+                    clientStream.Send(messages);
+
+                    Assert.Equal(0, clientStream.ReceiveByte()); // FramebufferUpdate
+                    clientStream.ReceiveByte(); // padding
+                    Assert.Equal(1, clientStream.ReceiveUInt16BE());
+                    Assert.Equal(new VncRectangle(0, 0, 64, 32), clientStream.ReceiveRectangle());
+                    Assert.Equal((uint)VncEncoding.Raw, clientStream.ReceiveUInt32BE());
+                    clientStream.Receive(64 * 32 * 4);
+
+                    client.Close();
+                    Assert.True(closed.Wait(TimeSpan.FromSeconds(10)));
+
+                    session.Close();
+                    Assert.False(session.IsConnected);
+                }
+            }
+            finally
+            {
+                listener.Stop();
+            }
+        }
+
+        /// <summary>
+        /// Tests that a framebuffer update which is encoded on multiple threads is identical to an update which is
+        /// encoded on a single thread.
+        /// </summary>
+        [Fact]
+        public void MaxEncoderThreadsTest()
+        {
+            Assert.Equal(SendTightUpdate(maxEncoderThreads: 1), SendTightUpdate(maxEncoderThreads: 4));
+        }
+
+        /// <summary>
+        /// Tests that the <see cref="VncServerSession.Statistics"/> and the update counters of the session are
+        /// updated when a framebuffer update is sent, both when encoding on the session thread and on workers.
+        /// </summary>
+        /// <param name="maxEncoderThreads">
+        /// The number of threads used to encode the update.
+        /// </param>
+        [Theory]
+        [InlineData(1)]
+        [InlineData(4)]
+        public void StatisticsTest(int maxEncoderThreads)
+        {
+            using (var stream = new TestStream())
+            {
+                VncStream clientStream = new VncStream(stream.Input);
+                clientStream.SendByte(1); // Shared desktop
+                clientStream.SendByte((byte)VncMessageType.SetEncodings);
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt16BE(1);
+                clientStream.SendUInt32BE((uint)VncEncoding.Tight);
+                stream.Input.Position = 0;
+
+                var framebuffer = new VncFramebuffer("test", 256, 512, VncPixelFormat.RGB32);
+                var random = new Random(0);
+
+                for (int y = 0; y < framebuffer.Height; y++)
+                {
+                    for (int x = 0; x < framebuffer.Width; x++)
+                    {
+                        framebuffer.SetPixel(x, y, random.Next(0x1000000));
+                    }
+                }
+
+                var session = new VncServerSession();
+                session.MaxEncoderThreads = maxEncoderThreads;
+                session.SetFramebufferSource(framebuffer);
+                session.Connect(stream, null, startThread: false, forceConnected: true);
+                session.NegotiateDesktop();
+                session.HandleMessage();
+
+                var initLength = stream.Output.Length;
+
+                session.FramebufferUpdateRequest = new FramebufferUpdateRequest(false, new VncRectangle(0, 0, 256, 512));
+                Assert.True(session.FramebufferSendChanges());
+
+                Assert.Equal(1, session.FramebufferUpdatesSent);
+                Assert.Equal(stream.Output.Length - initLength, session.BytesSent);
+                Assert.Equal(0, session.SkippedFramebufferUpdates);
+
+                var statistics = Assert.Single(session.Statistics);
+                Assert.Equal(VncEncoding.Tight, statistics.Key);
+                Assert.Equal(2u, statistics.Value.Rectangles);
+                Assert.Equal(256ul * 512 * 4, statistics.Value.RawBytes);
+                Assert.True(statistics.Value.EncodeTime > TimeSpan.Zero);
+            }
+        }
+
+        /// <summary>
+        /// Tests that the cursor of a <see cref="IVncCursorSource"/> is sent to clients which support the RichCursor
+        /// pseudo-encoding, and that it is only sent again when it has changed.
+        /// </summary>
+        [Fact]
+        public void CursorPseudoEncodingTest()
+        {
+            using (var stream = new TestStream())
+            {
+                VncStream clientStream = new VncStream(stream.Input);
+                clientStream.SendByte(1); // Shared desktop
+                clientStream.SendByte((byte)VncMessageType.SetEncodings);
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt16BE(2);
+                clientStream.SendUInt32BE((uint)VncEncoding.Raw);
+                clientStream.SendUInt32BE(unchecked((uint)VncEncoding.RichCursor));
+                stream.Input.Position = 0;
+
+                var framebuffer = new VncFramebuffer("test", 16, 16, VncPixelFormat.RGB32);
+                var cursor = new VncCursor(2, 1, 1, 0, new byte[] { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0xFF });
+
+                var framebufferSourceMock = new Mock<IVncCursorSource>();
+                framebufferSourceMock.Setup(m => m.Capture()).Returns(framebuffer);
+                framebufferSourceMock.Setup(m => m.Cursor).Returns(() => cursor);
+
+                var session = new VncServerSession();
+                session.SetFramebufferSource(framebufferSourceMock.Object);
+                session.Connect(stream, null, startThread: false, forceConnected: true);
+                session.NegotiateDesktop();
+                session.HandleMessage();
+
+                var initLength = stream.Output.Length;
+
+                session.FramebufferUpdateRequest = new FramebufferUpdateRequest(false, new VncRectangle(0, 0, 16, 16));
+                Assert.True(session.FramebufferSendChanges());
+                Assert.Same(cursor, session.Cursor);
+
+                // Nothing has changed.
+                session.FramebufferUpdateRequest = new FramebufferUpdateRequest(true, new VncRectangle(0, 0, 16, 16));
+                Assert.False(session.FramebufferSendChanges());
+
+                // Only the cursor has changed.
+                cursor = VncCursor.Hidden;
+                Assert.True(session.FramebufferSendChanges());
+
+                VncStream serverStream = new VncStream(stream.Output);
+                stream.Output.Position = initLength;
+
+                Assert.Equal(0, serverStream.ReceiveUInt16BE()); // FramebufferUpdate
+                Assert.Equal(2, serverStream.ReceiveUInt16BE());
+                Assert.Equal(new VncRectangle(0, 0, 16, 16), serverStream.ReceiveRectangle());
+                Assert.Equal((uint)VncEncoding.Raw, serverStream.ReceiveUInt32BE());
+                serverStream.Receive(16 * 16 * 4);
+                Assert.Equal(new VncRectangle(1, 0, 2, 1), serverStream.ReceiveRectangle());
+                Assert.Equal(unchecked((uint)VncEncoding.RichCursor), serverStream.ReceiveUInt32BE());
+                serverStream.Receive(2 * 4); // pixels
+                Assert.Equal(0xC0, serverStream.ReceiveByte()); // mask
+
+                Assert.Equal(0, serverStream.ReceiveUInt16BE()); // FramebufferUpdate
+                Assert.Equal(1, serverStream.ReceiveUInt16BE());
+                Assert.Equal(new VncRectangle(0, 0, 0, 0), serverStream.ReceiveRectangle());
+                Assert.Equal(unchecked((uint)VncEncoding.RichCursor), serverStream.ReceiveUInt32BE());
+
+                Assert.Equal(stream.Output.Length, stream.Output.Position);
+            }
+        }
+
+        /// <summary>
+        /// Tests that the cursor is drawn into the framebuffer updates, at the position of the pointer of the client,
+        /// when the client doesn't support any of the cursor pseudo-encodings.
+        /// </summary>
+        [Fact]
+        public void SoftwareCursorTest()
+        {
+            using (var stream = new TestStream())
+            {
+                VncStream clientStream = new VncStream(stream.Input);
+                clientStream.SendByte(1); // Shared desktop
+                clientStream.SendByte((byte)VncMessageType.SetEncodings);
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt16BE(1);
+                clientStream.SendUInt32BE((uint)VncEncoding.Raw);
+                clientStream.SendByte((byte)VncMessageType.PointerEvent);
+                clientStream.SendByte(0); // buttons
+                clientStream.SendUInt16BE(4);
+                clientStream.SendUInt16BE(6);
+                stream.Input.Position = 0;
+
+                var framebuffer = new VncFramebuffer("test", 16, 16, VncPixelFormat.RGB32);
+
+                var session = new VncServerSession();
+                session.SetFramebufferSource(framebuffer);
+                session.Connect(stream, null, startThread: false, forceConnected: true);
+                session.NegotiateDesktop();
+                session.HandleMessage();
+                session.HandleMessage();
+
+                session.Cursor = new VncCursor(2, 1, 1, 0, new byte[] { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 });
+
+                var initLength = stream.Output.Length;
+
+                session.FramebufferUpdateRequest = new FramebufferUpdateRequest(true, new VncRectangle(0, 0, 16, 16));
+                Assert.True(session.FramebufferSendChanges());
+
+                // The cursor hasn't moved.
+                session.FramebufferUpdateRequest = new FramebufferUpdateRequest(true, new VncRectangle(0, 0, 16, 16));
+                Assert.False(session.FramebufferSendChanges());
+
+                VncStream serverStream = new VncStream(stream.Output);
+                stream.Output.Position = initLength;
+
+                Assert.Equal(0, serverStream.ReceiveUInt16BE()); // FramebufferUpdate
+                Assert.Equal(1, serverStream.ReceiveUInt16BE());
+                Assert.Equal(new VncRectangle(3, 6, 2, 1), serverStream.ReceiveRectangle());
+                Assert.Equal((uint)VncEncoding.Raw, serverStream.ReceiveUInt32BE());
+                Assert.Equal(new byte[] { 0xFF, 0xFF, 0xFF }, serverStream.Receive(3));
+                serverStream.Receive(1);
+                Assert.Equal(new byte[] { 0x00, 0x00, 0x00 }, serverStream.Receive(3));
+                serverStream.Receive(1);
+
+                Assert.Equal(stream.Output.Length, stream.Output.Position);
+            }
+        }
+
+        /// <summary>
+        /// Tests a session which uses a <see cref="VncScaledFramebufferSource"/>: the client requests a smaller desktop,
+        /// receives the new size before the scaled pixels, and its pointer events are mapped to the source.
+        /// </summary>
+        [Fact]
+        public void ScaledFramebufferSourceTest()
+        {
+            using (var stream = new TestStream())
+            {
+                VncStream clientStream = new VncStream(stream.Input);
+                clientStream.SendByte(1); // Shared desktop
+                clientStream.SendByte((byte)VncMessageType.SetEncodings);
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt16BE(2);
+                clientStream.SendUInt32BE((uint)VncEncoding.Raw);
+                clientStream.SendUInt32BE(unchecked((uint)VncEncoding.ExtendedDesktopSize));
+
+                clientStream.SendByte((byte)VncMessageType.SetDesktopSize);
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt16BE(8); // width
+                clientStream.SendUInt16BE(4); // height
+                clientStream.SendByte(1); // number of screens
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt32BE(0); // screen id
+                clientStream.SendUInt16BE(0); // x position
+                clientStream.SendUInt16BE(0); // y position
+                clientStream.SendUInt16BE(8); // width
+                clientStream.SendUInt16BE(4); // height
+                clientStream.SendUInt32BE(0); // flags
+
+                clientStream.SendByte((byte)VncMessageType.PointerEvent);
+                clientStream.SendByte(1); // buttons
+                clientStream.SendUInt16BE(3);
+                clientStream.SendUInt16BE(2);
+                stream.Input.Position = 0;
+
+                var framebuffer = new VncFramebuffer("test", 16, 8, VncPixelFormat.RGB32);
+                framebuffer.SetPixel(2, 2, 0xFFFFFF);
+                framebuffer.SetPixel(3, 2, 0xFFFFFF);
+                framebuffer.SetPixel(2, 3, 0xFFFFFF);
+                framebuffer.SetPixel(3, 3, 0xFFFFFF);
+
+                PointerChangedEventArgs pointer = null;
+
+                var session = new VncServerSession();
+                session.SetFramebufferSource(new VncScaledFramebufferSource(framebuffer));
+                session.PointerChanged += (sender, e) => pointer = e;
+                session.Connect(stream, null, startThread: false, forceConnected: true);
+                session.NegotiateDesktop();
+                session.HandleMessage();
+                session.HandleMessage();
+
+                var initLength = stream.Output.Length;
+
+                session.FramebufferUpdateRequest = new FramebufferUpdateRequest(true, new VncRectangle(0, 0, 16, 8));
+                Assert.True(session.FramebufferSendChanges());
+                Assert.Equal(8, session.Framebuffer.Width);
+                Assert.Equal(4, session.Framebuffer.Height);
+
+                session.HandleMessage();
+                Assert.Equal(7, pointer.X);
+                Assert.Equal(5, pointer.Y);
+
+                VncStream serverStream = new VncStream(stream.Output);
+                stream.Output.Position = initLength;
+
+                Assert.Equal(0, serverStream.ReceiveUInt16BE()); // FramebufferUpdate
+                Assert.Equal(2, serverStream.ReceiveUInt16BE());
+
+                Assert.Equal(new VncRectangle((int)ExtendedDesktopSizeReason.External, 0, 8, 4), serverStream.ReceiveRectangle());
+                Assert.Equal(unchecked((uint)VncEncoding.ExtendedDesktopSize), serverStream.ReceiveUInt32BE());
+                serverStream.Receive(20);
+
+                Assert.Equal(new VncRectangle(0, 0, 8, 4), serverStream.ReceiveRectangle());
+                Assert.Equal((uint)VncEncoding.Raw, serverStream.ReceiveUInt32BE());
+                var pixels = serverStream.Receive(8 * 4 * 4);
+                Assert.Equal(0xFF, pixels[(1 * 8 * 4) + 4]);
+                Assert.Equal(0, pixels[0]);
+
+                Assert.Equal(stream.Output.Length, stream.Output.Position);
+            }
+        }
+
+        private static byte[] SendTightUpdate(int maxEncoderThreads)
+        {
+            using (var stream = new TestStream())
+            {
+                VncStream clientStream = new VncStream(stream.Input);
+                clientStream.SendByte(1); // Shared desktop
+                clientStream.SendByte((byte)VncMessageType.SetEncodings);
+                clientStream.SendByte(0); // padding
+                clientStream.SendUInt16BE(1);
+                clientStream.SendUInt32BE((uint)VncEncoding.Tight);
+                stream.Input.Position = 0;
+
+                // The update is split into 256x256 rectangles. Solid rectangles can be sent using fill compression
+                // by the workers; the other rectangles use the zlib streams of the session.
+                var framebuffer = new VncFramebuffer("test", 256, 1024, VncPixelFormat.RGB32);
+                var random = new Random(0);
+
+                for (int y = 0; y < framebuffer.Height; y++)
+                {
+                    for (int x = 0; x < framebuffer.Width; x++)
+                    {
+                        framebuffer.SetPixel(x, y, (y / 256) % 2 == 0 ? 0x123456 : random.Next(0x1000000));
+                    }
+                }
+
+                var session = new VncServerSession();
+                session.MaxEncoderThreads = maxEncoderThreads;
+                session.SetFramebufferSource(framebuffer);
+                session.Connect(stream, null, startThread: false, forceConnected: true);
+                session.NegotiateDesktop();
+                session.HandleMessage();
+                Assert.Equal(VncEncoding.Tight, session.Encoder.Encoding);
+
+                session.FramebufferUpdateRequest = new FramebufferUpdateRequest(false, new VncRectangle(0, 0, 256, 1024));
+                Assert.True(session.FramebufferSendChanges());
+
+                return ((MemoryStream)stream.Output).ToArray();
+            }
+        }
     }
 }
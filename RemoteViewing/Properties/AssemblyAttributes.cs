@@ -29,4 +29,5 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 using System;
 using System.Runtime.CompilerServices;
 
-[assembly: InternalsVisibleTo("RemoteViewing.Tests, PublicKey=0024000004800000940000000602000000240000525341310004000001000100015161dd5029e80502d304eeff507c29ec51c14720c9da66b5455ddc24b21e77fa9ff559917f5ec86b6eded62ad609243bcafc8055aac5f7a0a0f73d70396b2cdf6ec5b39b2690c775c959335e3aeae25f8f3c75f2e24a6ef21f8340bcef8ff0a4045a8c81787d71df8b08835d5e4a3b42f8bb6972a7df6712b48eed967d2ecf")]
\ No newline at end of file
+[assembly: InternalsVisibleTo("RemoteViewing.Tests, PublicKey=0024000004800000940000000602000000240000525341310004000001000100015161dd5029e80502d304eeff507c29ec51c14720c9da66b5455ddc24b21e77fa9ff559917f5ec86b6eded62ad609243bcafc8055aac5f7a0a0f73d70396b2cdf6ec5b39b2690c775c959335e3aeae25f8f3c75f2e24a6ef21f8340bcef8ff0a4045a8c81787d71df8b08835d5e4a3b42f8bb6972a7df6712b48eed967d2ecf")]
+[assembly: InternalsVisibleTo("RemoteViewing.Benchmarks, PublicKey=0024000004800000940000000602000000240000525341310004000001000100015161dd5029e80502d304eeff507c29ec51c14720c9da66b5455ddc24b21e77fa9ff559917f5ec86b6eded62ad609243bcafc8055aac5f7a0a0f73d70396b2cdf6ec5b39b2690c775c959335e3aeae25f8f3c75f2e24a6ef21f8340bcef8ff0a4045a8c81787d71df8b08835d5e4a3b42f8bb6972a7df6712b48eed967d2ecf")]
\ No newline at end of file
@@ -0,0 +1,68 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Buffers;
+using System.IO;
+
+namespace RemoteViewing.Utility
+{
+    /// <summary>
+    /// Provides extensions to the <see cref="Stream"/> class.
+    /// </summary>
+    internal static class StreamExtensions
+    {
+#if NET462
+        /// <summary>
+        /// Writes a sequence of bytes to a <see cref="Stream"/>. .NET Framework does not provide an overload of
+        /// <see cref="Stream.Write(byte[], int, int)"/> which accepts a <see cref="ReadOnlySpan{T}"/>, so the data
+        /// is copied into a pooled buffer first.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> to which to write the data.
+        /// </param>
+        /// <param name="buffer">
+        /// The data to write.
+        /// </param>
+        public static void Write(this Stream stream, ReadOnlySpan<byte> buffer)
+        {
+            byte[] array = ArrayPool<byte>.Shared.Rent(buffer.Length);
+
+            try
+            {
+                buffer.CopyTo(array);
+                stream.Write(array, 0, buffer.Length);
+            }
+            finally
+            {
+                ArrayPool<byte>.Shared.Return(array);
+            }
+        }
+#endif
+    }
+}
@@ -0,0 +1,83 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System.Runtime.InteropServices;
+
+namespace RemoteViewing.VMware
+{
+    /// <summary>
+    /// The header of an AVI standard index chunk, which indexes the chunks of a single stream within one
+    /// <c>movi</c> list. It is followed by <see cref="EntriesInUse"/> <see cref="AviStandardIndexEntry"/> values.
+    /// </summary>
+    /// <seealso href="http://www.jmcgowan.com/odmlff2.pdf"/>
+    [StructLayout(LayoutKind.Sequential, Pack = 4)]
+    internal struct AviStandardIndexChunk
+    {
+        /// <summary>
+        /// The chunk identifier, typically <c>ix00</c>.
+        /// </summary>
+        public FourCC FourCC;
+
+        /// <summary>
+        /// The size of the chunk, excluding <see cref="FourCC"/> and <see cref="Size"/>.
+        /// </summary>
+        public int Size;
+
+        /// <summary>
+        /// The size of each entry, in 4-byte units. This is always 2.
+        /// </summary>
+        public short LongsPerEntry;
+
+        /// <summary>
+        /// The index sub type.
+        /// </summary>
+        public IndexSubType IndexSubType;
+
+        /// <summary>
+        /// The index type. This is always <see cref="IndexType.IndexOfChunks"/>.
+        /// </summary>
+        public IndexType IndexType;
+
+        /// <summary>
+        /// The number of entries in the index.
+        /// </summary>
+        public int EntriesInUse;
+
+        /// <summary>
+        /// The identifier of the chunks which are indexed, such as <c>00dc</c>.
+        /// </summary>
+        public FourCC ChunkId;
+
+        /// <summary>
+        /// The offset, from the start of the file, to which the offsets of all entries are relative.
+        /// </summary>
+        public long BaseOffset;
+
+        private int reserved;
+    }
+}
@@ -50,6 +50,12 @@ namespace RemoteViewing.VMware
         /// </summary>
         Avi = 0x20495641,
 
+        /// <summary>
+        /// OpenDML files store the data which doesn't fit in the first RIFF list in additional RIFF lists,
+        /// which are identified by the FOURCC 'AVIX'.
+        /// </summary>
+        Avix = 0x58495641,
+
         /// <summary>
         /// The 'hdrl' list begins with the main AVI header, which is contained in an 'avih' chunk.
         /// </summary>
@@ -126,6 +132,11 @@ namespace RemoteViewing.VMware
         /// </summary>
         Ix = 0x00007869,
 
+        /// <summary>
+        /// The standard index of the chunks of stream 0.
+        /// </summary>
+        Ix00 = 0x30307869,
+
         /// <summary>
         /// The VMware codec.
         /// </summary>
@@ -120,6 +120,73 @@ namespace RemoteViewing.VMware
             }
         }
 
+        /// <summary>
+        /// Reads a struct from a <see cref="Stream"/>.
+        /// </summary>
+        /// <typeparam name="T">
+        /// The type of struct to deserialize.
+        /// </typeparam>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> from which to read the struct.
+        /// </param>
+        /// <returns>
+        /// The value of the struct.
+        /// </returns>
+        public static T ReadStruct<T>(this Stream stream)
+            where T : struct
+        {
+            byte[] buffer = null;
+
+            try
+            {
+                var size = Unsafe.SizeOf<T>();
+                buffer = ArrayPool<byte>.Shared.Rent(size);
+                stream.ReadAll(buffer, 0, size);
+                return MemoryMarshal.Read<T>(buffer);
+            }
+            finally
+            {
+                if (buffer != null)
+                {
+                    ArrayPool<byte>.Shared.Return(buffer);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Reads an exact number of bytes from a <see cref="Stream"/>.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> from which to read.
+        /// </param>
+        /// <param name="buffer">
+        /// The buffer into which to read the data.
+        /// </param>
+        /// <param name="offset">
+        /// The offset in <paramref name="buffer"/> at which to store the data.
+        /// </param>
+        /// <param name="count">
+        /// The number of bytes to read.
+        /// </param>
+        /// <exception cref="EndOfStreamException">
+        /// The stream ended before <paramref name="count"/> bytes could be read.
+        /// </exception>
+        public static void ReadAll(this Stream stream, byte[] buffer, int offset, int count)
+        {
+            while (count > 0)
+            {
+                int read = stream.Read(buffer, offset, count);
+
+                if (read == 0)
+                {
+                    throw new EndOfStreamException();
+                }
+
+                offset += read;
+                count -= read;
+            }
+        }
+
 #if !NETCOREAPP2_1
         public static Task WriteAsync(this Stream stream, ReadOnlyMemory<byte> memory, CancellationToken cancellationToken)
         {
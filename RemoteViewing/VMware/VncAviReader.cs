@@ -0,0 +1,742 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+
+namespace RemoteViewing.VMware
+{
+    /// <summary>
+    /// The <see cref="VncAviReader"/> replays a RFB session which has been stored in a VMnc AVI file, such as the files
+    /// recorded by VMware Workstation or by the <see cref="VncAviWriter"/>.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// The frames are located using the OpenDML index of the file. If the file has no index (for example, because the
+    /// recording was written to a stream which can't seek), the frames are located by scanning the file once.
+    /// </para>
+    /// <para>
+    /// Only one frame is held in memory at any time, so the size of the recording is not limited by the amount of
+    /// memory available. Key frames are used to seek to any frame without decoding the entire recording.
+    /// </para>
+    /// <para>
+    /// The rectangles which are decoded are reported through <see cref="IVncFramebufferDamageSource"/>, so the server
+    /// only has to compare the regions which the recording has updated.
+    /// </para>
+    /// </remarks>
+    public class VncAviReader : IVncFramebufferDamageSource, IDisposable
+    {
+        private readonly object syncRoot = new object();
+        private readonly Stream stream;
+        private readonly bool leaveOpen;
+        private readonly string name;
+        private readonly List<Frame> frames = new List<Frame>();
+
+        private readonly MemoryStream frameData = new MemoryStream();
+        private readonly VncStream frameReader;
+        private readonly VncInflater zlibInflater = new VncInflater();
+        private readonly ZrleDecoder zrleDecoder = new ZrleDecoder();
+        private readonly TightDecoder tightDecoder = new TightDecoder();
+        private readonly HextileDecoder hextileDecoder = new HextileDecoder();
+        private readonly byte[] pixelFormat = new byte[16];
+        private readonly Stopwatch clock = new Stopwatch();
+        private readonly VncDamageHistory damage = new VncDamageHistory();
+        private readonly List<VncRectangle> decodedRegions = new List<VncRectangle>();
+        private bool isDamageUnknown;
+
+        private VncFramebuffer framebuffer;
+        private byte[] scratch = new byte[0];
+        private int currentFrame = -1;
+        private int clockStartFrame;
+        private bool isDisposed;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncAviReader"/> class.
+        /// </summary>
+        /// <param name="stream">
+        /// A <see cref="Stream"/> which contains the AVI file. The stream must be seekable.
+        /// </param>
+        public VncAviReader(Stream stream)
+            : this(stream, "VMnc", leaveOpen: false)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncAviReader"/> class.
+        /// </summary>
+        /// <param name="stream">
+        /// A <see cref="Stream"/> which contains the AVI file. The stream must be seekable.
+        /// </param>
+        /// <param name="name">
+        /// The name of the framebuffer.
+        /// </param>
+        /// <param name="leaveOpen">
+        /// <see langword="true"/> to leave <paramref name="stream"/> open when this <see cref="VncAviReader"/> is disposed of;
+        /// otherwise, <see langword="false"/>.
+        /// </param>
+        public VncAviReader(Stream stream, string name, bool leaveOpen)
+        {
+            if (stream == null)
+            {
+                throw new ArgumentNullException(nameof(stream));
+            }
+
+            if (!stream.CanSeek)
+            {
+                throw new ArgumentOutOfRangeException(nameof(stream), "The stream must be seekable.");
+            }
+
+            this.stream = stream;
+            this.name = name ?? throw new ArgumentNullException(nameof(name));
+            this.leaveOpen = leaveOpen;
+            this.frameReader = new VncStream(this.frameData);
+
+            this.ReadHeaders();
+        }
+
+        /// <summary>
+        /// Gets the number of frames in the recording.
+        /// </summary>
+        public int FrameCount
+        {
+            get { return this.frames.Count; }
+        }
+
+        /// <summary>
+        /// Gets the amount of time each frame is displayed.
+        /// </summary>
+        public TimeSpan FrameDuration
+        { get; private set; }
+
+        /// <summary>
+        /// Gets the index of the frame which is currently held by <see cref="Framebuffer"/>, or -1 if no frame has been
+        /// decoded yet.
+        /// </summary>
+        public int CurrentFrame
+        {
+            get { return this.currentFrame; }
+        }
+
+        /// <summary>
+        /// Gets the framebuffer which holds the current frame.
+        /// </summary>
+        public VncFramebuffer Framebuffer
+        {
+            get { return this.framebuffer; }
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether the last frame of the recording has been decoded.
+        /// </summary>
+        public bool EndOfStream
+        {
+            get { return this.currentFrame == this.frames.Count - 1; }
+        }
+
+        /// <summary>
+        /// Gets or sets a value indicating whether <see cref="Capture"/> replays the recording in real time, or decodes
+        /// the next frame on every call.
+        /// </summary>
+        /// <remarks>
+        /// The default is <see langword="true"/>. When playing back in real time, frames which are due at the same time
+        /// are skipped.
+        /// </remarks>
+        public bool RealTime
+        { get; set; } = true;
+
+        /// <summary>
+        /// Gets or sets a value indicating whether playback restarts at the first frame once the end of the recording has
+        /// been reached.
+        /// </summary>
+        public bool Loop
+        { get; set; }
+
+        /// <inheritdoc/>
+        public bool SupportsResizing => false;
+
+        /// <inheritdoc/>
+        public long FrameSequence => this.damage.Sequence;
+
+        /// <summary>
+        /// Opens a VMnc AVI file.
+        /// </summary>
+        /// <param name="path">
+        /// The path to the AVI file.
+        /// </param>
+        /// <returns>
+        /// A <see cref="VncAviReader"/> which replays the file.
+        /// </returns>
+        public static VncAviReader Open(string path)
+        {
+            var stream = new FileStream(path, FileMode.Open, FileAccess.Read, FileShare.Read, 0x10000, FileOptions.RandomAccess);
+
+            try
+            {
+                return new VncAviReader(stream, Path.GetFileNameWithoutExtension(path), leaveOpen: false);
+            }
+            catch
+            {
+                stream.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>
+        /// Decodes the next frame which is due, and returns the framebuffer which holds it.
+        /// </summary>
+        /// <returns>
+        /// The framebuffer. Once the end of the recording has been reached, the framebuffer keeps holding the last frame,
+        /// unless <see cref="Loop"/> is set.
+        /// </returns>
+        public VncFramebuffer Capture()
+        {
+            lock (this.syncRoot)
+            {
+                this.EnsureNotDisposed();
+
+                if (this.frames.Count == 0)
+                {
+                    return this.framebuffer;
+                }
+
+                int target;
+
+                if (this.RealTime)
+                {
+                    if (!this.clock.IsRunning)
+                    {
+                        this.clockStartFrame = Math.Max(0, this.currentFrame);
+                        this.clock.Restart();
+                    }
+
+                    target = this.clockStartFrame + (int)(this.clock.Elapsed.Ticks / Math.Max(1, this.FrameDuration.Ticks));
+                }
+                else
+                {
+                    target = this.currentFrame + 1;
+                }
+
+                if (target >= this.frames.Count)
+                {
+                    if (this.Loop)
+                    {
+                        target = 0;
+                        this.clockStartFrame = 0;
+                        this.clock.Restart();
+                    }
+                    else
+                    {
+                        target = this.frames.Count - 1;
+                    }
+                }
+
+                this.DecodeTo(target);
+                return this.framebuffer;
+            }
+        }
+
+        /// <summary>
+        /// Decodes a specific frame. Playback continues from this frame.
+        /// </summary>
+        /// <param name="frame">
+        /// The index of the frame to decode.
+        /// </param>
+        public void Seek(int frame)
+        {
+            lock (this.syncRoot)
+            {
+                this.EnsureNotDisposed();
+
+                if (frame < 0 || frame >= this.frames.Count)
+                {
+                    throw new ArgumentOutOfRangeException(nameof(frame));
+                }
+
+                this.DecodeTo(frame);
+                this.clock.Reset();
+            }
+        }
+
+        /// <inheritdoc/>
+        public ExtendedDesktopSizeStatus SetDesktopSize(int width, int height)
+        {
+            return ExtendedDesktopSizeStatus.Prohibited;
+        }
+
+        /// <inheritdoc/>
+        public bool TryGetDamage(long sequence, ICollection<VncRectangle> damage)
+        {
+            return this.damage.TryGetDamage(sequence, damage);
+        }
+
+        /// <inheritdoc/>
+        public void Dispose()
+        {
+            lock (this.syncRoot)
+            {
+                if (this.isDisposed)
+                {
+                    return;
+                }
+
+                this.isDisposed = true;
+
+                if (!this.leaveOpen)
+                {
+                    this.stream.Dispose();
+                }
+
+                this.zlibInflater.Dispose();
+                this.zrleDecoder.Dispose();
+                this.tightDecoder.Dispose();
+            }
+        }
+
+        private static void Require(bool condition, string message)
+        {
+            if (!condition)
+            {
+                throw new InvalidDataException(message);
+            }
+        }
+
+        private void EnsureNotDisposed()
+        {
+            if (this.isDisposed)
+            {
+                throw new ObjectDisposedException(nameof(VncAviReader));
+            }
+        }
+
+        private void ReadHeaders()
+        {
+            this.stream.Position = 0;
+            var riff = this.stream.ReadStruct<List>();
+            Require(riff.ListType == FourCC.Riff && riff.FourCC == FourCC.Avi, "The stream does not contain an AVI file.");
+
+            // Recordings which were written to a stream which can't seek have placeholder sizes.
+            long riffEnd = Math.Min(this.stream.Length, 8L + riff.Size);
+
+            var mainHeader = default(AviMainHeader);
+            var streamHeader = default(AviStreamHeader);
+            var bitmapInfoHeader = default(BitmapInfoHeader);
+            var superIndex = new List<AviSuperIndexEntry>();
+            long moviStart = -1;
+            long moviEnd = -1;
+
+            // The hdrl and strl lists are flattened; the chunks they contain are unique.
+            long position = this.stream.Position;
+
+            while (position + Unsafe.SizeOf<Chunk>() <= riffEnd)
+            {
+                this.stream.Position = position;
+                var chunk = this.stream.ReadStruct<Chunk>();
+                long dataStart = position + Unsafe.SizeOf<Chunk>();
+                long dataEnd = Math.Min(riffEnd, dataStart + (uint)chunk.Size);
+                position = dataEnd + (dataEnd & 1);
+
+                switch (chunk.FourCC)
+                {
+                    case FourCC.List:
+                        var listType = this.stream.ReadStruct<FourCC>();
+
+                        if (listType == FourCC.Movi)
+                        {
+                            moviStart = dataStart + sizeof(int);
+                            moviEnd = dataEnd;
+                        }
+                        else if (listType == FourCC.Hdrl || listType == FourCC.Strl)
+                        {
+                            position = dataStart + sizeof(int);
+                        }
+
+                        break;
+
+                    case FourCC.Avih:
+                        mainHeader = this.stream.ReadStruct<AviMainHeader>();
+                        break;
+
+                    case FourCC.Strh:
+                        streamHeader = this.stream.ReadStruct<AviStreamHeader>();
+                        break;
+
+                    case FourCC.Strf:
+                        bitmapInfoHeader = this.stream.ReadStruct<BitmapInfoHeader>();
+                        break;
+
+                    case FourCC.Indx:
+                        this.stream.Position = dataStart - Unsafe.SizeOf<Chunk>();
+                        var indexHeader = this.stream.ReadStruct<AviIndexChunck>();
+
+                        if (indexHeader.IndexType == IndexType.IndexOfIndexes)
+                        {
+                            for (int i = 0; i < indexHeader.EntriesInUse; i++)
+                            {
+                                superIndex.Add(this.stream.ReadStruct<AviSuperIndexEntry>());
+                            }
+                        }
+
+                        break;
+                }
+            }
+
+            Require(streamHeader.Handler == FourCC.VMnc || bitmapInfoHeader.Compression == FourCC.VMnc, "The AVI file does not contain a VMnc stream.");
+
+            if (streamHeader.Rate > 0 && streamHeader.Scale > 0)
+            {
+                this.FrameDuration = TimeSpan.FromTicks(streamHeader.Scale * TimeSpan.TicksPerSecond / streamHeader.Rate);
+            }
+            else
+            {
+                this.FrameDuration = TimeSpan.FromTicks(mainHeader.MicroSecPerFrame * (TimeSpan.TicksPerMillisecond / 1000));
+            }
+
+            int width = bitmapInfoHeader.Width != 0 ? bitmapInfoHeader.Width : mainHeader.Width;
+            int height = Math.Abs(bitmapInfoHeader.Height != 0 ? bitmapInfoHeader.Height : mainHeader.Height);
+            this.framebuffer = new VncFramebuffer(this.name, width, height, VncPixelFormat.RGB32);
+
+            if (superIndex.Count > 0)
+            {
+                foreach (var entry in superIndex)
+                {
+                    this.ReadStandardIndex(entry);
+                }
+            }
+            else if (moviStart >= 0)
+            {
+                this.ScanFrames(moviStart, moviEnd);
+
+                // An OpenDML file continues with RIFF AVIX lists.
+                position = riffEnd + (riffEnd & 1);
+
+                while (position + Unsafe.SizeOf<List>() + Unsafe.SizeOf<List>() <= this.stream.Length)
+                {
+                    this.stream.Position = position;
+                    var segment = this.stream.ReadStruct<List>();
+                    var movi = this.stream.ReadStruct<List>();
+
+                    if (segment.ListType != FourCC.Riff || segment.FourCC != FourCC.Avix || movi.ListType != FourCC.List || movi.FourCC != FourCC.Movi)
+                    {
+                        break;
+                    }
+
+                    long segmentEnd = Math.Min(this.stream.Length, position + 8 + segment.Size);
+                    moviStart = position + Unsafe.SizeOf<List>() + Unsafe.SizeOf<List>();
+                    this.ScanFrames(moviStart, Math.Min(segmentEnd, moviStart - sizeof(int) + movi.Size));
+                    position = segmentEnd + (segmentEnd & 1);
+                }
+            }
+        }
+
+        private void ReadStandardIndex(AviSuperIndexEntry entry)
+        {
+            this.stream.Position = entry.Offset;
+            var header = this.stream.ReadStruct<AviStandardIndexChunk>();
+            Require(header.IndexType == IndexType.IndexOfChunks && header.LongsPerEntry == 2, "The AVI file contains an invalid standard index.");
+
+            int entrySize = Unsafe.SizeOf<AviStandardIndexEntry>();
+            var buffer = new byte[header.EntriesInUse * entrySize];
+            this.stream.ReadAll(buffer, 0, buffer.Length);
+
+            foreach (var indexEntry in MemoryMarshal.Cast<byte, AviStandardIndexEntry>(buffer))
+            {
+                bool isKeyframe = (indexEntry.Size & AviStandardIndexEntry.DeltaFrame) == 0;
+                this.AddFrame(header.BaseOffset + indexEntry.Offset, (int)(indexEntry.Size & ~AviStandardIndexEntry.DeltaFrame), isKeyframe);
+            }
+        }
+
+        private void ScanFrames(long start, long end)
+        {
+            // Key frames start with a display mode change; peek at the first rectangle of each frame.
+            byte[] header = new byte[16];
+            long position = start;
+
+            while (position + Unsafe.SizeOf<Chunk>() <= end)
+            {
+                this.stream.Position = position;
+                var chunk = this.stream.ReadStruct<Chunk>();
+                long dataStart = position + Unsafe.SizeOf<Chunk>();
+                long dataEnd = dataStart + (uint)chunk.Size;
+
+                if (dataEnd > end)
+                {
+                    // A truncated recording.
+                    break;
+                }
+
+                if (chunk.FourCC == FourCC.Dc00)
+                {
+                    bool isKeyframe = this.frames.Count == 0;
+
+                    if (chunk.Size >= header.Length)
+                    {
+                        this.stream.ReadAll(header, 0, header.Length);
+                        isKeyframe |= (VncEncoding)VncUtility.DecodeUInt32BE(header, 12) == VncEncoding.VMWi;
+                    }
+
+                    this.AddFrame(dataStart, chunk.Size, isKeyframe);
+                }
+
+                position = dataEnd + (dataEnd & 1);
+            }
+        }
+
+        private void AddFrame(long offset, int size, bool isKeyframe)
+        {
+            int index = this.frames.Count;
+
+            this.frames.Add(
+                new Frame()
+                {
+                    Offset = offset,
+                    Size = size,
+
+                    // The first frame is always used as a key frame.
+                    Keyframe = isKeyframe || index == 0 ? index : this.frames[index - 1].Keyframe,
+                });
+        }
+
+        private void DecodeTo(int target)
+        {
+            if (target == this.currentFrame)
+            {
+                return;
+            }
+
+            // Start decoding from the most recent key frame, unless the target frame can be reached by decoding
+            // the frames which follow the current frame.
+            int keyframe = this.frames[target].Keyframe;
+            int start = target < this.currentFrame || keyframe > this.currentFrame ? keyframe : this.currentFrame + 1;
+
+            for (int i = start; i <= target; i++)
+            {
+                this.DecodeFrame(i);
+            }
+
+            this.currentFrame = target;
+
+            var fb = this.framebuffer;
+            if (fb != null)
+            {
+                lock (fb.SyncRoot)
+                {
+                    if (this.isDamageUnknown)
+                    {
+                        this.damage.AddUnknown();
+                    }
+                    else
+                    {
+                        this.damage.Add(this.decodedRegions);
+                    }
+                }
+            }
+
+            this.decodedRegions.Clear();
+            this.isDamageUnknown = false;
+        }
+
+        private void DecodeFrame(int index)
+        {
+            var frame = this.frames[index];
+
+            if (frame.Keyframe == index)
+            {
+                this.ResetDecoders();
+            }
+
+            // Frames in which nothing has changed are empty.
+            if (frame.Size == 0)
+            {
+                return;
+            }
+
+            this.stream.Position = frame.Offset;
+            this.frameData.SetLength(frame.Size);
+            this.stream.ReadAll(this.frameData.GetBuffer(), 0, frame.Size);
+            this.frameData.Position = 0;
+
+            var c = this.frameReader;
+            var messageType = c.ReceiveByte();
+            Require(messageType == 0, "The frame does not contain a framebuffer update.");
+            c.ReceiveByte(); // padding
+
+            var numRects = c.ReceiveUInt16BE();
+
+            for (int i = 0; i < numRects; i++)
+            {
+                var r = c.ReceiveRectangle();
+                int x = r.X, y = r.Y, w = r.Width, h = r.Height;
+                var encoding = (VncEncoding)c.ReceiveUInt32BE();
+
+                var fb = this.framebuffer;
+                var pixelFormat = fb.PixelFormat;
+                int bpp = pixelFormat.BytesPerPixel;
+                int rectangleSize = VncUtility.GetRectangleSize(w, h, bpp);
+                var inRange = w <= fb.Width && h <= fb.Height && x <= fb.Width - w && y <= fb.Height - h;
+                byte[] pixels;
+
+                switch (encoding)
+                {
+                    case VncEncoding.VMWi:
+                        // The display mode has changed. This is a key frame.
+                        c.Receive(this.pixelFormat, 0, this.pixelFormat.Length);
+                        var displayFormat = VncPixelFormat.Decode(this.pixelFormat, 0);
+
+                        if (w != fb.Width || h != fb.Height || !displayFormat.Equals(pixelFormat))
+                        {
+                            this.framebuffer = new VncFramebuffer(this.name, w, h, displayFormat);
+                            this.isDamageUnknown = true;
+                        }
+
+                        this.ResetDecoders();
+                        continue;
+
+                    case VncEncoding.Raw:
+                        VncStream.SanityCheck(rectangleSize <= this.frameData.Length);
+                        pixels = VncUtility.AllocateScratch(rectangleSize, ref this.scratch);
+                        c.Receive(pixels, 0, rectangleSize);
+                        break;
+
+                    case VncEncoding.CopyRect:
+                        var sourceX = c.ReceiveUInt16BE();
+                        var sourceY = c.ReceiveUInt16BE();
+
+                        if (!inRange || sourceX > fb.Width - w || sourceY > fb.Height - h)
+                        {
+                            continue;
+                        }
+
+                        pixels = VncUtility.AllocateScratch(rectangleSize, ref this.scratch);
+
+                        lock (fb.SyncRoot)
+                        {
+                            VncPixelFormat.Copy(fb.GetBuffer(), fb.Width, fb.Stride, pixelFormat, new VncRectangle(sourceX, sourceY, w, h), pixels, w, w * bpp, pixelFormat);
+                        }
+
+                        break;
+
+                    case VncEncoding.Hextile:
+                        pixels = this.hextileDecoder.Decode(c, pixelFormat, w, h);
+                        break;
+
+                    case VncEncoding.Zlib:
+                        int size = (int)c.ReceiveUInt32BE();
+                        VncStream.SanityCheck(size >= 0 && size <= this.frameData.Length);
+                        this.zlibInflater.Receive(c, size);
+
+                        pixels = VncUtility.AllocateScratch(rectangleSize, ref this.scratch);
+                        this.zlibInflater.Read(pixels, 0, rectangleSize);
+                        break;
+
+                    case VncEncoding.Zrle:
+                        pixels = this.zrleDecoder.Decode(c, pixelFormat, w, h);
+                        break;
+
+                    case VncEncoding.Tight:
+                        pixels = this.tightDecoder.Decode(c, pixelFormat, w, h);
+                        break;
+
+                    case VncEncoding.VMWd:
+                        // The cursor shape: a cursor type and padding byte, followed by the cursor image and mask.
+                        this.Skip(2 + (2L * rectangleSize));
+                        continue;
+
+                    case VncEncoding.VMWe:
+                    case VncEncoding.VMWj:
+                        this.Skip(2);
+                        continue;
+
+                    case VncEncoding.VMWg:
+                        this.Skip(10);
+                        continue;
+
+                    case VncEncoding.VMWh:
+                        this.Skip(4);
+                        continue;
+
+                    case VncEncoding.VMWf:
+                        // The cursor position; the rectangle has no data.
+                        continue;
+
+                    default:
+                        throw new InvalidDataException($"The frame contains an unsupported encoding, {encoding}.");
+                }
+
+                if (inRange)
+                {
+                    lock (fb.SyncRoot)
+                    {
+                        VncPixelFormat.Copy(pixels, w, w * bpp, pixelFormat, new VncRectangle(0, 0, w, h), fb.GetBuffer(), fb.Width, fb.Stride, pixelFormat, x, y);
+                    }
+
+                    this.decodedRegions.Add(new VncRectangle(x, y, w, h));
+                }
+            }
+        }
+
+        private void Skip(long count)
+        {
+            Require(count >= 0 && this.frameData.Length - this.frameData.Position >= count, "The frame is truncated.");
+            this.frameData.Position += count;
+        }
+
+        private void ResetDecoders()
+        {
+            // The VncAviWriter starts a new encoder at every key frame.
+            this.zlibInflater.Reset();
+            this.zrleDecoder.Reset();
+            this.tightDecoder.Reset();
+        }
+
+        /// <summary>
+        /// The location of a frame in the AVI file.
+        /// </summary>
+        private struct Frame
+        {
+            /// <summary>
+            /// The offset of the frame data.
+            /// </summary>
+            public long Offset;
+
+            /// <summary>
+            /// The size of the frame data.
+            /// </summary>
+            public int Size;
+
+            /// <summary>
+            /// The index of the most recent key frame, at or before this frame.
+            /// </summary>
+            public int Keyframe;
+        }
+    }
+}
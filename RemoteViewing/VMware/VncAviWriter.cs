@@ -28,12 +28,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using RemoteViewing.Vnc;
 using RemoteViewing.Vnc.Messages;
+using RemoteViewing.Vnc.Server;
 using System;
 using System.Buffers.Binary;
+using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
 using System.Runtime.CompilerServices;
-using System.Text;
+using System.Runtime.InteropServices;
 using System.Threading;
 using System.Threading.Tasks;
 
@@ -42,12 +44,77 @@ namespace RemoteViewing.VMware
     /// <summary>
     /// The <see cref="VncAviWriter"/> stores a RFB session into an AVI file.
     /// </summary>
+    /// <remarks>
+    /// <para>
+    /// Each frame is stored as a framebuffer update which only contains the regions which have changed since the
+    /// previous frame. Every <see cref="KeyframeInterval"/> frames, a key frame which contains the entire framebuffer
+    /// is written, and the encoder is reset, so playback can start at any key frame.
+    /// </para>
+    /// <para>
+    /// The frames are indexed using OpenDML standard indexes, which are written to the file as it grows, and which are
+    /// referenced by the super index in the header. When writing to a seekable stream, the header is kept up to date
+    /// while recording, and the data is split in RIFF lists of at most 1 GB. When writing to a stream which can't
+    /// seek, the header contains the <see cref="ExpectedSize"/> and <see cref="ExpectedTotalFrames"/> values instead.
+    /// </para>
+    /// </remarks>
     /// <seealso href="https://cdn.hackaday.io/files/274271173436768/avi.pdf"/>
     /// <seealso href="http://www.jmcgowan.com/odmlff2.pdf"/>
     public class VncAviWriter
     {
+        /// <summary>
+        /// The size of the <c>indx</c> chunk, which holds the super index.
+        /// </summary>
+        private const int SuperIndexSize = 0x42c8;
+
+        /// <summary>
+        /// The maximum number of entries in the super index.
+        /// </summary>
+        private const int SuperIndexCapacity = (SuperIndexSize - 24) / 16;
+
+        /// <summary>
+        /// The size of the <c>dmlh</c> chunk, which holds the OpenDML extended header.
+        /// </summary>
+        private const int ExtendedHeaderSize = 0xf8;
+
+        /// <summary>
+        /// The offset of the <c>movi</c> list in the first RIFF list. The header is padded up to this offset.
+        /// </summary>
+        private const int MoviOffset = 0x4800;
+
         private readonly IVncFramebufferSource framebufferSource;
 
+        private readonly AviSuperIndexEntry[] superIndex = new AviSuperIndexEntry[SuperIndexCapacity];
+        private readonly List<VncRectangle> regions = new List<VncRectangle>();
+        private readonly FramebufferUpdateRectangle rectangle = new FramebufferUpdateRectangle();
+        private readonly DisplayModeChange displayModeChange = new DisplayModeChange();
+        private readonly MemoryStream frame = new MemoryStream();
+
+        private VncEncoding encoding = VncEncoding.Raw;
+        private int keyframeInterval = 50;
+
+        // The state of the current recording.
+        private Stream stream;
+        private long start;
+        private long position;
+        private VncFramebuffer headerFramebuffer;
+        private long mainHeaderOffset;
+        private long streamHeaderOffset;
+        private long superIndexOffset;
+        private long extendedHeaderOffset;
+        private long segmentOffset;
+        private long moviOffset;
+        private int superIndexCount;
+        private AviStandardIndexEntry[] index;
+        private byte[] indexBuffer;
+        private int indexCount;
+        private long indexBaseOffset;
+        private int totalFrames;
+        private int firstSegmentFrames;
+        private int largestChunk;
+        private VncFramebufferCache cache;
+        private VncEncoder encoder;
+        private byte[] scratch = new byte[0];
+
         /// <summary>
         /// Initializes a new instance of the <see cref="VncAviWriter"/> class.
         /// </summary>
@@ -70,14 +137,14 @@ namespace RemoteViewing.VMware
 
         /// <summary>
         /// Gets or sets the expected size of the AVI file. Set to the maximum value by default,
-        /// useful when streaming to FFmpeg.
+        /// useful when streaming to FFmpeg. This value is only used when the output stream can't seek.
         /// </summary>
         public uint ExpectedSize
         { get; set; } = uint.MaxValue;
 
         /// <summary>
         /// Gets or sets the expected number of frames in the AVI file. Set to the maximum value by default,
-        /// useful when streaming to FFmpeg.
+        /// useful when streaming to FFmpeg. This value is only used when the output stream can't seek.
         /// </summary>
         public int ExpectedTotalFrames
         { get; set; } = int.MaxValue;
@@ -95,6 +162,68 @@ namespace RemoteViewing.VMware
         public int Scale
         { get; set; } = 200_000;
 
+        /// <summary>
+        /// Gets or sets the encoding used to store the framebuffer data. Supported values are
+        /// <see cref="VncEncoding.Raw"/>, <see cref="VncEncoding.Zlib"/> and <see cref="VncEncoding.Zrle"/>.
+        /// </summary>
+        /// <remarks>
+        /// The default is <see cref="VncEncoding.Raw"/>, which can be played back by most VMnc decoders.
+        /// </remarks>
+        public VncEncoding Encoding
+        {
+            get
+            {
+                return this.encoding;
+            }
+
+            set
+            {
+                if (value != VncEncoding.Raw && value != VncEncoding.Zlib && value != VncEncoding.Zrle)
+                {
+                    throw new ArgumentOutOfRangeException(nameof(value));
+                }
+
+                this.encoding = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the number of frames between two key frames.
+        /// </summary>
+        /// <remarks>
+        /// The default is 50. Set to 1 to store the entire framebuffer in every frame.
+        /// </remarks>
+        public int KeyframeInterval
+        {
+            get
+            {
+                return this.keyframeInterval;
+            }
+
+            set
+            {
+                if (value < 1)
+                {
+                    throw new ArgumentOutOfRangeException(nameof(value));
+                }
+
+                this.keyframeInterval = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the maximum size of a RIFF list, in bytes, when writing to a seekable stream.
+        /// </summary>
+        internal long MaximumSegmentSize
+        { get; set; } = 1L << 30;
+
+        /// <summary>
+        /// Gets or sets the maximum number of frames in a standard index. This bounds the amount of memory
+        /// used for indexing, regardless of the length of the recording.
+        /// </summary>
+        internal int StandardIndexCapacity
+        { get; set; } = 2044;
+
         /// <summary>
         /// Asynchronously writes framebuffer packages to a <see cref="Stream"/>.
         /// </summary>
@@ -103,7 +232,8 @@ namespace RemoteViewing.VMware
         /// </param>
         /// <param name="cancellationToken">
         /// A <see cref="CancellationToken"/> which can be used to cancel the asynchronous operation. This method
-        /// will keep recording until cancellation is requested.
+        /// will keep recording until cancellation is requested, the framebuffer source returns <see langword="null"/>,
+        /// or the super index is full.
         /// </param>
         /// <returns>
         /// A <see cref="Task"/> which represents the asynchronous operation.
@@ -117,8 +247,161 @@ namespace RemoteViewing.VMware
 
             VncFramebuffer framebuffer = this.framebufferSource.Capture();
 
+            this.stream = stream;
+            this.start = stream.CanSeek ? stream.Position : 0;
+            this.position = 0;
+            this.headerFramebuffer = framebuffer;
+            this.superIndexCount = 0;
+            this.index = new AviStandardIndexEntry[this.StandardIndexCapacity];
+            this.indexBuffer = new byte[this.StandardIndexCapacity * Unsafe.SizeOf<AviStandardIndexEntry>()];
+            this.indexCount = 0;
+            this.totalFrames = 0;
+            this.firstSegmentFrames = 0;
+            this.largestChunk = 0;
+            this.cache = null;
+
+            await this.WriteHeaderAsync(framebuffer, cancellationToken).ConfigureAwait(false);
+
+            Stopwatch timer = new Stopwatch();
+            int framesSinceKeyframe = 0;
+
+            while (!cancellationToken.IsCancellationRequested)
+            {
+                // Start a timer which will timeout after the timeframe allotted to each frame.
+                timer.Restart();
+                var interval = Task.Delay(this.MicrosecondsPerFrame / 1000, cancellationToken);
+                framebuffer = this.framebufferSource.Capture();
+
+                if (framebuffer == null)
+                {
+                    break;
+                }
+
+                // A new framebuffer (for example, because the screen was resized) always starts with a key frame.
+                bool isKeyframe = this.cache == null || this.cache.Framebuffer != framebuffer || framesSinceKeyframe >= this.KeyframeInterval;
+
+                if (this.cache == null || this.cache.Framebuffer != framebuffer)
+                {
+                    this.cache = new VncFramebufferCache(framebuffer, null);
+                    this.cache.DamageSource = this.framebufferSource as IVncFramebufferDamageSource;
+                }
+
+                if (isKeyframe)
+                {
+                    this.encoder = this.CreateEncoder();
+                    framesSinceKeyframe = 0;
+                }
+
+                this.EncodeFrame(framebuffer, isKeyframe);
+
+                if (!await this.WriteFrameAsync(isKeyframe, cancellationToken).ConfigureAwait(false))
+                {
+                    break;
+                }
+
+                framesSinceKeyframe++;
+                Debug.WriteLine($"Completed in {timer.ElapsedMilliseconds} ms out of allowed {this.MicrosecondsPerFrame / 1000} ms");
+
+                // Wait for the timer to complete.
+                try
+                {
+                    await interval.ConfigureAwait(false);
+                }
+                catch (OperationCanceledException)
+                {
+                    break;
+                }
+            }
+
+            // Complete the file, even if the recording was cancelled.
+            await this.CompleteAsync(CancellationToken.None).ConfigureAwait(false);
+        }
+
+        private VncEncoder CreateEncoder()
+        {
+            switch (this.Encoding)
+            {
+                case VncEncoding.Zlib:
+                    return new ZlibEncoder();
+
+                case VncEncoding.Zrle:
+                    return new ZrleEncoder();
+
+                default:
+                    return new RawEncoder();
+            }
+        }
+
+        private AviMainHeader CreateMainHeader()
+        {
+            var framebuffer = this.headerFramebuffer;
+
+            // Until the recording has completed, estimate the buffer size based on a raw frame.
+            long bufferSize = this.stream.CanSeek ? this.largestChunk : (long)framebuffer.Stride * framebuffer.Height;
+
+            return new AviMainHeader()
+            {
+                Flags = MainHeaderFlags.HasIndex,
+                Height = framebuffer.Height,
+                Width = framebuffer.Width,
+                MaxBytesPerSec = (int)Math.Min(int.MaxValue, bufferSize * this.Rate / this.Scale),
+                MicroSecPerFrame = this.MicrosecondsPerFrame,
+                Streams = 1,
+                SuggestedBufferSize = (int)Math.Min(int.MaxValue, bufferSize),
+
+                // For OpenDML files, this is the number of frames in the first RIFF list.
+                TotalFrames = this.stream.CanSeek ? this.firstSegmentFrames : this.ExpectedTotalFrames,
+            };
+        }
+
+        private AviStreamHeader CreateStreamHeader()
+        {
+            var framebuffer = this.headerFramebuffer;
+            long bufferSize = this.stream.CanSeek ? this.largestChunk : (long)framebuffer.Stride * framebuffer.Height;
+
+            return new AviStreamHeader()
+            {
+                Type = FourCC.Vids,
+                Handler = FourCC.VMnc,
+                Length = this.stream.CanSeek ? this.totalFrames : this.ExpectedTotalFrames,
+                Quality = -1,
+                Rate = this.Rate,
+                Scale = this.Scale,
+                SuggestedBufferSize = (int)Math.Min(int.MaxValue, bufferSize),
+                Bottom = (short)framebuffer.Height,
+                Right = (short)framebuffer.Width,
+            };
+        }
+
+        private AviIndexChunck CreateSuperIndexHeader()
+        {
+            return new AviIndexChunck()
+            {
+                FourCC = FourCC.Indx,
+                Size = SuperIndexSize,
+                EntriesInUse = this.superIndexCount,
+                ChunkId = FourCC.Dc00,
+                LongsPerEntry = 4,
+                IndexType = IndexType.IndexOfIndexes,
+                IndexSubType = IndexSubType.None,
+            };
+        }
+
+        private async Task WriteHeaderAsync(VncFramebuffer framebuffer, CancellationToken cancellationToken)
+        {
+            int mainHeaderSize = Unsafe.SizeOf<AviMainHeader>();
+            int streamHeaderSize = Unsafe.SizeOf<AviStreamHeader>();
+            int bitmapInfoHeaderSize = Unsafe.SizeOf<BitmapInfoHeader>();
+            int chunkHeaderSize = Unsafe.SizeOf<Chunk>();
+            int listHeaderSize = Unsafe.SizeOf<List>();
+
+            int strlSize = 4 + chunkHeaderSize + streamHeaderSize + chunkHeaderSize + bitmapInfoHeaderSize + chunkHeaderSize + SuperIndexSize;
+            int odmlSize = 4 + chunkHeaderSize + ExtendedHeaderSize;
+            int hdrlSize = 4 + chunkHeaderSize + mainHeaderSize + listHeaderSize - 4 + strlSize + listHeaderSize - 4 + odmlSize;
+
             // The RIFF header, wraps the entire file.
-            await stream.WriteStructAsync(
+            this.segmentOffset = this.position;
+            await this.WriteStructAsync(
                 new List()
                 {
                     ListType = FourCC.Riff,
@@ -128,241 +411,429 @@ namespace RemoteViewing.VMware
                 cancellationToken).ConfigureAwait(false);
 
             // HDRL list. Defines the format of the data and is the first required LIST chunk.
-            await stream.WriteStructAsync(
+            await this.WriteStructAsync(
                 new List()
                 {
                     ListType = FourCC.List,
                     FourCC = FourCC.Hdrl,
-                    Size = 0x449c, // TBC
+                    Size = (uint)hdrlSize,
                 },
                 cancellationToken).ConfigureAwait(false);
 
             // AVIH chunk. Contains the main AVI header.
-            await stream.WriteStructAsync(
+            await this.WriteStructAsync(
                 new Chunk()
                 {
                     FourCC = FourCC.Avih,
-                    Size = Unsafe.SizeOf<AviMainHeader>(),
+                    Size = mainHeaderSize,
                 },
                 cancellationToken).ConfigureAwait(false);
 
-            await stream.WriteStructAsync(
-                new AviMainHeader()
-                {
-                    Flags = MainHeaderFlags.HasIndex,
-                    Height = framebuffer.Height,
-                    Width = framebuffer.Width,
-                    MaxBytesPerSec = 1448660, // TBC
-                    MicroSecPerFrame = this.MicrosecondsPerFrame,
-                    Streams = 1,
-                    SuggestedBufferSize = 0x046bc4, // TBC
-                    TotalFrames = this.ExpectedTotalFrames,
-                },
-                cancellationToken).ConfigureAwait(false);
+            this.mainHeaderOffset = this.position;
+            await this.WriteStructAsync(this.CreateMainHeader(), cancellationToken).ConfigureAwait(false);
 
             // STRL list. Contains informatio about a stream.
-            await stream.WriteStructAsync(
+            await this.WriteStructAsync(
                 new List()
                 {
                     ListType = FourCC.List,
                     FourCC = FourCC.Strl,
-                    Size = 17220,
+                    Size = (uint)strlSize,
                 },
                 cancellationToken).ConfigureAwait(false);
 
             // STRH chunk
-            await stream.WriteStructAsync(
+            await this.WriteStructAsync(
                 new Chunk()
                 {
                     FourCC = FourCC.Strh,
-                    Size = 0x38,
+                    Size = streamHeaderSize,
                 },
                 cancellationToken).ConfigureAwait(false);
 
-            await stream.WriteStructAsync(
-                new AviStreamHeader()
-                {
-                    Type = FourCC.Vids,
-                    Handler = FourCC.VMnc,
-                    Length = this.ExpectedTotalFrames,
-                    Quality = -1,
-                    Rate = this.Rate,
-                    Scale = this.Scale,
-                    SuggestedBufferSize = 0x00046bc4,
-                    Bottom = (short)framebuffer.Height,
-                    Right = (short)framebuffer.Width,
-                },
-                cancellationToken).ConfigureAwait(false);
+            this.streamHeaderOffset = this.position;
+            await this.WriteStructAsync(this.CreateStreamHeader(), cancellationToken).ConfigureAwait(false);
 
             // STRF chunk
-            await stream.WriteStructAsync(
+            await this.WriteStructAsync(
                 new Chunk()
                 {
                     FourCC = FourCC.Strf,
-                    Size = 0x28,
+                    Size = bitmapInfoHeaderSize,
                 },
                 cancellationToken).ConfigureAwait(false);
 
             // BitmapInfoHeader
-            await stream.WriteStructAsync(
+            await this.WriteStructAsync(
                 new BitmapInfoHeader()
                 {
                     BitCount = 0x20,
                     Compression = FourCC.VMnc,
                     Height = framebuffer.Height,
                     Planes = 1,
-                    Size = 0x28, // TBC
+                    Size = (uint)bitmapInfoHeaderSize,
                     Width = framebuffer.Width,
                 },
                 cancellationToken).ConfigureAwait(false);
 
-            // Index chunk
-            var indexSize = 0x000042c8; // TBC
-            await stream.WriteStructAsync(
-                new AviIndexChunck()
-                {
-                    FourCC = FourCC.Indx,
-                    Size = indexSize,
-                    EntriesInUse = 1,
-                    ChunkId = FourCC.Dc00,
-                    LongsPerEntry = 4,
-                    IndexType = IndexType.IndexOfIndexes,
-                    IndexSubType = IndexSubType.None,
-                },
-                cancellationToken).ConfigureAwait(false);
+            // Super index chunk. The entries are written as the standard indexes are written.
+            this.superIndexOffset = this.position;
+            await this.WriteStructAsync(this.CreateSuperIndexHeader(), cancellationToken).ConfigureAwait(false);
+            await this.GrowAsync(SuperIndexSize - Unsafe.SizeOf<AviIndexChunck>() + chunkHeaderSize, cancellationToken).ConfigureAwait(false);
 
-            // Super index chunk
-            await stream.WriteStructAsync(
-                new AviSuperIndexEntry()
-                {
-                    Duration = this.ExpectedTotalFrames,
-                    Offset = 0x000000000004196a,
-                    Size = 0x4000,
-                },
-                cancellationToken);
-
-            await stream.GrowAsync(indexSize - Unsafe.SizeOf<AviSuperIndexEntry>() - Unsafe.SizeOf<AviIndexChunck>() + Unsafe.SizeOf<Chunk>(), cancellationToken).ConfigureAwait(false);
-
-            // ODML chunk
-            await stream.WriteStructAsync(
+            // ODML list
+            await this.WriteStructAsync(
                 new List()
                 {
                     ListType = FourCC.List,
                     FourCC = FourCC.Odml,
-                    Size = 0x00000104,
+                    Size = (uint)odmlSize,
                 },
                 cancellationToken).ConfigureAwait(false);
 
-            // DMLH chunk
-            indexSize = 0xf8;
-            await stream.WriteStructAsync(
-                new AviIndexChunck()
+            // DMLH chunk. Contains the total number of frames in the file.
+            await this.WriteStructAsync(
+                new Chunk()
                 {
                     FourCC = FourCC.Dmlh,
-                    Size = indexSize,
-                    IndexType = IndexType.IndexOfIndexes,
-                    IndexSubType = IndexSubType.None,
-                    ChunkId = (FourCC)BinaryPrimitives.ReverseEndianness((uint)VncEncoding.Raw),
-                    EntriesInUse = 0,
-                    LongsPerEntry = 0x13e,
+                    Size = ExtendedHeaderSize,
                 },
-                cancellationToken);
+                cancellationToken).ConfigureAwait(false);
 
-            await stream.GrowAsync(indexSize - Unsafe.SizeOf<AviIndexChunck>() + Unsafe.SizeOf<Chunk>(), cancellationToken).ConfigureAwait(false);
+            this.extendedHeaderOffset = this.position;
+            await this.WriteStructAsync(this.ExpectedTotalFrames, cancellationToken).ConfigureAwait(false);
+            await this.GrowAsync(ExtendedHeaderSize - sizeof(int), cancellationToken).ConfigureAwait(false);
 
-            var junkSize = 0x00000348;
-            await stream.WriteStructAsync(
+            int junkSize = MoviOffset - (int)this.position - chunkHeaderSize;
+            await this.WriteStructAsync(
                 new Chunk()
                 {
                     FourCC = FourCC.Junk,
-                    Size = junkSize, // TBC
+                    Size = junkSize,
                 },
                 cancellationToken).ConfigureAwait(false);
 
             var junk = "VMware Workstation";
             byte[] buffer = new byte[128];
-            Encoding.ASCII.GetBytes(junk, 0, junk.Length, buffer, 0);
-            stream.Write(buffer, 0, junk.Length);
+            System.Text.Encoding.ASCII.GetBytes(junk, 0, junk.Length, buffer, 0);
+            await this.WriteAsync(buffer, junk.Length, cancellationToken).ConfigureAwait(false);
 
-            await stream.GrowAsync(junkSize - junk.Length, cancellationToken).ConfigureAwait(false);
+            await this.GrowAsync(junkSize - junk.Length, cancellationToken).ConfigureAwait(false);
 
             // The movie list
-            await stream.WriteStructAsync(
+            this.moviOffset = this.position;
+            await this.WriteStructAsync(
                 new List()
                 {
                     FourCC = FourCC.Movi,
                     ListType = FourCC.List,
-                    Size = this.ExpectedSize - 0x4800,
+                    Size = this.ExpectedSize - MoviOffset,
                 },
-                cancellationToken);
+                cancellationToken).ConfigureAwait(false);
+        }
+
+        private void EncodeFrame(VncFramebuffer framebuffer, bool isKeyframe)
+        {
+            this.regions.Clear();
+            this.cache.GetChangedRegions(!isKeyframe, this.regions);
+
+            // The framebuffer update message; the number of rectangles is filled in at the end.
+            this.frame.SetLength(0);
+            this.frame.Write(new byte[4], 0, 4);
+            int rectangles = 0;
+
+            if (isKeyframe)
+            {
+                // Pseudo-rectangle: display mode change pseudo-encoding
+                this.rectangle.X = 0;
+                this.rectangle.Y = 0;
+                this.rectangle.Width = (ushort)framebuffer.Width;
+                this.rectangle.Height = (ushort)framebuffer.Height;
+                this.rectangle.EncodingType = VncEncoding.VMWi;
+                this.frame.Write(this.rectangle.Buffer.Span);
+
+                var pixelFormat = framebuffer.PixelFormat;
+                this.displayModeChange.BitsPerSample = (byte)pixelFormat.BitsPerPixel;
+                this.displayModeChange.Depth = (byte)pixelFormat.BitDepth;
+                this.displayModeChange.MaxBlue = pixelFormat.BlueMax;
+                this.displayModeChange.MaxGreen = pixelFormat.GreenMax;
+                this.displayModeChange.MaxRed = pixelFormat.RedMax;
+                this.displayModeChange.BlueShift = (byte)pixelFormat.BlueShift;
+                this.displayModeChange.GreenShift = (byte)pixelFormat.GreenShift;
+                this.displayModeChange.RedShift = (byte)pixelFormat.RedShift;
+                this.displayModeChange.TrueColor = !pixelFormat.IsPalettized;
+                this.frame.Write(this.displayModeChange.Buffer.Span);
+                rectangles++;
+            }
+
+            var encoder = this.encoder;
+            int bpp = framebuffer.PixelFormat.BytesPerPixel;
+
+            lock (framebuffer.SyncRoot)
+            {
+                foreach (var region in this.regions)
+                {
+                    // Some encoders limit the size of a rectangle, so split the region into subrectangles
+                    // which the encoder can send.
+                    int width = Math.Min(region.Width, encoder.MaximumRectangleWidth);
+                    int height = Math.Max(1, Math.Min(region.Height, encoder.MaximumRectangleArea / width));
+
+                    for (int y = region.Y; y < region.Y + region.Height; y += height)
+                    {
+                        for (int x = region.X; x < region.X + region.Width; x += width)
+                        {
+                            var subregion = new VncRectangle(
+                                x,
+                                y,
+                                Math.Min(width, region.X + region.Width - x),
+                                Math.Min(height, region.Y + region.Height - y));
+
+                            int length = subregion.Width * subregion.Height * bpp;
+                            var contents = VncUtility.AllocateScratch(length, ref this.scratch);
+                            VncPixelFormat.Copy(
+                                framebuffer.GetBuffer(),
+                                framebuffer.Width,
+                                framebuffer.Stride,
+                                framebuffer.PixelFormat,
+                                subregion,
+                                contents,
+                                subregion.Width,
+                                subregion.Width * bpp,
+                                framebuffer.PixelFormat);
+
+                            this.rectangle.X = (ushort)subregion.X;
+                            this.rectangle.Y = (ushort)subregion.Y;
+                            this.rectangle.Width = (ushort)subregion.Width;
+                            this.rectangle.Height = (ushort)subregion.Height;
+                            this.rectangle.EncodingType = encoder.Encoding;
+                            this.frame.Write(this.rectangle.Buffer.Span);
+
+                            encoder.Send(this.frame, framebuffer.PixelFormat, subregion, new ReadOnlySpan<byte>(contents, 0, length));
+                            rectangles++;
+                        }
+                    }
+                }
+            }
+
+            BinaryPrimitives.WriteUInt16BigEndian(this.frame.GetBuffer().AsSpan(2, 2), (ushort)rectangles);
+        }
+
+        private async Task<bool> WriteFrameAsync(bool isKeyframe, CancellationToken cancellationToken)
+        {
+            int size = (int)this.frame.Length;
+            int chunkSize = Unsafe.SizeOf<Chunk>() + size + (size & 1);
+
+            // Make sure the standard index which will be written once this segment is complete still fits in the segment.
+            int indexSize = Unsafe.SizeOf<AviStandardIndexChunk>() + ((this.indexCount + 1) * Unsafe.SizeOf<AviStandardIndexEntry>());
+            bool startSegment = this.stream.CanSeek
+                && this.position > this.moviOffset + Unsafe.SizeOf<List>()
+                && this.position + chunkSize + indexSize - this.segmentOffset > this.MaximumSegmentSize;
+
+            // The offsets in a standard index are 32-bit values.
+            bool flushIndex = this.indexCount == this.index.Length
+                || (this.indexCount > 0 && this.position + Unsafe.SizeOf<Chunk>() - this.indexBaseOffset > uint.MaxValue);
+
+            if (startSegment || flushIndex)
+            {
+                // Keep one super index entry for the standard index of the frames which are still to be written.
+                if (this.superIndexCount >= SuperIndexCapacity - 1)
+                {
+                    return false;
+                }
 
-            FramebufferUpdate framebufferUpdate = new FramebufferUpdate()
+                if (startSegment)
+                {
+                    await this.StartSegmentAsync(cancellationToken).ConfigureAwait(false);
+                }
+                else
+                {
+                    await this.FlushIndexAsync(cancellationToken).ConfigureAwait(false);
+                }
+            }
+
+            if (this.indexCount == 0)
+            {
+                this.indexBaseOffset = this.position;
+            }
+
+            this.index[this.indexCount++] = new AviStandardIndexEntry()
             {
-                MessageType = 0,
-                NumberOfRectangles = 2,
+                Offset = (uint)(this.position + Unsafe.SizeOf<Chunk>() - this.indexBaseOffset),
+                Size = (uint)size | (isKeyframe ? 0u : AviStandardIndexEntry.DeltaFrame),
             };
 
-            FramebufferUpdateRectangle rectangle = new FramebufferUpdateRectangle();
-            DisplayModeChange displayModeChange = new DisplayModeChange();
+            await this.WriteStructAsync(
+                new Chunk()
+                {
+                    FourCC = FourCC.Dc00,
+                    Size = size,
+                },
+                cancellationToken).ConfigureAwait(false);
+
+            await this.WriteAsync(this.frame.GetBuffer(), size, cancellationToken).ConfigureAwait(false);
+
+            // Chunks are aligned on word boundaries.
+            if ((size & 1) != 0)
+            {
+                await this.GrowAsync(1, cancellationToken).ConfigureAwait(false);
+            }
+
+            this.totalFrames++;
+            this.largestChunk = Math.Max(this.largestChunk, size);
+
+            if (this.segmentOffset == 0)
+            {
+                this.firstSegmentFrames++;
+            }
+
+            return true;
+        }
+
+        private async Task FlushIndexAsync(CancellationToken cancellationToken)
+        {
+            if (this.indexCount == 0)
+            {
+                return;
+            }
+
+            int entrySize = Unsafe.SizeOf<AviStandardIndexEntry>();
+            int size = Unsafe.SizeOf<AviStandardIndexChunk>() - Unsafe.SizeOf<Chunk>() + (this.indexCount * entrySize);
+            long offset = this.position;
+
+            await this.WriteStructAsync(
+                new AviStandardIndexChunk()
+                {
+                    FourCC = FourCC.Ix00,
+                    Size = size,
+                    LongsPerEntry = (short)(entrySize / 4),
+                    IndexType = IndexType.IndexOfChunks,
+                    IndexSubType = IndexSubType.None,
+                    EntriesInUse = this.indexCount,
+                    ChunkId = FourCC.Dc00,
+                    BaseOffset = this.indexBaseOffset,
+                },
+                cancellationToken).ConfigureAwait(false);
+
+            MemoryMarshal.AsBytes(this.index.AsSpan(0, this.indexCount)).CopyTo(this.indexBuffer);
+            await this.WriteAsync(this.indexBuffer, this.indexCount * entrySize, cancellationToken).ConfigureAwait(false);
 
-            Chunk dcChunk = new Chunk()
+            var entry = new AviSuperIndexEntry()
             {
-                FourCC = FourCC.Dc00,
-                Size =
-                    4
-                    + (2 * framebufferUpdate.Buffer.Length)
-                    + displayModeChange.Buffer.Length
-                    + (framebuffer.Stride * framebuffer.Width * framebuffer.PixelFormat.BytesPerPixel),
+                Offset = offset,
+                Size = size + Unsafe.SizeOf<Chunk>(),
+                Duration = this.indexCount,
             };
 
-            Stopwatch timer = new Stopwatch();
+            this.superIndex[this.superIndexCount++] = entry;
+            this.indexCount = 0;
 
-            while (!cancellationToken.IsCancellationRequested)
+            // Keep the super index up to date, so the file remains usable if the recording is interrupted.
+            if (this.stream.CanSeek)
             {
-                // Start a timer which will timeout after the timeframe allotted to each frame.
-                timer.Restart();
-                var interval = Task.Delay(this.MicrosecondsPerFrame / 1000, cancellationToken).ConfigureAwait(false);
-                framebuffer = this.framebufferSource.Capture();
+                await this.PatchAsync(this.superIndexOffset, this.CreateSuperIndexHeader(), cancellationToken).ConfigureAwait(false);
+                await this.PatchAsync(
+                    this.superIndexOffset + Unsafe.SizeOf<AviIndexChunck>() + ((this.superIndexCount - 1) * Unsafe.SizeOf<AviSuperIndexEntry>()),
+                    entry,
+                    cancellationToken).ConfigureAwait(false);
+            }
+        }
 
-                if (framebuffer == null)
+        private async Task StartSegmentAsync(CancellationToken cancellationToken)
+        {
+            await this.FlushIndexAsync(cancellationToken).ConfigureAwait(false);
+            await this.CompleteSegmentAsync(cancellationToken).ConfigureAwait(false);
+
+            this.segmentOffset = this.position;
+            await this.WriteStructAsync(
+                new List()
                 {
-                    break;
-                }
+                    ListType = FourCC.Riff,
+                    FourCC = FourCC.Avix,
+                },
+                cancellationToken).ConfigureAwait(false);
 
-                rectangle.Width = (ushort)framebuffer.Width;
-                rectangle.Height = (ushort)framebuffer.Height;
+            this.moviOffset = this.position;
+            await this.WriteStructAsync(
+                new List()
+                {
+                    ListType = FourCC.List,
+                    FourCC = FourCC.Movi,
+                },
+                cancellationToken).ConfigureAwait(false);
+        }
+
+        private async Task CompleteSegmentAsync(CancellationToken cancellationToken)
+        {
+            if (!this.stream.CanSeek)
+            {
+                return;
+            }
 
-                await stream.WriteStructAsync(dcChunk, cancellationToken).ConfigureAwait(false);
+            await this.PatchAsync(
+                this.segmentOffset,
+                new List()
+                {
+                    ListType = FourCC.Riff,
+                    FourCC = this.segmentOffset == 0 ? FourCC.Avi : FourCC.Avix,
+                    Size = (uint)(this.position - this.segmentOffset - 8),
+                },
+                cancellationToken).ConfigureAwait(false);
 
-                // Framebuffer update message, with 2 rectangles
-                await stream.WriteAsync(framebufferUpdate.Buffer, cancellationToken).ConfigureAwait(false);
+            await this.PatchAsync(
+                this.moviOffset,
+                new List()
+                {
+                    ListType = FourCC.List,
+                    FourCC = FourCC.Movi,
+                    Size = (uint)(this.position - this.moviOffset - 8),
+                },
+                cancellationToken).ConfigureAwait(false);
+        }
 
-                // Pseudo-rectangle: display mode change pseudo-encoding
-                rectangle.EncodingType = VncEncoding.VMWi;
-                await stream.WriteAsync(rectangle.Buffer, cancellationToken).ConfigureAwait(false);
-
-                displayModeChange.BitsPerSample = (byte)framebuffer.PixelFormat.BitsPerPixel;
-                displayModeChange.Depth = (byte)framebuffer.PixelFormat.BitDepth;
-                displayModeChange.MaxBlue = framebuffer.PixelFormat.BlueMax;
-                displayModeChange.MaxGreen = framebuffer.PixelFormat.GreenMax;
-                displayModeChange.MaxRed = framebuffer.PixelFormat.RedMax;
-                displayModeChange.BlueShift = (byte)framebuffer.PixelFormat.BlueShift;
-                displayModeChange.GreenShift = (byte)framebuffer.PixelFormat.GreenShift;
-                displayModeChange.RedShift = (byte)framebuffer.PixelFormat.RedShift;
-                displayModeChange.TrueColor = !framebuffer.PixelFormat.IsPalettized;
-                await stream.WriteAsync(displayModeChange.Buffer, cancellationToken).ConfigureAwait(false);
-
-                // Rectangle: framebuffer
-                rectangle.EncodingType = VncEncoding.Raw;
-                await stream.WriteAsync(rectangle.Buffer, cancellationToken).ConfigureAwait(false);
-
-                var rawFramebuffer = framebuffer.GetBuffer();
-                await stream.WriteAsync(rawFramebuffer, 0, rawFramebuffer.Length, cancellationToken).ConfigureAwait(false);
-                Debug.WriteLine($"Completed in {timer.ElapsedMilliseconds} ms out of allowed {this.MicrosecondsPerFrame / 1000} ms");
+        private async Task CompleteAsync(CancellationToken cancellationToken)
+        {
+            await this.FlushIndexAsync(cancellationToken).ConfigureAwait(false);
 
-                // Wait for the timer to complete.
-                await interval;
+            if (this.stream.CanSeek)
+            {
+                await this.CompleteSegmentAsync(cancellationToken).ConfigureAwait(false);
+                await this.PatchAsync(this.mainHeaderOffset, this.CreateMainHeader(), cancellationToken).ConfigureAwait(false);
+                await this.PatchAsync(this.streamHeaderOffset, this.CreateStreamHeader(), cancellationToken).ConfigureAwait(false);
+                await this.PatchAsync(this.extendedHeaderOffset, this.totalFrames, cancellationToken).ConfigureAwait(false);
             }
+
+            await this.stream.FlushAsync(cancellationToken).ConfigureAwait(false);
+
+            this.stream = null;
+            this.cache = null;
+            this.encoder = null;
+        }
+
+        private async Task PatchAsync<T>(long offset, T value, CancellationToken cancellationToken)
+            where T : struct
+        {
+            this.stream.Seek(this.start + offset, SeekOrigin.Begin);
+            await this.stream.WriteStructAsync(value, cancellationToken).ConfigureAwait(false);
+            this.stream.Seek(this.start + this.position, SeekOrigin.Begin);
+        }
+
+        private async Task WriteStructAsync<T>(T value, CancellationToken cancellationToken)
+            where T : struct
+        {
+            await this.stream.WriteStructAsync(value, cancellationToken).ConfigureAwait(false);
+            this.position += Unsafe.SizeOf<T>();
+        }
+
+        private async Task WriteAsync(byte[] buffer, int count, CancellationToken cancellationToken)
+        {
+            await this.stream.WriteAsync(buffer, 0, count, cancellationToken).ConfigureAwait(false);
+            this.position += count;
+        }
+
+        private async Task GrowAsync(int count, CancellationToken cancellationToken)
+        {
+            await this.stream.GrowAsync(count, cancellationToken).ConfigureAwait(false);
+            this.position += count;
         }
     }
 }
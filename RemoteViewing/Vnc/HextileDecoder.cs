@@ -0,0 +1,158 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Decodes rectangles which have been encoded using the Hextile encoding.
+    /// </summary>
+    /// <remarks>
+    /// The rectangle is divided in 16x16 tiles. Each tile is either sent raw, or as a background color with a number of
+    /// single-colored subrectangles. The background and foreground colors carry over from one tile to the next.
+    /// </remarks>
+    /// <seealso href="https://github.com/rfbproto/rfbproto/blob/master/rfbproto.rst#hextile-encoding"/>
+    internal sealed class HextileDecoder
+    {
+        /// <summary>
+        /// The width and height of a tile.
+        /// </summary>
+        internal const int TileSize = 16;
+
+        private readonly byte[] background = new byte[4];
+        private readonly byte[] foreground = new byte[4];
+        private readonly byte[] color = new byte[4];
+        private byte[] pixels = new byte[0];
+
+        /// <summary>
+        /// Receives and decodes a rectangle.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="VncStream"/> from which to read the rectangle.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format of the framebuffer.
+        /// </param>
+        /// <param name="width">
+        /// The width of the rectangle.
+        /// </param>
+        /// <param name="height">
+        /// The height of the rectangle.
+        /// </param>
+        /// <returns>
+        /// A buffer which holds the pixels of the rectangle, in the framebuffer pixel format. The buffer is reused
+        /// by the next call to this method.
+        /// </returns>
+        public byte[] Decode(VncStream stream, VncPixelFormat pixelFormat, int width, int height)
+        {
+            int bpp = pixelFormat.BytesPerPixel;
+            int stride = width * bpp;
+            var pixels = VncUtility.AllocateScratch(VncUtility.GetRectangleSize(width, height, bpp), ref this.pixels);
+
+            Array.Clear(this.background, 0, this.background.Length);
+            Array.Clear(this.foreground, 0, this.foreground.Length);
+
+            for (int ty = 0; ty < height; ty += TileSize)
+            {
+                int th = Math.Min(TileSize, height - ty);
+                for (int tx = 0; tx < width; tx += TileSize)
+                {
+                    int tw = Math.Min(TileSize, width - tx);
+                    int tileOffset = (ty * stride) + (tx * bpp);
+
+                    var subencoding = stream.ReceiveByte();
+
+                    if ((subencoding & 1) != 0)
+                    {
+                        // raw
+                        for (int y = 0; y < th; y++)
+                        {
+                            stream.Receive(pixels, tileOffset + (y * stride), tw * bpp);
+                        }
+
+                        continue;
+                    }
+
+                    if ((subencoding & 2) != 0)
+                    {
+                        stream.Receive(this.background, 0, bpp);
+                    }
+
+                    if ((subencoding & 4) != 0)
+                    {
+                        stream.Receive(this.foreground, 0, bpp);
+                    }
+
+                    Fill(pixels, tileOffset, stride, bpp, this.background, 0, 0, tw, th);
+
+                    int nsubrects = (subencoding & 8) != 0 ? stream.ReceiveByte() : 0;
+                    var subrectsColored = (subencoding & 16) != 0;
+                    for (int subrect = 0; subrect < nsubrects; subrect++)
+                    {
+                        var color = this.foreground;
+
+                        if (subrectsColored)
+                        {
+                            color = this.color;
+                            stream.Receive(color, 0, bpp);
+                        }
+
+                        var srxy = stream.ReceiveByte();
+                        var srwh = stream.ReceiveByte();
+                        int srx = (srxy >> 4) & 0xf, srw = ((srwh >> 4) & 0xf) + 1;
+                        int sry = (srxy >> 0) & 0xf, srh = ((srwh >> 0) & 0xf) + 1;
+                        if (srx + srw > tw || sry + srh > th)
+                        {
+                            continue;
+                        }
+
+                        Fill(pixels, tileOffset, stride, bpp, color, srx, sry, srw, srh);
+                    }
+                }
+            }
+
+            return pixels;
+        }
+
+        private static void Fill(byte[] pixels, int offset, int stride, int bpp, byte[] color, int x, int y, int width, int height)
+        {
+            for (int py = 0; py < height; py++)
+            {
+                int off = offset + ((py + y) * stride) + (x * bpp);
+                for (int px = 0; px < width; px++)
+                {
+                    for (int pe = 0; pe < bpp; pe++)
+                    {
+                        pixels[off++] = color[pe];
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// A framebuffer source which provides the shape of the cursor separately from the framebuffer.
+    /// </summary>
+    /// <remarks>
+    /// Sources which implement this interface should not draw the cursor into the framebuffer. The VNC server sends the
+    /// cursor shape to clients which support the cursor pseudo-encodings, which then draw the cursor themselves; moving
+    /// the pointer then no longer changes the framebuffer. For other clients, the server draws the cursor into the
+    /// framebuffer updates it sends, at the position of the pointer of that client.
+    /// </remarks>
+    public interface IVncCursorSource : IVncFramebufferSource
+    {
+        /// <summary>
+        /// Gets the current cursor, or <see langword="null"/> if the source doesn't know the cursor, in which case
+        /// the cursor of the session is left unchanged. When the shape of the cursor changes, the source must return
+        /// a new <see cref="VncCursor"/> instance; use <see cref="VncCursor.Hidden"/> to hide the cursor.
+        /// </summary>
+        VncCursor Cursor { get; }
+    }
+}
@@ -0,0 +1,74 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System.Collections.Generic;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// A framebuffer source which knows which regions of the framebuffer have changed.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// Consumers which keep a copy of the framebuffer (such as the framebuffer caches of the VNC server) normally have
+    /// to compare every pixel to find out what has changed. When the source implements this interface, they only
+    /// compare the regions which the source reports as damaged, and skip the comparison altogether when the
+    /// <see cref="FrameSequence"/> hasn't changed.
+    /// </para>
+    /// <para>
+    /// Sources must update the framebuffer and the damage information while holding the <see cref="VncFramebuffer.SyncRoot"/>
+    /// of the framebuffer, and consumers read both while holding that lock. <see cref="VncDamageHistory"/> implements the
+    /// bookkeeping for sources.
+    /// </para>
+    /// </remarks>
+    public interface IVncFramebufferDamageSource : IVncFramebufferSource
+    {
+        /// <summary>
+        /// Gets the sequence number of the current contents of the framebuffer. The sequence number increases each time
+        /// the contents of the framebuffer change, and remains the same as long as they don't.
+        /// </summary>
+        long FrameSequence { get; }
+
+        /// <summary>
+        /// Gets the regions of the framebuffer which have changed since an earlier <see cref="FrameSequence"/>.
+        /// </summary>
+        /// <param name="sequence">
+        /// A value of <see cref="FrameSequence"/> which was read earlier.
+        /// </param>
+        /// <param name="damage">
+        /// A collection to which the regions which have changed are added. The regions may overlap, and may cover
+        /// pixels which have not actually changed.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the regions which have changed are known; <see langword="false"/> if the
+        /// source no longer knows which regions have changed since <paramref name="sequence"/>, in which case
+        /// the entire framebuffer must be considered to have changed.
+        /// </returns>
+        bool TryGetDamage(long sequence, ICollection<VncRectangle> damage);
+    }
+}
@@ -26,29 +26,117 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #endregion
 
+using System;
+using System.Diagnostics;
+using System.Threading;
+
 namespace RemoteViewing.Vnc.Server
 {
     /// <summary>
     /// Tracks the performance of an individual encoder.
     /// </summary>
+    /// <remarks>
+    /// The counters can be updated by multiple threads at once, without taking a lock.
+    /// </remarks>
     public class EncoderStatistics
     {
+        private readonly VncEncoding? encoding;
+        private long rectangles;
+        private long rawBytes;
+        private long encodedBytes;
+        private long encodeTicks;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="EncoderStatistics"/> class.
+        /// </summary>
+        public EncoderStatistics()
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="EncoderStatistics"/> class, which also reports
+        /// the transfers to <see cref="VncServerEventSource"/>.
+        /// </summary>
+        /// <param name="encoding">
+        /// The encoding for which statistics are being tracked.
+        /// </param>
+        internal EncoderStatistics(VncEncoding encoding)
+        {
+            this.encoding = encoding;
+        }
+
         /// <summary>
         /// Gets or sets the total amount of rectangles transferred.
         /// </summary>
         public uint Rectangles
-        { get; set; }
+        {
+            get { return (uint)Interlocked.Read(ref this.rectangles); }
+            set { Interlocked.Exchange(ref this.rectangles, value); }
+        }
 
         /// <summary>
         /// Gets or sets the total number of bytes transferred, in raw format.
         /// </summary>
         public ulong RawBytes
-        { get; set; }
+        {
+            get { return (ulong)Interlocked.Read(ref this.rawBytes); }
+            set { Interlocked.Exchange(ref this.rawBytes, (long)value); }
+        }
 
         /// <summary>
         /// Gets or sets the total number of bytes transferred, in encoded format.
         /// </summary>
         public ulong EncodedBytes
-        { get; set; }
+        {
+            get { return (ulong)Interlocked.Read(ref this.encodedBytes); }
+            set { Interlocked.Exchange(ref this.encodedBytes, (long)value); }
+        }
+
+        /// <summary>
+        /// Gets or sets the total amount of time spent encoding rectangles.
+        /// </summary>
+        public TimeSpan EncodeTime
+        {
+            get { return TimeSpan.FromSeconds(Interlocked.Read(ref this.encodeTicks) / (double)Stopwatch.Frequency); }
+            set { Interlocked.Exchange(ref this.encodeTicks, (long)(value.TotalSeconds * Stopwatch.Frequency)); }
+        }
+
+        /// <summary>
+        /// Records the transfer of a rectangle.
+        /// </summary>
+        /// <param name="rawLength">
+        /// The size of the rectangle, in raw format.
+        /// </param>
+        /// <param name="encodedLength">
+        /// The size of the rectangle, in encoded format.
+        /// </param>
+        internal void AddTransfer(int rawLength, int encodedLength)
+        {
+            Interlocked.Increment(ref this.rectangles);
+            Interlocked.Add(ref this.rawBytes, rawLength);
+            Interlocked.Add(ref this.encodedBytes, encodedLength);
+
+            if (this.encoding != null)
+            {
+                VncServerEventSource.Instance.AddRectangle(this.encoding.Value, encodedLength);
+            }
+        }
+
+        /// <summary>
+        /// Records the time spent encoding a rectangle.
+        /// </summary>
+        /// <param name="startTimestamp">
+        /// The <see cref="Stopwatch"/> timestamp at which encoding started.
+        /// </param>
+        internal void AddEncodeTime(long startTimestamp)
+        {
+            var elapsed = Stopwatch.GetTimestamp() - startTimestamp;
+            Interlocked.Add(ref this.encodeTicks, elapsed);
+
+            if (this.encoding != null)
+            {
+                VncServerEventSource.Instance.AddEncodeDuration(this.encoding.Value, elapsed * 1000.0 / Stopwatch.Frequency);
+            }
+        }
     }
 }
@@ -136,6 +136,23 @@ namespace RemoteViewing.Vnc.Server
         /// </remarks>
         void FramebufferManualBeginUpdate();
 
+        /// <summary>
+        /// Queues an update corresponding to one region of the framebuffer being copied to another.
+        /// </summary>
+        /// <param name="target">
+        /// The updated <see cref="VncRectangle"/>.
+        /// </param>
+        /// <param name="sourceX">
+        /// The X coordinate of the source.
+        /// </param>
+        /// <param name="sourceY">
+        /// The Y coordinate of the source.
+        /// </param>
+        /// <remarks>
+        /// Do not call this method without holding <see cref="IVncServerSession.FramebufferUpdateRequestLock"/>.
+        /// </remarks>
+        void FramebufferManualCopyRegion(VncRectangle target, int sourceX, int sourceY);
+
         /// <summary>
         /// Queues an update for the specified region.
         /// </summary>
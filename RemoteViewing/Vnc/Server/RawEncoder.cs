@@ -27,6 +27,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #endregion
 
+using RemoteViewing.Utility;
+using System;
 using System.IO;
 
 namespace RemoteViewing.Vnc.Server
@@ -51,5 +53,12 @@ namespace RemoteViewing.Vnc.Server
             stream.Write(contents, 0, contents.Length);
             return contents.Length;
         }
+
+        /// <inheritdoc/>
+        public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            stream.Write(contents);
+            return contents.Length;
+        }
     }
 }
@@ -54,7 +54,7 @@ namespace RemoteViewing.Vnc.Server
         /// <summary>
         /// Informs the client zlib compression stream at index 3 should be reset before decoding the rectangle.
         /// </summary>
-        ResetStream3 = 0b_10100,
+        ResetStream3 = 0b_1000,
 
         /// <summary>
         /// Informs the client zlib compression stream at index 0 should be used to decode the rectangle.
@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #endregion
 
+using RemoteViewing.Utility;
 using SharpCompress.Compressors;
 using SharpCompress.Compressors.Deflate;
 using System;
@@ -34,6 +35,12 @@ using System.Diagnostics;
 using System.Drawing.Imaging;
 using System.IO;
 using System.Linq;
+#if NET5_0_OR_GREATER
+using System.Runtime.CompilerServices;
+using System.Runtime.Intrinsics;
+using System.Runtime.Intrinsics.Arm;
+using System.Runtime.Intrinsics.X86;
+#endif
 using TurboJpegWrapper;
 
 namespace RemoteViewing.Vnc.Server
@@ -43,24 +50,116 @@ namespace RemoteViewing.Vnc.Server
     /// JPEG compression or fill compression, and optionally applying filters to the raw pixel data.
     /// </summary>
     /// <remarks>
-    /// The <see cref="TightEncoder"/> currently only implements zlib compression over a single zlib stream,
-    /// which is reset after every rectangle.
+    /// Each rectangle is classified in a single pass over the pixel data, which counts the number of colors and
+    /// estimates how smooth the image is. Solid rectangles are sent using fill compression, rectangles with few colors
+    /// using the palette filter, photo-like rectangles using JPEG compression (when enabled), and smooth rectangles
+    /// using the gradient filter. All other rectangles are sent using basic compression of the unfiltered data.
     /// </remarks>
     /// <seealso href="https://github.com/rfbproto/rfbproto/blob/master/rfbproto.rst#tight-encoding"/>
     /// <seealso href="https://virtualgl.org/pmwiki/uploads/About/tighttoturbo.pdf"/>
     public class TightEncoder : VncEncoder
     {
+        /// <summary>
+        /// The zlib stream used to compress full-color (unfiltered) pixel data. As in the TightVNC server,
+        /// streams 1 and 2 are reserved for palette-filtered data, and stream 3 for gradient-filtered data.
+        /// </summary>
+        protected const int FullColorStream = 0;
+
+        /// <summary>
+        /// The zlib stream used to compress data using the palette filter with two colors.
+        /// </summary>
+        protected const int MonoPaletteStream = 1;
+
+        /// <summary>
+        /// The zlib stream used to compress data using the palette filter with more than two colors.
+        /// </summary>
+        protected const int IndexedPaletteStream = 2;
+
+        /// <summary>
+        /// The zlib stream used to compress data using the gradient filter.
+        /// </summary>
+        protected const int GradientStream = 3;
+
+        /// <summary>
+        /// Data which is smaller than this size is sent as is, without compression.
+        /// </summary>
+        private const int MinimumCompressionSize = 12;
+
+        /// <summary>
+        /// The maximum number of colors in a palette.
+        /// </summary>
+        private const int MaximumPaletteSize = 256;
+
+        /// <summary>
+        /// The maximum number of colors in a palette when JPEG compression is enabled. Rectangles with more colors
+        /// are considered to be photo-like, and are compressed using JPEG.
+        /// </summary>
+        private const int MaximumJpegPaletteSize = 24;
+
+        /// <summary>
+        /// The size of the hash table used to look up palette indices. Must be a power of two, and larger
+        /// than <see cref="MaximumPaletteSize"/>.
+        /// </summary>
+        private const int PaletteHashSize = 1024;
+
+        /// <summary>
+        /// Images in which the average prediction error of the gradient filter, summed over all color components,
+        /// is less than this value are considered to be smooth, and are compressed using the gradient filter.
+        /// </summary>
+        private const int SmoothnessThreshold = 16;
+
         /// <summary>
         /// Mapping of Tight quality levels to JPEG quality levels.
         /// </summary>
         /// <seealso href=""/>
         private static readonly int[] QualityLevels = new int[] { 5, 10, 15, 25, 37, 50, 60, 70, 75, 80, 0 };
 
+        /// <summary>
+        /// The filter ID which is sent before rectangles which use the gradient filter.
+        /// </summary>
+        private static readonly byte[] GradientFilterId = new byte[] { (byte)TightFilter.Gradient };
+
         /// <summary>
         /// The TurboJpeg compressor which will be used to compress rectangles into JPEG format.
         /// </summary>
         private readonly TJCompressor compressor = new TJCompressor();
 
+        /// <summary>
+        /// The zlib streams used for basic compression. The Tight protocol allows for four zlib streams, which
+        /// are kept alive for the duration of the session.
+        /// </summary>
+        private readonly ZlibStream[] zlibStreams = new ZlibStream[4];
+
+        /// <summary>
+        /// The buffers which receive the output of the zlib streams.
+        /// </summary>
+        private readonly MemoryStream[] zlibBuffers = new MemoryStream[4];
+
+        /// <summary>
+        /// The compression level of each zlib stream.
+        /// </summary>
+        private readonly CompressionLevel[] zlibLevels = new CompressionLevel[4];
+
+        /// <summary>
+        /// A buffer which holds the compression control byte, the filter and the length of the compressed data.
+        /// </summary>
+        private readonly byte[] header = new byte[1 + 2 + (4 * MaximumPaletteSize) + 4];
+
+        /// <summary>
+        /// The colors in the palette of the current rectangle.
+        /// </summary>
+        private readonly uint[] palette = new uint[MaximumPaletteSize];
+
+        /// <summary>
+        /// A hash table which maps colors to their index in <see cref="palette"/>.
+        /// </summary>
+        private readonly uint[] paletteHashColors = new uint[PaletteHashSize];
+
+        /// <summary>
+        /// The index + 1 of the colors in <see cref="paletteHashColors"/>, or 0 for empty entries.
+        /// </summary>
+        private readonly short[] paletteHashIndices = new short[PaletteHashSize];
+
         /// <summary>
         /// Initializes a new instance of the <see cref="TightEncoder"/> class.
         /// </summary>
@@ -75,12 +174,28 @@ namespace RemoteViewing.Vnc.Server
         /// <inheritdoc/>
         public override VncEncoding Encoding => VncEncoding.Tight;
 
+        /// <inheritdoc/>
+        /// <remarks>
+        /// The width of any Tight-encoded rectangle cannot exceed 2048 pixels.
+        /// </remarks>
+        public override int MaximumRectangleWidth => 2048;
+
+        /// <inheritdoc/>
+        public override int MaximumRectangleArea => 65536;
+
         /// <summary>
         /// Gets or sets the compression method used.
         /// </summary>
         public TightCompression Compression
         { get; set; } = TightCompression.Jpeg;
 
+        /// <summary>
+        /// Gets or sets the <see cref="VncQualityController"/> which adapts the JPEG quality level to the
+        /// connection, if any.
+        /// </summary>
+        internal VncQualityController QualityController
+        { get; set; }
+
         /// <summary>
         /// Gets the <see cref="VncServerSession"/> to which this <see cref="TightEncoder"/> is linked.
         /// </summary>
@@ -137,24 +252,284 @@ namespace RemoteViewing.Vnc.Server
         /// <inheritdoc/>
         public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, byte[] contents)
         {
-            var jpegQualityLevel = GetQualityLevel(this.VncServerSession);
+            return this.Send(stream, pixelFormat, region, new ReadOnlySpan<byte>(contents));
+        }
 
-            // The JPEG compression currently assumes a RGB32 pixel format, fall back to basic compression
-            // when this pixel format is not available.
-            // Additionally, a minimal JPEG image is at least ~128 bytes in size, so only compress to JPEG
-            // when the uncompressed file significantly larger.
-            if (this.Compression != TightCompression.Jpeg
-                || !VncPixelFormat.RGB32.Equals(pixelFormat)
-                || region.IsEmpty
-                || contents.Length < 256
-                || jpegQualityLevel == 0)
+        /// <inheritdoc/>
+        public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            return this.Send(stream, pixelFormat, region, contents, independent: false);
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// Each worker has its own JPEG compressor. The settings of this encoder are copied when the worker is created.
+        /// </remarks>
+        public override VncEncoder CreateWorker()
+        {
+            return new TightEncoder(this.VncServerSession)
+            {
+                Compression = this.Compression,
+                QualityController = this.QualityController,
+            };
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// Rectangles which are sent using fill or JPEG compression don't use the zlib streams, and can be sent
+        /// independently.
+        /// </remarks>
+        public override bool TrySendIndependently(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            return this.Send(stream, pixelFormat, region, contents, independent: true) >= 0;
+        }
+
+        /// <inheritdoc/>
+        /// <remarks>
+        /// The output of <see cref="TrySendIndependently(Stream, VncPixelFormat, VncRectangle, ReadOnlySpan{byte})"/>
+        /// depends on the JPEG quality level and chroma subsampling, if JPEG compression is used for the rectangle.
+        /// </remarks>
+        public override int? GetIndependentEncodingKey(VncPixelFormat pixelFormat, VncRectangle region)
+        {
+            this.GetJpegSettings(out int jpegQualityLevel, out TJSubsamplingOption subsamplingOption);
+
+            if (!this.UseJpegCompression(pixelFormat, region, region.Width * region.Height * pixelFormat.BytesPerPixel, jpegQualityLevel))
             {
-                return this.SendWithBasicCompression(stream, pixelFormat, region, contents);
+                // Only fill compression can be used, which doesn't depend on any setting.
+                return 0;
             }
-            else
+
+            return (jpegQualityLevel << 8) | ((int)subsamplingOption + 1);
+        }
+
+        /// <summary>
+        /// Gets the JPEG quality level requested by the client.
+        /// </summary>
+        /// <param name="vncServerSession">
+        /// The current VNC server session.
+        /// </param>
+        /// <returns>
+        /// The quality level requested by the client, ranging from 0 to 9, or <see langword="null"/> if the
+        /// client didn't request JPEG compression.
+        /// </returns>
+        internal static int? GetRequestedQualityLevel(IVncServerSession vncServerSession)
+        {
+            var level = GetLevel(vncServerSession, VncEncoding.TightQualityLevel0, VncEncoding.TightQualityLevel9, 10);
+            return level < 10 ? level : (int?)null;
+        }
+
+        /// <summary>
+        /// Gets the chroma subsampling to use for a JPEG quality level. Like other VNC servers, chroma is
+        /// subsampled more aggressively at lower quality levels.
+        /// </summary>
+        /// <param name="qualityLevel">
+        /// The quality level, ranging from 0 to 9.
+        /// </param>
+        /// <returns>
+        /// The chroma subsampling to use.
+        /// </returns>
+        internal static TJSubsamplingOption GetSubsampling(int qualityLevel)
+        {
+            return qualityLevel < 3 ? TJSubsamplingOption.Chrominance420
+                : qualityLevel < 6 ? TJSubsamplingOption.Chrominance422
+                : TJSubsamplingOption.Chrominance444;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether a pixel format can be represented using 3-byte Tight pixels (TPIXEL).
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The pixel format.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if rectangles should be sent as TPIXELs; otherwise, <see langword="false"/>.
+        /// </returns>
+        internal static bool IsTightPixelFormat(VncPixelFormat pixelFormat)
+        {
+            // The Tight encoding makes use of a new type TPIXEL (Tight pixel). This is the same as a PIXEL for the agreed
+            // pixel format, except where true-colour-flag is non-zero, bits-per-pixel is 32, depth is 24 and all of the bits
+            // making up the red, green and blue intensities are exactly 8 bits wide.
+            return pixelFormat.BitsPerPixel == 32
+                && pixelFormat.BitDepth == 24
+                && pixelFormat.BlueBits == 8
+                && pixelFormat.RedBits == 8
+                && pixelFormat.GreenBits == 8
+                && !pixelFormat.IsPalettized;
+        }
+
+        /// <summary>
+        /// Gets the offsets of the red, green and blue components within a 32-bit pixel which can be represented
+        /// using a Tight pixel (TPIXEL).
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The pixel format.
+        /// </param>
+        /// <param name="redOffset">
+        /// When this method returns, the offset of the red component, in bytes.
+        /// </param>
+        /// <param name="greenOffset">
+        /// When this method returns, the offset of the green component, in bytes.
+        /// </param>
+        /// <param name="blueOffset">
+        /// When this method returns, the offset of the blue component, in bytes.
+        /// </param>
+        internal static void GetTightPixelOffsets(VncPixelFormat pixelFormat, out int redOffset, out int greenOffset, out int blueOffset)
+        {
+            redOffset = pixelFormat.RedShift / 8;
+            greenOffset = pixelFormat.GreenShift / 8;
+            blueOffset = pixelFormat.BlueShift / 8;
+
+            if (!pixelFormat.IsLittleEndian)
+            {
+                redOffset = 3 - redOffset;
+                greenOffset = 3 - greenOffset;
+                blueOffset = 3 - blueOffset;
+            }
+        }
+
+        /// <summary>
+        /// Converts 32-bit pixels to 3-byte Tight pixels (TPIXEL), where the first byte is the red component,
+        /// the second byte is the green component, and the third byte is the blue component of the pixel color value.
+        /// </summary>
+        /// <param name="source">
+        /// The 32-bit pixels to convert.
+        /// </param>
+        /// <param name="target">
+        /// A buffer which receives the TPIXELs. When SIMD instructions are available, this method uses 16-byte
+        /// stores, so this buffer should be 16 bytes larger than the packed data to get the most benefit.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format of <paramref name="source"/>.
+        /// </param>
+        internal static unsafe void PackTightPixels(ReadOnlySpan<byte> source, Span<byte> target, VncPixelFormat pixelFormat)
+        {
+            GetTightPixelOffsets(pixelFormat, out int redOffset, out int greenOffset, out int blueOffset);
+
+            int pixels = source.Length / 4;
+            int i = 0;
+
+            if (target.Length < 3 * pixels)
+            {
+                throw new ArgumentOutOfRangeException(nameof(target));
+            }
+
+            fixed (byte* src = source)
+            fixed (byte* dst = target)
+            {
+#if NET5_0_OR_GREATER
+                if (Ssse3.IsSupported || AdvSimd.Arm64.IsSupported)
+                {
+                    // Shuffle 4 pixels (16 bytes) into 4 TPIXELs (12 bytes) at a time; the last 4 bytes are cleared,
+                    // and overwritten by the next iteration.
+                    var mask = Vector128.Create(
+                        (byte)redOffset,
+                        (byte)greenOffset,
+                        (byte)blueOffset,
+                        (byte)(4 + redOffset),
+                        (byte)(4 + greenOffset),
+                        (byte)(4 + blueOffset),
+                        (byte)(8 + redOffset),
+                        (byte)(8 + greenOffset),
+                        (byte)(8 + blueOffset),
+                        (byte)(12 + redOffset),
+                        (byte)(12 + greenOffset),
+                        (byte)(12 + blueOffset),
+                        0x80,
+                        0x80,
+                        0x80,
+                        0x80);
+
+                    for (; i + 4 <= pixels && (3 * i) + 16 <= target.Length; i += 4)
+                    {
+                        var value = Unsafe.ReadUnaligned<Vector128<byte>>(src + (4 * i));
+
+                        var packed = Ssse3.IsSupported
+                            ? Ssse3.Shuffle(value, mask)
+                            : AdvSimd.Arm64.VectorTableLookup(value, mask);
+
+                        Unsafe.WriteUnaligned(dst + (3 * i), packed);
+                    }
+                }
+#endif
+
+                for (; i < pixels; i++)
+                {
+                    dst[3 * i] = src[(4 * i) + redOffset];
+                    dst[(3 * i) + 1] = src[(4 * i) + greenOffset];
+                    dst[(3 * i) + 2] = src[(4 * i) + blueOffset];
+                }
+            }
+        }
+
+        /// <summary>
+        /// Writes the compression control byte, the filter and the (optionally compressed) data of a rectangle to the client.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> which represents connectivity with the client.
+        /// </param>
+        /// <param name="streamId">
+        /// The index of the zlib stream to use, between 0 and 3.
+        /// </param>
+        /// <param name="compressionControl">
+        /// The compression control flags to send. The flags which select and reset the zlib stream
+        /// are added by this method.
+        /// </param>
+        /// <param name="filter">
+        /// The filter id and parameters, if <see cref="TightCompressionControl.ReadFilterId"/> is set; or empty.
+        /// </param>
+        /// <param name="data">
+        /// The data to send, after a filter has been applied.
+        /// </param>
+        /// <returns>
+        /// The total number of bytes written to the wire.
+        /// </returns>
+        internal int SendBasicData(Stream stream, int streamId, TightCompressionControl compressionControl, ReadOnlySpan<byte> filter, ReadOnlySpan<byte> data)
+        {
+            compressionControl |= (TightCompressionControl)(streamId << 4);
+
+            if (data.Length < MinimumCompressionSize)
             {
-                return this.SendWithJpegCompression(stream, pixelFormat, region, contents, jpegQualityLevel);
+                // If the data size after applying the filter but before the compression is less then 12,
+                // then the data is sent as is, uncompressed, and without a length.
+                this.header[0] = (byte)compressionControl;
+                filter.CopyTo(this.header.AsSpan(1));
+                stream.Write(this.header, 0, 1 + filter.Length);
+                stream.Write(data);
+                return 1 + filter.Length + data.Length;
             }
+
+            var compressionLevel = GetCompressionLevel(this.VncServerSession);
+
+            // The client keeps the zlib streams alive for the duration of the session, so that the dictionary built
+            // for previous rectangles can be used to compress the next ones. A stream is only reset when it hasn't
+            // been used before, or when the client has requested a different compression level.
+            if (this.zlibStreams[streamId] == null || this.zlibLevels[streamId] != compressionLevel)
+            {
+                // Disposing of the old stream releases its deflater, and closes the buffer it writes to.
+                this.zlibStreams[streamId]?.Dispose();
+
+                this.zlibBuffers[streamId] = new MemoryStream();
+                this.zlibStreams[streamId] = new ZlibStream(this.zlibBuffers[streamId], CompressionMode.Compress, compressionLevel);
+                this.zlibLevels[streamId] = compressionLevel;
+
+                compressionControl |= (TightCompressionControl)(1 << streamId);
+            }
+
+            var buffer = this.zlibBuffers[streamId];
+            var deflater = this.zlibStreams[streamId];
+
+            // A sync flush makes sure the client can decode all data of this rectangle, without resetting the stream.
+            buffer.SetLength(0);
+            deflater.FlushMode = FlushType.Sync;
+            deflater.Write(data);
+
+            this.header[0] = (byte)compressionControl;
+            filter.CopyTo(this.header.AsSpan(1));
+            var length = WriteEncodedValue(this.header, 1 + filter.Length, (int)buffer.Length);
+            stream.Write(this.header, 0, length);
+            stream.Write(buffer.GetBuffer(), 0, (int)buffer.Length);
+
+            return length + (int)buffer.Length;
         }
 
         /// <summary>
@@ -175,10 +550,34 @@ namespace RemoteViewing.Vnc.Server
         /// <param name="jpegQualityLevel">
         /// The JPEG quality level to use.
         /// </param>
-        protected int SendWithJpegCompression(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, byte[] contents, int jpegQualityLevel)
+        protected int SendWithJpegCompression(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents, int jpegQualityLevel)
         {
-            var subsamplingOption = TJSubsamplingOption.Chrominance420;
+            return this.SendWithJpegCompression(stream, pixelFormat, region, contents, jpegQualityLevel, TJSubsamplingOption.Chrominance420);
+        }
 
+        /// <summary>
+        /// Sends a rectangle using JPEG compression.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> which represents connectivity with the client.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format to use. This must be <see cref="VncPixelFormat.RGB32"/>.
+        /// </param>
+        /// <param name="region">
+        /// The rectangle to send.
+        /// </param>
+        /// <param name="contents">
+        /// A buffer holding the raw pixel data for the rectangle.
+        /// </param>
+        /// <param name="jpegQualityLevel">
+        /// The JPEG quality level to use.
+        /// </param>
+        /// <param name="subsamplingOption">
+        /// The chroma subsampling to use.
+        /// </param>
+        protected unsafe int SendWithJpegCompression(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents, int jpegQualityLevel, TJSubsamplingOption subsamplingOption)
+        {
             var size = this.compressor.GetBufferSize(region.Width, region.Height, subsamplingOption) + 5;
 
             byte[] buffer = null;
@@ -189,18 +588,22 @@ namespace RemoteViewing.Vnc.Server
                 // JPEG buffer.
                 buffer = ArrayPool<byte>.Shared.Rent(size);
 
-                var qualityLevel = GetQualityLevel(this.VncServerSession);
+                Span<byte> jpeg;
 
-                var jpeg = this.compressor.Compress(
-                    contents.AsSpan(),
-                    buffer.AsSpan(5),
-                    0, /* auto-calculate pitch */
-                    region.Width,
-                    region.Height,
-                    TJPixelFormat.BGRA,
-                    subsamplingOption,
-                    jpegQualityLevel,
-                    TJFlags.NoRealloc);
+                // TurboJpeg doesn't modify the source buffer, but requires a writable span.
+                fixed (byte* source = contents)
+                {
+                    jpeg = this.compressor.Compress(
+                        new Span<byte>(source, contents.Length),
+                        buffer.AsSpan(5),
+                        0, /* auto-calculate pitch */
+                        region.Width,
+                        region.Height,
+                        TJPixelFormat.BGRA,
+                        subsamplingOption,
+                        jpegQualityLevel,
+                        TJFlags.NoRealloc);
+                }
 
                 // Write the JPEG compression control byte and the size of the JPEG buffer.
                 buffer[0] = (byte)TightCompressionControl.JpegCompression;
@@ -209,7 +612,7 @@ namespace RemoteViewing.Vnc.Server
                 stream.Write(buffer, 0, length);
                 stream.Write(buffer, 5, jpeg.Length);
 
-                return jpeg.Length + 5;
+                return length + jpeg.Length;
             }
             finally
             {
@@ -235,84 +638,210 @@ namespace RemoteViewing.Vnc.Server
         /// <param name="contents">
         /// A buffer holding the raw pixel data for the rectangle.
         /// </param>
-        protected int SendWithBasicCompression(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, byte[] contents)
+        /// <returns>
+        /// The total number of bytes written to the wire.
+        /// </returns>
+        protected int SendWithBasicCompression(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
         {
-            if (contents.Length < 12)
+            if (!IsTightPixelFormat(pixelFormat))
             {
-                var compressionControl = TightCompressionControl.BasicCompression;
-                stream.WriteByte((byte)compressionControl);
+                return this.SendBasicData(stream, FullColorStream, TightCompressionControl.BasicCompression, default, contents);
+            }
+
+            Debug.Assert(contents.Length % 4 == 0, "The size of the raw pixel data must be a multiple of 4 when using a 32bpp pixel format.");
 
-                // If the data size after applying the filter but before the compression is less then 12, then the data is sent as is, uncompressed.
-                byte[] encodedBuffer = new byte[4];
-                var length = WriteEncodedValue(encodedBuffer, 0, (int)contents.Length);
-                stream.Write(encodedBuffer, 0, length);
+            int pixels = contents.Length / 4;
 
-                stream.Write(contents, 0, contents.Length);
+            // Leave some room at the end of the buffer, so that PackTightPixels can use vector stores.
+            byte[] tpixels = ArrayPool<byte>.Shared.Rent((3 * pixels) + 16);
 
-                return 1 + length + contents.Length;
+            try
+            {
+                PackTightPixels(contents, tpixels, pixelFormat);
+                return this.SendBasicData(stream, FullColorStream, TightCompressionControl.BasicCompression, default, tpixels.AsSpan(0, 3 * pixels));
             }
-            else
+            finally
             {
-                var compressionControl = TightCompressionControl.BasicCompression
-                    | TightCompressionControl.ResetStream0
-                    | TightCompressionControl.UseStream0;
+                ArrayPool<byte>.Shared.Return(tpixels);
+            }
+        }
+
+        /// <summary>
+        /// Sends a rectangle which consists of a single color using fill compression.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> which represents connectivity with the client.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format to use.
+        /// </param>
+        /// <param name="color">
+        /// The color of the rectangle, as read by <see cref="ReadPixel(byte*, int)"/>.
+        /// </param>
+        /// <returns>
+        /// The total number of bytes written to the wire.
+        /// </returns>
+        protected int SendWithFillCompression(Stream stream, VncPixelFormat pixelFormat, uint color)
+        {
+            this.header[0] = (byte)TightCompressionControl.FillCompression;
+            int length = 1 + WritePixel(this.header, 1, color, pixelFormat);
+            stream.Write(this.header, 0, length);
+            return length;
+        }
+
+        /// <summary>
+        /// Sends a rectangle using the palette filter. The palette must have been collected by
+        /// <see cref="Classify(byte*, VncPixelFormat, VncRectangle, int, bool, out int, out bool)"/>.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> which represents connectivity with the client.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format to use.
+        /// </param>
+        /// <param name="region">
+        /// The rectangle to send.
+        /// </param>
+        /// <param name="contents">
+        /// A buffer holding the raw pixel data for the rectangle.
+        /// </param>
+        /// <param name="paletteSize">
+        /// The number of colors in the palette.
+        /// </param>
+        /// <returns>
+        /// The total number of bytes written to the wire.
+        /// </returns>
+        protected unsafe int SendWithPaletteFilter(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents, int paletteSize)
+        {
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            uint mask = GetColorMask(pixelFormat);
 
-                var compressionLevel = GetCompressionLevel(this.VncServerSession);
+            // The palette is sent as part of the filter parameters: the number of colors - 1, followed by the colors.
+            byte[] filter = ArrayPool<byte>.Shared.Rent(2 + (paletteSize * 4));
 
-                stream.WriteByte((byte)compressionControl);
+            // When the palette has two colors, the data is a bitmap with one bit per pixel, where each row is
+            // padded to a byte boundary. Otherwise, each pixel is represented by its index in the palette.
+            int rowLength = paletteSize == 2 ? (region.Width + 7) / 8 : region.Width;
+            byte[] data = ArrayPool<byte>.Shared.Rent(rowLength * region.Height);
 
-                using (var buffer = new MemoryStream())
-                using (var deflater = new ZlibStream(buffer, CompressionMode.Compress, compressionLevel))
+            try
+            {
+                int filterLength = 2;
+                filter[0] = (byte)TightFilter.Palette;
+                filter[1] = (byte)(paletteSize - 1);
+
+                for (int i = 0; i < paletteSize; i++)
                 {
-                    // The Tight encoding makes use of a new type TPIXEL (Tight pixel). This is the same as a PIXEL for the agreed
-                    // pixel format, except where true-colour-flag is non-zero, bits-per-pixel is 32, depth is 24 and all of the bits
-                    // making up the red, green and blue intensities are exactly 8 bits wide.
-                    // In this case a TPIXEL is only 3 bytes long, where the first byte is the red component, the second byte is the
-                    // green component, and the third byte is the blue component of the pixel color value.
-                    if (pixelFormat.BitsPerPixel == 32
-                        && pixelFormat.BitDepth == 24
-                        && pixelFormat.BlueBits == 8
-                        && pixelFormat.RedBits == 8
-                        && pixelFormat.GreenBits == 8
-                        && !pixelFormat.IsPalettized)
+                    filterLength += WritePixel(filter, filterLength, this.palette[i], pixelFormat);
+                }
+
+                fixed (byte* source = contents)
+                {
+                    uint previous = ReadPixel(source, bytesPerPixel) & mask;
+                    int index = this.GetPaletteIndex(previous);
+
+                    for (int y = 0; y < region.Height; y++)
                     {
-                        Debug.Assert(contents.Length % 4 == 0, "The size of the raw pixel data must be a multiple of 4 when using a 32bpp pixel format.");
+                        byte* row = source + (y * region.Width * bytesPerPixel);
+                        int offset = y * rowLength;
 
-                        int redOffset = pixelFormat.RedShift / 8;
-                        int blueOffset = pixelFormat.BlueShift / 8;
-                        int greenOffset = pixelFormat.GreenShift / 8;
+                        if (paletteSize == 2)
+                        {
+                            Array.Clear(data, offset, rowLength);
+                        }
 
-                        for (int i = 0; i < contents.Length; i += 4)
+                        for (int x = 0; x < region.Width; x++)
                         {
-                            if (i == contents.Length - 4)
+                            uint pixel = ReadPixel(row + (x * bytesPerPixel), bytesPerPixel) & mask;
+
+                            if (pixel != previous)
                             {
-                                deflater.FlushMode = FlushType.Full;
+                                previous = pixel;
+                                index = this.GetPaletteIndex(pixel);
                             }
 
-                            // The first byte is the red component, the second byte is the
-                            // green component, and the third byte is the blue component of the pixel color value.
-                            deflater.Write(contents, i + redOffset, 1);
-                            deflater.Write(contents, i + greenOffset, 1);
-                            deflater.Write(contents, i + blueOffset, 1);
+                            if (paletteSize != 2)
+                            {
+                                data[offset + x] = (byte)index;
+                            }
+                            else if (index != 0)
+                            {
+                                data[offset + (x >> 3)] |= (byte)(0x80 >> (x & 7));
+                            }
                         }
                     }
-                    else
-                    {
-                        deflater.FlushMode = FlushType.Finish;
-                        deflater.Write(contents, 0, contents.Length);
-                    }
+                }
 
-                    deflater.Flush();
+                return this.SendBasicData(
+                    stream,
+                    paletteSize == 2 ? MonoPaletteStream : IndexedPaletteStream,
+                    TightCompressionControl.BasicCompression | TightCompressionControl.ReadFilterId,
+                    filter.AsSpan(0, filterLength),
+                    data.AsSpan(0, rowLength * region.Height));
+            }
+            finally
+            {
+                ArrayPool<byte>.Shared.Return(filter);
+                ArrayPool<byte>.Shared.Return(data);
+            }
+        }
 
-                    byte[] encodedBuffer = new byte[4];
-                    var length = WriteEncodedValue(encodedBuffer, 0, (int)buffer.Length);
-                    stream.Write(encodedBuffer, 0, length);
+        /// <summary>
+        /// Sends a rectangle using the gradient filter. The pixel format must be a Tight pixel format.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> which represents connectivity with the client.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format to use.
+        /// </param>
+        /// <param name="region">
+        /// The rectangle to send.
+        /// </param>
+        /// <param name="contents">
+        /// A buffer holding the raw pixel data for the rectangle.
+        /// </param>
+        /// <returns>
+        /// The total number of bytes written to the wire.
+        /// </returns>
+        protected int SendWithGradientFilter(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            Debug.Assert(IsTightPixelFormat(pixelFormat), "The gradient filter is only supported for Tight pixel formats.");
 
-                    buffer.Position = 0;
-                    buffer.CopyTo(stream);
+            int width = region.Width;
+            int pixels = region.Width * region.Height;
+            byte[] data = ArrayPool<byte>.Shared.Rent((3 * pixels) + 16);
 
-                    return (int)buffer.Length + 1;
+            try
+            {
+                PackTightPixels(contents.Slice(0, 4 * pixels), data, pixelFormat);
+
+                // Replace each color component by the difference with its predicted value, V[x-1,y] + V[x,y-1] - V[x-1,y-1]
+                // (where values outside the rectangle are 0), clamped to [0, 255]. Work backwards, so that the values used for
+                // the prediction have not been overwritten yet.
+                for (int i = (3 * pixels) - 1; i >= 0; i--)
+                {
+                    int x = (i / 3) % width;
+                    int left = x > 0 ? data[i - 3] : 0;
+                    int above = i >= 3 * width ? data[i - (3 * width)] : 0;
+                    int aboveLeft = x > 0 && i >= 3 * width ? data[i - (3 * width) - 3] : 0;
+
+                    int predicted = left + above - aboveLeft;
+                    predicted = predicted < 0 ? 0 : predicted > 255 ? 255 : predicted;
+
+                    data[i] = (byte)(data[i] - predicted);
                 }
+
+                return this.SendBasicData(
+                    stream,
+                    GradientStream,
+                    TightCompressionControl.BasicCompression | TightCompressionControl.ReadFilterId,
+                    GradientFilterId,
+                    data.AsSpan(0, 3 * pixels));
+            }
+            finally
+            {
+                ArrayPool<byte>.Shared.Return(data);
             }
         }
 
@@ -333,5 +862,278 @@ namespace RemoteViewing.Vnc.Server
 
             return defaultValue;
         }
+
+        private static uint GetColorMask(VncPixelFormat pixelFormat)
+        {
+            uint mask = pixelFormat.BytesPerPixel == 4 ? uint.MaxValue : (1u << pixelFormat.BitsPerPixel) - 1;
+
+            if (pixelFormat.IsPalettized)
+            {
+                return mask;
+            }
+
+            mask &= ((uint)pixelFormat.RedMax << pixelFormat.RedShift)
+                | ((uint)pixelFormat.GreenMax << pixelFormat.GreenShift)
+                | ((uint)pixelFormat.BlueMax << pixelFormat.BlueShift);
+
+            if (!pixelFormat.IsLittleEndian)
+            {
+                // ReadPixel reads the bytes in little-endian order, so swap the bytes of the mask.
+                uint swapped = 0;
+
+                for (int i = 0; i < pixelFormat.BytesPerPixel; i++)
+                {
+                    swapped |= ((mask >> (8 * i)) & 0xFF) << (8 * (pixelFormat.BytesPerPixel - 1 - i));
+                }
+
+                mask = swapped;
+            }
+
+            return mask;
+        }
+
+        private static unsafe uint ReadPixel(byte* pixel, int bytesPerPixel)
+        {
+            switch (bytesPerPixel)
+            {
+                case 1:
+                    return pixel[0];
+
+                case 2:
+                    return (uint)(pixel[0] | (pixel[1] << 8));
+
+                default:
+                    return (uint)(pixel[0] | (pixel[1] << 8) | (pixel[2] << 16) | (pixel[3] << 24));
+            }
+        }
+
+        private static int WritePixel(byte[] buffer, int offset, uint pixel, VncPixelFormat pixelFormat)
+        {
+            if (IsTightPixelFormat(pixelFormat))
+            {
+                GetTightPixelOffsets(pixelFormat, out int redOffset, out int greenOffset, out int blueOffset);
+                buffer[offset] = (byte)(pixel >> (8 * redOffset));
+                buffer[offset + 1] = (byte)(pixel >> (8 * greenOffset));
+                buffer[offset + 2] = (byte)(pixel >> (8 * blueOffset));
+                return 3;
+            }
+
+            for (int i = 0; i < pixelFormat.BytesPerPixel; i++)
+            {
+                buffer[offset + i] = (byte)(pixel >> (8 * i));
+            }
+
+            return pixelFormat.BytesPerPixel;
+        }
+
+        private static int GetPaletteHash(uint color)
+        {
+            return (int)((color * 2654435761u) >> 22) & (PaletteHashSize - 1);
+        }
+
+        private static unsafe int GetGradientError(byte* pixel, int stride, int offset)
+        {
+            int predicted = pixel[offset - 4] + pixel[offset - stride] - pixel[offset - stride - 4];
+            predicted = predicted < 0 ? 0 : predicted > 255 ? 255 : predicted;
+
+            int error = pixel[offset] - predicted;
+            return error < 0 ? -error : error;
+        }
+
+        private unsafe int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents, bool independent)
+        {
+            this.GetJpegSettings(out int jpegQualityLevel, out TJSubsamplingOption subsamplingOption);
+
+            var useJpeg = this.UseJpegCompression(pixelFormat, region, contents.Length, jpegQualityLevel);
+
+            if (region.IsEmpty || contents.Length < region.Width * region.Height * pixelFormat.BytesPerPixel)
+            {
+                return independent ? -1 : this.SendWithBasicCompression(stream, pixelFormat, region, contents);
+            }
+
+            int pixels = region.Width * region.Height;
+            int maximumPaletteSize = Math.Min(useJpeg ? MaximumJpegPaletteSize : MaximumPaletteSize, Math.Max(2, pixels / 4));
+
+            // A palette index takes one byte, so the palette filter is only useful for 8bpp pixel formats when the
+            // palette can be represented using 1 bit per pixel.
+            if (pixelFormat.BytesPerPixel == 1)
+            {
+                maximumPaletteSize = 2;
+            }
+
+            fixed (byte* source = contents)
+            {
+                this.Classify(source, pixelFormat, region, maximumPaletteSize, !useJpeg && IsTightPixelFormat(pixelFormat), out int paletteSize, out bool isSmooth);
+
+                if (paletteSize == 1)
+                {
+                    return this.SendWithFillCompression(stream, pixelFormat, this.palette[0]);
+                }
+                else if (useJpeg && paletteSize == 0)
+                {
+                    return this.SendWithJpegCompression(stream, pixelFormat, region, contents, jpegQualityLevel, subsamplingOption);
+                }
+                else if (independent)
+                {
+                    // All other compression methods use the zlib streams.
+                    return -1;
+                }
+                else if (paletteSize > 1)
+                {
+                    return this.SendWithPaletteFilter(stream, pixelFormat, region, contents, paletteSize);
+                }
+                else if (isSmooth)
+                {
+                    return this.SendWithGradientFilter(stream, pixelFormat, region, contents);
+                }
+                else
+                {
+                    return this.SendWithBasicCompression(stream, pixelFormat, region, contents);
+                }
+            }
+        }
+
+        private void GetJpegSettings(out int jpegQualityLevel, out TJSubsamplingOption subsamplingOption)
+        {
+            jpegQualityLevel = GetQualityLevel(this.VncServerSession);
+            subsamplingOption = TJSubsamplingOption.Chrominance420;
+
+            var adaptedQualityLevel = this.QualityController?.QualityLevel;
+            if (jpegQualityLevel != 0 && adaptedQualityLevel != null)
+            {
+                jpegQualityLevel = QualityLevels[adaptedQualityLevel.Value];
+                subsamplingOption = GetSubsampling(adaptedQualityLevel.Value);
+            }
+        }
+
+        private bool UseJpegCompression(VncPixelFormat pixelFormat, VncRectangle region, int length, int jpegQualityLevel)
+        {
+            // The JPEG compression currently assumes a RGB32 pixel format, fall back to basic compression
+            // when this pixel format is not available.
+            // Additionally, a minimal JPEG image is at least ~128 bytes in size, so only compress to JPEG
+            // when the uncompressed file significantly larger.
+            return this.Compression == TightCompression.Jpeg
+                && VncPixelFormat.RGB32.Equals(pixelFormat)
+                && !region.IsEmpty
+                && length >= 256
+                && jpegQualityLevel != 0;
+        }
+
+        /// <summary>
+        /// Classifies a rectangle in a single pass, by collecting the colors in the rectangle into <see cref="palette"/>,
+        /// and estimating whether the image is smooth.
+        /// </summary>
+        /// <param name="source">
+        /// The raw pixel data of the rectangle.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format of the rectangle.
+        /// </param>
+        /// <param name="region">
+        /// The rectangle to classify.
+        /// </param>
+        /// <param name="maximumPaletteSize">
+        /// The maximum number of colors to collect.
+        /// </param>
+        /// <param name="detectSmoothness">
+        /// A value indicating whether to estimate whether the image is smooth. Requires a Tight pixel format.
+        /// </param>
+        /// <param name="paletteSize">
+        /// When this method returns, the number of colors in the rectangle, or 0 if the rectangle contains more than
+        /// <paramref name="maximumPaletteSize"/> colors.
+        /// </param>
+        /// <param name="isSmooth">
+        /// When this method returns, a value indicating whether the gradient filter is likely to compress the image well.
+        /// </param>
+        private unsafe void Classify(byte* source, VncPixelFormat pixelFormat, VncRectangle region, int maximumPaletteSize, bool detectSmoothness, out int paletteSize, out bool isSmooth)
+        {
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            int stride = region.Width * bytesPerPixel;
+            uint mask = GetColorMask(pixelFormat);
+
+            GetTightPixelOffsets(pixelFormat, out int redOffset, out int greenOffset, out int blueOffset);
+
+            Array.Clear(this.paletteHashIndices, 0, PaletteHashSize);
+
+            uint previous = ReadPixel(source, bytesPerPixel) & mask;
+            paletteSize = 0;
+            this.AddToPalette(previous, maximumPaletteSize, ref paletteSize);
+
+            long error = 0;
+            int samples = 0;
+
+            for (int y = 0; y < region.Height; y++)
+            {
+                byte* row = source + (y * stride);
+
+                // Estimate the smoothness of the image by calculating the error of the gradient filter on every 4th row.
+                bool sampleRow = detectSmoothness && (y & 3) == 1;
+
+                if (paletteSize == 0 && !sampleRow)
+                {
+                    continue;
+                }
+
+                for (int x = 0; x < region.Width; x++)
+                {
+                    byte* pixel = row + (x * bytesPerPixel);
+                    uint value = ReadPixel(pixel, bytesPerPixel) & mask;
+
+                    if (value != previous && paletteSize != 0)
+                    {
+                        previous = value;
+                        this.AddToPalette(value, maximumPaletteSize, ref paletteSize);
+                    }
+
+                    if (sampleRow && x > 0)
+                    {
+                        error += GetGradientError(pixel, stride, redOffset)
+                            + GetGradientError(pixel, stride, greenOffset)
+                            + GetGradientError(pixel, stride, blueOffset);
+                        samples++;
+                    }
+                }
+            }
+
+            isSmooth = samples > 0 && error < (long)SmoothnessThreshold * samples;
+        }
+
+        private void AddToPalette(uint color, int maximumPaletteSize, ref int paletteSize)
+        {
+            int hash = GetPaletteHash(color);
+
+            while (this.paletteHashIndices[hash] != 0)
+            {
+                if (this.paletteHashColors[hash] == color)
+                {
+                    return;
+                }
+
+                hash = (hash + 1) & (PaletteHashSize - 1);
+            }
+
+            if (paletteSize == maximumPaletteSize)
+            {
+                // Too many colors; stop collecting them.
+                paletteSize = 0;
+                return;
+            }
+
+            this.palette[paletteSize] = color;
+            this.paletteHashColors[hash] = color;
+            this.paletteHashIndices[hash] = (short)++paletteSize;
+        }
+
+        private int GetPaletteIndex(uint color)
+        {
+            int hash = GetPaletteHash(color);
+
+            while (this.paletteHashIndices[hash] == 0 || this.paletteHashColors[hash] != color)
+            {
+                hash = (hash + 1) & (PaletteHashSize - 1);
+            }
+
+            return this.paletteHashIndices[hash] - 1;
+        }
     }
 }
@@ -0,0 +1,620 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Buffers;
+using System.IO;
+using System.Threading.Tasks;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Implements the TRLE (Tiled Run-Length Encoding) protocol.
+    /// </summary>
+    /// <remarks>
+    /// The rectangle is divided into tiles, and each tile is sent using the subencoding which yields the smallest
+    /// output: solid, raw, run-length encoded, packed palette or palette run-length encoded. Pixels are sent as
+    /// compressed pixels (CPIXEL), which are 3 bytes long for 32 bpp pixel formats with a depth of 24 bits or less.
+    /// Tiles are analyzed in parallel for large rectangles, and are written to the client in order.
+    /// </remarks>
+    /// <seealso href="https://github.com/rfbproto/rfbproto/blob/master/rfbproto.rst#trle-encoding"/>
+    internal class TrleEncoder : VncEncoder
+    {
+        /// <summary>
+        /// The minimum number of tiles in a rectangle before the tiles are encoded in parallel.
+        /// </summary>
+        private const int MinimumParallelTileCount = 4;
+
+        /// <summary>
+        /// The maximum number of colors in a palette.
+        /// </summary>
+        private const int MaximumPaletteSize = 127;
+
+        /// <summary>
+        /// The size of the hash table used to look up palette indices. Must be a power of two, and larger
+        /// than <see cref="MaximumPaletteSize"/>.
+        /// </summary>
+        private const int PaletteHashSize = 256;
+
+        [ThreadStatic]
+        private static uint[] tilePixels;
+
+        [ThreadStatic]
+        private static uint[] palette;
+
+        [ThreadStatic]
+        private static uint[] paletteHashColors;
+
+        [ThreadStatic]
+        private static byte[] paletteHashIndices;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="TrleEncoder"/> class.
+        /// </summary>
+        public TrleEncoder()
+            : this(16)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="TrleEncoder"/> class.
+        /// </summary>
+        /// <param name="tileSize">
+        /// The width and height of a tile.
+        /// </param>
+        protected TrleEncoder(int tileSize)
+        {
+            this.TileSize = tileSize;
+        }
+
+        /// <inheritdoc/>
+        public override VncEncoding Encoding => VncEncoding.TRLE;
+
+        /// <summary>
+        /// Gets the width and height of a tile.
+        /// </summary>
+        public int TileSize { get; }
+
+        /// <inheritdoc/>
+        public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, byte[] contents)
+        {
+            return this.Send(stream, pixelFormat, region, new ReadOnlySpan<byte>(contents));
+        }
+
+        /// <inheritdoc/>
+        public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            return this.SendTiles(stream, pixelFormat, region, contents);
+        }
+
+        /// <inheritdoc/>
+        public override int? GetSharedEncodingKey(VncPixelFormat pixelFormat, VncRectangle region)
+        {
+            // TRLE is stateless, so the encoded data only depends on the pixel data.
+            return 0;
+        }
+
+        /// <summary>
+        /// Gets the size and position of the compressed pixel (CPIXEL) for a pixel format.
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The pixel format.
+        /// </param>
+        /// <param name="size">
+        /// When this method returns, the size of a CPIXEL, in bytes.
+        /// </param>
+        /// <param name="offset">
+        /// When this method returns, the offset of the CPIXEL within the pixel, in bytes.
+        /// </param>
+        internal static void GetCompressedPixelFormat(VncPixelFormat pixelFormat, out int size, out int offset)
+        {
+            size = pixelFormat.BytesPerPixel;
+            offset = 0;
+
+            // A CPIXEL is the same as a PIXEL, except where true-colour-flag is non-zero, bits-per-pixel is 32,
+            // depth is 24 or less and all of the bits making up the red, green and blue intensities fit in either
+            // the least significant 3 bytes or the most significant 3 bytes.
+            if (pixelFormat.BitsPerPixel != 32 || pixelFormat.BitDepth > 24 || pixelFormat.IsPalettized)
+            {
+                return;
+            }
+
+            uint mask = ((uint)pixelFormat.RedMax << pixelFormat.RedShift)
+                | ((uint)pixelFormat.GreenMax << pixelFormat.GreenShift)
+                | ((uint)pixelFormat.BlueMax << pixelFormat.BlueShift);
+
+            if ((mask & 0xFF000000) == 0)
+            {
+                size = 3;
+                offset = pixelFormat.IsLittleEndian ? 0 : 1;
+            }
+            else if ((mask & 0x000000FF) == 0)
+            {
+                size = 3;
+                offset = pixelFormat.IsLittleEndian ? 1 : 0;
+            }
+        }
+
+        /// <summary>
+        /// Encodes a single tile.
+        /// </summary>
+        /// <param name="source">
+        /// A pointer to the top-left pixel of the tile.
+        /// </param>
+        /// <param name="stride">
+        /// The number of bytes between two lines of the source.
+        /// </param>
+        /// <param name="width">
+        /// The width of the tile.
+        /// </param>
+        /// <param name="height">
+        /// The height of the tile.
+        /// </param>
+        /// <param name="bytesPerPixel">
+        /// The number of bytes per pixel.
+        /// </param>
+        /// <param name="compressedPixelSize">
+        /// The size of a CPIXEL, in bytes.
+        /// </param>
+        /// <param name="compressedPixelOffset">
+        /// The offset of the CPIXEL within the pixel, in bytes.
+        /// </param>
+        /// <param name="target">
+        /// A buffer which receives the encoded tile. This buffer must be at least
+        /// <c>1 + (width * height * compressedPixelSize)</c> bytes long.
+        /// </param>
+        /// <returns>
+        /// The number of bytes written to <paramref name="target"/>.
+        /// </returns>
+        internal static unsafe int EncodeTile(byte* source, int stride, int width, int height, int bytesPerPixel, int compressedPixelSize, int compressedPixelOffset, byte[] target)
+        {
+            if (tilePixels == null)
+            {
+                tilePixels = new uint[64 * 64];
+                palette = new uint[MaximumPaletteSize];
+                paletteHashColors = new uint[PaletteHashSize];
+                paletteHashIndices = new byte[PaletteHashSize];
+            }
+
+            int count = width * height;
+
+            if (tilePixels.Length < count)
+            {
+                tilePixels = new uint[count];
+            }
+
+            uint[] pixels = tilePixels;
+            int shift = 8 * compressedPixelOffset;
+
+            for (int y = 0, i = 0; y < height; y++)
+            {
+                byte* row = source + (y * stride);
+
+                for (int x = 0; x < width; x++, i++)
+                {
+                    pixels[i] = ReadPixel(row + (x * bytesPerPixel), bytesPerPixel);
+                }
+            }
+
+            // Analyze the tile: count the runs and collect the palette, and calculate the size of each subencoding.
+            Array.Clear(paletteHashIndices, 0, PaletteHashSize);
+
+            int paletteSize = 0;
+            int runCount = 0;
+            int runLengthSize = 0;
+            int paletteRunLengthSize = 0;
+            int runLength = 1;
+
+            uint previous = pixels[0];
+            bool usePalette = AddToPalette(previous, ref paletteSize);
+
+            for (int i = 1; i <= count; i++)
+            {
+                if (i < count && pixels[i] == previous)
+                {
+                    runLength++;
+                    continue;
+                }
+
+                int lengthSize = ((runLength - 1) / 255) + 1;
+                runCount++;
+                runLengthSize += lengthSize;
+                paletteRunLengthSize += runLength == 1 ? 1 : 1 + lengthSize;
+
+                if (i < count)
+                {
+                    previous = pixels[i];
+                    runLength = 1;
+
+                    if (usePalette)
+                    {
+                        usePalette = AddToPalette(previous, ref paletteSize);
+                    }
+                }
+            }
+
+            fixed (byte* start = target)
+            {
+                byte* output = start;
+
+                if (usePalette && paletteSize == 1)
+                {
+                    *output++ = 1;
+                    output = WriteCompressedPixel(output, previous, compressedPixelSize, shift);
+                    return (int)(output - start);
+                }
+
+                int subencoding = 0;
+                int size = count * compressedPixelSize;
+
+                if ((runCount * compressedPixelSize) + runLengthSize < size)
+                {
+                    subencoding = 128;
+                    size = (runCount * compressedPixelSize) + runLengthSize;
+                }
+
+                int bitsPerIndex = paletteSize <= 2 ? 1 : paletteSize <= 4 ? 2 : 4;
+
+                if (usePalette && paletteSize <= 16
+                    && (paletteSize * compressedPixelSize) + (height * (((width * bitsPerIndex) + 7) / 8)) < size)
+                {
+                    subencoding = paletteSize;
+                    size = (paletteSize * compressedPixelSize) + (height * (((width * bitsPerIndex) + 7) / 8));
+                }
+
+                if (usePalette && (paletteSize * compressedPixelSize) + paletteRunLengthSize < size)
+                {
+                    subencoding = 128 + paletteSize;
+                }
+
+                *output++ = (byte)subencoding;
+
+                if (subencoding == 0)
+                {
+                    for (int i = 0; i < count; i++)
+                    {
+                        output = WriteCompressedPixel(output, pixels[i], compressedPixelSize, shift);
+                    }
+                }
+                else if (subencoding == 128)
+                {
+                    for (int i = 0; i < count;)
+                    {
+                        int j = i + 1;
+
+                        while (j < count && pixels[j] == pixels[i])
+                        {
+                            j++;
+                        }
+
+                        output = WriteCompressedPixel(output, pixels[i], compressedPixelSize, shift);
+                        output = WriteRunLength(output, j - i);
+                        i = j;
+                    }
+                }
+                else
+                {
+                    for (int i = 0; i < paletteSize; i++)
+                    {
+                        output = WriteCompressedPixel(output, palette[i], compressedPixelSize, shift);
+                    }
+
+                    if (subencoding < 128)
+                    {
+                        // Packed palette: the indices are packed into bytes, starting with the most significant bits,
+                        // and every row starts at a byte boundary.
+                        for (int y = 0, i = 0; y < height; y++)
+                        {
+                            int value = 0;
+                            int bits = 0;
+
+                            for (int x = 0; x < width; x++, i++)
+                            {
+                                value = (value << bitsPerIndex) | GetPaletteIndex(pixels[i]);
+                                bits += bitsPerIndex;
+
+                                if (bits == 8)
+                                {
+                                    *output++ = (byte)value;
+                                    value = 0;
+                                    bits = 0;
+                                }
+                            }
+
+                            if (bits > 0)
+                            {
+                                *output++ = (byte)(value << (8 - bits));
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (int i = 0; i < count;)
+                        {
+                            int j = i + 1;
+
+                            while (j < count && pixels[j] == pixels[i])
+                            {
+                                j++;
+                            }
+
+                            int index = GetPaletteIndex(pixels[i]);
+
+                            if (j - i == 1)
+                            {
+                                *output++ = (byte)index;
+                            }
+                            else
+                            {
+                                *output++ = (byte)(index | 128);
+                                output = WriteRunLength(output, j - i);
+                            }
+
+                            i = j;
+                        }
+                    }
+                }
+
+                return (int)(output - start);
+            }
+        }
+
+        /// <summary>
+        /// Encodes all tiles of a rectangle, and writes them to the client.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> to which to write the tiles.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format to use.
+        /// </param>
+        /// <param name="region">
+        /// The rectangle to send.
+        /// </param>
+        /// <param name="contents">
+        /// A buffer holding the raw pixel data for the rectangle.
+        /// </param>
+        /// <returns>
+        /// The total number of bytes written to <paramref name="stream"/>.
+        /// </returns>
+        protected unsafe int SendTiles(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            int tileSize = this.TileSize;
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            int stride = region.Width * bytesPerPixel;
+            int columns = (region.Width + tileSize - 1) / tileSize;
+            int rows = (region.Height + tileSize - 1) / tileSize;
+            int tileCount = columns * rows;
+            int bufferSize = 1 + (tileSize * tileSize * bytesPerPixel);
+            int sent = 0;
+
+            GetCompressedPixelFormat(pixelFormat, out int compressedPixelSize, out int compressedPixelOffset);
+
+            if (tileCount == 0)
+            {
+                return 0;
+            }
+
+            if (contents.Length < stride * region.Height)
+            {
+                throw new ArgumentOutOfRangeException(nameof(contents));
+            }
+
+            fixed (byte* source = contents)
+            {
+                if (tileCount < MinimumParallelTileCount || Environment.ProcessorCount == 1)
+                {
+                    byte[] buffer = ArrayPool<byte>.Shared.Rent(bufferSize);
+
+                    try
+                    {
+                        for (int i = 0; i < tileCount; i++)
+                        {
+                            int x = (i % columns) * tileSize;
+                            int y = (i / columns) * tileSize;
+
+                            int length = EncodeTile(
+                                source + (y * stride) + (x * bytesPerPixel),
+                                stride,
+                                Math.Min(tileSize, region.Width - x),
+                                Math.Min(tileSize, region.Height - y),
+                                bytesPerPixel,
+                                compressedPixelSize,
+                                compressedPixelOffset,
+                                buffer);
+
+                            this.WriteTile(stream, buffer, length, i == tileCount - 1);
+                            sent += length;
+                        }
+                    }
+                    finally
+                    {
+                        ArrayPool<byte>.Shared.Return(buffer);
+                    }
+
+                    return sent;
+                }
+
+                // Analyzing and encoding the tiles is where most of the time is spent, so do that in parallel.
+                // The encoded tiles are written to the client in order afterwards.
+                byte[][] buffers = ArrayPool<byte[]>.Shared.Rent(tileCount);
+                int[] lengths = ArrayPool<int>.Shared.Rent(tileCount);
+                IntPtr sourcePointer = (IntPtr)source;
+
+                try
+                {
+                    Parallel.For(
+                        0,
+                        tileCount,
+                        (i) =>
+                        {
+                            int x = (i % columns) * tileSize;
+                            int y = (i / columns) * tileSize;
+
+                            buffers[i] = ArrayPool<byte>.Shared.Rent(bufferSize);
+                            lengths[i] = EncodeTile(
+                                (byte*)sourcePointer + (y * stride) + (x * bytesPerPixel),
+                                stride,
+                                Math.Min(tileSize, region.Width - x),
+                                Math.Min(tileSize, region.Height - y),
+                                bytesPerPixel,
+                                compressedPixelSize,
+                                compressedPixelOffset,
+                                buffers[i]);
+                        });
+
+                    for (int i = 0; i < tileCount; i++)
+                    {
+                        this.WriteTile(stream, buffers[i], lengths[i], i == tileCount - 1);
+                        sent += lengths[i];
+                    }
+                }
+                finally
+                {
+                    for (int i = 0; i < tileCount; i++)
+                    {
+                        if (buffers[i] != null)
+                        {
+                            ArrayPool<byte>.Shared.Return(buffers[i]);
+                            buffers[i] = null;
+                        }
+                    }
+
+                    ArrayPool<byte[]>.Shared.Return(buffers);
+                    ArrayPool<int>.Shared.Return(lengths);
+                }
+
+                return sent;
+            }
+        }
+
+        /// <summary>
+        /// Writes an encoded tile to the client.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="Stream"/> to which to write the tile.
+        /// </param>
+        /// <param name="buffer">
+        /// A buffer which contains the encoded tile.
+        /// </param>
+        /// <param name="count">
+        /// The size of the encoded tile.
+        /// </param>
+        /// <param name="isLastTile">
+        /// A value indicating whether this is the last tile of the rectangle.
+        /// </param>
+        protected virtual void WriteTile(Stream stream, byte[] buffer, int count, bool isLastTile)
+        {
+            stream.Write(buffer, 0, count);
+        }
+
+        private static unsafe uint ReadPixel(byte* pixel, int bytesPerPixel)
+        {
+            switch (bytesPerPixel)
+            {
+                case 1:
+                    return pixel[0];
+
+                case 2:
+                    return (uint)(pixel[0] | (pixel[1] << 8));
+
+                default:
+                    return (uint)(pixel[0] | (pixel[1] << 8) | (pixel[2] << 16) | (pixel[3] << 24));
+            }
+        }
+
+        private static unsafe byte* WriteCompressedPixel(byte* output, uint pixel, int size, int shift)
+        {
+            pixel >>= shift;
+
+            for (int i = 0; i < size; i++)
+            {
+                *output++ = (byte)(pixel >> (8 * i));
+            }
+
+            return output;
+        }
+
+        private static unsafe byte* WriteRunLength(byte* output, int runLength)
+        {
+            // The run length is encoded as (runLength - 1), split into bytes of which all but the last are 255.
+            int value = runLength - 1;
+
+            while (value >= 255)
+            {
+                *output++ = 255;
+                value -= 255;
+            }
+
+            *output++ = (byte)value;
+            return output;
+        }
+
+        private static int GetPaletteHash(uint color)
+        {
+            return (int)((color * 2654435761u) >> 24) & (PaletteHashSize - 1);
+        }
+
+        private static bool AddToPalette(uint color, ref int paletteSize)
+        {
+            int hash = GetPaletteHash(color);
+
+            while (paletteHashIndices[hash] != 0)
+            {
+                if (paletteHashColors[hash] == color)
+                {
+                    return true;
+                }
+
+                hash = (hash + 1) & (PaletteHashSize - 1);
+            }
+
+            if (paletteSize == MaximumPaletteSize)
+            {
+                return false;
+            }
+
+            palette[paletteSize] = color;
+            paletteHashColors[hash] = color;
+            paletteHashIndices[hash] = (byte)++paletteSize;
+            return true;
+        }
+
+        private static int GetPaletteIndex(uint color)
+        {
+            int hash = GetPaletteHash(color);
+
+            while (paletteHashColors[hash] != color)
+            {
+                hash = (hash + 1) & (PaletteHashSize - 1);
+            }
+
+            return paletteHashIndices[hash] - 1;
+        }
+    }
+}
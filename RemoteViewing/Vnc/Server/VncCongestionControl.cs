@@ -0,0 +1,208 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Generic;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Limits the amount of framebuffer data which is in flight between the server and a client which uses continuous
+    /// updates, based on the round-trip times of fences.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// A fence is sent after each framebuffer update; the client only responds to it once it has processed
+    /// all data which was sent before. All data sent before an acknowledged fence has therefore left the network, and
+    /// the amount of data which is still in flight is the amount sent since the most recently acknowledged fence.
+    /// </para>
+    /// <para>
+    /// The congestion window starts out small and grows quickly (doubling each round trip) for as long as the round-trip
+    /// time stays close to the lowest round-trip time measured so far. Once the round-trip time increases, data is
+    /// queuing up somewhere along the way; the window is then reduced, and grows slowly afterwards.
+    /// </para>
+    /// </remarks>
+    internal sealed class VncCongestionControl
+    {
+        /// <summary>
+        /// The initial size of the congestion window, in bytes.
+        /// </summary>
+        internal const int InitialWindow = 64 * 1024;
+
+        /// <summary>
+        /// The minimum size of the congestion window, in bytes.
+        /// </summary>
+        internal const int MinimumWindow = 16 * 1024;
+
+        /// <summary>
+        /// The maximum size of the congestion window, in bytes.
+        /// </summary>
+        internal const int MaximumWindow = 32 * 1024 * 1024;
+
+        // Round-trip times which exceed the lowest round-trip time by less than this are not
+        // considered to be a sign of congestion; this allows for some jitter on fast networks.
+        private static readonly TimeSpan MinimumExtraDelay = TimeSpan.FromMilliseconds(20);
+
+        private readonly Queue<Ping> pings = new Queue<Ping>();
+
+        private uint nextId;
+        private long sentBytes;
+        private long acknowledgedBytes;
+        private bool slowStart = true;
+
+        // The position of the stream at which the window was last reduced. The window
+        // is reduced at most once per round trip.
+        private long reducedAt = -1;
+
+        /// <summary>
+        /// Gets the size of the congestion window, in bytes.
+        /// </summary>
+        public long Window
+        { get; private set; } = InitialWindow;
+
+        /// <summary>
+        /// Gets the number of bytes which have been sent, but which have not yet been processed by the client.
+        /// </summary>
+        public long BytesInFlight => this.sentBytes - this.acknowledgedBytes;
+
+        /// <summary>
+        /// Gets a value indicating whether the congestion window is full, and no further updates should be sent.
+        /// </summary>
+        public bool IsCongested => this.BytesInFlight >= this.Window;
+
+        /// <summary>
+        /// Gets the most recently measured round-trip time.
+        /// </summary>
+        public TimeSpan RoundTripTime
+        { get; private set; }
+
+        /// <summary>
+        /// Gets the lowest round-trip time measured so far.
+        /// </summary>
+        public TimeSpan MinimumRoundTripTime
+        { get; private set; } = TimeSpan.MaxValue;
+
+        /// <summary>
+        /// Records data which has been sent to the client.
+        /// </summary>
+        /// <param name="count">
+        /// The number of bytes which have been sent.
+        /// </param>
+        public void Sent(long count)
+        {
+            this.sentBytes += count;
+        }
+
+        /// <summary>
+        /// Records a fence request which has been sent to the client.
+        /// </summary>
+        /// <param name="time">
+        /// The time at which the fence was sent.
+        /// </param>
+        /// <returns>
+        /// The identifier of the fence, which must be included in the payload of the fence.
+        /// </returns>
+        public uint SentPing(TimeSpan time)
+        {
+            var id = this.nextId++;
+            this.pings.Enqueue(new Ping() { Id = id, Time = time, Position = this.sentBytes });
+            return id;
+        }
+
+        /// <summary>
+        /// Records the response of the client to a fence request.
+        /// </summary>
+        /// <param name="id">
+        /// The identifier of the fence.
+        /// </param>
+        /// <param name="time">
+        /// The time at which the response was received.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the response matches a fence request; otherwise, <see langword="false"/>.
+        /// </returns>
+        public bool ReceivedPong(uint id, TimeSpan time)
+        {
+            // The client responds to fences in order, so any older fences must have been lost.
+            while (this.pings.Count > 0 && this.pings.Peek().Id != id)
+            {
+                this.pings.Dequeue();
+            }
+
+            if (this.pings.Count == 0)
+            {
+                return false;
+            }
+
+            var ping = this.pings.Dequeue();
+            var acknowledged = ping.Position - this.acknowledgedBytes;
+            this.acknowledgedBytes = ping.Position;
+
+            this.RoundTripTime = time - ping.Time;
+            if (this.RoundTripTime < this.MinimumRoundTripTime)
+            {
+                this.MinimumRoundTripTime = this.RoundTripTime;
+            }
+
+            var extraDelay = this.RoundTripTime - this.MinimumRoundTripTime;
+            var maximumExtraDelay = TimeSpan.FromTicks(Math.Max(MinimumExtraDelay.Ticks, this.MinimumRoundTripTime.Ticks / 2));
+
+            if (extraDelay > maximumExtraDelay)
+            {
+                // Data is queuing up. Reduce the window, unless it has been reduced already for data which was
+                // in flight at the time.
+                this.slowStart = false;
+
+                if (ping.Position > this.reducedAt)
+                {
+                    this.Window = Math.Max(MinimumWindow, this.Window * 3 / 4);
+                    this.reducedAt = this.sentBytes;
+                }
+            }
+            else if (this.slowStart)
+            {
+                // Growing the window by the amount of data acknowledged doubles the window each round trip.
+                this.Window = Math.Min(MaximumWindow, this.Window + acknowledged);
+            }
+            else
+            {
+                // Grow the window by roughly the minimum window each round trip.
+                this.Window = Math.Min(MaximumWindow, this.Window + Math.Max(1, MinimumWindow * acknowledged / this.Window));
+            }
+
+            return true;
+        }
+
+        private struct Ping
+        {
+            public uint Id;
+            public TimeSpan Time;
+            public long Position;
+        }
+    }
+}
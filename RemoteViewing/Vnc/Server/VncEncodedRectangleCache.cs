@@ -0,0 +1,124 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System.Collections.Generic;
+using System.Linq;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Caches the encoded data of rectangles, so it can be shared between sessions which use the same encoder settings.
+    /// </summary>
+    internal sealed class VncEncodedRectangleCache
+    {
+        private readonly Dictionary<VncEncodedRectangleKey, byte[]> rectangles = new Dictionary<VncEncodedRectangleKey, byte[]>();
+        private long size;
+
+        /// <summary>
+        /// Gets or sets the maximum number of bytes which can be held by this cache. Once this limit is reached,
+        /// newly encoded rectangles are no longer cached until the next generation.
+        /// </summary>
+        public long MaximumSize
+        { get; set; } = 32 * 1024 * 1024;
+
+        /// <summary>
+        /// Gets the number of bytes currently held by this cache.
+        /// </summary>
+        public long Size
+        {
+            get
+            {
+                lock (this.rectangles)
+                {
+                    return this.size;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gets the encoded data for a rectangle.
+        /// </summary>
+        /// <param name="key">
+        /// The key which identifies the rectangle.
+        /// </param>
+        /// <param name="data">
+        /// When this method returns, the encoded data for the rectangle, if it was found.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the encoded data was found; otherwise, <see langword="false"/>.
+        /// </returns>
+        public bool TryGetValue(VncEncodedRectangleKey key, out byte[] data)
+        {
+            lock (this.rectangles)
+            {
+                return this.rectangles.TryGetValue(key, out data);
+            }
+        }
+
+        /// <summary>
+        /// Adds the encoded data for a rectangle to the cache.
+        /// </summary>
+        /// <param name="key">
+        /// The key which identifies the rectangle.
+        /// </param>
+        /// <param name="data">
+        /// The encoded data.
+        /// </param>
+        public void Add(VncEncodedRectangleKey key, byte[] data)
+        {
+            lock (this.rectangles)
+            {
+                if (this.size + data.Length > this.MaximumSize || this.rectangles.ContainsKey(key))
+                {
+                    return;
+                }
+
+                this.rectangles.Add(key, data);
+                this.size += data.Length;
+            }
+        }
+
+        /// <summary>
+        /// Removes all rectangles which belong to a generation older than <paramref name="generation"/>.
+        /// </summary>
+        /// <param name="generation">
+        /// The oldest generation to keep.
+        /// </param>
+        public void Trim(long generation)
+        {
+            lock (this.rectangles)
+            {
+                foreach (var key in this.rectangles.Keys.Where(k => k.Generation < generation).ToList())
+                {
+                    this.size -= this.rectangles[key].Length;
+                    this.rectangles.Remove(key);
+                }
+            }
+        }
+    }
+}
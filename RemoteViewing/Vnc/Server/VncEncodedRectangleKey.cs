@@ -0,0 +1,117 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Identifies an encoded rectangle in the <see cref="VncEncodedRectangleCache"/>.
+    /// </summary>
+    internal struct VncEncodedRectangleKey : IEquatable<VncEncodedRectangleKey>
+    {
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncEncodedRectangleKey"/> struct.
+        /// </summary>
+        /// <param name="generation">
+        /// The generation of the framebuffer data.
+        /// </param>
+        /// <param name="region">
+        /// The region of the framebuffer which was encoded.
+        /// </param>
+        /// <param name="encoding">
+        /// The encoding which was used.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format of the client.
+        /// </param>
+        /// <param name="settings">
+        /// A value which identifies the encoder settings, such as the quality or compression level.
+        /// </param>
+        public VncEncodedRectangleKey(long generation, VncRectangle region, VncEncoding encoding, VncPixelFormat pixelFormat, int settings)
+        {
+            this.Generation = generation;
+            this.Region = region;
+            this.Encoding = encoding;
+            this.PixelFormat = pixelFormat;
+            this.Settings = settings;
+        }
+
+        /// <summary>
+        /// Gets the generation of the framebuffer data.
+        /// </summary>
+        public long Generation { get; }
+
+        /// <summary>
+        /// Gets the region of the framebuffer which was encoded.
+        /// </summary>
+        public VncRectangle Region { get; }
+
+        /// <summary>
+        /// Gets the encoding which was used.
+        /// </summary>
+        public VncEncoding Encoding { get; }
+
+        /// <summary>
+        /// Gets the pixel format of the client.
+        /// </summary>
+        public VncPixelFormat PixelFormat { get; }
+
+        /// <summary>
+        /// Gets a value which identifies the encoder settings.
+        /// </summary>
+        public int Settings { get; }
+
+        /// <inheritdoc/>
+        public bool Equals(VncEncodedRectangleKey other)
+        {
+            return this.Generation == other.Generation
+                && this.Region == other.Region
+                && this.Encoding == other.Encoding
+                && this.Settings == other.Settings
+                && object.Equals(this.PixelFormat, other.PixelFormat);
+        }
+
+        /// <inheritdoc/>
+        public override bool Equals(object obj)
+        {
+            return obj is VncEncodedRectangleKey other && this.Equals(other);
+        }
+
+        /// <inheritdoc/>
+        public override int GetHashCode()
+        {
+            int hash = this.Generation.GetHashCode();
+            hash = (hash * 31) + this.Region.GetHashCode();
+            hash = (hash * 31) + (int)this.Encoding;
+            hash = (hash * 31) + this.Settings;
+            hash = (hash * 31) + (this.PixelFormat?.GetHashCode() ?? 0);
+            return hash;
+        }
+    }
+}
@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #endregion
 
+using System;
 using System.IO;
 
 namespace RemoteViewing.Vnc.Server
@@ -41,6 +42,18 @@ namespace RemoteViewing.Vnc.Server
         /// </summary>
         public abstract VncEncoding Encoding { get; }
 
+        /// <summary>
+        /// Gets the maximum width of a rectangle sent using this <see cref="VncEncoder"/>. Wider rectangles
+        /// are split into multiple rectangles.
+        /// </summary>
+        public virtual int MaximumRectangleWidth => int.MaxValue;
+
+        /// <summary>
+        /// Gets the maximum number of pixels in a rectangle sent using this <see cref="VncEncoder"/>. Larger
+        /// rectangles are split into multiple rectangles.
+        /// </summary>
+        public virtual int MaximumRectangleArea => int.MaxValue;
+
         /// <summary>
         /// Sends the contents of a rectangle to the client.
         /// </summary>
@@ -60,5 +73,116 @@ namespace RemoteViewing.Vnc.Server
         /// The total number of bytes written to the wire. Used for bookkeeping.
         /// </returns>
         public abstract int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, byte[] contents);
+
+        /// <summary>
+        /// Sends the contents of a rectangle to the client.
+        /// </summary>
+        /// <param name="stream">
+        /// A <see cref="Stream"/> which represents the connection to the VNC client.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The <see cref="VncPixelFormat"/> being used.
+        /// </param>
+        /// <param name="region">
+        /// The dimesions of the rectangle.
+        /// </param>
+        /// <param name="contents">
+        /// The contents of the rectangle, in raw pixel format. This may refer directly to the framebuffer,
+        /// or to a pooled buffer, so encoders must not hold on to it after this method returns.
+        /// </param>
+        /// <returns>
+        /// The total number of bytes written to the wire. Used for bookkeeping.
+        /// </returns>
+        /// <remarks>
+        /// Encoders should override this method. The default implementation copies the contents to a new
+        /// array and calls <see cref="Send(Stream, VncPixelFormat, VncRectangle, byte[])"/>, for compatibility
+        /// with encoders which only support arrays.
+        /// </remarks>
+        public virtual int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            return this.Send(stream, pixelFormat, region, contents.ToArray());
+        }
+
+        /// <summary>
+        /// Gets a value which identifies the settings (such as the quality or compression level) this encoder
+        /// would use to encode a rectangle. Sessions which share a framebuffer can reuse each other's encoded
+        /// data if their encoders return the same value.
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The <see cref="VncPixelFormat"/> being used.
+        /// </param>
+        /// <param name="region">
+        /// The dimesions of the rectangle.
+        /// </param>
+        /// <returns>
+        /// A value which identifies the encoder settings, or <see langword="null"/> if the encoded data
+        /// can't be shared; for example, because it depends on the state of a zlib stream.
+        /// </returns>
+        public virtual int? GetSharedEncodingKey(VncPixelFormat pixelFormat, VncRectangle region)
+        {
+            return null;
+        }
+
+        /// <summary>
+        /// Gets a value which identifies the settings this encoder would use to encode a rectangle using
+        /// <see cref="TrySendIndependently(Stream, VncPixelFormat, VncRectangle, ReadOnlySpan{byte})"/>. Sessions which
+        /// share a framebuffer can reuse each other's independently encoded rectangles if their encoders return the
+        /// same value.
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The <see cref="VncPixelFormat"/> being used.
+        /// </param>
+        /// <param name="region">
+        /// The dimesions of the rectangle.
+        /// </param>
+        /// <returns>
+        /// A value which identifies the encoder settings, or <see langword="null"/> if this encoder can't send
+        /// rectangles independently. This value is only used when <see cref="GetSharedEncodingKey(VncPixelFormat, VncRectangle)"/>
+        /// returns <see langword="null"/>.
+        /// </returns>
+        public virtual int? GetIndependentEncodingKey(VncPixelFormat pixelFormat, VncRectangle region)
+        {
+            return null;
+        }
+
+        /// <summary>
+        /// Creates an encoder with the same settings as this encoder, which a worker thread can use to encode
+        /// rectangles at the same time as this encoder.
+        /// </summary>
+        /// <returns>
+        /// A new <see cref="VncEncoder"/>, or <see langword="null"/> if this encoder doesn't support encoding
+        /// rectangles in parallel.
+        /// </returns>
+        public virtual VncEncoder CreateWorker()
+        {
+            return null;
+        }
+
+        /// <summary>
+        /// Tries to send the contents of a rectangle without using any state which is shared between rectangles,
+        /// such as a zlib stream. This method is called on encoders created by <see cref="CreateWorker"/>, at the
+        /// same time as other rectangles are being encoded.
+        /// </summary>
+        /// <param name="stream">
+        /// A <see cref="Stream"/> to which to write the encoded rectangle.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The <see cref="VncPixelFormat"/> being used.
+        /// </param>
+        /// <param name="region">
+        /// The dimesions of the rectangle.
+        /// </param>
+        /// <param name="contents">
+        /// The contents of the rectangle, in raw pixel format.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the rectangle has been written to <paramref name="stream"/>; or <see langword="false"/>
+        /// if the rectangle must be sent by the encoder of the session, using
+        /// <see cref="Send(Stream, VncPixelFormat, VncRectangle, ReadOnlySpan{byte})"/>.
+        /// </returns>
+        public virtual bool TrySendIndependently(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            return false;
+        }
     }
 }
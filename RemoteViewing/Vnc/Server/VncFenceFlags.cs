@@ -0,0 +1,68 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Flags used by the Fence extension.
+    /// </summary>
+    [Flags]
+    internal enum VncFenceFlags : uint
+    {
+        /// <summary>
+        /// No flags are set.
+        /// </summary>
+        None = 0,
+
+        /// <summary>
+        /// All messages preceding this one must have finished processing and taken effect before the response
+        /// is sent.
+        /// </summary>
+        BlockBefore = 0x00000001,
+
+        /// <summary>
+        /// All messages following this one must not start processing until the response is sent.
+        /// </summary>
+        BlockAfter = 0x00000002,
+
+        /// <summary>
+        /// The message following this one must be executed in an atomic manner, so that anything preceding
+        /// the fence response must not be affected by the message, and anything following the fence response
+        /// must be affected by the message.
+        /// </summary>
+        SyncNext = 0x00000004,
+
+        /// <summary>
+        /// Indicates that this is a new request and that a response is expected. If this bit is cleared,
+        /// the message is a response to an earlier request.
+        /// </summary>
+        Request = 0x80000000,
+    }
+}
@@ -28,6 +28,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using Microsoft.Extensions.Logging;
 using System;
+using System.Collections.Generic;
+using System.Linq;
 
 namespace RemoteViewing.Vnc.Server
 {
@@ -38,12 +40,28 @@ namespace RemoteViewing.Vnc.Server
     internal sealed class VncFramebufferCache : IVncFramebufferCache
     {
         // The size of the tiles which will be invalidated. So we're basically
-        // dividing the framebuffer in blocks of 32x32 and are invalidating them one at a time.
-        private const int TileSize = 64;
+        // dividing the framebuffer in blocks of 64x64 and are invalidating them one at a time.
+        internal const int TileSize = 64;
 
         private readonly ILogger logger;
 
-        private readonly bool[] isLineInvalid;
+        // The number of tile columns and rows in the framebuffer.
+        private readonly int tileColumns;
+        private readonly int tileRows;
+
+        // isTileInvalid will indicate, on a tile-by-tile basis, whether a tile has changed
+        // since the last update. Tiles are stored row by row.
+        private readonly bool[] isTileInvalid;
+
+        // For clients which support CopyRect, blocks which have moved (e.g. because a window was scrolled)
+        // are sent as a copy of the data the client already has, and only the remainder is invalidated.
+        private readonly VncMotionDetector motionDetector = new VncMotionDetector();
+        private readonly List<VncFramebufferMove> moves = new List<VncFramebufferMove>();
+
+        // When the framebuffer source reports which regions it has changed, only the tiles which
+        // overlap these regions are compared.
+        private readonly VncDamageReader damageReader = new VncDamageReader();
+        private readonly bool[] isTileDamaged;
 
         // We cache the latest framebuffer data as it was sent to the client. When looking for changes,
         // we compare with the framebuffer which is cached here and send the deltas (for each time
@@ -70,7 +88,10 @@ namespace RemoteViewing.Vnc.Server
             this.cachedFramebuffer = new VncFramebuffer(framebuffer.Name, framebuffer.Width, framebuffer.Height, framebuffer.PixelFormat);
 
             this.logger = logger;
-            this.isLineInvalid = new bool[this.Framebuffer.Height];
+            this.tileColumns = (framebuffer.Width + TileSize - 1) / TileSize;
+            this.tileRows = (framebuffer.Height + TileSize - 1) / TileSize;
+            this.isTileInvalid = new bool[this.tileColumns * this.tileRows];
+            this.isTileDamaged = new bool[this.tileColumns * this.tileRows];
         }
 
         /// <summary>
@@ -82,6 +103,15 @@ namespace RemoteViewing.Vnc.Server
             private set;
         }
 
+        /// <summary>
+        /// Gets or sets the source of <see cref="Framebuffer"/>, if that source reports which regions have changed.
+        /// </summary>
+        internal IVncFramebufferDamageSource DamageSource
+        {
+            get;
+            set;
+        }
+
         /// <summary>
         /// Responds to a <see cref="VncServerSession"/> update request.
         /// </summary>
@@ -92,10 +122,8 @@ namespace RemoteViewing.Vnc.Server
         /// <see langword="true"/> if the operation completed successfully; otherwise,
         /// <see langword="false"/>.
         /// </returns>
-        public unsafe bool RespondToUpdateRequest(IVncServerSession session)
+        public bool RespondToUpdateRequest(IVncServerSession session)
         {
-            VncRectangle subregion = default(VncRectangle);
-
             var fb = this.Framebuffer;
             var fbr = session.FramebufferUpdateRequest;
             if (fb == null || fbr == null)
@@ -104,8 +132,8 @@ namespace RemoteViewing.Vnc.Server
             }
 
             var incremental = fbr.Incremental;
-            var region = fbr.Region;
-            int bpp = fb.PixelFormat.BytesPerPixel;
+            var detectMoves = incremental && session.ClientEncodings != null && session.ClientEncodings.Contains(VncEncoding.CopyRect);
+            var region = VncRectangle.Intersect(fbr.Region, new VncRectangle(0, 0, fb.Width, fb.Height));
 
             this.logger?.LogDebug($"Responding to an update request for region {region}.");
 
@@ -117,81 +145,570 @@ namespace RemoteViewing.Vnc.Server
             {
                 lock (this.cachedFramebuffer.SyncRoot)
                 {
-                    var actualBuffer = this.Framebuffer.GetBuffer();
-                    var bufferedBuffer = this.cachedFramebuffer.GetBuffer();
-
-                    // In this block, we will determine which rectangles need updating. Right now, we consider
-                    // each line at once. It's not a very efficient algorithm, but it works.
-                    // We're going to start at the upper-left position of the region, and then we will work our way down,
-                    // on a line by line basis, to determine if each line is still valid.
-                    // isLineInvalid will indicate, on a line-by-line basis, whether a line is still valid or not.
-                    for (int y = region.Y; y < region.Y + region.Height; y++)
-                    {
-                        subregion.X = region.X;
-                        subregion.Y = y;
-                        subregion.Width = region.Width;
-                        subregion.Height = 1;
-
-                        // For a given y, the x pixels are stored sequentially in the array
-                        // starting at y * stride (number of bytes per row); for each x
-                        // value there are bpp bytes of data (4 for a 32-bit integer); we are looking
-                        // for pixels between x and x + w so this translates to
-                        // y * stride + bpp * x and y * stride + bpp * (x + w)
-                        int srcOffset = (y * this.Framebuffer.Stride) + (bpp * region.X);
-                        int length = bpp * region.Width;
-
-                        var isValid = actualBuffer.AsSpan().Slice(srcOffset, length)
-                                          .SequenceCompareTo(bufferedBuffer.AsSpan().Slice(srcOffset, length)) == 0;
-
-                        if (!isValid)
-                        {
-                            try
-                            {
-                                Buffer.BlockCopy(actualBuffer, srcOffset, bufferedBuffer, srcOffset, length);
-                            }
-                            catch
-                            {
-                                throw;
-                            }
-                        }
+                    var isTileDamaged = this.ReadDamage(region);
 
-                        this.isLineInvalid[y - region.Y] = !isValid;
+                    if (detectMoves)
+                    {
+                        this.DetectMovesAndInvalidateChangedTiles(region, isTileDamaged);
+                    }
+                    else if (incremental)
+                    {
+                        this.InvalidateChangedTiles(region, isTileDamaged);
+                    }
+                    else
+                    {
+                        // The client has asked for the entire region, so there's no need to compare anything;
+                        // just bring the cache up to date.
+                        this.CopyToCache(region);
                     }
                 } // lock
             } // lock
 
+            if (detectMoves)
+            {
+                // The moves must be sent before the tiles which were invalidated, as the client
+                // copies the data it has at the time it processes the CopyRect rectangle.
+                foreach (var move in this.moves)
+                {
+                    session.FramebufferManualCopyRegion(move.Target, move.SourceX, move.SourceY);
+                }
+
+                InvalidateMergedTiles(session, region, this.isTileInvalid, this.tileColumns);
+            }
+            else if (incremental)
+            {
+                InvalidateMergedTiles(session, region, this.isTileInvalid, this.tileColumns);
+            }
+            else if (!region.IsEmpty)
+            {
+                session.FramebufferManualInvalidate(region);
+            }
+
+            return session.FramebufferManualEndUpdate();
+        }
+
+        /// <summary>
+        /// Brings the cache up to date with the framebuffer, and determines which regions have changed.
+        /// </summary>
+        /// <param name="incremental">
+        /// <see langword="true"/> to only return the regions which have changed since the previous call;
+        /// <see langword="false"/> to return the entire framebuffer.
+        /// </param>
+        /// <param name="regions">
+        /// A list to which the regions are added.
+        /// </param>
+        internal void GetChangedRegions(bool incremental, List<VncRectangle> regions)
+        {
+            var fb = this.Framebuffer;
+            var region = new VncRectangle(0, 0, fb.Width, fb.Height);
+
+            lock (fb.SyncRoot)
+            {
+                lock (this.cachedFramebuffer.SyncRoot)
+                {
+                    var isTileDamaged = this.ReadDamage(region);
+
+                    if (incremental)
+                    {
+                        this.InvalidateChangedTiles(region, isTileDamaged);
+                    }
+                    else
+                    {
+                        this.CopyToCache(region);
+                    }
+                }
+            }
+
             if (incremental)
             {
-                // Determine logical group of lines which are invalid. We find the first line which is invalid,
-                // create a new region which contains the all invalid lines which immediately follow the current line.
-                // If we find a valid line, we'll create a new region.
-                int? y = null;
+                MergeTiles(region, this.isTileInvalid, this.tileColumns, regions);
+            }
+            else if (!region.IsEmpty)
+            {
+                regions.Add(region);
+            }
+        }
+
+        /// <summary>
+        /// Compares a tile of a framebuffer with the same tile in a cached copy of that framebuffer,
+        /// and updates the cached copy if the tile has changed.
+        /// </summary>
+        /// <param name="actualBuffer">
+        /// The framebuffer data.
+        /// </param>
+        /// <param name="bufferedBuffer">
+        /// The cached framebuffer data.
+        /// </param>
+        /// <param name="stride">
+        /// The stride of both buffers.
+        /// </param>
+        /// <param name="bpp">
+        /// The number of bytes per pixel.
+        /// </param>
+        /// <param name="left">
+        /// The left edge of the tile.
+        /// </param>
+        /// <param name="top">
+        /// The top edge of the tile.
+        /// </param>
+        /// <param name="right">
+        /// The right edge of the tile (exclusive).
+        /// </param>
+        /// <param name="bottom">
+        /// The bottom edge of the tile (exclusive).
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the tile has changed; otherwise, <see langword="false"/>.
+        /// </returns>
+        internal static bool CompareAndCopyTile(byte[] actualBuffer, byte[] bufferedBuffer, int stride, int bpp, int left, int top, int right, int bottom)
+        {
+            int length = bpp * (right - left);
+            int y = FindChangedLine(actualBuffer, bufferedBuffer, stride, bpp, left, top, right, bottom);
+
+            if (y == bottom)
+            {
+                return false;
+            }
 
-                for (int line = 0; line < region.Height; line++)
+            // The lines above y have already been found to be equal; only copy the remainder of the tile.
+            for (; y < bottom; y++)
+            {
+                int offset = (y * stride) + (bpp * left);
+                Buffer.BlockCopy(actualBuffer, offset, bufferedBuffer, offset, length);
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Compares a tile of a framebuffer with the same tile in a cached copy of that framebuffer.
+        /// </summary>
+        /// <param name="actualBuffer">
+        /// The framebuffer data.
+        /// </param>
+        /// <param name="bufferedBuffer">
+        /// The cached framebuffer data.
+        /// </param>
+        /// <param name="stride">
+        /// The stride of both buffers.
+        /// </param>
+        /// <param name="bpp">
+        /// The number of bytes per pixel.
+        /// </param>
+        /// <param name="left">
+        /// The left edge of the tile.
+        /// </param>
+        /// <param name="top">
+        /// The top edge of the tile.
+        /// </param>
+        /// <param name="right">
+        /// The right edge of the tile (exclusive).
+        /// </param>
+        /// <param name="bottom">
+        /// The bottom edge of the tile (exclusive).
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the tile has changed; otherwise, <see langword="false"/>.
+        /// </returns>
+        internal static bool IsTileChanged(byte[] actualBuffer, byte[] bufferedBuffer, int stride, int bpp, int left, int top, int right, int bottom)
+        {
+            return FindChangedLine(actualBuffer, bufferedBuffer, stride, bpp, left, top, right, bottom) < bottom;
+        }
+
+        /// <summary>
+        /// Marks the tiles which overlap a number of regions.
+        /// </summary>
+        /// <param name="regions">
+        /// The regions. Parts of the regions which fall outside the framebuffer are ignored.
+        /// </param>
+        /// <param name="width">
+        /// The width of the framebuffer.
+        /// </param>
+        /// <param name="height">
+        /// The height of the framebuffer.
+        /// </param>
+        /// <param name="isTileMarked">
+        /// For each tile, stored row by row, whether the tile overlaps any of the regions. Tiles which don't overlap
+        /// any region are left unchanged.
+        /// </param>
+        /// <param name="tileColumns">
+        /// The number of tile columns in the framebuffer.
+        /// </param>
+        internal static void MarkTiles(List<VncRectangle> regions, int width, int height, bool[] isTileMarked, int tileColumns)
+        {
+            var bounds = new VncRectangle(0, 0, width, height);
+
+            foreach (var damage in regions)
+            {
+                var region = VncRectangle.Intersect(damage, bounds);
+
+                if (region.IsEmpty)
+                {
+                    continue;
+                }
+
+                for (int row = region.Y / TileSize; row <= (region.Y + region.Height - 1) / TileSize; row++)
                 {
-                    if (y == null && this.isLineInvalid[line])
+                    for (int column = region.X / TileSize; column <= (region.X + region.Width - 1) / TileSize; column++)
                     {
-                        y = region.Y + line;
+                        isTileMarked[(row * tileColumns) + column] = true;
                     }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Merges adjacent invalid tiles into rectangles and invalidates them on the session.
+        /// </summary>
+        /// <param name="session">
+        /// The session to invalidate.
+        /// </param>
+        /// <param name="region">
+        /// The region which was inspected. The rectangles are clipped to this region.
+        /// </param>
+        /// <param name="isTileInvalid">
+        /// For each tile, stored row by row, whether the tile is invalid.
+        /// </param>
+        /// <param name="tileColumns">
+        /// The number of tile columns in the framebuffer.
+        /// </param>
+        internal static void InvalidateMergedTiles(IVncServerSession session, VncRectangle region, bool[] isTileInvalid, int tileColumns)
+        {
+            var rectangles = new List<VncRectangle>();
+            MergeTiles(region, isTileInvalid, tileColumns, rectangles);
+
+            foreach (var rectangle in rectangles)
+            {
+                session.FramebufferManualInvalidate(rectangle);
+            }
+        }
 
-                    if (y != null && (!this.isLineInvalid[line] || line == region.Height - 1))
+        /// <summary>
+        /// Merges adjacent invalid tiles into rectangles.
+        /// </summary>
+        /// <param name="region">
+        /// The region which was inspected. The rectangles are clipped to this region.
+        /// </param>
+        /// <param name="isTileInvalid">
+        /// For each tile, stored row by row, whether the tile is invalid.
+        /// </param>
+        /// <param name="tileColumns">
+        /// The number of tile columns in the framebuffer.
+        /// </param>
+        /// <param name="rectangles">
+        /// A list to which the merged rectangles are added.
+        /// </param>
+        internal static void MergeTiles(VncRectangle region, bool[] isTileInvalid, int tileColumns, List<VncRectangle> rectangles)
+        {
+            if (region.IsEmpty)
+            {
+                return;
+            }
+
+            // Horizontal runs of invalid tiles are extended downwards for as long as the row below
+            // contains a run with exactly the same columns. Runs which can't be extended are flushed.
+            // The open runs are expressed in tiles, not in pixels; their height is only known once they are flushed.
+            var open = new List<VncRectangle>();
+            var next = new List<VncRectangle>();
+
+            int firstColumn = region.X / TileSize;
+            int lastColumn = (region.X + region.Width - 1) / TileSize;
+            int firstRow = region.Y / TileSize;
+            int lastRow = (region.Y + region.Height - 1) / TileSize;
+
+            for (int row = firstRow; row <= lastRow + 1; row++)
+            {
+                next.Clear();
+
+                if (row <= lastRow)
+                {
+                    for (int column = firstColumn; column <= lastColumn; column++)
                     {
-                        // Flush
-                        subregion.X = region.X;
-                        subregion.Y = region.Y + y.Value;
-                        subregion.Width = region.Width;
-                        subregion.Height = line - y.Value + 1;
-                        session.FramebufferManualInvalidate(subregion);
-                        y = null;
+                        if (!isTileInvalid[(row * tileColumns) + column])
+                        {
+                            continue;
+                        }
+
+                        int first = column;
+                        while (column < lastColumn && isTileInvalid[(row * tileColumns) + column + 1])
+                        {
+                            column++;
+                        }
+
+                        var width = column - first + 1;
+                        var index = open.FindIndex(r => r.X == first && r.Width == width);
+                        if (index >= 0)
+                        {
+                            next.Add(open[index]);
+                            open.RemoveAt(index);
+                        }
+                        else
+                        {
+                            next.Add(new VncRectangle(first, row, width, 0));
+                        }
                     }
                 }
+
+                foreach (var run in open)
+                {
+                    var subregion = new VncRectangle(
+                        run.X * TileSize,
+                        run.Y * TileSize,
+                        run.Width * TileSize,
+                        (row - run.Y) * TileSize);
+
+                    rectangles.Add(VncRectangle.Intersect(subregion, region));
+                }
+
+                var swap = open;
+                open = next;
+                next = swap;
             }
-            else
+        }
+
+        /// <summary>
+        /// Finds the first line of a tile which differs between a framebuffer and its cached copy.
+        /// </summary>
+        /// <param name="actualBuffer">
+        /// The framebuffer data.
+        /// </param>
+        /// <param name="bufferedBuffer">
+        /// The cached framebuffer data.
+        /// </param>
+        /// <param name="stride">
+        /// The stride of both buffers.
+        /// </param>
+        /// <param name="bpp">
+        /// The number of bytes per pixel.
+        /// </param>
+        /// <param name="left">
+        /// The left edge of the tile.
+        /// </param>
+        /// <param name="top">
+        /// The top edge of the tile.
+        /// </param>
+        /// <param name="right">
+        /// The right edge of the tile (exclusive).
+        /// </param>
+        /// <param name="bottom">
+        /// The bottom edge of the tile (exclusive).
+        /// </param>
+        /// <returns>
+        /// The Y coordinate of the first line which has changed, or <paramref name="bottom"/> if the tile hasn't changed.
+        /// </returns>
+        private static int FindChangedLine(byte[] actualBuffer, byte[] bufferedBuffer, int stride, int bpp, int left, int top, int right, int bottom)
+        {
+            int length = bpp * (right - left);
+
+            // For a given y, the x pixels are stored sequentially in the array
+            // starting at y * stride (number of bytes per row); for each x
+            // value there are bpp bytes of data (4 for a 32-bit integer).
+            // SequenceEqual is vectorized, and we stop comparing a tile as soon
+            // as we've found a line which has changed.
+            int y = top;
+            for (; y < bottom; y++)
             {
-                session.FramebufferManualInvalidate(region);
+                int offset = (y * stride) + (bpp * left);
+
+                if (!actualBuffer.AsSpan(offset, length).SequenceEqual(bufferedBuffer.AsSpan(offset, length)))
+                {
+                    break;
+                }
             }
 
-            return session.FramebufferManualEndUpdate();
+            return y;
+        }
+
+        /// <summary>
+        /// Compares the framebuffer with the cached framebuffer, one tile at a time, marks
+        /// the tiles which have changed as invalid and copies their contents into the cache.
+        /// </summary>
+        /// <param name="region">
+        /// The region of the framebuffer to inspect.
+        /// </param>
+        /// <param name="isTileDamaged">
+        /// For each tile, whether the framebuffer source has reported it as changed; or <see langword="null"/>
+        /// to compare all tiles.
+        /// </param>
+        private void InvalidateChangedTiles(VncRectangle region, bool[] isTileDamaged)
+        {
+            Array.Clear(this.isTileInvalid, 0, this.isTileInvalid.Length);
+
+            if (region.IsEmpty)
+            {
+                return;
+            }
+
+            var actualBuffer = this.Framebuffer.GetBuffer();
+            var bufferedBuffer = this.cachedFramebuffer.GetBuffer();
+            int stride = this.Framebuffer.Stride;
+            int bpp = this.Framebuffer.PixelFormat.BytesPerPixel;
+
+            int firstColumn = region.X / TileSize;
+            int lastColumn = (region.X + region.Width - 1) / TileSize;
+            int firstRow = region.Y / TileSize;
+            int lastRow = (region.Y + region.Height - 1) / TileSize;
+
+            for (int row = firstRow; row <= lastRow; row++)
+            {
+                int top = Math.Max(region.Y, row * TileSize);
+                int bottom = Math.Min(region.Y + region.Height, (row + 1) * TileSize);
+
+                for (int column = firstColumn; column <= lastColumn; column++)
+                {
+                    if (isTileDamaged != null && !isTileDamaged[(row * this.tileColumns) + column])
+                    {
+                        continue;
+                    }
+
+                    int left = Math.Max(region.X, column * TileSize);
+                    int right = Math.Min(region.X + region.Width, (column + 1) * TileSize);
+
+                    if (CompareAndCopyTile(actualBuffer, bufferedBuffer, stride, bpp, left, top, right, bottom))
+                    {
+                        this.isTileInvalid[(row * this.tileColumns) + column] = true;
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Compares the framebuffer with the cached framebuffer and detects blocks which have moved. The moves
+        /// are applied to the cache, after which the tiles which still differ are marked as invalid and copied
+        /// into the cache.
+        /// </summary>
+        /// <param name="region">
+        /// The region of the framebuffer to inspect.
+        /// </param>
+        /// <param name="isTileDamaged">
+        /// For each tile, whether the framebuffer source has reported it as changed; or <see langword="null"/>
+        /// to compare all tiles.
+        /// </param>
+        private void DetectMovesAndInvalidateChangedTiles(VncRectangle region, bool[] isTileDamaged)
+        {
+            Array.Clear(this.isTileInvalid, 0, this.isTileInvalid.Length);
+            this.moves.Clear();
+
+            if (region.IsEmpty)
+            {
+                return;
+            }
+
+            var actualBuffer = this.Framebuffer.GetBuffer();
+            var bufferedBuffer = this.cachedFramebuffer.GetBuffer();
+            int stride = this.Framebuffer.Stride;
+            int bpp = this.Framebuffer.PixelFormat.BytesPerPixel;
+
+            int firstColumn = region.X / TileSize;
+            int lastColumn = (region.X + region.Width - 1) / TileSize;
+            int firstRow = region.Y / TileSize;
+            int lastRow = (region.Y + region.Height - 1) / TileSize;
+
+            // The first pass only determines which tiles have changed; the cache must still contain
+            // the previous frame when looking for moves.
+            for (int row = firstRow; row <= lastRow; row++)
+            {
+                int top = Math.Max(region.Y, row * TileSize);
+                int bottom = Math.Min(region.Y + region.Height, (row + 1) * TileSize);
+
+                for (int column = firstColumn; column <= lastColumn; column++)
+                {
+                    int left = Math.Max(region.X, column * TileSize);
+                    int right = Math.Min(region.X + region.Width, (column + 1) * TileSize);
+
+                    int index = (row * this.tileColumns) + column;
+
+                    // Only damaged tiles can have changed, or be the target of a move.
+                    this.isTileInvalid[index] = (isTileDamaged == null || isTileDamaged[index])
+                        && IsTileChanged(actualBuffer, bufferedBuffer, stride, bpp, left, top, right, bottom);
+                }
+            }
+
+            this.motionDetector.DetectMoves(actualBuffer, bufferedBuffer, stride, bpp, region, this.isTileInvalid, this.tileColumns, this.moves);
+
+            // Bring the cache in line with what the client will have once it has processed the moves. The tiles
+            // which overlap a move have to be compared again; the others haven't changed since the first pass.
+            foreach (var move in this.moves)
+            {
+                VncMotionDetector.ApplyMove(bufferedBuffer, stride, bpp, move);
+
+                var target = move.Target;
+                for (int row = target.Y / TileSize; row <= (target.Y + target.Height - 1) / TileSize; row++)
+                {
+                    for (int column = target.X / TileSize; column <= (target.X + target.Width - 1) / TileSize; column++)
+                    {
+                        this.isTileInvalid[(row * this.tileColumns) + column] = true;
+                    }
+                }
+            }
+
+            for (int row = firstRow; row <= lastRow; row++)
+            {
+                int top = Math.Max(region.Y, row * TileSize);
+                int bottom = Math.Min(region.Y + region.Height, (row + 1) * TileSize);
+
+                for (int column = firstColumn; column <= lastColumn; column++)
+                {
+                    int index = (row * this.tileColumns) + column;
+
+                    if (this.isTileInvalid[index])
+                    {
+                        int left = Math.Max(region.X, column * TileSize);
+                        int right = Math.Min(region.X + region.Width, (column + 1) * TileSize);
+
+                        this.isTileInvalid[index] = CompareAndCopyTile(actualBuffer, bufferedBuffer, stride, bpp, left, top, right, bottom);
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Determines which tiles the framebuffer source has reported as changed since the cache was last brought
+        /// up to date. The caller must hold the <see cref="VncFramebuffer.SyncRoot"/> of the framebuffer.
+        /// </summary>
+        /// <param name="region">
+        /// The region of the framebuffer which is about to be brought up to date.
+        /// </param>
+        /// <returns>
+        /// For each tile, whether it has been damaged; or <see langword="null"/> if all tiles in
+        /// <paramref name="region"/> must be compared.
+        /// </returns>
+        private bool[] ReadDamage(VncRectangle region)
+        {
+            var fb = this.Framebuffer;
+
+            // The damage is tracked for the framebuffer as a whole. An update of part of the framebuffer leaves the
+            // other tiles out of date, so the damage is read again when the entire framebuffer is updated.
+            if (region != new VncRectangle(0, 0, fb.Width, fb.Height)
+                || !this.damageReader.Read(this.DamageSource))
+            {
+                return null;
+            }
+
+            Array.Clear(this.isTileDamaged, 0, this.isTileDamaged.Length);
+            MarkTiles(this.damageReader.Damage, fb.Width, fb.Height, this.isTileDamaged, this.tileColumns);
+            return this.isTileDamaged;
+        }
+
+        /// <summary>
+        /// Copies a region of the framebuffer into the cache.
+        /// </summary>
+        /// <param name="region">
+        /// The region to copy.
+        /// </param>
+        private void CopyToCache(VncRectangle region)
+        {
+            var actualBuffer = this.Framebuffer.GetBuffer();
+            var bufferedBuffer = this.cachedFramebuffer.GetBuffer();
+            int stride = this.Framebuffer.Stride;
+            int bpp = this.Framebuffer.PixelFormat.BytesPerPixel;
+            int length = bpp * region.Width;
+
+            for (int y = region.Y; y < region.Y + region.Height; y++)
+            {
+                int offset = (y * stride) + (bpp * region.X);
+                Buffer.BlockCopy(actualBuffer, offset, bufferedBuffer, offset, length);
+            }
         }
     }
 }
@@ -0,0 +1,75 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Describes a block of the framebuffer which has moved, for example because a window was scrolled.
+    /// </summary>
+    internal struct VncFramebufferMove
+    {
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncFramebufferMove"/> struct.
+        /// </summary>
+        /// <param name="target">
+        /// The region to which the block has moved.
+        /// </param>
+        /// <param name="sourceX">
+        /// The X coordinate of the block before it was moved.
+        /// </param>
+        /// <param name="sourceY">
+        /// The Y coordinate of the block before it was moved.
+        /// </param>
+        public VncFramebufferMove(VncRectangle target, int sourceX, int sourceY)
+        {
+            this.Target = target;
+            this.SourceX = sourceX;
+            this.SourceY = sourceY;
+        }
+
+        /// <summary>
+        /// Gets the region to which the block has moved.
+        /// </summary>
+        public VncRectangle Target { get; }
+
+        /// <summary>
+        /// Gets the X coordinate of the block before it was moved.
+        /// </summary>
+        public int SourceX { get; }
+
+        /// <summary>
+        /// Gets the Y coordinate of the block before it was moved.
+        /// </summary>
+        public int SourceY { get; }
+
+        /// <summary>
+        /// Gets the region of the block before it was moved.
+        /// </summary>
+        public VncRectangle Source => new VncRectangle(this.SourceX, this.SourceY, this.Target.Width, this.Target.Height);
+    }
+}
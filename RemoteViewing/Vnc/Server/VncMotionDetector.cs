@@ -0,0 +1,317 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Detects blocks of a framebuffer which have moved vertically between two frames, such as a scrolled
+    /// window or document, so that they can be sent to the client as a <see cref="VncEncoding.CopyRect"/>
+    /// instead of being encoded again.
+    /// </summary>
+    /// <remarks>
+    /// The framebuffer is inspected one column of tiles at a time. Within a column, each vertical run of changed tiles
+    /// is considered as a band. A hash is computed of each row of the band, in both frames, and each changed row votes
+    /// for the vertical offset at which its hash was found in the previous frame. The offset with the most votes is
+    /// verified by comparing the rows byte by byte, and the longest run of matching rows is reported as a move.
+    /// Moves of adjacent columns which share the same rows and offset are merged.
+    /// </remarks>
+    internal sealed class VncMotionDetector
+    {
+        /// <summary>
+        /// The minimum height of a block, in pixels, before it is reported as a move. Smaller moves
+        /// are not worth the overhead of an additional rectangle.
+        /// </summary>
+        internal const int MinimumMoveHeight = 16;
+
+        // Maps the hash of each row of the previous frame to the index of that row within the band,
+        // or to -1 if multiple rows share the same hash (e.g. blank lines).
+        private readonly Dictionary<ulong, int> previousRows = new Dictionary<ulong, int>();
+
+        // The number of votes for each vertical offset.
+        private readonly Dictionary<int, int> votes = new Dictionary<int, int>();
+
+        private ulong[] previousHashes = new ulong[VncFramebufferCache.TileSize];
+        private ulong[] currentHashes = new ulong[VncFramebufferCache.TileSize];
+
+        /// <summary>
+        /// Applies a move to a buffer, by copying the source of the move to its target.
+        /// </summary>
+        /// <param name="buffer">
+        /// The framebuffer data.
+        /// </param>
+        /// <param name="stride">
+        /// The stride of the buffer.
+        /// </param>
+        /// <param name="bpp">
+        /// The number of bytes per pixel.
+        /// </param>
+        /// <param name="move">
+        /// The move to apply.
+        /// </param>
+        public static void ApplyMove(byte[] buffer, int stride, int bpp, VncFramebufferMove move)
+        {
+            var target = move.Target;
+            int length = bpp * target.Width;
+            int dy = target.Y - move.SourceY;
+
+            // The source and target usually overlap; copy the rows in an order which doesn't
+            // overwrite source rows before they've been copied.
+            for (int i = 0; i < target.Height; i++)
+            {
+                int y = dy > 0 ? target.Height - 1 - i : i;
+                int sourceOffset = ((move.SourceY + y) * stride) + (bpp * move.SourceX);
+                int targetOffset = ((target.Y + y) * stride) + (bpp * target.X);
+                Buffer.BlockCopy(buffer, sourceOffset, buffer, targetOffset, length);
+            }
+        }
+
+        /// <summary>
+        /// Detects the blocks of a framebuffer which have moved vertically.
+        /// </summary>
+        /// <param name="currentBuffer">
+        /// The current framebuffer data.
+        /// </param>
+        /// <param name="previousBuffer">
+        /// The previous framebuffer data.
+        /// </param>
+        /// <param name="stride">
+        /// The stride of both buffers.
+        /// </param>
+        /// <param name="bpp">
+        /// The number of bytes per pixel.
+        /// </param>
+        /// <param name="region">
+        /// The region of the framebuffer to inspect. Moves are contained in this region.
+        /// </param>
+        /// <param name="isTileChanged">
+        /// For each tile, stored row by row, whether the tile has changed.
+        /// </param>
+        /// <param name="tileColumns">
+        /// The number of tile columns in the framebuffer.
+        /// </param>
+        /// <param name="moves">
+        /// Receives the moves which were detected. The targets of these moves don't overlap.
+        /// </param>
+        public void DetectMoves(byte[] currentBuffer, byte[] previousBuffer, int stride, int bpp, VncRectangle region, bool[] isTileChanged, int tileColumns, List<VncFramebufferMove> moves)
+        {
+            const int tileSize = VncFramebufferCache.TileSize;
+
+            moves.Clear();
+
+            if (region.IsEmpty)
+            {
+                return;
+            }
+
+            int firstColumn = region.X / tileSize;
+            int lastColumn = (region.X + region.Width - 1) / tileSize;
+            int firstRow = region.Y / tileSize;
+            int lastRow = (region.Y + region.Height - 1) / tileSize;
+
+            for (int column = firstColumn; column <= lastColumn; column++)
+            {
+                int left = Math.Max(region.X, column * tileSize);
+                int right = Math.Min(region.X + region.Width, (column + 1) * tileSize);
+
+                for (int row = firstRow; row <= lastRow; row++)
+                {
+                    if (!isTileChanged[(row * tileColumns) + column])
+                    {
+                        continue;
+                    }
+
+                    int first = row;
+                    while (row < lastRow && isTileChanged[((row + 1) * tileColumns) + column])
+                    {
+                        row++;
+                    }
+
+                    int top = Math.Max(region.Y, first * tileSize);
+                    int bottom = Math.Min(region.Y + region.Height, (row + 1) * tileSize);
+
+                    if (bottom - top >= MinimumMoveHeight)
+                    {
+                        this.DetectMove(currentBuffer, previousBuffer, stride, bpp, left, top, right, bottom, moves);
+                    }
+                }
+            }
+        }
+
+        private static ulong GetRowHash(byte[] buffer, int offset, int length)
+        {
+            var row = buffer.AsSpan(offset, length);
+            var values = MemoryMarshal.Cast<byte, ulong>(row);
+
+            // FNV-1a, but processing 8 bytes at a time. Collisions are harmless, because
+            // candidate moves are always verified by comparing the actual data.
+            ulong hash = 14695981039346656037;
+
+            for (int i = 0; i < values.Length; i++)
+            {
+                hash = (hash ^ values[i]) * 1099511628211;
+            }
+
+            for (int i = values.Length * sizeof(ulong); i < row.Length; i++)
+            {
+                hash = (hash ^ row[i]) * 1099511628211;
+            }
+
+            return hash;
+        }
+
+        private static void AddMove(List<VncFramebufferMove> moves, VncFramebufferMove move)
+        {
+            var target = move.Target;
+
+            for (int i = 0; i < moves.Count; i++)
+            {
+                var other = moves[i].Target;
+
+                if (other.X + other.Width == target.X
+                    && other.Y == target.Y
+                    && other.Height == target.Height
+                    && moves[i].SourceY == move.SourceY)
+                {
+                    moves[i] = new VncFramebufferMove(
+                        new VncRectangle(other.X, other.Y, other.Width + target.Width, other.Height),
+                        moves[i].SourceX,
+                        moves[i].SourceY);
+                    return;
+                }
+            }
+
+            moves.Add(move);
+        }
+
+        private void DetectMove(byte[] currentBuffer, byte[] previousBuffer, int stride, int bpp, int left, int top, int right, int bottom, List<VncFramebufferMove> moves)
+        {
+            int height = bottom - top;
+            int length = bpp * (right - left);
+
+            if (this.currentHashes.Length < height)
+            {
+                this.currentHashes = new ulong[height];
+                this.previousHashes = new ulong[height];
+            }
+
+            this.previousRows.Clear();
+
+            for (int i = 0; i < height; i++)
+            {
+                int offset = ((top + i) * stride) + (bpp * left);
+                var previousHash = this.previousHashes[i] = GetRowHash(previousBuffer, offset, length);
+                this.currentHashes[i] = GetRowHash(currentBuffer, offset, length);
+
+                if (this.previousRows.ContainsKey(previousHash))
+                {
+                    this.previousRows[previousHash] = -1;
+                }
+                else
+                {
+                    this.previousRows.Add(previousHash, i);
+                }
+            }
+
+            // Each row which has changed votes for the offset at which it was found in the previous frame.
+            this.votes.Clear();
+            int bestOffset = 0;
+            int bestVotes = 0;
+
+            for (int i = 0; i < height; i++)
+            {
+                if (this.currentHashes[i] == this.previousHashes[i]
+                    || !this.previousRows.TryGetValue(this.currentHashes[i], out int previousRow)
+                    || previousRow < 0)
+                {
+                    continue;
+                }
+
+                int offset = i - previousRow;
+                this.votes.TryGetValue(offset, out int count);
+                this.votes[offset] = ++count;
+
+                if (count > bestVotes)
+                {
+                    bestOffset = offset;
+                    bestVotes = count;
+                }
+            }
+
+            if (bestVotes < MinimumMoveHeight)
+            {
+                return;
+            }
+
+            // Find the longest run of rows which match the previous frame at that offset.
+            int first = Math.Max(0, bestOffset);
+            int last = Math.Min(height, height + bestOffset);
+            int runStart = 0;
+            int runLength = 0;
+            int start = -1;
+
+            for (int i = first; i <= last; i++)
+            {
+                if (i < last && this.currentHashes[i] == this.previousHashes[i - bestOffset])
+                {
+                    int currentOffset = ((top + i) * stride) + (bpp * left);
+                    int previousOffset = ((top + i - bestOffset) * stride) + (bpp * left);
+
+                    if (currentBuffer.AsSpan(currentOffset, length).SequenceEqual(previousBuffer.AsSpan(previousOffset, length)))
+                    {
+                        start = start < 0 ? i : start;
+                        continue;
+                    }
+                }
+
+                if (start >= 0 && i - start > runLength)
+                {
+                    runStart = start;
+                    runLength = i - start;
+                }
+
+                start = -1;
+            }
+
+            if (runLength < MinimumMoveHeight)
+            {
+                return;
+            }
+
+            AddMove(
+                moves,
+                new VncFramebufferMove(
+                    new VncRectangle(left, top + runStart, right - left, runLength),
+                    left,
+                    top + runStart - bestOffset));
+        }
+    }
+}
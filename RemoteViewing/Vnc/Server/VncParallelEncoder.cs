@@ -0,0 +1,166 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Concurrent;
+using System.Diagnostics;
+using System.IO;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Encodes the rectangles of a framebuffer update on multiple threads, using workers created by
+    /// <see cref="VncEncoder.CreateWorker"/>.
+    /// </summary>
+    /// <remarks>
+    /// Rectangles are encoded to a buffer, and the session writes the buffers to the client in order, as soon as
+    /// each one is available. Rectangles which can't be encoded independently (for example, because they depend on
+    /// the state of a zlib stream) are encoded by the session itself, when their turn comes.
+    /// </remarks>
+    internal sealed class VncParallelEncoder
+    {
+        /// <summary>
+        /// The minimum number of pixels in a rectangle for it to be encoded on a worker thread. Smaller
+        /// rectangles are cheap to encode, and are not worth the overhead.
+        /// </summary>
+        internal const int MinimumArea = 4096;
+
+        private readonly ConcurrentBag<VncEncoder> workers = new ConcurrentBag<VncEncoder>();
+        private VncEncoder encoder;
+        private bool supportsWorkers;
+        private int maxThreads = 1;
+        private TaskScheduler scheduler;
+
+        /// <summary>
+        /// Gets or sets the maximum number of rectangles which are encoded at the same time.
+        /// </summary>
+        public int MaxThreads
+        {
+            get
+            {
+                return this.maxThreads;
+            }
+
+            set
+            {
+                if (value < 1)
+                {
+                    throw new ArgumentOutOfRangeException(nameof(value));
+                }
+
+                this.maxThreads = value;
+                this.scheduler = value > 1 ? new ConcurrentExclusiveSchedulerPair(TaskScheduler.Default, value).ConcurrentScheduler : null;
+            }
+        }
+
+        /// <summary>
+        /// Starts encoding a rectangle on a worker thread.
+        /// </summary>
+        /// <param name="encoder">
+        /// The encoder used by the session.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The <see cref="VncPixelFormat"/> being used.
+        /// </param>
+        /// <param name="region">
+        /// The dimesions of the rectangle.
+        /// </param>
+        /// <param name="contents">
+        /// The contents of the rectangle, in raw pixel format. The contents must not be modified until
+        /// the returned task has completed.
+        /// </param>
+        /// <param name="statistics">
+        /// If set, the statistics to which the time spent encoding the rectangle is added.
+        /// </param>
+        /// <returns>
+        /// A task whose result holds the encoded rectangle, or is <see langword="null"/> if <paramref name="encoder"/>
+        /// must encode the rectangle itself. Returns <see langword="null"/> instead of a task when parallel encoding
+        /// is disabled, or not worth it for this rectangle.
+        /// </returns>
+        public Task<MemoryStream> Encode(VncEncoder encoder, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlyMemory<byte> contents, EncoderStatistics statistics = null)
+        {
+            var scheduler = this.scheduler;
+
+            if (scheduler == null || region.Area < MinimumArea || !this.SupportsWorkers(encoder))
+            {
+                return null;
+            }
+
+            return Task.Factory.StartNew(
+                () =>
+                {
+                    var timestamp = Stopwatch.GetTimestamp();
+
+                    if (!this.workers.TryTake(out VncEncoder worker))
+                    {
+                        worker = encoder.CreateWorker();
+                    }
+
+                    try
+                    {
+                        var buffer = new MemoryStream();
+                        return worker.TrySendIndependently(buffer, pixelFormat, region, contents.Span) ? buffer : null;
+                    }
+                    finally
+                    {
+                        this.workers.Add(worker);
+                        statistics?.AddEncodeTime(timestamp);
+                    }
+                },
+                CancellationToken.None,
+                TaskCreationOptions.DenyChildAttach,
+                scheduler);
+        }
+
+        private bool SupportsWorkers(VncEncoder encoder)
+        {
+            // Workers are created for a specific encoder; when the session switches encoders, start over.
+            // This happens between framebuffer updates, when no workers are in use.
+            if (encoder != this.encoder)
+            {
+                this.encoder = encoder;
+
+                while (this.workers.TryTake(out _))
+                {
+                }
+
+                var worker = encoder.CreateWorker();
+                this.supportsWorkers = worker != null;
+
+                if (worker != null)
+                {
+                    this.workers.Add(worker);
+                }
+            }
+
+            return this.supportsWorkers;
+        }
+    }
+}
@@ -0,0 +1,265 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Buffers;
+using System.IO;
+using System.IO.Pipelines;
+using System.Runtime.InteropServices;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Wraps the network stream of a <see cref="VncServerSession"/>, so that the session can receive and send data
+    /// without dedicating a thread to the connection.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// Incoming data is read using a <see cref="PipeReader"/>. The session waits asynchronously until a complete
+    /// message has been received, and then hands that message to the (synchronous) message handlers using
+    /// <see cref="SetMessage(ReadOnlyMemory{byte})"/>. Synchronous reads are served from that message, and never block.
+    /// </para>
+    /// <para>
+    /// Outgoing data is written to a <see cref="Pipe"/>, and sent to the network when the stream is flushed. Writes never
+    /// block: instead, the session checks <see cref="PendingBytes"/> before it sends a new framebuffer update. The
+    /// network stream is flushed once for all data which was flushed since it was last written to.
+    /// </para>
+    /// </remarks>
+    internal sealed class VncPipeStream : Stream
+    {
+        private readonly Stream stream;
+        private readonly Pipe output;
+        private ReadOnlyMemory<byte> message;
+        private long pendingBytes;
+        private bool disposed;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncPipeStream"/> class.
+        /// </summary>
+        /// <param name="stream">
+        /// The network stream.
+        /// </param>
+        public VncPipeStream(Stream stream)
+        {
+            this.stream = stream ?? throw new ArgumentNullException(nameof(stream));
+            this.Reader = PipeReader.Create(stream);
+            this.output = new Pipe(new PipeOptions(pauseWriterThreshold: 0, resumeWriterThreshold: 0, useSynchronizationContext: false));
+            _ = this.SendAsync();
+        }
+
+        /// <summary>
+        /// Occurs when all data which was written to this stream has been sent to the network.
+        /// </summary>
+        public event EventHandler Drained;
+
+        /// <summary>
+        /// Gets the <see cref="PipeReader"/> from which incoming data is read.
+        /// </summary>
+        public PipeReader Reader { get; }
+
+        /// <summary>
+        /// Gets the number of bytes which have been written to this stream, but which have not yet been
+        /// sent to the network.
+        /// </summary>
+        public long PendingBytes => Interlocked.Read(ref this.pendingBytes);
+
+        /// <inheritdoc/>
+        public override bool CanRead => true;
+
+        /// <inheritdoc/>
+        public override bool CanSeek => false;
+
+        /// <inheritdoc/>
+        public override bool CanWrite => true;
+
+        /// <inheritdoc/>
+        public override long Length => throw new NotSupportedException();
+
+        /// <inheritdoc/>
+        public override long Position
+        {
+            get => throw new NotSupportedException();
+            set => throw new NotSupportedException();
+        }
+
+        /// <summary>
+        /// Sets the message from which synchronous reads are served.
+        /// </summary>
+        /// <param name="message">
+        /// The message which is being handled, or an empty buffer once it has been handled.
+        /// </param>
+        public void SetMessage(ReadOnlyMemory<byte> message)
+        {
+            this.message = message;
+        }
+
+        /// <inheritdoc/>
+        public override int Read(byte[] buffer, int offset, int count)
+        {
+            if (this.message.IsEmpty)
+            {
+                // The message handlers should never read past the end of a message.
+                throw new VncException("Read past the end of the message.", VncFailureReason.SanityCheckFailed);
+            }
+
+            return this.ReadMessage(buffer, offset, count);
+        }
+
+        /// <inheritdoc/>
+        public override async Task<int> ReadAsync(byte[] buffer, int offset, int count, CancellationToken cancellationToken)
+        {
+            if (!this.message.IsEmpty)
+            {
+                return this.ReadMessage(buffer, offset, count);
+            }
+
+            var result = await this.Reader.ReadAsync(cancellationToken).ConfigureAwait(false);
+            var data = result.Buffer;
+
+            if (data.IsEmpty && result.IsCompleted)
+            {
+                this.Reader.AdvanceTo(data.End);
+                return 0;
+            }
+
+            count = (int)Math.Min(count, data.Length);
+            data.Slice(0, count).CopyTo(buffer.AsSpan(offset, count));
+            this.Reader.AdvanceTo(data.GetPosition(count));
+            return count;
+        }
+
+        /// <inheritdoc/>
+        public override void Write(byte[] buffer, int offset, int count)
+        {
+            try
+            {
+                this.output.Writer.Write(buffer.AsSpan(offset, count));
+                Interlocked.Add(ref this.pendingBytes, count);
+            }
+            catch (InvalidOperationException) when (this.disposed)
+            {
+                throw new ObjectDisposedException(nameof(VncPipeStream));
+            }
+        }
+
+        /// <inheritdoc/>
+        public override void Flush()
+        {
+            // The pipe never pauses the writer, so this completes synchronously; it
+            // only wakes up the loop which sends the data to the network.
+            try
+            {
+                this.output.Writer.FlushAsync().GetAwaiter().GetResult();
+            }
+            catch (InvalidOperationException) when (this.disposed)
+            {
+            }
+        }
+
+        /// <inheritdoc/>
+        public override long Seek(long offset, SeekOrigin origin)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        public override void SetLength(long value)
+        {
+            throw new NotSupportedException();
+        }
+
+        /// <inheritdoc/>
+        protected override void Dispose(bool disposing)
+        {
+            if (disposing && !this.disposed)
+            {
+                this.disposed = true;
+                this.output.Writer.Complete();
+                this.Reader.CancelPendingRead();
+                this.stream.Dispose();
+            }
+
+            base.Dispose(disposing);
+        }
+
+        private int ReadMessage(byte[] buffer, int offset, int count)
+        {
+            count = Math.Min(count, this.message.Length);
+            this.message.Span.Slice(0, count).CopyTo(buffer.AsSpan(offset, count));
+            this.message = this.message.Slice(count);
+            return count;
+        }
+
+        private async Task SendAsync()
+        {
+            var reader = this.output.Reader;
+
+            try
+            {
+                while (true)
+                {
+                    var result = await reader.ReadAsync().ConfigureAwait(false);
+                    var buffer = result.Buffer;
+
+                    // Everything which was flushed since the previous iteration is sent in one go.
+                    foreach (var segment in buffer)
+                    {
+                        MemoryMarshal.TryGetArray(segment, out ArraySegment<byte> array);
+                        await this.stream.WriteAsync(array.Array, array.Offset, array.Count).ConfigureAwait(false);
+                    }
+
+                    // Streams which frame their data, such as WebSockets, send one frame per flush.
+                    await this.stream.FlushAsync().ConfigureAwait(false);
+
+                    var pendingBytes = Interlocked.Add(ref this.pendingBytes, -buffer.Length);
+                    reader.AdvanceTo(buffer.End);
+
+                    if (pendingBytes == 0)
+                    {
+                        this.Drained?.Invoke(this, EventArgs.Empty);
+                    }
+
+                    if (result.IsCompleted)
+                    {
+                        break;
+                    }
+                }
+            }
+            catch (Exception)
+            {
+                // The connection was lost; the session will notice when it next reads from the stream.
+            }
+            finally
+            {
+                reader.Complete();
+            }
+        }
+    }
+}
@@ -0,0 +1,248 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Adapts the JPEG quality level and the update rate of a <see cref="VncServerSession"/> to the throughput
+    /// of the connection and the time it takes to encode framebuffer updates.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// The controller estimates how long it takes to send an average framebuffer update, based on the rate at
+    /// which the output of the session drains to the network, and how long it takes to encode an update.
+    /// </para>
+    /// <para>
+    /// When an update costs more time than the interval between updates, the JPEG quality is lowered first, so
+    /// that the client keeps receiving a smooth stream of updates. Once the quality is at its minimum (or when the
+    /// server can't encode updates fast enough), the update rate is lowered. When there is plenty of headroom,
+    /// the update rate is restored first, and the quality afterwards; the quality never exceeds the level which
+    /// was requested by the client.
+    /// </para>
+    /// </remarks>
+    internal sealed class VncQualityController
+    {
+        /// <summary>
+        /// The lowest update rate, in frames per second.
+        /// </summary>
+        internal const double MinimumUpdateRate = 1;
+
+        // The weight of a new sample in the moving averages.
+        private const double SampleWeight = 0.25;
+
+        /// <summary>
+        /// The minimum amount of time between two adjustments.
+        /// </summary>
+        internal static readonly TimeSpan AdjustInterval = TimeSpan.FromMilliseconds(250);
+
+        private double maximumUpdateRate = 15;
+        private int? maximumQualityLevel;
+
+        private bool isDraining;
+        private TimeSpan drainStart;
+        private long drainBytes;
+
+        private TimeSpan? lastAdjusted;
+
+        /// <summary>
+        /// Gets or sets the highest update rate, in frames per second.
+        /// </summary>
+        public double MaximumUpdateRate
+        {
+            get
+            {
+                return this.maximumUpdateRate;
+            }
+
+            set
+            {
+                this.maximumUpdateRate = value;
+                this.UpdateRate = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets the current update rate, in frames per second.
+        /// </summary>
+        public double UpdateRate
+        { get; private set; } = 15;
+
+        /// <summary>
+        /// Gets or sets the JPEG quality level requested by the client, ranging from 0 to 9, or
+        /// <see langword="null"/> if the client doesn't accept JPEG compression.
+        /// </summary>
+        public int? MaximumQualityLevel
+        {
+            get
+            {
+                return this.maximumQualityLevel;
+            }
+
+            set
+            {
+                this.maximumQualityLevel = value;
+                this.QualityLevel = this.QualityLevel == null || value == null ? value : Math.Min(this.QualityLevel.Value, value.Value);
+            }
+        }
+
+        /// <summary>
+        /// Gets the JPEG quality level to use, ranging from 0 to 9, or <see langword="null"/> if JPEG
+        /// compression should not be used.
+        /// </summary>
+        public int? QualityLevel
+        { get; private set; }
+
+        /// <summary>
+        /// Gets a value indicating whether the quality or update rate have been reduced.
+        /// </summary>
+        public bool IsConstrained => this.UpdateRate < this.MaximumUpdateRate || this.QualityLevel < this.MaximumQualityLevel;
+
+        /// <summary>
+        /// Gets the estimated throughput of the connection, in bytes per second, or 0 if it is not known yet.
+        /// </summary>
+        public double Bandwidth
+        { get; private set; }
+
+        /// <summary>
+        /// Gets the average size of a framebuffer update, in bytes.
+        /// </summary>
+        public double UpdateSize
+        { get; private set; }
+
+        /// <summary>
+        /// Gets the average time it takes to encode a framebuffer update.
+        /// </summary>
+        public TimeSpan EncodeTime
+        { get; private set; }
+
+        /// <summary>
+        /// Records a framebuffer update which has been queued for sending.
+        /// </summary>
+        /// <param name="count">
+        /// The size of the update, in bytes.
+        /// </param>
+        /// <param name="encodeTime">
+        /// The time it took to encode the update.
+        /// </param>
+        /// <param name="now">
+        /// The current time.
+        /// </param>
+        public void Queued(long count, TimeSpan encodeTime, TimeSpan now)
+        {
+            this.UpdateSize = Average(this.UpdateSize, count);
+            this.EncodeTime = TimeSpan.FromTicks((long)Average(this.EncodeTime.Ticks, encodeTime.Ticks));
+
+            if (!this.isDraining)
+            {
+                this.isDraining = true;
+                this.drainStart = now;
+                this.drainBytes = 0;
+            }
+
+            this.drainBytes += count;
+        }
+
+        /// <summary>
+        /// Records that all queued data has been sent to the network.
+        /// </summary>
+        /// <param name="now">
+        /// The current time.
+        /// </param>
+        public void Drained(TimeSpan now)
+        {
+            if (!this.isDraining)
+            {
+                return;
+            }
+
+            this.isDraining = false;
+
+            // Data which is sent within a millisecond doesn't tell much about the throughput, other than that
+            // it is high.
+            var elapsed = Math.Max((now - this.drainStart).TotalSeconds, 0.001);
+            this.Bandwidth = Average(this.Bandwidth, this.drainBytes / elapsed);
+        }
+
+        /// <summary>
+        /// Adjusts the quality level and update rate to the most recent measurements.
+        /// </summary>
+        /// <param name="now">
+        /// The current time.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the quality level or the update rate have changed; otherwise,
+        /// <see langword="false"/>.
+        /// </returns>
+        public bool Adjust(TimeSpan now)
+        {
+            if (this.UpdateSize == 0 || now - this.lastAdjusted < AdjustInterval)
+            {
+                return false;
+            }
+
+            this.lastAdjusted = now;
+
+            var updateRate = this.UpdateRate;
+            var qualityLevel = this.QualityLevel;
+
+            var interval = 1 / this.MaximumUpdateRate;
+            var sendTime = this.Bandwidth > 0 ? this.UpdateSize / this.Bandwidth : 0;
+            var encodeTime = this.EncodeTime.TotalSeconds;
+            var cost = Math.Max(sendTime, encodeTime);
+
+            if (cost > interval)
+            {
+                if (sendTime > encodeTime && this.QualityLevel > 0)
+                {
+                    this.QualityLevel--;
+                }
+                else
+                {
+                    this.UpdateRate = Math.Max(MinimumUpdateRate, Math.Min(this.MaximumUpdateRate, 1 / cost));
+                }
+            }
+            else if (this.UpdateRate < this.MaximumUpdateRate)
+            {
+                this.UpdateRate = this.MaximumUpdateRate;
+            }
+            else if (cost < interval / 2 && this.QualityLevel < this.MaximumQualityLevel)
+            {
+                this.QualityLevel++;
+            }
+
+            return this.UpdateRate != updateRate || this.QualityLevel != qualityLevel;
+        }
+
+        private static double Average(double average, double sample)
+        {
+            return average == 0 ? sample : average + (SampleWeight * (sample - average));
+        }
+    }
+}
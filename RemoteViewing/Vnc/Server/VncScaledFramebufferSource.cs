@@ -0,0 +1,476 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Generic;
+#if NET5_0_OR_GREATER
+using System.Numerics;
+#endif
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// A framebuffer source which scales down the framebuffer of another source, so that clients which only show a
+    /// small version of the desktop (such as thumbnails on a dashboard) don't have to receive it at full resolution.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// The size of the scaled framebuffer is set using <see cref="SetDesktopSize(int, int)"/>, either by the server
+    /// or by a client which supports the ExtendedDesktopSize pseudo-encoding. The framebuffer is scaled using a box
+    /// filter. Only the regions which have changed are scaled again, if the underlying source reports them (see
+    /// <see cref="IVncFramebufferDamageSource"/>).
+    /// </para>
+    /// <para>
+    /// Use a separate instance for each session. The session maps the pointer events of the client back to the
+    /// coordinates of the underlying source.
+    /// </para>
+    /// </remarks>
+    public sealed class VncScaledFramebufferSource : IVncFramebufferDamageSource, IVncCursorSource
+    {
+        private readonly IVncFramebufferSource source;
+        private readonly object syncRoot = new object();
+        private readonly VncDamageHistory damageHistory = new VncDamageHistory();
+        private readonly VncDamageReader damageReader = new VncDamageReader();
+        private readonly List<VncRectangle> sourceDamage = new List<VncRectangle>();
+        private readonly List<VncRectangle> damage = new List<VncRectangle>();
+
+        private int requestedWidth;
+        private int requestedHeight;
+
+        // The framebuffer which was last captured from the source, and the framebuffer returned to the session; these
+        // are the same when the framebuffer is not scaled.
+        private VncFramebuffer captured;
+        private VncFramebuffer framebuffer;
+
+        // When the source is shared, the generation of each tile which has been scaled.
+        private long[] scaledGenerations;
+        private bool[] isTileInvalid;
+
+        private uint[] sums;
+        private byte[] row;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncScaledFramebufferSource"/> class. The framebuffer is not
+        /// scaled until a smaller size is set using <see cref="SetDesktopSize(int, int)"/>.
+        /// </summary>
+        /// <param name="source">
+        /// The framebuffer source to scale.
+        /// </param>
+        public VncScaledFramebufferSource(IVncFramebufferSource source)
+        {
+            this.source = source ?? throw new ArgumentNullException(nameof(source));
+        }
+
+        /// <inheritdoc/>
+        public bool SupportsResizing => true;
+
+        /// <inheritdoc/>
+        public long FrameSequence => this.damageHistory.Sequence;
+
+        /// <inheritdoc/>
+        public VncCursor Cursor => (this.source as IVncCursorSource)?.Cursor;
+
+        /// <inheritdoc/>
+        public VncFramebuffer Capture()
+        {
+            lock (this.syncRoot)
+            {
+                var captured = this.source.Capture();
+                if (captured == null)
+                {
+                    return this.framebuffer;
+                }
+
+                lock (captured.SyncRoot)
+                {
+                    int width = this.requestedWidth == 0 ? captured.Width : Math.Min(this.requestedWidth, captured.Width);
+                    int height = this.requestedHeight == 0 ? captured.Height : Math.Min(this.requestedHeight, captured.Height);
+
+                    if (width == captured.Width && height == captured.Height)
+                    {
+                        this.PassThrough(captured);
+                    }
+                    else
+                    {
+                        this.Scale(captured, width, height);
+                    }
+
+                    this.captured = captured;
+                }
+
+                return this.framebuffer;
+            }
+        }
+
+        /// <summary>
+        /// Sets the size of the scaled framebuffer.
+        /// </summary>
+        /// <param name="width">
+        /// The width of the scaled framebuffer.
+        /// </param>
+        /// <param name="height">
+        /// The height of the scaled framebuffer.
+        /// </param>
+        /// <returns>
+        /// <see cref="ExtendedDesktopSizeStatus.Success"/> if the framebuffer will be scaled to the requested size.
+        /// Sizes which are larger than the framebuffer of the underlying source are passed on to that source, and turn
+        /// scaling off if the source could be resized.
+        /// </returns>
+        public ExtendedDesktopSizeStatus SetDesktopSize(int width, int height)
+        {
+            if (width <= 0 || height <= 0)
+            {
+                return ExtendedDesktopSizeStatus.InvalidScreenLayout;
+            }
+
+            lock (this.syncRoot)
+            {
+                var captured = this.captured ?? this.source.Capture();
+                if (captured == null)
+                {
+                    return ExtendedDesktopSizeStatus.OutOfResources;
+                }
+
+                if (width > captured.Width || height > captured.Height)
+                {
+                    var status = this.source.SetDesktopSize(width, height);
+
+                    if (status == ExtendedDesktopSizeStatus.Success)
+                    {
+                        this.requestedWidth = 0;
+                        this.requestedHeight = 0;
+                    }
+
+                    return status;
+                }
+
+                bool isNative = width == captured.Width && height == captured.Height;
+                this.requestedWidth = isNative ? 0 : width;
+                this.requestedHeight = isNative ? 0 : height;
+                return ExtendedDesktopSizeStatus.Success;
+            }
+        }
+
+        /// <inheritdoc/>
+        public bool TryGetDamage(long sequence, ICollection<VncRectangle> damage)
+        {
+            return this.damageHistory.TryGetDamage(sequence, damage);
+        }
+
+        /// <summary>
+        /// Maps a point in the scaled framebuffer to the framebuffer of the underlying source.
+        /// </summary>
+        /// <param name="x">
+        /// The X coordinate of the point. Receives the X coordinate in the framebuffer of the underlying source.
+        /// </param>
+        /// <param name="y">
+        /// The Y coordinate of the point. Receives the Y coordinate in the framebuffer of the underlying source.
+        /// </param>
+        public void MapToSource(ref int x, ref int y)
+        {
+            lock (this.syncRoot)
+            {
+                var framebuffer = this.framebuffer;
+                var captured = this.captured;
+
+                if (framebuffer == null || framebuffer == captured)
+                {
+                    return;
+                }
+
+                // Use the center of the pixel.
+                x = (int)Math.Min(captured.Width - 1, ((2L * x) + 1) * captured.Width / (2L * framebuffer.Width));
+                y = (int)Math.Min(captured.Height - 1, ((2L * y) + 1) * captured.Height / (2L * framebuffer.Height));
+            }
+        }
+
+        /// <summary>
+        /// Adds the bytes of a row of pixels to a row of sums.
+        /// </summary>
+        /// <param name="source">
+        /// The buffer which contains the row of pixels.
+        /// </param>
+        /// <param name="offset">
+        /// The offset of the row in <paramref name="source"/>.
+        /// </param>
+        /// <param name="sums">
+        /// The sums, one for each byte of the row.
+        /// </param>
+        /// <param name="count">
+        /// The number of bytes in the row.
+        /// </param>
+        internal static void AddRow(byte[] source, int offset, uint[] sums, int count)
+        {
+            int i = 0;
+
+#if NET5_0_OR_GREATER
+            if (Vector.IsHardwareAccelerated)
+            {
+                int uintCount = Vector<uint>.Count;
+
+                for (; i + Vector<byte>.Count <= count; i += Vector<byte>.Count)
+                {
+                    Vector.Widen(new Vector<byte>(source, offset + i), out Vector<ushort> low, out Vector<ushort> high);
+                    Vector.Widen(low, out Vector<uint> sum0, out Vector<uint> sum1);
+                    Vector.Widen(high, out Vector<uint> sum2, out Vector<uint> sum3);
+
+                    (new Vector<uint>(sums, i) + sum0).CopyTo(sums, i);
+                    (new Vector<uint>(sums, i + uintCount) + sum1).CopyTo(sums, i + uintCount);
+                    (new Vector<uint>(sums, i + (2 * uintCount)) + sum2).CopyTo(sums, i + (2 * uintCount));
+                    (new Vector<uint>(sums, i + (3 * uintCount)) + sum3).CopyTo(sums, i + (3 * uintCount));
+                }
+            }
+#endif
+
+            for (; i < count; i++)
+            {
+                sums[i] += source[offset + i];
+            }
+        }
+
+        /// <summary>
+        /// Determines whether the pixels of a format can be averaged byte by byte.
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The pixel format.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if each color channel is stored in a separate byte of a 32-bit pixel.
+        /// </returns>
+        internal static bool CanScale(VncPixelFormat pixelFormat)
+        {
+            return pixelFormat.BitsPerPixel == 32
+                && !pixelFormat.IsPalettized
+                && pixelFormat.RedBits == 8 && pixelFormat.RedShift % 8 == 0
+                && pixelFormat.GreenBits == 8 && pixelFormat.GreenShift % 8 == 0
+                && pixelFormat.BlueBits == 8 && pixelFormat.BlueShift % 8 == 0;
+        }
+
+        private static int ToTarget(int value, int sourceSize, int targetSize)
+        {
+            return (int)((long)value * targetSize / sourceSize);
+        }
+
+        private static int ToTargetCeiling(int value, int sourceSize, int targetSize)
+        {
+            return (int)((((long)value * targetSize) + sourceSize - 1) / sourceSize);
+        }
+
+        private static int ToSource(int value, int sourceSize, int targetSize)
+        {
+            return (int)((long)value * sourceSize / targetSize);
+        }
+
+        private void PassThrough(VncFramebuffer captured)
+        {
+            // The damage of the source is passed on, so the sessions can use it.
+            bool isKnown = this.ReadSourceDamage(captured);
+
+            if (this.framebuffer != captured)
+            {
+                this.framebuffer = captured;
+                this.damageHistory.AddUnknown();
+            }
+            else if (isKnown)
+            {
+                this.damageHistory.Add(this.sourceDamage);
+            }
+            else
+            {
+                this.damageHistory.AddUnknown();
+            }
+        }
+
+        private void Scale(VncFramebuffer captured, int width, int height)
+        {
+            var pixelFormat = CanScale(captured.PixelFormat) ? captured.PixelFormat : VncPixelFormat.RGB32;
+            bool isNew = false;
+
+            if (this.framebuffer == null
+                || this.framebuffer == this.captured
+                || this.captured != captured
+                || this.framebuffer.Width != width
+                || this.framebuffer.Height != height
+                || !this.framebuffer.PixelFormat.Equals(pixelFormat))
+            {
+                this.framebuffer = new VncFramebuffer(captured.Name, width, height, pixelFormat);
+                isNew = true;
+            }
+
+            lock (this.framebuffer.SyncRoot)
+            {
+                bool isKnown = this.ReadSourceDamage(captured);
+
+                if (isNew || !isKnown)
+                {
+                    this.ScaleRegion(captured, new VncRectangle(0, 0, width, height));
+                    this.damageHistory.AddUnknown();
+                    return;
+                }
+
+                this.damage.Clear();
+
+                foreach (var region in this.sourceDamage)
+                {
+                    var clipped = VncRectangle.Intersect(region, new VncRectangle(0, 0, captured.Width, captured.Height));
+                    if (clipped.IsEmpty)
+                    {
+                        continue;
+                    }
+
+                    // Include every target pixel whose box overlaps with the region. The box of the last target
+                    // pixel may start before the end of the region, and extend beyond it.
+                    int left = ToTarget(clipped.X, captured.Width, width);
+                    int top = ToTarget(clipped.Y, captured.Height, height);
+                    int right = Math.Min(width, ToTargetCeiling(clipped.X + clipped.Width, captured.Width, width));
+                    int bottom = Math.Min(height, ToTargetCeiling(clipped.Y + clipped.Height, captured.Height, height));
+
+                    var target = new VncRectangle(left, top, right - left, bottom - top);
+                    this.ScaleRegion(captured, target);
+                    this.damage.Add(target);
+                }
+
+                this.damageHistory.Add(this.damage);
+            }
+        }
+
+        private bool ReadSourceDamage(VncFramebuffer captured)
+        {
+            this.sourceDamage.Clear();
+
+            if (this.source is VncSharedFramebufferSource sharedSource)
+            {
+                const int tileSize = VncFramebufferCache.TileSize;
+                int tileColumns = (captured.Width + tileSize - 1) / tileSize;
+                int tileRows = (captured.Height + tileSize - 1) / tileSize;
+                bool isKnown = this.scaledGenerations != null
+                    && this.scaledGenerations.Length == tileColumns * tileRows
+                    && captured == this.captured;
+
+                if (!isKnown)
+                {
+                    this.scaledGenerations = new long[tileColumns * tileRows];
+                    this.isTileInvalid = new bool[tileColumns * tileRows];
+                }
+
+                sharedSource.GetInvalidTiles(captured, new VncRectangle(0, 0, captured.Width, captured.Height), this.scaledGenerations, this.isTileInvalid);
+
+                for (int i = 0; i < this.isTileInvalid.Length; i++)
+                {
+                    if (this.isTileInvalid[i])
+                    {
+                        this.sourceDamage.Add(new VncRectangle((i % tileColumns) * tileSize, (i / tileColumns) * tileSize, tileSize, tileSize));
+                    }
+                }
+
+                return isKnown;
+            }
+
+            if (captured != this.captured)
+            {
+                this.damageReader.Reset();
+            }
+
+            bool isDamageKnown = this.damageReader.Read(this.source as IVncFramebufferDamageSource);
+            this.sourceDamage.AddRange(this.damageReader.Damage);
+            return isDamageKnown;
+        }
+
+        private void ScaleRegion(VncFramebuffer captured, VncRectangle region)
+        {
+            int sourceWidth = captured.Width, sourceHeight = captured.Height;
+            int targetWidth = this.framebuffer.Width, targetHeight = this.framebuffer.Height;
+            var sourceBuffer = captured.GetBuffer();
+            var targetBuffer = this.framebuffer.GetBuffer();
+            bool convert = !captured.PixelFormat.Equals(this.framebuffer.PixelFormat);
+
+            // The box of target pixel x consists of the source pixels ToSource(x) up to, but not including, ToSource(x + 1).
+            int left = ToSource(region.X, sourceWidth, targetWidth);
+            int right = ToSource(region.X + region.Width, sourceWidth, targetWidth);
+            int count = (right - left) * 4;
+
+            if (this.sums == null || this.sums.Length < count)
+            {
+                this.sums = new uint[count];
+                this.row = new byte[count];
+            }
+
+            for (int y = region.Y; y < region.Y + region.Height; y++)
+            {
+                int top = ToSource(y, sourceHeight, targetHeight);
+                int bottom = Math.Max(top + 1, ToSource(y + 1, sourceHeight, targetHeight));
+
+                Array.Clear(this.sums, 0, count);
+
+                for (int sourceY = top; sourceY < bottom; sourceY++)
+                {
+                    if (convert)
+                    {
+                        VncPixelFormat.Copy(
+                            sourceBuffer,
+                            sourceWidth,
+                            captured.Stride,
+                            captured.PixelFormat,
+                            new VncRectangle(left, sourceY, right - left, 1),
+                            this.row,
+                            right - left,
+                            count,
+                            this.framebuffer.PixelFormat);
+
+                        AddRow(this.row, 0, this.sums, count);
+                    }
+                    else
+                    {
+                        AddRow(sourceBuffer, (sourceY * captured.Stride) + (left * 4), this.sums, count);
+                    }
+                }
+
+                int targetOffset = (y * this.framebuffer.Stride) + (region.X * 4);
+
+                for (int x = region.X; x < region.X + region.Width; x++, targetOffset += 4)
+                {
+                    int boxLeft = ToSource(x, sourceWidth, targetWidth);
+                    int boxRight = Math.Max(boxLeft + 1, ToSource(x + 1, sourceWidth, targetWidth));
+                    uint pixels = (uint)((boxRight - boxLeft) * (bottom - top));
+
+                    for (int channel = 0; channel < 4; channel++)
+                    {
+                        uint sum = 0;
+
+                        for (int i = ((boxLeft - left) * 4) + channel; i < (boxRight - left) * 4; i += 4)
+                        {
+                            sum += this.sums[i];
+                        }
+
+                        targetBuffer[targetOffset + channel] = (byte)((sum + (pixels / 2)) / pixels);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -42,7 +42,7 @@ namespace RemoteViewing.Vnc.Server
     /// </summary>
     public class VncServer : IVncServer
     {
-        private readonly IVncFramebufferSource framebufferSource;
+        private readonly VncSharedFramebufferSource framebufferSource;
         private readonly IVncRemoteKeyboard keyboard;
         private readonly IVncRemoteController controller;
         private readonly ILogger logger;
@@ -87,10 +87,18 @@ namespace RemoteViewing.Vnc.Server
         /// </param>
         public VncServer(IVncFramebufferSource framebufferSource, IVncRemoteKeyboard keyboard, IVncRemoteController controller, ILogger logger)
         {
-            this.framebufferSource = framebufferSource ?? throw new ArgumentNullException(nameof(framebufferSource));
+            if (framebufferSource == null)
+            {
+                throw new ArgumentNullException(nameof(framebufferSource));
+            }
+
             this.keyboard = keyboard;
             this.controller = controller;
             this.logger = logger ?? throw new ArgumentNullException(nameof(logger));
+
+            // All sessions share a single capture of the framebuffer, and the rectangles
+            // encoded for that capture.
+            this.framebufferSource = new VncSharedFramebufferSource(framebufferSource, logger);
         }
 
         /// <inheritdoc/>
@@ -102,6 +110,20 @@ namespace RemoteViewing.Vnc.Server
         /// <inheritdoc/>
         public event EventHandler<PasswordProvidedEventArgs> PasswordProvided;
 
+        /// <summary>
+        /// Gets or sets a value indicating whether clients can ask for a smaller desktop, using the ExtendedDesktopSize
+        /// pseudo-encoding. The framebuffer is then scaled down for those clients; see <see cref="VncScaledFramebufferSource"/>.
+        /// </summary>
+        /// <remarks>
+        /// The default is <see langword="false"/>. When scaling is allowed, sessions no longer share the rectangles they
+        /// have encoded, and clients can't resize the underlying framebuffer source to a smaller size.
+        /// </remarks>
+        public bool AllowScaling
+        {
+            get;
+            set;
+        }
+
         /// <inheritdoc/>
         public IReadOnlyList<IVncServerSession> Sessions => this.sessions;
 
@@ -163,6 +185,9 @@ namespace RemoteViewing.Vnc.Server
             {
                 var client = await this.listener.AcceptTcpClientAsync();
 
+                // Updates are flushed as soon as they have been encoded, don't let Nagle's algorithm hold them back.
+                client.NoDelay = true;
+
                 // Set up a framebuffer and options.
                 var options = new VncServerSessionOptions();
                 options.AuthenticationMethod = AuthenticationMethod.Password;
@@ -175,7 +200,13 @@ namespace RemoteViewing.Vnc.Server
                 session.Connected += this.OnConnected;
                 session.Closed += this.OnClosed;
                 session.PasswordProvided += this.OnPasswordProvided;
-                session.SetFramebufferSource(this.framebufferSource);
+                session.CreateFramebufferCache = this.framebufferSource.CreateFramebufferCache;
+
+                // When scaling is allowed, each session scales the shared framebuffer to the size requested by its client.
+                session.SetFramebufferSource(
+                    this.AllowScaling
+                        ? new VncScaledFramebufferSource(this.framebufferSource)
+                        : (IVncFramebufferSource)this.framebufferSource);
                 session.Connect(client.GetStream(), options);
 
                 if (this.keyboard != null)
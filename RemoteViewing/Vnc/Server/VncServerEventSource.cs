@@ -0,0 +1,373 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Diagnostics.Tracing;
+using System.Threading;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// The event source used for <see cref="VncServerSession"/> performance counters.
+    /// </summary>
+    /// <remarks>
+    /// Use <c>dotnet-counters monitor --counters RemoteViewing-VncServer</c> to watch the counters of a running server.
+    /// </remarks>
+    [EventSource(Name = EventSourceName)]
+    public class VncServerEventSource : EventSource
+    {
+        private const string EventSourceName = "RemoteViewing-VncServer";
+
+#if NET5_0_OR_GREATER
+        private readonly EventCounter captureDurationCounter;
+        private readonly EventCounter diffDurationCounter;
+        private readonly EventCounter updateLatencyCounter;
+
+        private readonly PollingCounter activeSessionsCounter;
+        private readonly IncrementingPollingCounter skippedUpdatesCounter;
+        private readonly IncrementingPollingCounter bytesSentCounter;
+
+        private readonly ConcurrentDictionary<VncEncoding, EncodingCounters> encodingCounters = new ConcurrentDictionary<VncEncoding, EncodingCounters>();
+        private readonly Dictionary<VncServerSession, DiagnosticCounter[]> sessionCounters = new Dictionary<VncServerSession, DiagnosticCounter[]>();
+
+        private int activeSessions;
+        private int sessionId;
+        private long skippedUpdates;
+        private long bytesSent;
+#endif
+
+        /// <summary>
+        /// Initializes static members of the <see cref="VncServerEventSource"/> class.
+        /// </summary>
+        static VncServerEventSource()
+        {
+            Instance = new VncServerEventSource();
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncServerEventSource"/> class.
+        /// </summary>
+        public VncServerEventSource()
+            : base(EventSourceName, EventSourceSettings.EtwSelfDescribingEventFormat)
+        {
+#if NET5_0_OR_GREATER
+            this.captureDurationCounter = new EventCounter("capture", this)
+            {
+                DisplayName = "Time required to capture the framebuffer",
+                DisplayUnits = "ms",
+            };
+
+            this.diffDurationCounter = new EventCounter("diff", this)
+            {
+                DisplayName = "Time required to detect the changes in the framebuffer",
+                DisplayUnits = "ms",
+            };
+
+            this.updateLatencyCounter = new EventCounter("update-latency", this)
+            {
+                DisplayName = "Time between a framebuffer update request and the update being sent",
+                DisplayUnits = "ms",
+            };
+
+            this.activeSessionsCounter = new PollingCounter("active-sessions", this, () => Volatile.Read(ref this.activeSessions))
+            {
+                DisplayName = "Number of active sessions",
+                DisplayUnits = "#",
+            };
+
+            this.skippedUpdatesCounter = new IncrementingPollingCounter("skipped-updates", this, () => Interlocked.Read(ref this.skippedUpdates))
+            {
+                DisplayName = "Framebuffer updates held back because the client could not keep up",
+                DisplayUnits = "#",
+                DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+            };
+
+            this.bytesSentCounter = new IncrementingPollingCounter("bytes-sent", this, () => Interlocked.Read(ref this.bytesSent))
+            {
+                DisplayName = "Bytes sent to all clients",
+                DisplayUnits = "B",
+                DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+            };
+#endif
+        }
+
+        /// <summary>
+        /// Gets the default instance of the <see cref="VncServerEventSource"/>.
+        /// </summary>
+        public static VncServerEventSource Instance
+        {
+            get;
+            private set;
+        }
+
+        /// <summary>
+        /// Records the time required to capture the framebuffer.
+        /// </summary>
+        /// <param name="elapsedMilliseconds">
+        /// The amount of time required to capture the framebuffer, in milliseconds.
+        /// </param>
+        public void AddCaptureDuration(double elapsedMilliseconds)
+        {
+#if NET5_0_OR_GREATER
+            if (this.IsEnabled())
+            {
+                this.captureDurationCounter.WriteMetric(elapsedMilliseconds);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Records the time required to detect which regions of the framebuffer have changed.
+        /// </summary>
+        /// <param name="elapsedMilliseconds">
+        /// The amount of time required to detect the changes, in milliseconds.
+        /// </param>
+        public void AddDiffDuration(double elapsedMilliseconds)
+        {
+#if NET5_0_OR_GREATER
+            if (this.IsEnabled())
+            {
+                this.diffDurationCounter.WriteMetric(elapsedMilliseconds);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Records the time between a framebuffer update request from the client and the update being sent.
+        /// </summary>
+        /// <param name="elapsedMilliseconds">
+        /// The amount of time between the request and the update, in milliseconds.
+        /// </param>
+        public void AddUpdateLatency(double elapsedMilliseconds)
+        {
+#if NET5_0_OR_GREATER
+            if (this.IsEnabled())
+            {
+                this.updateLatencyCounter.WriteMetric(elapsedMilliseconds);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Records a framebuffer update which was held back because the output to the client was backlogged.
+        /// </summary>
+        public void AddSkippedUpdate()
+        {
+#if NET5_0_OR_GREATER
+            Interlocked.Increment(ref this.skippedUpdates);
+#endif
+        }
+
+        /// <summary>
+        /// Records the time required to encode a rectangle.
+        /// </summary>
+        /// <param name="encoding">
+        /// The encoding of the rectangle.
+        /// </param>
+        /// <param name="elapsedMilliseconds">
+        /// The amount of time required to encode the rectangle, in milliseconds.
+        /// </param>
+        public void AddEncodeDuration(VncEncoding encoding, double elapsedMilliseconds)
+        {
+#if NET5_0_OR_GREATER
+            if (this.IsEnabled())
+            {
+                this.GetEncodingCounters(encoding).EncodeDuration.WriteMetric(elapsedMilliseconds);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Records a rectangle which was sent to a client.
+        /// </summary>
+        /// <param name="encoding">
+        /// The encoding of the rectangle.
+        /// </param>
+        /// <param name="bytes">
+        /// The size of the encoded rectangle, in bytes.
+        /// </param>
+        public void AddRectangle(VncEncoding encoding, int bytes)
+        {
+#if NET5_0_OR_GREATER
+            this.GetEncodingCounters(encoding).AddRectangle(bytes);
+            Interlocked.Add(ref this.bytesSent, bytes);
+#endif
+        }
+
+        /// <summary>
+        /// Starts publishing the counters of a session: the rate at which bytes and framebuffer updates are sent
+        /// to the client, and the rate at which updates are held back.
+        /// </summary>
+        /// <param name="session">
+        /// The session for which to publish counters.
+        /// </param>
+        public void AddSession(VncServerSession session)
+        {
+#if NET5_0_OR_GREATER
+            Interlocked.Increment(ref this.activeSessions);
+
+            var id = Interlocked.Increment(ref this.sessionId);
+
+            var counters = new DiagnosticCounter[]
+            {
+                new IncrementingPollingCounter($"session-{id}-bytes-sent", this, () => session.BytesSent)
+                {
+                    DisplayName = $"Bytes sent to session {id}",
+                    DisplayUnits = "B",
+                    DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+                },
+                new IncrementingPollingCounter($"session-{id}-update-framebuffer-count", this, () => session.FramebufferUpdatesSent)
+                {
+                    DisplayName = $"Framebuffer updates sent to session {id}",
+                    DisplayUnits = "#",
+                    DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+                },
+                new IncrementingPollingCounter($"session-{id}-skipped-updates", this, () => session.SkippedFramebufferUpdates)
+                {
+                    DisplayName = $"Framebuffer updates held back for session {id}",
+                    DisplayUnits = "#",
+                    DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+                },
+            };
+
+            lock (this.sessionCounters)
+            {
+                this.sessionCounters.Add(session, counters);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Stops publishing the counters of a session.
+        /// </summary>
+        /// <param name="session">
+        /// The session for which to stop publishing counters.
+        /// </param>
+        public void RemoveSession(VncServerSession session)
+        {
+#if NET5_0_OR_GREATER
+            DiagnosticCounter[] counters;
+
+            lock (this.sessionCounters)
+            {
+                if (!this.sessionCounters.Remove(session, out counters))
+                {
+                    return;
+                }
+            }
+
+            Interlocked.Decrement(ref this.activeSessions);
+
+            foreach (var counter in counters)
+            {
+                counter.Dispose();
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Gets the number of milliseconds which have elapsed since a <see cref="Stopwatch"/> timestamp.
+        /// </summary>
+        /// <param name="timestamp">
+        /// A value returned by <see cref="Stopwatch.GetTimestamp"/>.
+        /// </param>
+        /// <returns>
+        /// The number of milliseconds which have elapsed since <paramref name="timestamp"/>.
+        /// </returns>
+        internal static double GetElapsedMilliseconds(long timestamp)
+        {
+            return (Stopwatch.GetTimestamp() - timestamp) * 1000.0 / Stopwatch.Frequency;
+        }
+
+#if NET5_0_OR_GREATER
+        private EncodingCounters GetEncodingCounters(VncEncoding encoding)
+        {
+            if (this.encodingCounters.TryGetValue(encoding, out EncodingCounters counters))
+            {
+                return counters;
+            }
+
+            // The counters are created the first time an encoding is used. Make sure they are only created once,
+            // because each counter registers itself with the event source.
+            lock (this.encodingCounters)
+            {
+                return this.encodingCounters.GetOrAdd(encoding, e => new EncodingCounters(this, e));
+            }
+        }
+
+        /// <summary>
+        /// The counters for a single encoding.
+        /// </summary>
+        private sealed class EncodingCounters
+        {
+            private long rectangles;
+            private long bytes;
+
+            public EncodingCounters(VncServerEventSource eventSource, VncEncoding encoding)
+            {
+                var name = encoding.ToString().ToLowerInvariant();
+
+                this.EncodeDuration = new EventCounter($"{name}-encode", eventSource)
+                {
+                    DisplayName = $"Time required to encode a {encoding} rectangle",
+                    DisplayUnits = "ms",
+                };
+
+                this.RectanglesCounter = new IncrementingPollingCounter($"{name}-rectangles", eventSource, () => Interlocked.Read(ref this.rectangles))
+                {
+                    DisplayName = $"{encoding} rectangles sent",
+                    DisplayUnits = "#",
+                    DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+                };
+
+                this.BytesCounter = new IncrementingPollingCounter($"{name}-bytes-sent", eventSource, () => Interlocked.Read(ref this.bytes))
+                {
+                    DisplayName = $"Bytes sent using the {encoding} encoding",
+                    DisplayUnits = "B",
+                    DisplayRateTimeScale = TimeSpan.FromSeconds(1),
+                };
+            }
+
+            public EventCounter EncodeDuration { get; }
+
+            public IncrementingPollingCounter RectanglesCounter { get; }
+
+            public IncrementingPollingCounter BytesCounter { get; }
+
+            public void AddRectangle(int bytes)
+            {
+                Interlocked.Increment(ref this.rectangles);
+                Interlocked.Add(ref this.bytes, bytes);
+            }
+        }
+#endif
+    }
+}
@@ -28,12 +28,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using Microsoft.Extensions.Logging;
 using System;
+using System.Buffers;
 using System.Buffers.Binary;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.Collections.ObjectModel;
+using System.Diagnostics;
 using System.IO;
 using System.Linq;
+using System.Runtime.InteropServices;
 using System.Threading;
+using System.Threading.Tasks;
 
 namespace RemoteViewing.Vnc.Server
 {
@@ -42,6 +47,13 @@ namespace RemoteViewing.Vnc.Server
     /// </summary>
     public class VncServerSession : IVncServerSession
     {
+        // Holds the pixel data of rectangles which have been invalidated but not yet sent. A full-screen
+        // rectangle easily exceeds the maximum array size of ArrayPool<byte>.Shared on .NET Framework,
+        // so use a dedicated pool which can hold framebuffers up to 4K resolution.
+        private static readonly ArrayPool<byte> RectanglePool = ArrayPool<byte>.Create(64 * 1024 * 1024, 4);
+
+        private readonly ConcurrentDictionary<VncEncoding, EncoderStatistics> statistics = new ConcurrentDictionary<VncEncoding, EncoderStatistics>();
+
         private ILogger logger;
         private IVncPasswordChallenge passwordChallenge;
         private VncStream c = new VncStream();
@@ -49,6 +61,7 @@ namespace RemoteViewing.Vnc.Server
         private VncPixelFormat clientPixelFormat;
         private int clientWidth;
         private int clientHeight;
+        private bool isDesktopSizeChanged;
         private Version clientVersion;
         private VncServerSessionOptions options;
         private IVncFramebufferCache fbuAutoCache;
@@ -56,11 +69,49 @@ namespace RemoteViewing.Vnc.Server
         private object fbuSync = new object();
         private IVncFramebufferSource fbSource;
         private double maxUpdateRate;
-        private Utility.PeriodicThread requester;
+        private VncUpdateScheduler.Registration updates;
         private object specialSync = new object();
-        private Thread threadMain;
+        private Task runTask;
         private bool securityNegotiated = false;
 
+        // With continuous updates, the client doesn't request each update; instead, updates for this region are
+        // sent whenever the framebuffer changes. Fences are used to measure how much data is still in flight,
+        // so that the server doesn't send updates faster than the client can receive them.
+        private VncRectangle? continuousUpdatesRegion;
+        private bool continuousUpdatesSupported;
+        private bool fenceSupported;
+        private VncCongestionControl congestionControl = new VncCongestionControl();
+        private VncQualityController qualityController = new VncQualityController();
+        private VncParallelEncoder parallelEncoder = new VncParallelEncoder();
+        private Stopwatch clock = Stopwatch.StartNew();
+
+        // Updated with Interlocked, so the counters can be read by the event source while the session is
+        // sending updates.
+        private long bytesSent;
+        private long framebufferUpdatesSent;
+        private long skippedFramebufferUpdates;
+
+        // Stopwatch timestamps of the oldest unanswered update request and of the start of the current update,
+        // or 0 when there is none.
+        private long requestTimestamp;
+        private long diffTimestamp;
+
+        // The cursor shown to the client; the cursor which was last sent using a cursor pseudo-encoding; and the
+        // pseudo-encoding preferred by the client, or null if the client can't draw the cursor itself.
+        private VncCursor cursor;
+        private VncCursor sentCursor;
+        private VncEncoding? cursorEncoding;
+
+        // When the client can't draw the cursor, it is drawn into the updates at the position of the pointer of the
+        // client: the cursor and its bounds in the current update, and the cursor which the client is showing.
+        private VncCursor softwareCursor;
+        private VncRectangle softwareCursorBounds;
+        private VncCursor drawnCursor;
+        private VncRectangle drawnCursorBounds;
+
+        // The position of the pointer of the client, as (x << 16) | y, or -1 if the client hasn't sent one yet.
+        private long pointerPosition = -1;
+
         // Used by HandleMessage to avoid flooding the event log.
         private VncMessageType previousCommand = VncMessageType.Unknown;
         private int commandCount = 0;
@@ -93,7 +144,9 @@ namespace RemoteViewing.Vnc.Server
             this.logger = logger;
             this.MaxUpdateRate = 15;
 
-            this.Encoders.Add(new TightEncoder(this));
+            this.Encoders.Add(new TightEncoder(this) { QualityController = this.qualityController });
+            this.Encoders.Add(new ZrleEncoder());
+            this.Encoders.Add(new TrleEncoder());
         }
 
         /// <summary>
@@ -174,6 +227,29 @@ namespace RemoteViewing.Vnc.Server
             private set;
         }
 
+        /// <summary>
+        /// Gets or sets the cursor which is shown to the client, or <see langword="null"/> to let the client decide.
+        /// </summary>
+        /// <remarks>
+        /// Clients which support the <see cref="VncEncoding.CursorWithAlpha"/> or <see cref="VncEncoding.RichCursor"/>
+        /// pseudo-encodings draw the cursor themselves. For other clients, the cursor is drawn into the framebuffer
+        /// updates, at the position of the pointer of the client. When the framebuffer source implements
+        /// <see cref="IVncCursorSource"/>, the cursor is updated each time the framebuffer is captured.
+        /// </remarks>
+        public VncCursor Cursor
+        {
+            get
+            {
+                return this.cursor;
+            }
+
+            set
+            {
+                this.cursor = value;
+                this.FramebufferChanged();
+            }
+        }
+
         /// <inheritdoc/>
         public FramebufferUpdateRequest FramebufferUpdateRequest
         {
@@ -231,6 +307,20 @@ namespace RemoteViewing.Vnc.Server
             private set;
         }
 
+        /// <summary>
+        /// Gets or sets the maximum number of threads used to encode a framebuffer update.
+        /// </summary>
+        /// <remarks>
+        /// The default is 1: all rectangles are encoded on the thread which sends the update. When set to a
+        /// higher value, encoders which support it (such as the Tight encoder, when using JPEG compression)
+        /// encode rectangles in parallel. The rectangles are still sent to the client in order.
+        /// </remarks>
+        public int MaxEncoderThreads
+        {
+            get { return this.parallelEncoder.MaxThreads; }
+            set { this.parallelEncoder.MaxThreads = value; }
+        }
+
         /// <summary>
         /// Gets or sets the max rate to send framebuffer updates at, in frames per second.
         /// </summary>
@@ -254,6 +344,7 @@ namespace RemoteViewing.Vnc.Server
                 }
 
                 this.maxUpdateRate = value;
+                this.qualityController.MaximumUpdateRate = value;
             }
         }
 
@@ -301,8 +392,35 @@ namespace RemoteViewing.Vnc.Server
         /// <summary>
         /// Gets performance statistics for the various encoders used by this session.
         /// </summary>
-        public Dictionary<VncEncoding, EncoderStatistics> Statistics
-        { get; private set; } = new Dictionary<VncEncoding, EncoderStatistics>();
+        public IReadOnlyDictionary<VncEncoding, EncoderStatistics> Statistics
+        {
+            get { return this.statistics; }
+        }
+
+        /// <summary>
+        /// Gets the total number of bytes which were sent to the client as part of framebuffer updates.
+        /// </summary>
+        public long BytesSent
+        {
+            get { return Interlocked.Read(ref this.bytesSent); }
+        }
+
+        /// <summary>
+        /// Gets the number of framebuffer updates which were sent to the client.
+        /// </summary>
+        public long FramebufferUpdatesSent
+        {
+            get { return Interlocked.Read(ref this.framebufferUpdatesSent); }
+        }
+
+        /// <summary>
+        /// Gets the number of times a framebuffer update was held back because the previous update was
+        /// still being sent to the client.
+        /// </summary>
+        public long SkippedFramebufferUpdates
+        {
+            get { return Interlocked.Read(ref this.skippedFramebufferUpdates); }
+        }
 
         /// <summary>
         /// Gets or sets the pixel format currently used by the client.
@@ -318,11 +436,11 @@ namespace RemoteViewing.Vnc.Server
         /// </summary>
         public void Close()
         {
-            var thread = this.threadMain;
+            var task = this.runTask;
             this.c.Close();
-            if (thread != null)
+            if (task != null)
             {
-                thread.Join();
+                task.Wait();
             }
         }
 
@@ -341,7 +459,7 @@ namespace RemoteViewing.Vnc.Server
         /// </summary>
         /// <param name="stream">The stream containing the connection.</param>
         /// <param name="options">Session options, if any.</param>
-        /// <param name="startThread">A value indicating whether to start the thread.</param>
+        /// <param name="startThread">A value indicating whether to start handling the connection in the background.</param>
         /// <param name="forceConnected">A value indicated whether to immediately set <see cref="IsConnected"/>. Intended for unit tests only.</param>
         public void Connect(Stream stream, VncServerSessionOptions options = null, bool startThread = true, bool forceConnected = false)
         {
@@ -355,13 +473,19 @@ namespace RemoteViewing.Vnc.Server
                 this.Close();
 
                 this.options = options ?? new VncServerSessionOptions();
-                this.c.Stream = stream;
 
                 if (startThread)
                 {
-                    this.threadMain = new Thread(this.ThreadMain);
-                    this.threadMain.IsBackground = true;
-                    this.threadMain.Start();
+                    // The connection is handled asynchronously, so that a server can handle many sessions
+                    // without dedicating a thread to each of them.
+                    var pipe = new VncPipeStream(stream);
+                    pipe.Drained += this.OnOutputDrained;
+                    this.c.Stream = pipe;
+                    this.runTask = Task.Run(() => this.RunAsync());
+                }
+                else
+                {
+                    this.c.Stream = stream;
                 }
 
                 if (forceConnected)
@@ -384,6 +508,7 @@ namespace RemoteViewing.Vnc.Server
                 }
 
                 this.c.SendByte((byte)2);
+                this.c.Flush();
             }
         }
 
@@ -409,6 +534,7 @@ namespace RemoteViewing.Vnc.Server
                 this.c.SendByte((byte)3);
                 this.c.Send(new byte[3]);
                 this.c.SendString(data, true);
+                this.c.Flush();
             }
         }
 
@@ -426,35 +552,49 @@ namespace RemoteViewing.Vnc.Server
         /// </summary>
         public void FramebufferChanged()
         {
-            this.requester.Signal();
+            this.updates?.Signal();
         }
 
         /// <inheritdoc/>
         public void FramebufferManualBeginUpdate()
         {
-            this.fbuRectangles.Clear();
+            this.ClearRectangles();
+
+            // Send the pixels of a resized framebuffer at the new size; the new size is sent along with them.
+            var fb = this.Framebuffer;
+            if (fb != null
+                && (this.clientWidth != fb.Width || this.clientHeight != fb.Height)
+                && (this.clientEncoding.Contains(VncEncoding.ExtendedDesktopSize) || this.clientEncoding.Contains(VncEncoding.PseudoDesktopSize)))
+            {
+                this.isDesktopSizeChanged = true;
+                this.clientWidth = fb.Width;
+                this.clientHeight = fb.Height;
+            }
+
+            var cursor = this.cursor;
+            var position = Volatile.Read(ref this.pointerPosition);
+
+            if (cursor != null && position >= 0 && this.cursorEncoding == null)
+            {
+                this.softwareCursor = cursor;
+                this.softwareCursorBounds = cursor.GetBounds((int)(position >> 16), (int)(position & 0xFFFF));
+            }
+            else
+            {
+                this.softwareCursor = null;
+                this.softwareCursorBounds = default(VncRectangle);
+            }
         }
 
-        /// <summary>
-        /// Queues an update corresponding to one region of the framebuffer being copied to another.
-        /// </summary>
-        /// <param name="target">
-        /// The updated <see cref="VncRectangle"/>.
-        /// </param>
-        /// <param name="sourceX">
-        /// The X coordinate of the source.
-        /// </param>
-        /// <param name="sourceY">
-        /// The Y coordinate of the source.
-        /// </param>
-        /// <remarks>
-        /// Do not call this method without holding <see cref="VncServerSession.FramebufferUpdateRequestLock"/>.
-        /// </remarks>
+        /// <inheritdoc/>
         public void FramebufferManualCopyRegion(VncRectangle target, int sourceX, int sourceY)
         {
-            if (!this.clientEncoding.Contains(VncEncoding.CopyRect))
+            var source = new VncRectangle(sourceX, sourceY, target.Width, target.Height);
+
+            // The client would copy the cursor which is drawn into the framebuffer along with the pixels around it,
+            // so send the pixels instead.
+            if (!this.clientEncoding.Contains(VncEncoding.CopyRect) || this.IsCursorDrawn(source) || this.IsCursorDrawn(target))
             {
-                var source = new VncRectangle(sourceX, sourceY, target.Width, target.Height);
                 var region = VncRectangle.Union(source, target);
 
                 if (region.Area > source.Area + target.Area)
@@ -472,7 +612,7 @@ namespace RemoteViewing.Vnc.Server
             var contents = new byte[4];
             VncUtility.EncodeUInt16BE(contents, 0, (ushort)sourceX);
             VncUtility.EncodeUInt16BE(contents, 2, (ushort)sourceY);
-            this.AddRegion(target, VncEncoding.CopyRect, contents);
+            this.AddRegion(new Rectangle() { Region = target, Encoding = VncEncoding.CopyRect, Contents = contents });
         }
 
         /// <inheritdoc/>
@@ -484,29 +624,30 @@ namespace RemoteViewing.Vnc.Server
         /// <inheritdoc/>
         public void FramebufferManualInvalidate(VncRectangle region)
         {
-            var fb = this.Framebuffer;
-            var cpf = this.clientPixelFormat;
             region = VncRectangle.Intersect(region, new VncRectangle(0, 0, this.clientWidth, this.clientHeight));
             if (region.IsEmpty)
             {
                 return;
             }
 
-            int x = region.X, y = region.Y, w = region.Width, h = region.Height, bpp = cpf.BytesPerPixel;
-            var contents = new byte[w * h * bpp];
-
-            VncPixelFormat.Copy(
-                fb.GetBuffer(),
-                fb.Width,
-                fb.Stride,
-                fb.PixelFormat,
-                region,
-                contents,
-                w,
-                w * bpp,
-                cpf);
+            // Some encoders limit the size of a rectangle, so split the region into subrectangles
+            // which the encoder can send.
+            var encoder = this.Encoder;
+            int width = Math.Min(region.Width, encoder.MaximumRectangleWidth);
+            int height = Math.Max(1, Math.Min(region.Height, encoder.MaximumRectangleArea / width));
 
-            this.AddRegion(region, VncEncoding.Raw, contents);
+            for (int y = region.Y; y < region.Y + region.Height; y += height)
+            {
+                for (int x = region.X; x < region.X + region.Width; x += width)
+                {
+                    this.AddFramebufferRegion(
+                        new VncRectangle(
+                            x,
+                            y,
+                            Math.Min(width, region.X + region.Width - x),
+                            Math.Min(height, region.Y + region.Height - y)));
+                }
+            }
         }
 
         /// <inheritdoc/>
@@ -526,15 +667,22 @@ namespace RemoteViewing.Vnc.Server
         /// <inheritdoc/>s
         public bool FramebufferManualEndUpdate()
         {
-            var fb = this.Framebuffer;
-            if (this.clientWidth != fb.Width || this.clientHeight != fb.Height)
+            this.AddCursorRegions();
+
+            // The client discards its framebuffer when it is resized, so the new size must precede the pixels.
+            if (this.isDesktopSizeChanged)
             {
-                if (this.clientEncoding.Contains(VncEncoding.PseudoDesktopSize))
+                this.isDesktopSizeChanged = false;
+
+                var fb = this.Framebuffer;
+                if (this.clientEncoding.Contains(VncEncoding.ExtendedDesktopSize))
+                {
+                    this.fbuRectangles.Insert(0, this.GetExtendedDesktopSizeRectangle(ExtendedDesktopSizeReason.External, ExtendedDesktopSizeStatus.Success));
+                }
+                else
                 {
                     var region = new VncRectangle(0, 0, fb.Width, fb.Height);
-                    this.AddRegion(region, VncEncoding.PseudoDesktopSize, new byte[0]);
-                    this.clientWidth = this.Framebuffer.Width;
-                    this.clientHeight = this.Framebuffer.Height;
+                    this.fbuRectangles.Insert(0, new Rectangle() { Region = region, Encoding = VncEncoding.PseudoDesktopSize, Contents = new byte[0] });
                 }
             }
 
@@ -543,10 +691,23 @@ namespace RemoteViewing.Vnc.Server
                 return false;
             }
 
+            this.EndDiff();
             this.FramebufferUpdateRequest = null;
 
             this.SendRectangles(this.fbuRectangles);
-            this.fbuRectangles.Clear();
+            this.ClearRectangles();
+
+            var requestTimestamp = Interlocked.Exchange(ref this.requestTimestamp, 0);
+            if (requestTimestamp != 0)
+            {
+                VncServerEventSource.Instance.AddUpdateLatency(VncServerEventSource.GetElapsedMilliseconds(requestTimestamp));
+            }
+
+            if (this.fenceSupported)
+            {
+                this.SendFenceRequest();
+            }
+
             return true;
         }
 
@@ -563,18 +724,43 @@ namespace RemoteViewing.Vnc.Server
 
             lock (this.FramebufferUpdateRequestLock)
             {
-                if (this.FramebufferUpdateRequest != null)
+                FramebufferUpdateRequest continuousUpdateRequest = null;
+
+                this.AdjustQuality();
+
+                if (this.FramebufferUpdateRequest == null && this.continuousUpdatesRegion != null && !this.IsCongested())
+                {
+                    continuousUpdateRequest = new FramebufferUpdateRequest(true, this.continuousUpdatesRegion.Value);
+                    this.FramebufferUpdateRequest = continuousUpdateRequest;
+                }
+
+                // While the previous update is still being sent, hold on to the request; this way, the client gets the
+                // latest framebuffer once the connection is available again, instead of a stale one.
+                if (this.FramebufferUpdateRequest != null && this.IsBacklogged())
+                {
+                    Interlocked.Increment(ref this.skippedFramebufferUpdates);
+                    VncServerEventSource.Instance.AddSkippedUpdate();
+                }
+                else if (this.FramebufferUpdateRequest != null)
                 {
                     var fbSource = this.fbSource;
                     if (fbSource != null)
                     {
                         try
                         {
+                            var captureTimestamp = Stopwatch.GetTimestamp();
                             var newFramebuffer = fbSource.Capture();
+                            VncServerEventSource.Instance.AddCaptureDuration(VncServerEventSource.GetElapsedMilliseconds(captureTimestamp));
+
                             if (newFramebuffer != null && newFramebuffer != this.Framebuffer)
                             {
                                 this.Framebuffer = newFramebuffer;
                             }
+
+                            if (fbSource is IVncCursorSource cursorSource && cursorSource.Cursor != null)
+                            {
+                                this.cursor = cursorSource.Cursor;
+                            }
                         }
                         catch (Exception exc)
                         {
@@ -592,10 +778,26 @@ namespace RemoteViewing.Vnc.Server
                             this.fbuAutoCache = this.CreateFramebufferCache(this.Framebuffer, this.logger);
                         }
 
+                        if (this.fbuAutoCache is VncFramebufferCache cache)
+                        {
+                            cache.DamageSource = fbSource as IVncFramebufferDamageSource;
+                        }
+
                         e.Handled = true;
+
+                        // The diff ends when the update is sent; if nothing has changed, it ends here.
+                        this.diffTimestamp = Stopwatch.GetTimestamp();
                         e.SentChanges = this.fbuAutoCache.RespondToUpdateRequest(this);
+                        this.EndDiff();
                     }
                 }
+
+                // Don't keep the request around if nothing has changed; the next update may have to
+                // wait for the congestion window, or continuous updates may be disabled in the meantime.
+                if (continuousUpdateRequest != null && this.FramebufferUpdateRequest == continuousUpdateRequest)
+                {
+                    this.FramebufferUpdateRequest = null;
+                }
             }
 
             return e.SentChanges;
@@ -662,6 +864,14 @@ namespace RemoteViewing.Vnc.Server
                     this.HandleSetDesktopSize();
                     break;
 
+                case VncMessageType.EnableContinuousUpdates:
+                    this.HandleEnableContinuousUpdates();
+                    break;
+
+                case VncMessageType.ClientFence:
+                    this.HandleClientFence();
+                    break;
+
                 default:
                     VncStream.Require(
                         false,
@@ -674,33 +884,99 @@ namespace RemoteViewing.Vnc.Server
 
         public void NegotiateDesktop()
         {
-            this.logger?.LogInformation("Negotiating desktop settings");
+            this.NegotiateDesktopAsync(CancellationToken.None).GetAwaiter().GetResult();
+        }
 
-            byte shareDesktopSetting = this.c.ReceiveByte();
-            bool shareDesktop = shareDesktopSetting != 0;
+        /// <summary>
+        /// Determines the length of the client message at the start of a buffer.
+        /// </summary>
+        /// <param name="buffer">
+        /// The data which has been received from the client.
+        /// </param>
+        /// <param name="length">
+        /// When this method returns <see langword="true"/>, the length of the message, in bytes.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if <paramref name="buffer"/> contains a complete message; otherwise,
+        /// <see langword="false"/>.
+        /// </returns>
+        internal static bool TryGetMessageLength(ReadOnlySequence<byte> buffer, out int length)
+        {
+            Span<byte> header = stackalloc byte[4];
+            length = 0;
 
-            var e = new CreatingDesktopEventArgs(shareDesktop);
-            this.OnCreatingDesktop(e);
+            if (buffer.IsEmpty)
+            {
+                return false;
+            }
 
-            var fbSource = this.fbSource;
-            this.Framebuffer = fbSource != null ? fbSource.Capture() : null;
-            VncStream.Require(
-                this.Framebuffer != null,
-                "No framebuffer. Make sure you've called SetFramebufferSource. It can be set to a VncFramebuffer.",
-                VncFailureReason.SanityCheckFailed);
-            this.clientPixelFormat = this.Framebuffer.PixelFormat;
-            this.clientWidth = this.Framebuffer.Width;
-            this.clientHeight = this.Framebuffer.Height;
-            this.fbuAutoCache = null;
+            switch ((VncMessageType)buffer.First.Span[0])
+            {
+                case VncMessageType.SetPixelFormat:
+                    length = 20;
+                    break;
 
-            this.c.SendUInt16BE((ushort)this.Framebuffer.Width);
-            this.c.SendUInt16BE((ushort)this.Framebuffer.Height);
-            var pixelFormat = new byte[VncPixelFormat.Size];
-            this.Framebuffer.PixelFormat.Encode(pixelFormat, 0);
-            this.c.Send(pixelFormat);
-            this.c.SendString(this.Framebuffer.Name, true);
+                case VncMessageType.SetEncodings:
+                    if (!TryPeek(buffer, 2, header.Slice(0, 2)))
+                    {
+                        return false;
+                    }
 
-            this.logger?.LogInformation($"The desktop {this.Framebuffer.Name} has initialized with pixel format {this.clientPixelFormat}; the screen size is {this.clientWidth}x{this.clientHeight}");
+                    length = 4 + (4 * BinaryPrimitives.ReadUInt16BigEndian(header));
+                    break;
+
+                case VncMessageType.FrameBufferUpdateRequest:
+                case VncMessageType.EnableContinuousUpdates:
+                    length = 10;
+                    break;
+
+                case VncMessageType.KeyEvent:
+                    length = 8;
+                    break;
+
+                case VncMessageType.PointerEvent:
+                    length = 6;
+                    break;
+
+                case VncMessageType.ClientCutText:
+                    if (!TryPeek(buffer, 4, header))
+                    {
+                        return false;
+                    }
+
+                    var textLength = BinaryPrimitives.ReadUInt32BigEndian(header);
+                    VncStream.SanityCheck(textLength <= 0xffffff);
+                    length = 8 + (int)textLength;
+                    break;
+
+                case VncMessageType.ClientFence:
+                    if (!TryPeek(buffer, 8, header.Slice(0, 1)))
+                    {
+                        return false;
+                    }
+
+                    length = 9 + header[0];
+                    break;
+
+                case VncMessageType.SetDesktopSize:
+                    if (!TryPeek(buffer, 6, header.Slice(0, 1)))
+                    {
+                        return false;
+                    }
+
+                    length = 8 + (16 * header[0]);
+                    break;
+
+                default:
+                    VncStream.Require(
+                        false,
+                        "Unsupported command.",
+                        VncFailureReason.UnrecognizedProtocolElement);
+
+                    break;
+            }
+
+            return buffer.Length >= length;
         }
 
         /// <summary>
@@ -716,32 +992,7 @@ namespace RemoteViewing.Vnc.Server
         /// </returns>
         internal bool NegotiateVersion(out AuthenticationMethod[] methods)
         {
-            this.logger?.LogInformation("Negotiating the version.");
-
-            this.c.SendVersion(new Version(3, 8));
-
-            this.clientVersion = this.c.ReceiveVersion();
-            if (this.clientVersion == new Version(3, 8))
-            {
-                methods = new[]
-                {
-                    this.options.AuthenticationMethod == AuthenticationMethod.Password
-                        ? AuthenticationMethod.Password : AuthenticationMethod.None,
-                };
-            }
-            else
-            {
-                // Clients using any version of the RFB protocol other than 3.8 are not supported.
-                // We'll let them know by sending an empty list of authenticaton methods, which will cause
-                // NegotiateSecurity to fail.
-                methods = new AuthenticationMethod[0];
-            }
-
-            var supportedMethods = $"Supported autentication method are {string.Join(" ", methods)}";
-
-            this.logger?.LogInformation($"The client version is {this.clientVersion}");
-            this.logger?.LogInformation(supportedMethods);
-
+            methods = this.NegotiateVersionAsync(CancellationToken.None).GetAwaiter().GetResult();
             return true;
         }
 
@@ -757,83 +1008,53 @@ namespace RemoteViewing.Vnc.Server
         /// <seealso href="https://github.com/rfbproto/rfbproto/blob/master/rfbproto.rst#712security"/>
         internal bool NegotiateSecurity(AuthenticationMethod[] methods)
         {
-            this.logger?.LogInformation("Negotiating security");
+            return this.NegotiateSecurityAsync(methods, CancellationToken.None).GetAwaiter().GetResult();
+        }
 
-            this.c.SendByte((byte)methods.Length);
+        internal void HandleSetEncodings()
+        {
+            this.c.Receive(1);
 
-            if (methods.Length == 0)
+            int encodingCount = this.c.ReceiveUInt16BE();
+            VncStream.SanityCheck(encodingCount <= 0x1ff);
+            this.clientEncoding.Clear();
+
+            this.logger?.LogInformation($"The client supports {encodingCount} encodings:");
+
+            for (int i = 0; i < encodingCount; i++)
             {
-                this.logger?.LogWarning("The server and client could not agree on any authentication method.");
-                this.c.SendString("The server and client could not agree on any authentication method.", includeLength: true);
-                return false;
+                var encoding = (VncEncoding)this.c.ReceiveUInt32BE();
+                this.clientEncoding.Add(encoding);
+
+                this.logger?.LogInformation($"- {encoding}");
             }
 
-            foreach (var method in methods)
+            // The client lists the encodings it prefers first. Send the cursor again, the client may have reset it.
+            this.cursorEncoding = this.clientEncoding
+                .Where(e => e == VncEncoding.CursorWithAlpha || e == VncEncoding.RichCursor)
+                .Cast<VncEncoding?>()
+                .FirstOrDefault();
+            this.sentCursor = null;
+
+            lock (this.c.SyncRoot)
             {
-                this.c.SendByte((byte)method);
+                this.qualityController.MaximumQualityLevel = TightEncoder.GetRequestedQualityLevel(this);
             }
 
-            var selectedMethod = (AuthenticationMethod)this.c.ReceiveByte();
-            if (!methods.Contains(selectedMethod))
+            this.InitFramebufferEncoder();
+
+            // The server confirms that it supports these extensions the first time the client announces them.
+            if (!this.fenceSupported && this.clientEncoding.Contains(VncEncoding.Fence))
             {
-                this.c.SendUInt32BE(1);
-                this.logger?.LogInformation("Invalid authentication method.");
-                this.c.SendString("Invalid authentication method.", includeLength: true);
-                return false;
+                this.fenceSupported = true;
+                this.SendFenceRequest();
             }
 
-            bool success = true;
-            if (selectedMethod == AuthenticationMethod.Password)
+            if (!this.continuousUpdatesSupported && this.clientEncoding.Contains(VncEncoding.ContinuousUpdates))
             {
-                var challenge = this.passwordChallenge.GenerateChallenge();
-                using (new Utility.AutoClear(challenge))
-                {
-                    this.c.Send(challenge);
-
-                    var response = this.c.Receive(16);
-                    using (new Utility.AutoClear(response))
-                    {
-                        var e = new PasswordProvidedEventArgs(this.passwordChallenge, challenge, response);
-                        this.OnPasswordProvided(e);
-                        success = e.IsAuthenticated;
-                    }
-                }
+                this.continuousUpdatesSupported = true;
+                this.SendEndOfContinuousUpdates();
             }
-
-            this.c.SendUInt32BE(success ? 0 : 1U);
-
-            if (!success)
-            {
-                this.logger?.LogInformation("The user failed to authenticate.");
-                this.c.SendString("Failed to authenticate", includeLength: true);
-                return false;
-            }
-
-            this.logger?.LogInformation("The user authenticated successfully.");
-            this.securityNegotiated = true;
-
-            return true;
-        }
-
-        internal void HandleSetEncodings()
-        {
-            this.c.Receive(1);
-
-            int encodingCount = this.c.ReceiveUInt16BE();
-            VncStream.SanityCheck(encodingCount <= 0x1ff);
-            this.clientEncoding.Clear();
-
-            this.logger?.LogInformation($"The client supports {encodingCount} encodings:");
-
-            for (int i = 0; i < encodingCount; i++)
-            {
-                var encoding = (VncEncoding)this.c.ReceiveUInt32BE();
-                this.clientEncoding.Add(encoding);
-
-                this.logger?.LogInformation($"- {encoding}");
-            }
-
-            this.InitFramebufferEncoder();
         }
 
         /// <summary>
@@ -881,13 +1102,13 @@ namespace RemoteViewing.Vnc.Server
         {
             this.Closed?.Invoke(this, EventArgs.Empty);
 
-            this.logger.LogInformation($"Encoder     Rectangles  Raw         Encoded     Ratio");
+            this.logger?.LogInformation($"Encoder     Rectangles  Raw         Encoded     Ratio");
 
             foreach (var stat in this.Statistics)
             {
                 var ratio = 100.0 - (stat.Value.EncodedBytes / (double)stat.Value.RawBytes * 100);
 
-                this.logger.LogInformation($"{stat.Key,-12}{stat.Value.Rectangles,-12}{stat.Value.RawBytes,-12}{stat.Value.EncodedBytes,-12}{ratio:0.#}%");
+                this.logger?.LogInformation($"{stat.Key,-12}{stat.Value.Rectangles,-12}{stat.Value.RawBytes,-12}{stat.Value.EncodedBytes,-12}{ratio:0.#}%");
             }
         }
 
@@ -943,73 +1164,532 @@ namespace RemoteViewing.Vnc.Server
             this.RemoteClipboardChanged?.Invoke(this, e);
         }
 
+        private static bool TryPeek(ReadOnlySequence<byte> buffer, int offset, Span<byte> value)
+        {
+            if (buffer.Length < offset + value.Length)
+            {
+                return false;
+            }
+
+            buffer.Slice(offset, value.Length).CopyTo(value);
+            return true;
+        }
+
+        private static Task<MemoryStream> AddEncodedRectangle(Task<MemoryStream> task, VncEncodedRectangleCache cache, VncEncodedRectangleKey key)
+        {
+            // Share the output of the worker with the other sessions; like on the session thread, an empty
+            // array records that the rectangle can't be sent independently.
+            return task.ContinueWith(
+                t =>
+                {
+                    var buffer = t.GetAwaiter().GetResult();
+                    cache.Add(key, buffer != null ? buffer.ToArray() : Array.Empty<byte>());
+                    return buffer;
+                },
+                CancellationToken.None,
+                TaskContinuationOptions.ExecuteSynchronously,
+                TaskScheduler.Default);
+        }
+
+        private static void WaitForEncoding(Task<MemoryStream>[] encoded)
+        {
+            if (encoded == null)
+            {
+                return;
+            }
+
+            foreach (var task in encoded)
+            {
+                try
+                {
+                    task?.Wait();
+                }
+                catch (AggregateException)
+                {
+                    // The exception has already been observed when the rectangle was sent.
+                }
+            }
+        }
+
         private void SendRectangles(List<Rectangle> rectangles)
         {
             lock (this.c.SyncRoot)
             {
+                var stopwatch = Stopwatch.StartNew();
+
                 this.c.Send(new byte[2] { 0, 0 });
                 this.c.SendUInt16BE((ushort)rectangles.Count);
 
-                foreach (var rectangle in rectangles)
+                long length = 4 + (12 * rectangles.Count);
+
+                var encoded = this.StartEncoding(rectangles);
+
+                try
                 {
-                    if (rectangle.Encoding != VncEncoding.Raw)
+                    for (int i = 0; i < rectangles.Count; i++)
                     {
-                        this.c.SendRectangle(rectangle.Region);
-                        this.c.SendUInt32BE((uint)rectangle.Encoding);
-                        this.c.Send(rectangle.Contents);
+                        this.SendRectangle(rectangles[i], encoded?[i], ref length);
+                    }
+                }
+                finally
+                {
+                    // The workers read from the contents of the rectangles, which are returned to the pool
+                    // once the update has been sent; make sure they are done, even if sending failed.
+                    WaitForEncoding(encoded);
+                }
+
+                this.congestionControl.Sent(length);
+                this.qualityController.Queued(length, stopwatch.Elapsed, this.clock.Elapsed);
+
+                Interlocked.Add(ref this.bytesSent, length);
+                Interlocked.Increment(ref this.framebufferUpdatesSent);
+                this.c.Flush();
+            }
+        }
+
+        private void SendRectangle(Rectangle rectangle, Task<MemoryStream> encoded, ref long length)
+        {
+            if (rectangle.Encoding != VncEncoding.Raw)
+            {
+                this.c.SendRectangle(rectangle.Region);
+                this.c.SendUInt32BE((uint)rectangle.Encoding);
+                MemoryMarshal.TryGetArray(rectangle.Contents, out ArraySegment<byte> contents);
+                this.c.Send(contents.Array, contents.Offset, contents.Count);
+
+                this.RecordEncoderTransfer(rectangle.Encoding, rectangle.Contents.Length, rectangle.Contents.Length);
+                length += rectangle.Contents.Length;
+            }
+            else
+            {
+                this.c.SendRectangle(rectangle.Region);
+                this.c.SendUInt32BE((uint)this.Encoder.Encoding);
+
+                int sent;
+                var buffer = encoded?.Result;
+
+                if (buffer != null)
+                {
+                    this.c.Send(buffer.GetBuffer(), 0, (int)buffer.Length);
+                    sent = (int)buffer.Length;
+                }
+                else
+                {
+                    var encodeTimestamp = Stopwatch.GetTimestamp();
+                    sent = this.SendEncodedRectangle(rectangle);
+                    this.GetStatistics(this.Encoder.Encoding).AddEncodeTime(encodeTimestamp);
+                }
+
+                this.RecordEncoderTransfer(this.Encoder.Encoding, rectangle.Contents.Length, sent);
+                length += sent;
+            }
+        }
+
+        private Task<MemoryStream>[] StartEncoding(List<Rectangle> rectangles)
+        {
+            Task<MemoryStream>[] encoded = null;
+            var sharedSource = this.fbSource as VncSharedFramebufferSource;
+
+            for (int i = 0; i < rectangles.Count; i++)
+            {
+                var rectangle = rectangles[i];
 
-                        this.RecordEncoderTransfer(rectangle.Encoding, rectangle.Contents.Length, rectangle.Contents.Length);
+                if (rectangle.Encoding != VncEncoding.Raw)
+                {
+                    continue;
+                }
+
+                // Rectangles which refer to the framebuffer are encoded while holding its lock, so they can't be
+                // encoded by the workers.
+                if (rectangle.Framebuffer != null)
+                {
+                    continue;
+                }
+
+                VncEncodedRectangleKey key = default;
+                bool independent = false;
+                bool cache = sharedSource != null
+                    && rectangle.Generation != 0
+                    && this.TryGetEncodedRectangleKey(rectangle.Generation, rectangle.Region, out key, out independent);
+
+                // Rectangles which are encoded once for all sessions which share the framebuffer are not encoded
+                // in parallel, unless they can be encoded independently and no other session has done so yet.
+                if (cache && (!independent || sharedSource.EncodedRectangles.TryGetValue(key, out _)))
+                {
+                    continue;
+                }
+
+                var task = this.parallelEncoder.Encode(this.Encoder, this.clientPixelFormat, rectangle.Region, rectangle.Contents, this.GetStatistics(this.Encoder.Encoding));
+
+                if (task != null)
+                {
+                    if (cache)
+                    {
+                        task = AddEncodedRectangle(task, sharedSource.EncodedRectangles, key);
                     }
-                    else
+
+                    if (encoded == null)
                     {
-                        this.c.SendRectangle(rectangle.Region);
-                        this.c.SendUInt32BE((uint)this.Encoder.Encoding);
+                        encoded = new Task<MemoryStream>[rectangles.Count];
+                    }
 
-                        int sent = this.Encoder.Send(this.c.Stream, this.clientPixelFormat, rectangle.Region, rectangle.Contents);
-                        this.RecordEncoderTransfer(this.Encoder.Encoding, rectangle.Contents.Length, sent);
+                    encoded[i] = task;
+                }
+            }
+
+            return encoded;
+        }
+
+        private void SendFenceRequest()
+        {
+            lock (this.c.SyncRoot)
+            {
+                // The client only responds once it has processed everything which was sent before; the identifier
+                // in the payload is used to match the response with the request.
+                var payload = new byte[4];
+                BinaryPrimitives.WriteUInt32BigEndian(payload, this.congestionControl.SentPing(this.clock.Elapsed));
+                this.SendFence(VncFenceFlags.Request | VncFenceFlags.BlockBefore, payload);
+            }
+        }
+
+        private void SendFence(VncFenceFlags flags, byte[] payload)
+        {
+            lock (this.c.SyncRoot)
+            {
+                this.c.SendByte(248); // ServerFence
+                this.c.Send(new byte[3]);
+                this.c.SendUInt32BE((uint)flags);
+                this.c.SendByte((byte)payload.Length);
+                this.c.Send(payload);
+                this.c.Flush();
+            }
+        }
+
+        private void SendEndOfContinuousUpdates()
+        {
+            lock (this.c.SyncRoot)
+            {
+                this.c.SendByte(150); // EndOfContinuousUpdates
+                this.c.Flush();
+            }
+        }
+
+        private bool IsCongested()
+        {
+            lock (this.c.SyncRoot)
+            {
+                // Without fences, at least wait for the previous update to be handed off to the network
+                // before queuing the next one.
+                return this.IsBacklogged() || (this.fenceSupported && this.congestionControl.IsCongested);
+            }
+        }
+
+        private bool IsBacklogged()
+        {
+            return this.c.Stream is VncPipeStream pipe && pipe.PendingBytes > 0;
+        }
+
+        private void AdjustQuality()
+        {
+            lock (this.c.SyncRoot)
+            {
+                var wasConstrained = this.qualityController.IsConstrained;
+
+                if (this.qualityController.Adjust(this.clock.Elapsed))
+                {
+                    this.logger?.LogDebug($"Adjusted the update rate to {this.qualityController.UpdateRate:0.#} fps and the quality level to {this.qualityController.QualityLevel}; the estimated bandwidth is {this.qualityController.Bandwidth / 1024:0} KB/s.");
+
+                    if (wasConstrained != this.qualityController.IsConstrained)
+                    {
+                        this.InitFramebufferEncoder();
+                    }
+                }
+            }
+        }
+
+        private void OnOutputDrained(object sender, EventArgs e)
+        {
+            lock (this.c.SyncRoot)
+            {
+                this.qualityController.Drained(this.clock.Elapsed);
+            }
+
+            // Send any update which was held back while the output was backlogged.
+            this.updates?.Signal();
+        }
+
+        private int SendEncodedRectangle(Rectangle rectangle)
+        {
+            var sharedSource = this.fbSource as VncSharedFramebufferSource;
+
+            if (rectangle.Framebuffer != null)
+            {
+                // The contents refer to the framebuffer, which may be updated while the rectangle is being encoded.
+                // Hold the lock while encoding, so that the data is consistent and matches the generation.
+                lock (rectangle.Framebuffer.SyncRoot)
+                {
+                    return sharedSource != null
+                        ? this.SendSharedEncodedRectangle(sharedSource, sharedSource.GetGeneration(rectangle.Framebuffer), rectangle)
+                        : this.Encoder.Send(this.c.Stream, this.clientPixelFormat, rectangle.Region, rectangle.Contents.Span);
+                }
+            }
+            else if (sharedSource != null && rectangle.Generation != 0)
+            {
+                return this.SendSharedEncodedRectangle(sharedSource, rectangle.Generation, rectangle);
+            }
+            else
+            {
+                return this.Encoder.Send(this.c.Stream, this.clientPixelFormat, rectangle.Region, rectangle.Contents.Span);
+            }
+        }
+
+        private int SendSharedEncodedRectangle(VncSharedFramebufferSource sharedSource, long generation, Rectangle rectangle)
+        {
+            if (!this.TryGetEncodedRectangleKey(generation, rectangle.Region, out VncEncodedRectangleKey key, out bool independent))
+            {
+                return this.Encoder.Send(this.c.Stream, this.clientPixelFormat, rectangle.Region, rectangle.Contents.Span);
+            }
+
+            // Another session with the same encoder settings may already have encoded this rectangle.
+            if (generation == 0 || !sharedSource.EncodedRectangles.TryGetValue(key, out byte[] encoded))
+            {
+                using (var buffer = new MemoryStream())
+                {
+                    if (!independent)
+                    {
+                        this.Encoder.Send(buffer, this.clientPixelFormat, rectangle.Region, rectangle.Contents.Span);
+                        encoded = buffer.ToArray();
                     }
+                    else
+                    {
+                        // An empty array records that the rectangle can't be sent independently, so other sessions
+                        // don't have to try again.
+                        encoded = this.Encoder.TrySendIndependently(buffer, this.clientPixelFormat, rectangle.Region, rectangle.Contents.Span)
+                            ? buffer.ToArray()
+                            : Array.Empty<byte>();
+                    }
+                }
+
+                if (generation != 0)
+                {
+                    sharedSource.EncodedRectangles.Add(key, encoded);
+                }
+            }
+
+            if (independent && encoded.Length == 0)
+            {
+                return this.Encoder.Send(this.c.Stream, this.clientPixelFormat, rectangle.Region, rectangle.Contents.Span);
+            }
+
+            this.c.Send(encoded);
+            return encoded.Length;
+        }
+
+        private bool TryGetEncodedRectangleKey(long generation, VncRectangle region, out VncEncodedRectangleKey key, out bool independent)
+        {
+            var settings = this.Encoder.GetSharedEncodingKey(this.clientPixelFormat, region);
+            independent = settings == null;
+
+            if (independent)
+            {
+                settings = this.Encoder.GetIndependentEncodingKey(this.clientPixelFormat, region);
+            }
+
+            key = settings != null
+                ? new VncEncodedRectangleKey(generation, region, this.Encoder.Encoding, this.clientPixelFormat, settings.Value)
+                : default;
+            return settings != null;
+        }
+
+        private void ClearRectangles()
+        {
+            foreach (var rectangle in this.fbuRectangles)
+            {
+                if (rectangle.PooledBuffer != null)
+                {
+                    RectanglePool.Return(rectangle.PooledBuffer);
                 }
             }
+
+            this.fbuRectangles.Clear();
         }
 
         private void RecordEncoderTransfer(VncEncoding encoding, int rawLength, int encodedLength)
         {
-            if (!this.Statistics.ContainsKey(encoding))
+            this.GetStatistics(encoding).AddTransfer(rawLength, encodedLength);
+        }
+
+        private EncoderStatistics GetStatistics(VncEncoding encoding)
+        {
+            if (!this.statistics.TryGetValue(encoding, out EncoderStatistics statistics))
+            {
+                statistics = this.statistics.GetOrAdd(encoding, e => new EncoderStatistics(e));
+            }
+
+            return statistics;
+        }
+
+        private void EndDiff()
+        {
+            if (this.diffTimestamp != 0)
+            {
+                VncServerEventSource.Instance.AddDiffDuration(VncServerEventSource.GetElapsedMilliseconds(this.diffTimestamp));
+                this.diffTimestamp = 0;
+            }
+        }
+
+        private async Task NegotiateDesktopAsync(CancellationToken cancellationToken)
+        {
+            this.logger?.LogInformation("Negotiating desktop settings");
+
+            byte shareDesktopSetting = await this.c.ReceiveByteAsync(cancellationToken).ConfigureAwait(false);
+            bool shareDesktop = shareDesktopSetting != 0;
+
+            var e = new CreatingDesktopEventArgs(shareDesktop);
+            this.OnCreatingDesktop(e);
+
+            var fbSource = this.fbSource;
+            this.Framebuffer = fbSource != null ? fbSource.Capture() : null;
+            VncStream.Require(
+                this.Framebuffer != null,
+                "No framebuffer. Make sure you've called SetFramebufferSource. It can be set to a VncFramebuffer.",
+                VncFailureReason.SanityCheckFailed);
+            this.clientPixelFormat = this.Framebuffer.PixelFormat;
+            this.clientWidth = this.Framebuffer.Width;
+            this.clientHeight = this.Framebuffer.Height;
+            this.fbuAutoCache = null;
+
+            this.c.SendUInt16BE((ushort)this.Framebuffer.Width);
+            this.c.SendUInt16BE((ushort)this.Framebuffer.Height);
+            var pixelFormat = new byte[VncPixelFormat.Size];
+            this.Framebuffer.PixelFormat.Encode(pixelFormat, 0);
+            this.c.Send(pixelFormat);
+            this.c.SendString(this.Framebuffer.Name, true);
+            this.c.Flush();
+
+            this.logger?.LogInformation($"The desktop {this.Framebuffer.Name} has initialized with pixel format {this.clientPixelFormat}; the screen size is {this.clientWidth}x{this.clientHeight}");
+        }
+
+        private async Task<AuthenticationMethod[]> NegotiateVersionAsync(CancellationToken cancellationToken)
+        {
+            this.logger?.LogInformation("Negotiating the version.");
+
+            this.c.SendVersion(new Version(3, 8));
+            this.c.Flush();
+
+            AuthenticationMethod[] methods;
+            this.clientVersion = await this.c.ReceiveVersionAsync(cancellationToken).ConfigureAwait(false);
+            if (this.clientVersion == new Version(3, 8))
             {
-                this.Statistics.Add(encoding, new EncoderStatistics());
+                methods = new[]
+                {
+                    this.options.AuthenticationMethod == AuthenticationMethod.Password
+                        ? AuthenticationMethod.Password : AuthenticationMethod.None,
+                };
+            }
+            else
+            {
+                // Clients using any version of the RFB protocol other than 3.8 are not supported.
+                // We'll let them know by sending an empty list of authenticaton methods, which will cause
+                // NegotiateSecurity to fail.
+                methods = new AuthenticationMethod[0];
             }
 
-            this.Statistics[encoding].EncodedBytes += (ulong)encodedLength;
-            this.Statistics[encoding].RawBytes += (ulong)rawLength;
-            this.Statistics[encoding].Rectangles++;
+            var supportedMethods = $"Supported autentication method are {string.Join(" ", methods)}";
+
+            this.logger?.LogInformation($"The client version is {this.clientVersion}");
+            this.logger?.LogInformation(supportedMethods);
+
+            return methods;
         }
 
-        private void ThreadMain()
+        private async Task<bool> NegotiateSecurityAsync(AuthenticationMethod[] methods, CancellationToken cancellationToken)
         {
-            this.requester = new Utility.PeriodicThread();
+            this.logger?.LogInformation("Negotiating security");
 
+            this.c.SendByte((byte)methods.Length);
+
+            if (methods.Length == 0)
+            {
+                this.logger?.LogWarning("The server and client could not agree on any authentication method.");
+                this.c.SendString("The server and client could not agree on any authentication method.", includeLength: true);
+                this.c.Flush();
+                return false;
+            }
+
+            foreach (var method in methods)
+            {
+                this.c.SendByte((byte)method);
+            }
+
+            this.c.Flush();
+
+            var selectedMethod = (AuthenticationMethod)await this.c.ReceiveByteAsync(cancellationToken).ConfigureAwait(false);
+            if (!methods.Contains(selectedMethod))
+            {
+                this.c.SendUInt32BE(1);
+                this.logger?.LogInformation("Invalid authentication method.");
+                this.c.SendString("Invalid authentication method.", includeLength: true);
+                this.c.Flush();
+                return false;
+            }
+
+            bool success = true;
+            if (selectedMethod == AuthenticationMethod.Password)
+            {
+                var challenge = this.passwordChallenge.GenerateChallenge();
+                using (new Utility.AutoClear(challenge))
+                {
+                    this.c.Send(challenge);
+                    this.c.Flush();
+
+                    var response = await this.c.ReceiveAsync(16, cancellationToken).ConfigureAwait(false);
+                    using (new Utility.AutoClear(response))
+                    {
+                        var e = new PasswordProvidedEventArgs(this.passwordChallenge, challenge, response);
+                        this.OnPasswordProvided(e);
+                        success = e.IsAuthenticated;
+                    }
+                }
+            }
+
+            this.c.SendUInt32BE(success ? 0 : 1U);
+            this.c.Flush();
+
+            if (!success)
+            {
+                this.logger?.LogInformation("The user failed to authenticate.");
+                this.c.SendString("Failed to authenticate", includeLength: true);
+                this.c.Flush();
+                return false;
+            }
+
+            this.logger?.LogInformation("The user authenticated successfully.");
+            this.securityNegotiated = true;
+
+            return true;
+        }
+
+        private async Task RunAsync()
+        {
             try
             {
                 this.InitFramebufferEncoder();
 
-                AuthenticationMethod[] methods;
+                var methods = await this.NegotiateVersionAsync(CancellationToken.None).ConfigureAwait(false);
 
-                if (this.NegotiateVersion(out methods)
-                    && this.NegotiateSecurity(methods))
+                if (await this.NegotiateSecurityAsync(methods, CancellationToken.None).ConfigureAwait(false))
                 {
-                    this.NegotiateDesktop();
+                    await this.NegotiateDesktopAsync(CancellationToken.None).ConfigureAwait(false);
 
-                    this.requester.Start(() => this.FramebufferSendChanges(), () => this.MaxUpdateRate, false);
+                    this.updates = VncUpdateScheduler.Shared.Schedule(() => this.FramebufferSendChanges(), () => this.qualityController.UpdateRate);
 
                     this.IsConnected = true;
                     this.logger?.LogInformation("The client has connected successfully");
 
+                    VncServerEventSource.Instance.AddSession(this);
                     this.OnConnected();
 
-                    while (true)
-                    {
-                        this.HandleMessage();
-                    }
+                    await this.ReceiveMessagesAsync((VncPipeStream)this.c.Stream).ConfigureAwait(false);
                 }
             }
             catch (Exception exception)
@@ -1017,12 +1697,15 @@ namespace RemoteViewing.Vnc.Server
                 this.logger?.LogError(new EventId(1), exception, $"VNC server session stopped due to: {exception.Message}");
             }
 
-            this.requester.Stop();
+            this.updates?.Dispose();
 
+            // Disposing of the stream also stops the task which sends queued data to the client.
+            this.c.Close();
             this.c.Stream = null;
             if (this.IsConnected)
             {
                 this.IsConnected = false;
+                VncServerEventSource.Instance.RemoveSession(this);
                 this.OnClosed();
             }
             else
@@ -1031,6 +1714,50 @@ namespace RemoteViewing.Vnc.Server
             }
         }
 
+        private async Task ReceiveMessagesAsync(VncPipeStream pipe)
+        {
+            var reader = pipe.Reader;
+
+            while (true)
+            {
+                var result = await reader.ReadAsync().ConfigureAwait(false);
+                var buffer = result.Buffer;
+
+                try
+                {
+                    // Handle all messages which have been received so far in one go; the handlers read
+                    // from a buffered copy of the message, and never block on the network.
+                    while (TryGetMessageLength(buffer, out int length))
+                    {
+                        var message = ArrayPool<byte>.Shared.Rent(length);
+
+                        try
+                        {
+                            buffer.Slice(0, length).CopyTo(message);
+                            pipe.SetMessage(new ReadOnlyMemory<byte>(message, 0, length));
+                            this.HandleMessage();
+                        }
+                        finally
+                        {
+                            pipe.SetMessage(ReadOnlyMemory<byte>.Empty);
+                            ArrayPool<byte>.Shared.Return(message);
+                        }
+
+                        buffer = buffer.Slice(length);
+                    }
+                }
+                finally
+                {
+                    reader.AdvanceTo(buffer.Start, buffer.End);
+                }
+
+                VncStream.Require(
+                    !result.IsCompleted && !result.IsCanceled,
+                    "Lost connection.",
+                    VncFailureReason.NetworkError);
+            }
+        }
+
         private void HandleSetPixelFormat()
         {
             this.c.Receive(3);
@@ -1102,6 +1829,59 @@ namespace RemoteViewing.Vnc.Server
                 }
 
                 this.FramebufferUpdateRequest = new FramebufferUpdateRequest(incremental, region);
+
+                // Measure the latency from the oldest request which hasn't been answered yet.
+                Interlocked.CompareExchange(ref this.requestTimestamp, Stopwatch.GetTimestamp(), 0);
+                this.FramebufferChanged();
+            }
+        }
+
+        private void HandleEnableContinuousUpdates()
+        {
+            var enable = this.c.ReceiveByte() != 0;
+            var region = this.c.ReceiveRectangle();
+
+            lock (this.FramebufferUpdateRequestLock)
+            {
+                if (enable)
+                {
+                    this.logger?.LogInformation($"Enabling continuous updates for {region}.");
+                    this.continuousUpdatesRegion = region;
+                    this.FramebufferChanged();
+                }
+                else
+                {
+                    // Holding the lock guarantees no update is being sent, so the client
+                    // won't receive any further updates after this message.
+                    this.logger?.LogInformation("Disabling continuous updates.");
+                    this.continuousUpdatesRegion = null;
+                    this.SendEndOfContinuousUpdates();
+                }
+            }
+        }
+
+        private void HandleClientFence()
+        {
+            this.c.Receive(3);
+            var flags = (VncFenceFlags)this.c.ReceiveUInt32BE();
+            int length = this.c.ReceiveByte();
+            VncStream.SanityCheck(length <= 64);
+            var payload = this.c.Receive(length);
+
+            if ((flags & VncFenceFlags.Request) != 0)
+            {
+                // Messages are handled one at a time, and updates are sent while holding the lock on the stream,
+                // so responding right away satisfies BlockBefore and BlockAfter. SyncNext is not supported.
+                this.SendFence(flags & (VncFenceFlags.BlockBefore | VncFenceFlags.BlockAfter), payload);
+            }
+            else if (length == 4)
+            {
+                lock (this.c.SyncRoot)
+                {
+                    this.congestionControl.ReceivedPong(BinaryPrimitives.ReadUInt32BigEndian(payload), this.clock.Elapsed);
+                }
+
+                // The congestion window may have opened up again.
                 this.FramebufferChanged();
             }
         }
@@ -1121,6 +1901,21 @@ namespace RemoteViewing.Vnc.Server
             int x = this.c.ReceiveUInt16BE();
             int y = this.c.ReceiveUInt16BE();
 
+            Volatile.Write(ref this.pointerPosition, ((long)x << 16) | (uint)y);
+
+            // The position of the cursor is kept in the coordinates of the client; the application expects the
+            // coordinates of the framebuffer source.
+            if (this.fbSource is VncScaledFramebufferSource scaledSource)
+            {
+                scaledSource.MapToSource(ref x, ref y);
+            }
+
+            // When the cursor is drawn into the framebuffer updates, it moves along with the pointer.
+            if (this.cursor != null && this.cursorEncoding == null)
+            {
+                this.FramebufferChanged();
+            }
+
             this.OnPointerChanged(new PointerChangedEventArgs(x, y, pressedButtons));
         }
 
@@ -1157,9 +1952,120 @@ namespace RemoteViewing.Vnc.Server
             this.SendRectangles(rectangles);
         }
 
-        private void AddRegion(VncRectangle region, VncEncoding encoding, byte[] contents)
+        private void AddFramebufferRegion(VncRectangle region)
+        {
+            var fb = this.Framebuffer;
+            var cpf = this.clientPixelFormat;
+
+            int x = region.X, y = region.Y, w = region.Width, h = region.Height, bpp = cpf.BytesPerPixel;
+
+            var cursor = this.softwareCursor;
+            var cursorBounds = this.softwareCursorBounds;
+            var drawCursor = cursor != null && !VncRectangle.Intersect(region, cursorBounds).IsEmpty;
+
+            if (!drawCursor && x == 0 && w == fb.Width && fb.PixelFormat.Equals(cpf) && this.MaxEncoderThreads == 1)
+            {
+                // The rectangle consists of entire lines of the framebuffer, and no pixel format conversion
+                // is required, so the encoder can read the pixel data straight from the framebuffer, while
+                // holding its lock. When encoding in parallel, the contents are copied so that the workers
+                // can read them without holding the lock.
+                this.AddRegion(
+                    new Rectangle()
+                    {
+                        Region = region,
+                        Encoding = VncEncoding.Raw,
+                        Contents = new ReadOnlyMemory<byte>(fb.GetBuffer(), y * fb.Stride, h * fb.Stride),
+                        Framebuffer = fb,
+                    });
+                return;
+            }
+
+            int length = w * h * bpp;
+            var contents = RectanglePool.Rent(length);
+            long generation = 0;
+
+            lock (fb.SyncRoot)
+            {
+                VncPixelFormat.Copy(
+                    fb.GetBuffer(),
+                    fb.Width,
+                    fb.Stride,
+                    fb.PixelFormat,
+                    region,
+                    contents,
+                    w,
+                    w * bpp,
+                    cpf);
+
+                // When the framebuffer is shared with other sessions, keep track of the generation
+                // of the data, so that the encoded rectangle can be shared, too.
+                if (this.fbSource is VncSharedFramebufferSource sharedSource)
+                {
+                    generation = sharedSource.GetGeneration(fb);
+                }
+            }
+
+            if (drawCursor)
+            {
+                // The contents no longer match the shared framebuffer, so they can't be shared with other sessions.
+                cursor.Draw(contents, region, w * bpp, cpf, cursorBounds.X + cursor.HotspotX, cursorBounds.Y + cursor.HotspotY);
+                generation = 0;
+            }
+
+            this.AddRegion(
+                new Rectangle()
+                {
+                    Region = region,
+                    Encoding = VncEncoding.Raw,
+                    Contents = new ReadOnlyMemory<byte>(contents, 0, length),
+                    PooledBuffer = contents,
+                    Generation = generation,
+                });
+        }
+
+        private void AddCursorRegions()
         {
-            this.fbuRectangles.Add(new Rectangle() { Region = region, Encoding = encoding, Contents = contents });
+            var cursor = this.cursor;
+            var encoding = this.cursorEncoding;
+
+            if (encoding != null && cursor != null && cursor != this.sentCursor)
+            {
+                this.sentCursor = cursor;
+
+                var contents = encoding == VncEncoding.CursorWithAlpha
+                    ? cursor.EncodeCursorWithAlpha()
+                    : cursor.EncodeRichCursor(this.clientPixelFormat);
+
+                this.AddRegion(
+                    new Rectangle()
+                    {
+                        Region = new VncRectangle(cursor.HotspotX, cursor.HotspotY, cursor.Width, cursor.Height),
+                        Encoding = encoding.Value,
+                        Contents = contents,
+                    });
+            }
+
+            // When the cursor has moved or changed, restore the pixels under the old cursor and draw the new one.
+            if (this.softwareCursor != this.drawnCursor || this.softwareCursorBounds != this.drawnCursorBounds)
+            {
+                var previousBounds = this.drawnCursorBounds;
+                this.drawnCursor = this.softwareCursor;
+                this.drawnCursorBounds = this.softwareCursorBounds;
+
+                this.FramebufferManualInvalidate(previousBounds);
+                this.FramebufferManualInvalidate(this.softwareCursorBounds);
+            }
+        }
+
+        private bool IsCursorDrawn(VncRectangle region)
+        {
+            return !VncRectangle.Intersect(region, this.drawnCursorBounds).IsEmpty
+                || !VncRectangle.Intersect(region, this.softwareCursorBounds).IsEmpty;
+        }
+
+        private void AddRegion(Rectangle rectangle)
+        {
+            this.fbuRectangles.Add(rectangle);
 
             // Avoid the overflow of updated rectangle count.
             // NOTE: EndUpdate may implicitly add one for desktop resizing.
@@ -1190,6 +2096,14 @@ namespace RemoteViewing.Vnc.Server
                         break;
                     }
                 }
+
+                // When the connection can't keep up, prefer JPEG compression if the client accepts it.
+                if (this.qualityController.IsConstrained
+                    && this.qualityController.MaximumQualityLevel != null
+                    && this.clientEncoding.Contains(VncEncoding.Tight))
+                {
+                    this.Encoder = this.Encoders.FirstOrDefault(c => c.Encoding == VncEncoding.Tight) ?? this.Encoder;
+                }
             }
             else
             {
@@ -1203,7 +2117,16 @@ namespace RemoteViewing.Vnc.Server
         {
             public VncRectangle Region;
             public VncEncoding Encoding;
-            public byte[] Contents;
+            public ReadOnlyMemory<byte> Contents;
+
+            // The buffer rented from RectanglePool which holds the contents, if any.
+            public byte[] PooledBuffer;
+
+            // The framebuffer, if the contents refer directly to the framebuffer.
+            public VncFramebuffer Framebuffer;
+
+            // The generation of the contents, if the framebuffer is shared; or 0.
+            public long Generation;
         }
     }
 }
@@ -0,0 +1,130 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Microsoft.Extensions.Logging;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// A per-session <see cref="IVncFramebufferCache"/> for a framebuffer which is provided by a
+    /// <see cref="VncSharedFramebufferSource"/>. Instead of comparing the framebuffer with its own copy,
+    /// this cache relies on the changes detected by the shared framebuffer source.
+    /// </summary>
+    internal sealed class VncSharedFramebufferCache : IVncFramebufferCache
+    {
+        private readonly VncSharedFramebufferSource source;
+        private readonly ILogger logger;
+        private readonly int tileColumns;
+
+        // For each tile, the generation of the tile which was last sent to the client,
+        // and whether the tile is invalid for the current update request.
+        private readonly long[] sentGenerations;
+        private readonly bool[] isTileInvalid;
+        private readonly List<VncFramebufferMove> moves = new List<VncFramebufferMove>();
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncSharedFramebufferCache"/> class.
+        /// </summary>
+        /// <param name="source">
+        /// The <see cref="VncSharedFramebufferSource"/> which provides the framebuffer.
+        /// </param>
+        /// <param name="framebuffer">
+        /// The shared framebuffer.
+        /// </param>
+        /// <param name="tileColumns">
+        /// The number of tile columns in the framebuffer.
+        /// </param>
+        /// <param name="tileRows">
+        /// The number of tile rows in the framebuffer.
+        /// </param>
+        /// <param name="logger">
+        /// The <see cref="ILogger"/> logger to use when logging diagnostic messages.
+        /// </param>
+        public VncSharedFramebufferCache(VncSharedFramebufferSource source, VncFramebuffer framebuffer, int tileColumns, int tileRows, ILogger logger)
+        {
+            this.source = source ?? throw new ArgumentNullException(nameof(source));
+            this.Framebuffer = framebuffer ?? throw new ArgumentNullException(nameof(framebuffer));
+            this.logger = logger;
+            this.tileColumns = tileColumns;
+            this.sentGenerations = new long[tileColumns * tileRows];
+            this.isTileInvalid = new bool[tileColumns * tileRows];
+        }
+
+        /// <inheritdoc/>
+        public VncFramebuffer Framebuffer
+        {
+            get;
+            private set;
+        }
+
+        /// <inheritdoc/>
+        public bool RespondToUpdateRequest(IVncServerSession session)
+        {
+            var fb = this.Framebuffer;
+            var fbr = session.FramebufferUpdateRequest;
+            if (fbr == null)
+            {
+                return false;
+            }
+
+            var region = VncRectangle.Intersect(fbr.Region, new VncRectangle(0, 0, fb.Width, fb.Height));
+
+            this.logger?.LogDebug($"Responding to an update request for region {region}.");
+
+            session.FramebufferManualBeginUpdate();
+
+            // Moves must be sent before the tiles which were invalidated; they also mark the tiles which they
+            // bring up to date as sent, so these tiles are not invalidated.
+            if (fbr.Incremental && session.ClientEncodings != null && session.ClientEncodings.Contains(VncEncoding.CopyRect))
+            {
+                this.source.GetMoves(fb, region, this.sentGenerations, this.moves);
+
+                foreach (var move in this.moves)
+                {
+                    session.FramebufferManualCopyRegion(move.Target, move.SourceX, move.SourceY);
+                }
+            }
+
+            this.source.GetInvalidTiles(fb, region, this.sentGenerations, this.isTileInvalid);
+
+            if (fbr.Incremental)
+            {
+                VncFramebufferCache.InvalidateMergedTiles(session, region, this.isTileInvalid, this.tileColumns);
+            }
+            else if (!region.IsEmpty)
+            {
+                session.FramebufferManualInvalidate(region);
+            }
+
+            return session.FramebufferManualEndUpdate();
+        }
+    }
+}
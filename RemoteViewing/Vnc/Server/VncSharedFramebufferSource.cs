@@ -0,0 +1,480 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using Microsoft.Extensions.Logging;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Shares a single <see cref="IVncFramebufferSource"/> between all sessions of a <see cref="VncServer"/>.
+    /// The framebuffer is captured and compared with the previous frame at most once per <see cref="CaptureInterval"/>,
+    /// regardless of the number of sessions.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// Sessions don't receive the framebuffer of the underlying source, but a snapshot of it which is only modified when
+    /// a new frame is captured. Each time a frame with changes is captured, the <see cref="Generation"/> is incremented,
+    /// and the tiles which have changed are tagged with that generation. The <see cref="VncSharedFramebufferCache"/> of
+    /// each session compares these generations with the generations it has already sent to its client.
+    /// </para>
+    /// <para>
+    /// Because the snapshot only changes between generations, the encoded data for a rectangle of a given generation can
+    /// be shared between sessions which use the same encoder settings. This data is stored in <see cref="EncodedRectangles"/>.
+    /// </para>
+    /// <para>
+    /// When a frame is captured, the blocks which have moved since the previous frame are detected as well. Sessions which
+    /// are up to date with the previous frame can send these moves as CopyRect rectangles; see <see cref="GetMoves"/>.
+    /// </para>
+    /// </remarks>
+    internal sealed class VncSharedFramebufferSource : IVncCursorSource
+    {
+        private readonly IVncFramebufferSource source;
+        private readonly ILogger logger;
+        private readonly object syncRoot = new object();
+        private readonly Stopwatch stopwatch = new Stopwatch();
+        private readonly VncMotionDetector motionDetector = new VncMotionDetector();
+
+        // When the underlying source reports which regions it has changed, only the tiles which overlap
+        // these regions are compared, and nothing is compared at all if the source hasn't changed.
+        private readonly VncDamageReader damageReader = new VncDamageReader();
+
+        // The moves which were detected in the most recent capture, and the generation of each tile
+        // before that capture; these are used to determine whether a session can use the moves.
+        private readonly List<VncFramebufferMove> detectedMoves = new List<VncFramebufferMove>();
+        private long[] previousTileGenerations;
+
+        private VncFramebuffer framebuffer;
+        private int tileColumns;
+        private int tileRows;
+        private long[] tileGenerations;
+        private bool[] isTileChanged;
+        private bool[] isTileDamaged;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncSharedFramebufferSource"/> class.
+        /// </summary>
+        /// <param name="source">
+        /// The framebuffer source to share.
+        /// </param>
+        /// <param name="logger">
+        /// The <see cref="ILogger"/> logger to use when logging diagnostic messages.
+        /// </param>
+        public VncSharedFramebufferSource(IVncFramebufferSource source, ILogger logger)
+        {
+            this.source = source ?? throw new ArgumentNullException(nameof(source));
+            this.logger = logger;
+        }
+
+        /// <summary>
+        /// Gets or sets the minimum amount of time between two captures of the underlying framebuffer source.
+        /// Sessions which request the framebuffer more frequently receive the most recently captured frame.
+        /// </summary>
+        public TimeSpan CaptureInterval
+        { get; set; } = TimeSpan.FromSeconds(1.0 / 30);
+
+        /// <summary>
+        /// Gets the generation of the most recently captured frame. Use the <see cref="VncFramebuffer.SyncRoot"/>
+        /// of the shared framebuffer when you need the generation to be consistent with the framebuffer data.
+        /// </summary>
+        public long Generation
+        {
+            get;
+            private set;
+        }
+
+        /// <summary>
+        /// Gets a cache which holds rectangles which have been encoded for the current <see cref="Generation"/>.
+        /// </summary>
+        public VncEncodedRectangleCache EncodedRectangles
+        { get; } = new VncEncodedRectangleCache();
+
+        /// <inheritdoc/>
+        public bool SupportsResizing => this.source.SupportsResizing;
+
+        /// <inheritdoc/>
+        public VncCursor Cursor => (this.source as IVncCursorSource)?.Cursor;
+
+        /// <inheritdoc/>
+        public VncFramebuffer Capture()
+        {
+            lock (this.syncRoot)
+            {
+                if (this.framebuffer != null && this.stopwatch.IsRunning && this.stopwatch.Elapsed < this.CaptureInterval)
+                {
+                    return this.framebuffer;
+                }
+
+                this.stopwatch.Restart();
+
+                var captured = this.source.Capture();
+                if (captured == null)
+                {
+                    return this.framebuffer;
+                }
+
+                long generation = this.Generation;
+
+                if (this.framebuffer == null
+                    || this.framebuffer.Width != captured.Width
+                    || this.framebuffer.Height != captured.Height
+                    || !this.framebuffer.PixelFormat.Equals(captured.PixelFormat))
+                {
+                    this.logger?.LogInformation($"Creating a {captured.Width}x{captured.Height} snapshot of the shared framebuffer.");
+
+                    // The sessions will notice that they have received a different framebuffer, and will
+                    // create a new cache (and hence re-send the entire framebuffer) for it.
+                    var snapshot = new VncFramebuffer(captured.Name, captured.Width, captured.Height, captured.PixelFormat);
+
+                    lock (captured.SyncRoot)
+                    {
+                        Buffer.BlockCopy(captured.GetBuffer(), 0, snapshot.GetBuffer(), 0, snapshot.GetBuffer().Length);
+
+                        // The snapshot is up to date with the current frame of the source.
+                        this.damageReader.Reset();
+                        this.damageReader.Read(this.source as IVncFramebufferDamageSource);
+                    }
+
+                    this.tileColumns = (snapshot.Width + VncFramebufferCache.TileSize - 1) / VncFramebufferCache.TileSize;
+                    this.tileRows = (snapshot.Height + VncFramebufferCache.TileSize - 1) / VncFramebufferCache.TileSize;
+                    this.tileGenerations = new long[this.tileColumns * this.tileRows];
+                    this.previousTileGenerations = new long[this.tileColumns * this.tileRows];
+                    this.isTileChanged = new bool[this.tileColumns * this.tileRows];
+                    this.isTileDamaged = new bool[this.tileColumns * this.tileRows];
+                    this.detectedMoves.Clear();
+
+                    generation++;
+
+                    for (int i = 0; i < this.tileGenerations.Length; i++)
+                    {
+                        this.tileGenerations[i] = generation;
+                    }
+
+                    this.Generation = generation;
+                    this.framebuffer = snapshot;
+                }
+                else
+                {
+                    this.CompareAndCopy(captured, generation + 1);
+                }
+
+                if (this.Generation != generation)
+                {
+                    this.EncodedRectangles.Trim(this.Generation);
+                }
+
+                return this.framebuffer;
+            }
+        }
+
+        /// <inheritdoc/>
+        public ExtendedDesktopSizeStatus SetDesktopSize(int width, int height)
+        {
+            return this.source.SetDesktopSize(width, height);
+        }
+
+        /// <summary>
+        /// Creates a new <see cref="IVncFramebufferCache"/> for a session. Use this method as the
+        /// <see cref="VncServerSession.CreateFramebufferCache"/> of sessions which use this framebuffer source.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The framebuffer for which to create a cache.
+        /// </param>
+        /// <param name="logger">
+        /// The <see cref="ILogger"/> logger to use when logging diagnostic messages.
+        /// </param>
+        /// <returns>
+        /// A <see cref="VncSharedFramebufferCache"/> if <paramref name="framebuffer"/> is the shared framebuffer;
+        /// otherwise, a regular <see cref="VncFramebufferCache"/>.
+        /// </returns>
+        public IVncFramebufferCache CreateFramebufferCache(VncFramebuffer framebuffer, ILogger logger)
+        {
+            lock (this.syncRoot)
+            {
+                if (framebuffer != null && framebuffer == this.framebuffer)
+                {
+                    return new VncSharedFramebufferCache(this, framebuffer, this.tileColumns, this.tileRows, logger);
+                }
+            }
+
+            return new VncFramebufferCache(framebuffer, logger);
+        }
+
+        /// <summary>
+        /// Gets the generation of the data in a framebuffer.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The framebuffer. The caller must hold the <see cref="VncFramebuffer.SyncRoot"/> of this framebuffer.
+        /// </param>
+        /// <returns>
+        /// The generation of the data in <paramref name="framebuffer"/>, or 0 if <paramref name="framebuffer"/>
+        /// is not the current shared framebuffer.
+        /// </returns>
+        internal long GetGeneration(VncFramebuffer framebuffer)
+        {
+            return framebuffer == this.framebuffer ? this.Generation : 0;
+        }
+
+        /// <summary>
+        /// Determines which tiles of a region have changed since they were last sent to a client.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The shared framebuffer which is being sent to the client.
+        /// </param>
+        /// <param name="region">
+        /// The region which is being sent to the client.
+        /// </param>
+        /// <param name="sentGenerations">
+        /// For each tile, the generation which was last sent to the client. Tiles which are entirely
+        /// contained in <paramref name="region"/> are updated to the current generation.
+        /// </param>
+        /// <param name="isTileInvalid">
+        /// Receives, for each tile, whether the tile has changed.
+        /// </param>
+        internal void GetInvalidTiles(VncFramebuffer framebuffer, VncRectangle region, long[] sentGenerations, bool[] isTileInvalid)
+        {
+            Array.Clear(isTileInvalid, 0, isTileInvalid.Length);
+
+            lock (framebuffer.SyncRoot)
+            {
+                // The shared framebuffer has been replaced (e.g. because it was resized) after this session captured it.
+                // The session will pick up the new framebuffer the next time it captures.
+                if (framebuffer != this.framebuffer || region.IsEmpty)
+                {
+                    return;
+                }
+
+                const int tileSize = VncFramebufferCache.TileSize;
+
+                for (int row = region.Y / tileSize; row <= (region.Y + region.Height - 1) / tileSize; row++)
+                {
+                    bool isRowContained = row * tileSize >= region.Y
+                        && Math.Min((row + 1) * tileSize, framebuffer.Height) <= region.Y + region.Height;
+
+                    for (int column = region.X / tileSize; column <= (region.X + region.Width - 1) / tileSize; column++)
+                    {
+                        int index = (row * this.tileColumns) + column;
+                        isTileInvalid[index] = this.tileGenerations[index] > sentGenerations[index];
+
+                        // Tiles which are only partially contained in the region are only partially sent,
+                        // so they must be considered again on the next update request.
+                        if (isRowContained
+                            && column * tileSize >= region.X
+                            && Math.Min((column + 1) * tileSize, framebuffer.Width) <= region.X + region.Width)
+                        {
+                            sentGenerations[index] = this.tileGenerations[index];
+                        }
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gets the moves which were detected in the most recent capture and which can be sent to a client.
+        /// </summary>
+        /// <param name="framebuffer">
+        /// The shared framebuffer which is being sent to the client.
+        /// </param>
+        /// <param name="region">
+        /// The region which is being sent to the client.
+        /// </param>
+        /// <param name="sentGenerations">
+        /// For each tile, the generation which was last sent to the client. A move can only be used if the client
+        /// is up to date with the source of the move. Tiles which are entirely contained in the target of a move
+        /// are updated to the current generation.
+        /// </param>
+        /// <param name="moves">
+        /// Receives the moves which can be sent to the client.
+        /// </param>
+        internal void GetMoves(VncFramebuffer framebuffer, VncRectangle region, long[] sentGenerations, List<VncFramebufferMove> moves)
+        {
+            const int tileSize = VncFramebufferCache.TileSize;
+
+            moves.Clear();
+
+            lock (framebuffer.SyncRoot)
+            {
+                if (framebuffer != this.framebuffer || region.IsEmpty)
+                {
+                    return;
+                }
+
+                foreach (var move in this.detectedMoves)
+                {
+                    var source = move.Source;
+                    var target = move.Target;
+
+                    if (VncRectangle.Intersect(target, region) != target
+                        || !this.IsUpToDate(source, sentGenerations, this.previousTileGenerations))
+                    {
+                        continue;
+                    }
+
+                    // Moves are only recorded for the most recent capture, so once the client has processed the move,
+                    // the tiles which are entirely contained in its target are up to date.
+                    for (int row = target.Y / tileSize; row <= (target.Y + target.Height - 1) / tileSize; row++)
+                    {
+                        bool isRowContained = row * tileSize >= target.Y
+                            && Math.Min((row + 1) * tileSize, framebuffer.Height) <= target.Y + target.Height;
+
+                        for (int column = target.X / tileSize; column <= (target.X + target.Width - 1) / tileSize; column++)
+                        {
+                            if (isRowContained
+                                && column * tileSize >= target.X
+                                && Math.Min((column + 1) * tileSize, framebuffer.Width) <= target.X + target.Width)
+                            {
+                                sentGenerations[(row * this.tileColumns) + column] = this.tileGenerations[(row * this.tileColumns) + column];
+                            }
+                        }
+                    }
+
+                    moves.Add(move);
+                }
+            }
+        }
+
+        private bool IsUpToDate(VncRectangle region, long[] sentGenerations, long[] generations)
+        {
+            const int tileSize = VncFramebufferCache.TileSize;
+
+            for (int row = region.Y / tileSize; row <= (region.Y + region.Height - 1) / tileSize; row++)
+            {
+                for (int column = region.X / tileSize; column <= (region.X + region.Width - 1) / tileSize; column++)
+                {
+                    int index = (row * this.tileColumns) + column;
+
+                    if (sentGenerations[index] != generations[index])
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        private void CompareAndCopy(VncFramebuffer captured, long generation)
+        {
+            const int tileSize = VncFramebufferCache.TileSize;
+
+            var actualBuffer = captured.GetBuffer();
+            var bufferedBuffer = this.framebuffer.GetBuffer();
+            int stride = this.framebuffer.Stride;
+            int bpp = this.framebuffer.PixelFormat.BytesPerPixel;
+            bool changed = false;
+
+            lock (captured.SyncRoot)
+            {
+                lock (this.framebuffer.SyncRoot)
+                {
+                    bool[] isTileDamaged = null;
+
+                    if (this.damageReader.Read(this.source as IVncFramebufferDamageSource))
+                    {
+                        if (this.damageReader.Damage.Count == 0)
+                        {
+                            return;
+                        }
+
+                        Array.Clear(this.isTileDamaged, 0, this.isTileDamaged.Length);
+                        VncFramebufferCache.MarkTiles(this.damageReader.Damage, this.framebuffer.Width, this.framebuffer.Height, this.isTileDamaged, this.tileColumns);
+                        isTileDamaged = this.isTileDamaged;
+                    }
+
+                    // Find the tiles which have changed, and look for moves while the snapshot still contains
+                    // the previous frame. The moves are not applied to the snapshot: the tiles they cover must
+                    // still get a new generation, for the benefit of sessions which can't use the moves.
+                    for (int row = 0; row < this.tileRows; row++)
+                    {
+                        int top = row * tileSize;
+                        int bottom = Math.Min(this.framebuffer.Height, top + tileSize);
+
+                        for (int column = 0; column < this.tileColumns; column++)
+                        {
+                            if (isTileDamaged != null && !isTileDamaged[(row * this.tileColumns) + column])
+                            {
+                                continue;
+                            }
+
+                            int left = column * tileSize;
+                            int right = Math.Min(this.framebuffer.Width, left + tileSize);
+
+                            if (VncFramebufferCache.IsTileChanged(actualBuffer, bufferedBuffer, stride, bpp, left, top, right, bottom))
+                            {
+                                this.isTileChanged[(row * this.tileColumns) + column] = true;
+                                changed = true;
+                            }
+                        }
+                    }
+
+                    if (!changed)
+                    {
+                        return;
+                    }
+
+                    this.motionDetector.DetectMoves(
+                        actualBuffer,
+                        bufferedBuffer,
+                        stride,
+                        bpp,
+                        new VncRectangle(0, 0, this.framebuffer.Width, this.framebuffer.Height),
+                        this.isTileChanged,
+                        this.tileColumns,
+                        this.detectedMoves);
+
+                    Array.Copy(this.tileGenerations, this.previousTileGenerations, this.tileGenerations.Length);
+
+                    for (int row = 0; row < this.tileRows; row++)
+                    {
+                        int top = row * tileSize;
+                        int bottom = Math.Min(this.framebuffer.Height, top + tileSize);
+
+                        for (int column = 0; column < this.tileColumns; column++)
+                        {
+                            int index = (row * this.tileColumns) + column;
+
+                            if (this.isTileChanged[index])
+                            {
+                                int left = column * tileSize;
+                                int right = Math.Min(this.framebuffer.Width, left + tileSize);
+
+                                VncFramebufferCache.CompareAndCopyTile(actualBuffer, bufferedBuffer, stride, bpp, left, top, right, bottom);
+                                this.tileGenerations[index] = generation;
+                                this.isTileChanged[index] = false;
+                            }
+                        }
+                    }
+
+                    this.Generation = generation;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,361 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Threading;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Periodically runs the framebuffer updates of many sessions on the thread pool, using a single timer
+    /// instead of a thread per session.
+    /// </summary>
+    /// <remarks>
+    /// The scheduled actions are kept in a timer wheel: a ring of slots, one per tick of <see cref="Resolution"/>.
+    /// An action which is due at a given tick is stored in the slot for that tick, so each tick only inspects the
+    /// actions in a single slot. Once an action has run, it is scheduled again, one interval after it started.
+    /// An action never runs concurrently with itself, and no longer runs once its registration has been disposed.
+    /// </remarks>
+    internal sealed class VncUpdateScheduler
+    {
+        private const int SlotCount = 512;
+
+        private readonly object syncRoot = new object();
+        private readonly List<Registration>[] slots = new List<Registration>[SlotCount];
+        private readonly Stopwatch stopwatch = Stopwatch.StartNew();
+        private readonly Timer timer;
+        private long currentTick;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncUpdateScheduler"/> class.
+        /// </summary>
+        /// <param name="resolution">
+        /// The interval at which the timer ticks.
+        /// </param>
+        public VncUpdateScheduler(TimeSpan resolution)
+        {
+            if (resolution <= TimeSpan.Zero)
+            {
+                throw new ArgumentOutOfRangeException(nameof(resolution));
+            }
+
+            this.Resolution = resolution;
+
+            for (int i = 0; i < this.slots.Length; i++)
+            {
+                this.slots[i] = new List<Registration>();
+            }
+
+            this.timer = new Timer((state) => this.Tick(), null, Timeout.Infinite, Timeout.Infinite);
+        }
+
+        /// <summary>
+        /// Gets the scheduler which is shared by all sessions.
+        /// </summary>
+        public static VncUpdateScheduler Shared
+        { get; } = new VncUpdateScheduler(TimeSpan.FromMilliseconds(5));
+
+        /// <summary>
+        /// Gets the interval at which the timer ticks.
+        /// </summary>
+        public TimeSpan Resolution
+        { get; }
+
+        /// <summary>
+        /// Gets the number of actions which are scheduled.
+        /// </summary>
+        public int Count
+        { get; private set; }
+
+        /// <summary>
+        /// Schedules an action to run periodically.
+        /// </summary>
+        /// <param name="action">
+        /// The action to run.
+        /// </param>
+        /// <param name="getUpdateRate">
+        /// A function which returns the frequency, in Hz, at which to run the action.
+        /// </param>
+        /// <returns>
+        /// A <see cref="Registration"/> which can be used to stop running the action.
+        /// </returns>
+        public Registration Schedule(Action action, Func<double> getUpdateRate)
+        {
+            if (action == null)
+            {
+                throw new ArgumentNullException(nameof(action));
+            }
+
+            if (getUpdateRate == null)
+            {
+                throw new ArgumentNullException(nameof(getUpdateRate));
+            }
+
+            var registration = new Registration(this, action, getUpdateRate);
+
+            lock (this.syncRoot)
+            {
+                if (this.Count++ == 0)
+                {
+                    this.currentTick = this.GetTick();
+                    this.timer.Change(this.Resolution, this.Resolution);
+                }
+
+                this.Insert(registration, this.currentTick + 1);
+            }
+
+            return registration;
+        }
+
+        /// <summary>
+        /// Runs the actions which are due.
+        /// </summary>
+        internal void Tick()
+        {
+            List<Registration> due = null;
+
+            lock (this.syncRoot)
+            {
+                // The timer may fire late, in which case multiple slots are processed at once.
+                long tick = this.GetTick();
+
+                for (; this.currentTick < tick; this.currentTick++)
+                {
+                    var slot = this.slots[(this.currentTick + 1) % SlotCount];
+
+                    for (int i = slot.Count - 1; i >= 0; i--)
+                    {
+                        var registration = slot[i];
+
+                        if (registration.DueTick <= this.currentTick + 1)
+                        {
+                            slot.RemoveAt(i);
+                            registration.IsScheduled = false;
+                            registration.IsRunning = true;
+                            (due = due ?? new List<Registration>()).Add(registration);
+                        }
+                    }
+                }
+            }
+
+            if (due != null)
+            {
+                foreach (var registration in due)
+                {
+                    ThreadPool.QueueUserWorkItem((state) => this.Run((Registration)state), registration);
+                }
+            }
+        }
+
+        private long GetTick()
+        {
+            return this.stopwatch.Elapsed.Ticks / this.Resolution.Ticks;
+        }
+
+        private void Insert(Registration registration, long dueTick)
+        {
+            registration.DueTick = dueTick;
+            registration.IsScheduled = true;
+            this.slots[dueTick % SlotCount].Add(registration);
+        }
+
+        private void Remove(Registration registration)
+        {
+            if (registration.IsScheduled)
+            {
+                this.slots[registration.DueTick % SlotCount].Remove(registration);
+                registration.IsScheduled = false;
+            }
+        }
+
+        private void Run(Registration registration)
+        {
+            long startTick = this.GetTick();
+            bool failed = false;
+            registration.RunningThread = Thread.CurrentThread;
+
+            try
+            {
+                registration.Action();
+            }
+            catch (Exception)
+            {
+                // Like a thread which crashes, a failing action is not run again.
+                failed = true;
+            }
+
+            lock (this.syncRoot)
+            {
+                registration.IsRunning = false;
+                registration.RunningThread = null;
+
+                // Wake up any thread which is waiting for the action to complete before disposing of it.
+                Monitor.PulseAll(this.syncRoot);
+
+                if (failed)
+                {
+                    registration.Dispose();
+                    return;
+                }
+
+                if (!registration.IsDisposed)
+                {
+                    double seconds = 1.0 / registration.GetUpdateRate();
+                    registration.StartTick = startTick;
+                    registration.IntervalTicks = Math.Max(1, (long)Math.Round(seconds * TimeSpan.TicksPerSecond / this.Resolution.Ticks));
+
+                    this.Insert(registration, Math.Max(this.currentTick + 1, startTick + registration.IntervalTicks));
+                }
+            }
+        }
+
+        /// <summary>
+        /// Represents an action which has been scheduled by a <see cref="VncUpdateScheduler"/>.
+        /// </summary>
+        internal sealed class Registration : IDisposable
+        {
+            private readonly VncUpdateScheduler scheduler;
+
+            /// <summary>
+            /// Initializes a new instance of the <see cref="Registration"/> class.
+            /// </summary>
+            /// <param name="scheduler">
+            /// The scheduler which runs the action.
+            /// </param>
+            /// <param name="action">
+            /// The action to run.
+            /// </param>
+            /// <param name="getUpdateRate">
+            /// A function which returns the frequency, in Hz, at which to run the action.
+            /// </param>
+            public Registration(VncUpdateScheduler scheduler, Action action, Func<double> getUpdateRate)
+            {
+                this.scheduler = scheduler;
+                this.Action = action;
+                this.GetUpdateRate = getUpdateRate;
+            }
+
+            /// <summary>
+            /// Gets the action to run.
+            /// </summary>
+            public Action Action { get; }
+
+            /// <summary>
+            /// Gets a function which returns the frequency, in Hz, at which to run the action.
+            /// </summary>
+            public Func<double> GetUpdateRate { get; }
+
+            /// <summary>
+            /// Gets or sets the tick at which the action should run next.
+            /// </summary>
+            public long DueTick { get; set; }
+
+            /// <summary>
+            /// Gets or sets the tick at which the action last started running.
+            /// </summary>
+            public long StartTick { get; set; }
+
+            /// <summary>
+            /// Gets or sets the number of ticks between two runs of the action.
+            /// </summary>
+            public long IntervalTicks { get; set; }
+
+            /// <summary>
+            /// Gets or sets a value indicating whether the action is stored in the timer wheel.
+            /// </summary>
+            public bool IsScheduled { get; set; }
+
+            /// <summary>
+            /// Gets or sets a value indicating whether the action is running.
+            /// </summary>
+            public bool IsRunning { get; set; }
+
+            /// <summary>
+            /// Gets or sets the thread which is running the action, if any.
+            /// </summary>
+            public Thread RunningThread { get; set; }
+
+            /// <summary>
+            /// Gets a value indicating whether the action has been unscheduled.
+            /// </summary>
+            public bool IsDisposed { get; private set; }
+
+            /// <summary>
+            /// Runs the action as soon as possible, without exceeding the update rate.
+            /// </summary>
+            public void Signal()
+            {
+                lock (this.scheduler.syncRoot)
+                {
+                    if (!this.IsScheduled)
+                    {
+                        return;
+                    }
+
+                    long dueTick = Math.Max(this.scheduler.currentTick + 1, this.StartTick + this.IntervalTicks);
+
+                    if (dueTick < this.DueTick)
+                    {
+                        this.scheduler.Remove(this);
+                        this.scheduler.Insert(this, dueTick);
+                    }
+                }
+            }
+
+            /// <summary>
+            /// Stops running the action. If the action is running, waits until it has completed, unless this method
+            /// is called by the action itself.
+            /// </summary>
+            public void Dispose()
+            {
+                lock (this.scheduler.syncRoot)
+                {
+                    if (this.IsDisposed)
+                    {
+                        return;
+                    }
+
+                    this.IsDisposed = true;
+                    this.scheduler.Remove(this);
+
+                    if (--this.scheduler.Count == 0)
+                    {
+                        this.scheduler.timer.Change(Timeout.Infinite, Timeout.Infinite);
+                    }
+
+                    while (this.IsRunning && this.RunningThread != Thread.CurrentThread)
+                    {
+                        Monitor.Wait(this.scheduler.syncRoot);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -26,8 +26,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #endregion
 
+using RemoteViewing.Utility;
 using SharpCompress.Compressors;
 using SharpCompress.Compressors.Deflate;
+using System;
 using System.IO;
 
 namespace RemoteViewing.Vnc.Server
@@ -56,9 +58,15 @@ namespace RemoteViewing.Vnc.Server
 
         /// <inheritdoc/>
         public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, byte[] contents)
+        {
+            return this.Send(stream, pixelFormat, region, new ReadOnlySpan<byte>(contents));
+        }
+
+        /// <inheritdoc/>
+        public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
         {
             this.buffer.SetLength(0);
-            this.deflater.Write(contents, 0, contents.Length);
+            this.deflater.Write(contents);
             this.deflater.Flush();
             this.buffer.Position = 0;
 
@@ -0,0 +1,91 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using SharpCompress.Compressors;
+using SharpCompress.Compressors.Deflate;
+using System;
+using System.IO;
+
+namespace RemoteViewing.Vnc.Server
+{
+    /// <summary>
+    /// Implements the ZRLE (Zlib Run-Length Encoding) protocol.
+    /// </summary>
+    /// <remarks>
+    /// ZRLE uses the same subencodings as TRLE, using 64x64 tiles. The tiles are compressed using a single
+    /// zlib stream, which is kept alive for the duration of the session.
+    /// </remarks>
+    /// <seealso href="https://github.com/rfbproto/rfbproto/blob/master/rfbproto.rst#zrle-encoding"/>
+    internal class ZrleEncoder : TrleEncoder
+    {
+        private readonly MemoryStream buffer;
+        private readonly ZlibStream deflater;
+        private readonly byte[] length = new byte[4];
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="ZrleEncoder"/> class.
+        /// </summary>
+        public ZrleEncoder()
+            : base(64)
+        {
+            this.buffer = new MemoryStream();
+            this.deflater = new ZlibStream(this.buffer, CompressionMode.Compress);
+        }
+
+        /// <inheritdoc/>
+        public override VncEncoding Encoding => VncEncoding.Zrle;
+
+        /// <inheritdoc/>
+        public override int Send(Stream stream, VncPixelFormat pixelFormat, VncRectangle region, ReadOnlySpan<byte> contents)
+        {
+            this.buffer.SetLength(0);
+            this.SendTiles(this.deflater, pixelFormat, region, contents);
+
+            VncUtility.EncodeUInt32BE(this.length, 0, (uint)this.buffer.Length);
+            stream.Write(this.length, 0, 4);
+            stream.Write(this.buffer.GetBuffer(), 0, (int)this.buffer.Length);
+
+            return (int)this.buffer.Length + 4;
+        }
+
+        /// <inheritdoc/>
+        public override int? GetSharedEncodingKey(VncPixelFormat pixelFormat, VncRectangle region)
+        {
+            // The encoded data depends on the state of the zlib stream.
+            return null;
+        }
+
+        /// <inheritdoc/>
+        protected override void WriteTile(Stream stream, byte[] buffer, int count, bool isLastTile)
+        {
+            // Only flush the zlib stream after the last tile, so that the client can decode the entire rectangle.
+            this.deflater.FlushMode = isLastTile ? FlushType.Sync : FlushType.None;
+            stream.Write(buffer, 0, count);
+        }
+    }
+}
@@ -0,0 +1,406 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc.Server;
+using System;
+using TurboJpegWrapper;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Decodes rectangles which have been encoded using the Tight encoding.
+    /// </summary>
+    /// <remarks>
+    /// Tight uses four zlib streams, which are kept alive for the duration of the session (unless the server
+    /// asks to reset them), and supports fill, JPEG and basic compression. Basic compression can use the copy,
+    /// palette or gradient filter.
+    /// </remarks>
+    /// <seealso href="https://github.com/rfbproto/rfbproto/blob/master/rfbproto.rst#tight-encoding"/>
+    internal sealed class TightDecoder : IDisposable
+    {
+        /// <summary>
+        /// Data which is smaller than this is sent as-is, rather than being compressed using zlib.
+        /// </summary>
+        internal const int MinimumCompressedSize = 12;
+
+        private readonly VncInflater[] inflaters = new VncInflater[] { new VncInflater(), new VncInflater(), new VncInflater(), new VncInflater() };
+        private readonly byte[] palette = new byte[256 * 4];
+        private readonly byte[] colors = new byte[256 * 4];
+        private byte[] pixels = new byte[0];
+        private byte[] data = new byte[0];
+        private byte[] rgb = new byte[0];
+        private TJDecompressor decompressor;
+
+        /// <summary>
+        /// Resets the zlib streams. Call this method when starting a new session.
+        /// </summary>
+        public void Reset()
+        {
+            foreach (var inflater in this.inflaters)
+            {
+                inflater.Reset();
+            }
+        }
+
+        /// <summary>
+        /// Receives and decodes a rectangle.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="VncStream"/> from which to read the rectangle.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format of the framebuffer.
+        /// </param>
+        /// <param name="width">
+        /// The width of the rectangle.
+        /// </param>
+        /// <param name="height">
+        /// The height of the rectangle.
+        /// </param>
+        /// <returns>
+        /// A buffer which holds the pixels of the rectangle, in the framebuffer pixel format. The buffer is reused
+        /// by the next call to this method.
+        /// </returns>
+        public byte[] Decode(VncStream stream, VncPixelFormat pixelFormat, int width, int height)
+        {
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            int tightPixelSize = TightEncoder.IsTightPixelFormat(pixelFormat) ? 3 : bytesPerPixel;
+            var pixels = VncUtility.AllocateScratch(VncUtility.GetRectangleSize(width, height, bytesPerPixel), ref this.pixels);
+            int count = width * height;
+
+            var control = stream.ReceiveByte();
+
+            for (int i = 0; i < this.inflaters.Length; i++)
+            {
+                if ((control & (1 << i)) != 0)
+                {
+                    this.inflaters[i].Reset();
+                }
+            }
+
+            switch ((TightCompressionControl)(control & 0xF0))
+            {
+                case TightCompressionControl.FillCompression:
+                    stream.Receive(this.palette, 0, tightPixelSize);
+                    ToPixels(pixelFormat, tightPixelSize, this.palette, this.colors, 1);
+
+                    for (int i = 0; i < count * bytesPerPixel; i += bytesPerPixel)
+                    {
+                        Buffer.BlockCopy(this.colors, 0, pixels, i, bytesPerPixel);
+                    }
+
+                    break;
+
+                case TightCompressionControl.JpegCompression:
+                    this.DecodeJpeg(stream, pixelFormat, width, height, pixels);
+                    break;
+
+                default:
+                    VncStream.Require(
+                        (control & (byte)TightCompressionControl.FillCompression) == 0,
+                        "Unsupported Tight compression.",
+                        VncFailureReason.UnrecognizedProtocolElement);
+
+                    var inflater = this.inflaters[(control >> 4) & 3];
+                    var filter = (control & (byte)TightCompressionControl.ReadFilterId) != 0 ? (TightFilter)stream.ReceiveByte() : TightFilter.Copy;
+                    byte[] data;
+
+                    switch (filter)
+                    {
+                        case TightFilter.Copy:
+                            data = this.ReceiveData(stream, inflater, count * tightPixelSize);
+                            ToPixels(pixelFormat, tightPixelSize, data, pixels, count);
+                            break;
+
+                        case TightFilter.Palette:
+                            int paletteSize = stream.ReceiveByte() + 1;
+                            stream.Receive(this.palette, 0, paletteSize * tightPixelSize);
+                            ToPixels(pixelFormat, tightPixelSize, this.palette, this.colors, paletteSize);
+
+                            if (paletteSize == 2)
+                            {
+                                // 1 bit per pixel, and each row is padded to a whole number of bytes.
+                                int rowSize = (width + 7) / 8;
+                                data = this.ReceiveData(stream, inflater, rowSize * height);
+
+                                for (int y = 0; y < height; y++)
+                                {
+                                    for (int x = 0; x < width; x++)
+                                    {
+                                        int index = (data[(y * rowSize) + (x / 8)] >> (7 - (x % 8))) & 1;
+                                        Buffer.BlockCopy(this.colors, index * bytesPerPixel, pixels, ((y * width) + x) * bytesPerPixel, bytesPerPixel);
+                                    }
+                                }
+                            }
+                            else
+                            {
+                                data = this.ReceiveData(stream, inflater, count);
+
+                                for (int i = 0; i < count; i++)
+                                {
+                                    VncStream.Require(
+                                        data[i] < paletteSize,
+                                        "Invalid palette index.",
+                                        VncFailureReason.UnrecognizedProtocolElement);
+
+                                    Buffer.BlockCopy(this.colors, data[i] * bytesPerPixel, pixels, i * bytesPerPixel, bytesPerPixel);
+                                }
+                            }
+
+                            break;
+
+                        case TightFilter.Gradient:
+                            data = this.ReceiveData(stream, inflater, count * tightPixelSize);
+
+                            if (tightPixelSize == 3)
+                            {
+                                DecodeGradient(data, width, height);
+                                ToPixels(pixelFormat, tightPixelSize, data, pixels, count);
+                            }
+                            else
+                            {
+                                DecodeGradient(pixelFormat, data, pixels, width, height);
+                            }
+
+                            break;
+
+                        default:
+                            VncStream.Require(
+                                false,
+                                "Unsupported Tight filter.",
+                                VncFailureReason.UnrecognizedProtocolElement);
+                            break;
+                    }
+
+                    break;
+            }
+
+            return pixels;
+        }
+
+        /// <inheritdoc/>
+        public void Dispose()
+        {
+            foreach (var inflater in this.inflaters)
+            {
+                inflater.Dispose();
+            }
+
+            this.decompressor?.Dispose();
+            this.decompressor = null;
+        }
+
+        /// <summary>
+        /// Receives a length in the compact representation used by the Tight encoding: 1 to 3 bytes, of which
+        /// the lower 7 bits hold the value, and the highest bit indicates whether another byte follows.
+        /// </summary>
+        /// <param name="stream">
+        /// The stream from which to read the length.
+        /// </param>
+        /// <returns>
+        /// The length.
+        /// </returns>
+        internal static int ReceiveCompactLength(VncStream stream)
+        {
+            int b = stream.ReceiveByte();
+            int length = b & 0x7F;
+
+            if ((b & 0x80) != 0)
+            {
+                b = stream.ReceiveByte();
+                length |= (b & 0x7F) << 7;
+
+                if ((b & 0x80) != 0)
+                {
+                    b = stream.ReceiveByte();
+                    length |= b << 14;
+                }
+            }
+
+            return length;
+        }
+
+        private static void ToPixels(VncPixelFormat pixelFormat, int tightPixelSize, byte[] source, byte[] target, int count)
+        {
+            if (tightPixelSize != 3)
+            {
+                Buffer.BlockCopy(source, 0, target, 0, count * tightPixelSize);
+                return;
+            }
+
+            TightEncoder.GetTightPixelOffsets(pixelFormat, out int redOffset, out int greenOffset, out int blueOffset);
+            int unusedOffset = 6 - redOffset - greenOffset - blueOffset;
+
+            for (int i = 0; i < count; i++)
+            {
+                target[(4 * i) + redOffset] = source[3 * i];
+                target[(4 * i) + greenOffset] = source[(3 * i) + 1];
+                target[(4 * i) + blueOffset] = source[(3 * i) + 2];
+                target[(4 * i) + unusedOffset] = 0;
+            }
+        }
+
+        private static void DecodeGradient(byte[] data, int width, int height)
+        {
+            // Each color component is the difference with its predicted value, V[x-1,y] + V[x,y-1] - V[x-1,y-1]
+            // (where values outside the rectangle are 0), clamped to [0, 255]. Work forwards, so that the values used
+            // for the prediction have already been decoded.
+            int stride = 3 * width;
+
+            for (int i = 0; i < stride * height; i++)
+            {
+                bool hasLeft = i % stride >= 3;
+                int left = hasLeft ? data[i - 3] : 0;
+                int above = i >= stride ? data[i - stride] : 0;
+                int aboveLeft = hasLeft && i >= stride ? data[i - stride - 3] : 0;
+
+                int predicted = left + above - aboveLeft;
+                predicted = predicted < 0 ? 0 : predicted > 255 ? 255 : predicted;
+
+                data[i] = (byte)(data[i] + predicted);
+            }
+        }
+
+        private static void DecodeGradient(VncPixelFormat pixelFormat, byte[] data, byte[] pixels, int width, int height)
+        {
+            // The same as above, but for each of the color components of a PIXEL.
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            int stride = width * bytesPerPixel;
+
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    int offset = (y * stride) + (x * bytesPerPixel);
+                    uint left = x > 0 ? ReadPixel(pixelFormat, pixels, offset - bytesPerPixel) : 0;
+                    uint above = y > 0 ? ReadPixel(pixelFormat, pixels, offset - stride) : 0;
+                    uint aboveLeft = x > 0 && y > 0 ? ReadPixel(pixelFormat, pixels, offset - stride - bytesPerPixel) : 0;
+                    uint difference = ReadPixel(pixelFormat, data, offset);
+
+                    uint pixel = DecodeGradientComponent(left, above, aboveLeft, difference, pixelFormat.RedShift, pixelFormat.RedMax)
+                        | DecodeGradientComponent(left, above, aboveLeft, difference, pixelFormat.GreenShift, pixelFormat.GreenMax)
+                        | DecodeGradientComponent(left, above, aboveLeft, difference, pixelFormat.BlueShift, pixelFormat.BlueMax);
+
+                    WritePixel(pixelFormat, pixels, offset, pixel);
+                }
+            }
+        }
+
+        private static uint DecodeGradientComponent(uint left, uint above, uint aboveLeft, uint difference, int shift, int max)
+        {
+            int predicted = (int)((left >> shift) & max) + (int)((above >> shift) & max) - (int)((aboveLeft >> shift) & max);
+            predicted = predicted < 0 ? 0 : predicted > max ? max : predicted;
+
+            return (uint)((predicted + (difference >> shift)) & max) << shift;
+        }
+
+        private static uint ReadPixel(VncPixelFormat pixelFormat, byte[] buffer, int offset)
+        {
+            uint pixel = 0;
+
+            for (int i = 0; i < pixelFormat.BytesPerPixel; i++)
+            {
+                int shift = pixelFormat.IsLittleEndian ? 8 * i : 8 * (pixelFormat.BytesPerPixel - 1 - i);
+                pixel |= (uint)buffer[offset + i] << shift;
+            }
+
+            return pixel;
+        }
+
+        private static void WritePixel(VncPixelFormat pixelFormat, byte[] buffer, int offset, uint pixel)
+        {
+            for (int i = 0; i < pixelFormat.BytesPerPixel; i++)
+            {
+                int shift = pixelFormat.IsLittleEndian ? 8 * i : 8 * (pixelFormat.BytesPerPixel - 1 - i);
+                buffer[offset + i] = (byte)(pixel >> shift);
+            }
+        }
+
+        private byte[] ReceiveData(VncStream stream, VncInflater inflater, int size)
+        {
+            var data = VncUtility.AllocateScratch(size, ref this.data);
+
+            if (size < MinimumCompressedSize)
+            {
+                stream.Receive(data, 0, size);
+            }
+            else
+            {
+                int length = ReceiveCompactLength(stream);
+                inflater.Receive(stream, length);
+                inflater.Read(data, 0, size);
+            }
+
+            return data;
+        }
+
+        private unsafe void DecodeJpeg(VncStream stream, VncPixelFormat pixelFormat, int width, int height, byte[] pixels)
+        {
+            int length = ReceiveCompactLength(stream);
+            var jpeg = VncUtility.AllocateScratch(length, ref this.data);
+            stream.Receive(jpeg, 0, length);
+
+            // The JPEG image is decompressed as BGRX, which is the same as RGB32. Other pixel formats
+            // are converted after decompressing.
+            bool isRgb32 = VncPixelFormat.RGB32.Equals(pixelFormat);
+            var rgb = isRgb32 ? pixels : VncUtility.AllocateScratch(width * height * 4, ref this.rgb);
+
+            if (this.decompressor == null)
+            {
+                this.decompressor = new TJDecompressor();
+            }
+
+            int decompressedWidth, decompressedHeight;
+
+            fixed (byte* jpegData = jpeg)
+            fixed (byte* rgbData = rgb)
+            {
+                this.decompressor.Decompress(
+                    (IntPtr)jpegData,
+                    (ulong)length,
+                    (IntPtr)rgbData,
+                    width * height * 4,
+                    TJPixelFormat.BGRX,
+                    TJFlags.None,
+                    out decompressedWidth,
+                    out decompressedHeight,
+                    out int stride);
+            }
+
+            VncStream.Require(
+                decompressedWidth == width && decompressedHeight == height,
+                "The size of the JPEG image does not match the size of the rectangle.",
+                VncFailureReason.UnrecognizedProtocolElement);
+
+            if (!isRgb32)
+            {
+                VncPixelFormat.Copy(rgb, width, width * 4, VncPixelFormat.RGB32, new VncRectangle(0, 0, width, height), pixels, width, width * pixelFormat.BytesPerPixel, pixelFormat);
+            }
+        }
+    }
+}
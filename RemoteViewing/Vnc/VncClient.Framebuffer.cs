@@ -28,8 +28,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using System;
 using System.Collections.Generic;
-using System.IO;
-using System.IO.Compression;
 
 namespace RemoteViewing.Vnc
 {
@@ -38,15 +36,25 @@ namespace RemoteViewing.Vnc
     /// </summary>
     public partial class VncClient
     {
+        private readonly VncInflater zlibInflater = new VncInflater();
+        private readonly ZrleDecoder zrleDecoder = new ZrleDecoder();
+        private readonly TightDecoder tightDecoder = new TightDecoder();
+        private readonly HextileDecoder hextileDecoder = new HextileDecoder();
         private byte[] framebufferScratch = new byte[0];
-        private byte[] zlibScratch = new byte[0];
-        private Stream zlibMemoryStream;
-        private DeflateStream zlibInflater;
 
         private void InitFramebufferDecoder()
         {
-            this.zlibMemoryStream = new MemoryStream();
-            this.zlibInflater = null; // Don't reuse the dictionary between sessions.
+            // Don't reuse the dictionaries between sessions.
+            this.zlibInflater.Reset();
+            this.zrleDecoder.Reset();
+            this.tightDecoder.Reset();
+        }
+
+        private void DisposeFramebufferDecoder()
+        {
+            this.zlibInflater.Dispose();
+            this.zrleDecoder.Dispose();
+            this.tightDecoder.Dispose();
         }
 
         private byte[] AllocateFramebufferScratch(int bytes)
@@ -69,6 +77,7 @@ namespace RemoteViewing.Vnc
                 VncStream.SanityCheck(h > 0 && h < 0x8000);
 
                 int fbW = this.Framebuffer.Width, fbH = this.Framebuffer.Height, bpp = this.Framebuffer.PixelFormat.BytesPerPixel;
+                int rectangleSize = VncUtility.GetRectangleSize(w, h, bpp);
                 var inRange = w <= fbW && h <= fbH && x <= fbW - w && y <= fbH - h;
                 byte[] pixels;
 
@@ -76,89 +85,13 @@ namespace RemoteViewing.Vnc
                 switch (encoding)
                 {
                     case VncEncoding.Hextile: // KVM seems to avoid this now that I support Zlib.
-                        var background = new byte[bpp];
-                        var foreground = new byte[bpp];
+                        pixels = this.hextileDecoder.Decode(this.c, this.Framebuffer.PixelFormat, w, h);
 
-                        for (int ty = 0; ty < h; ty += 16)
+                        if (inRange)
                         {
-                            int th = Math.Min(16, h - ty);
-                            for (int tx = 0; tx < w; tx += 16)
+                            lock (this.Framebuffer.SyncRoot)
                             {
-                                int tw = Math.Min(16, w - tx);
-
-                                var subencoding = this.c.ReceiveByte();
-                                pixels = this.AllocateFramebufferScratch(tw * th * bpp);
-
-                                if ((subencoding & 1) != 0)
-                                {
-                                    // raw
-                                    this.c.Receive(pixels, 0, tw * th * bpp);
-
-                                    if (inRange)
-                                    {
-                                        lock (this.Framebuffer.SyncRoot)
-                                        {
-                                            this.CopyToFramebuffer(x + tx, y + ty, tw, th, pixels);
-                                        }
-                                    }
-                                }
-                                else
-                                {
-                                    pixels = this.AllocateFramebufferScratch(tw * th * bpp);
-                                    if ((subencoding & 2) != 0)
-                                    {
-                                        background = this.c.Receive(bpp);
-                                    }
-
-                                    if ((subencoding & 4) != 0)
-                                    {
-                                        foreground = this.c.Receive(bpp);
-                                    }
-
-                                    int ptr = 0;
-                                    for (int pp = 0; pp < tw * th; pp++)
-                                    {
-                                        for (int pe = 0; pe < bpp; pe++)
-                                        {
-                                            pixels[ptr++] = background[pe];
-                                        }
-                                    }
-
-                                    int nsubrects = (subencoding & 8) != 0 ? this.c.ReceiveByte() : 0;
-                                    if (nsubrects > 0)
-                                    {
-                                        var subrectsColored = (subencoding & 16) != 0;
-                                        for (int subrect = 0; subrect < nsubrects; subrect++)
-                                        {
-                                            var color = subrectsColored ? this.c.Receive(bpp) : foreground;
-                                            var srxy = this.c.ReceiveByte();
-                                            var srwh = this.c.ReceiveByte();
-                                            int srx = (srxy >> 4) & 0xf, srw = ((srwh >> 4) & 0xf) + 1;
-                                            int sry = (srxy >> 0) & 0xf, srh = ((srwh >> 0) & 0xf) + 1;
-                                            if (srx + srw > tw || sry + srh > th)
-                                            {
-                                                continue;
-                                            }
-
-                                            for (int py = 0; py < srh; py++)
-                                            {
-                                                for (int px = 0; px < srw; px++)
-                                                {
-                                                    int off = bpp * (((py + sry) * tw) + (px + srx));
-                                                    for (int pe = 0; pe < bpp; pe++)
-                                                    {
-                                                        pixels[off + pe] = color[pe];
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    }
-
-                                    lock (this.Framebuffer.SyncRoot)
-                                    {
-                                        this.CopyToFramebuffer(x + tx, y + ty, tw, th, pixels);
-                                    }
-                                }
+                                this.CopyToFramebuffer(x, y, w, h, pixels);
                             }
                         }
 
@@ -192,8 +125,8 @@ namespace RemoteViewing.Vnc
                         break;
 
                     case VncEncoding.Raw:
-                        pixels = this.AllocateFramebufferScratch(w * h * bpp);
-                        this.c.Receive(pixels, 0, w * h * bpp);
+                        pixels = this.AllocateFramebufferScratch(rectangleSize);
+                        this.c.Receive(pixels, 0, rectangleSize);
 
                         if (inRange)
                         {
@@ -206,49 +139,38 @@ namespace RemoteViewing.Vnc
                         break;
 
                     case VncEncoding.Zlib:
-                        int bytesDesired = w * h * bpp;
-
                         int size = (int)this.c.ReceiveUInt32BE(); VncStream.SanityCheck(size >= 0 && size < 0x10000000);
-                        VncUtility.AllocateScratch(size, ref this.zlibScratch);
-                        this.c.Receive(this.zlibScratch, 0, size);
+                        this.zlibInflater.Receive(this.c, size);
 
-                        this.zlibMemoryStream.Position = 0;
-                        this.zlibMemoryStream.Write(this.zlibScratch, 0, size);
-                        this.zlibMemoryStream.SetLength(size);
-                        this.zlibMemoryStream.Position = 0;
+                        pixels = this.AllocateFramebufferScratch(rectangleSize);
+                        this.zlibInflater.Read(pixels, 0, rectangleSize);
 
-                        if (this.zlibInflater == null)
+                        if (inRange)
                         {
-                            // Zlib has a two-byte header.
-                            VncStream.SanityCheck(size >= 2);
-                            this.zlibMemoryStream.Position = 2;
-                            this.zlibInflater = new DeflateStream(this.zlibMemoryStream, CompressionMode.Decompress, false);
+                            lock (this.Framebuffer.SyncRoot)
+                            {
+                                this.CopyToFramebuffer(x, y, w, h, pixels);
+                            }
                         }
 
-                        pixels = this.AllocateFramebufferScratch(bytesDesired);
-                        for (int j = 0; j < bytesDesired;)
-                        {
-                            int count = 0;
+                        break;
 
-                            try
-                            {
-                                count = this.zlibInflater.Read(pixels, j, bytesDesired - j);
-                            }
-                            catch (InvalidDataException)
+                    case VncEncoding.Zrle:
+                        pixels = this.zrleDecoder.Decode(this.c, this.Framebuffer.PixelFormat, w, h);
+
+                        if (inRange)
+                        {
+                            lock (this.Framebuffer.SyncRoot)
                             {
-                                VncStream.Require(
-                                    false,
-                                    "Bad data compressed.",
-                                    VncFailureReason.UnrecognizedProtocolElement);
+                                this.CopyToFramebuffer(x, y, w, h, pixels);
                             }
-
-                            VncStream.Require(
-                                count > 0,
-                                "No data compressed.",
-                                VncFailureReason.UnrecognizedProtocolElement);
-                            j += count;
                         }
 
+                        break;
+
+                    case VncEncoding.Tight:
+                        pixels = this.tightDecoder.Decode(this.c, this.Framebuffer.PixelFormat, w, h);
+
                         if (inRange)
                         {
                             lock (this.Framebuffer.SyncRoot)
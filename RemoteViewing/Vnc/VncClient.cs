@@ -404,6 +404,7 @@ namespace RemoteViewing.Vnc
         public void Dispose()
         {
             this.Close();
+            this.DisposeFramebufferDecoder();
         }
 
         /// <summary>
@@ -648,17 +649,17 @@ namespace RemoteViewing.Vnc
 
         private void NegotiateEncodings()
         {
-            var encodings = new VncEncoding[]
+            var encodings = new List<VncEncoding>(this.options.Encodings ?? VncClientConnectOptions.DefaultEncodings);
+            encodings.Add(VncEncoding.PseudoDesktopSize);
+
+            // Servers only use JPEG compression when the client asks for a quality level.
+            if (this.options.JpegQualityLevel != null)
             {
-                VncEncoding.Zlib,
-                VncEncoding.Hextile,
-                VncEncoding.CopyRect,
-                VncEncoding.Raw,
-                VncEncoding.PseudoDesktopSize,
-            };
+                encodings.Add(VncEncoding.TightQualityLevel0 + this.options.JpegQualityLevel.Value);
+            }
 
             this.c.Send(new[] { (byte)2, (byte)0 });
-            this.c.SendUInt16BE((ushort)encodings.Length);
+            this.c.SendUInt16BE((ushort)encodings.Count);
             foreach (var encoding in encodings)
             {
                 this.c.SendUInt32BE((uint)encoding);
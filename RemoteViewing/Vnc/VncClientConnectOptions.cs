@@ -26,6 +26,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #endregion
 
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
 namespace RemoteViewing.Vnc
 {
     /// <summary>
@@ -40,6 +44,23 @@ namespace RemoteViewing.Vnc
     /// </summary>
     public sealed class VncClientConnectOptions
     {
+        /// <summary>
+        /// The encodings which <see cref="VncClient"/> can decode, in the order in which they are offered
+        /// to the server by default.
+        /// </summary>
+        internal static readonly VncEncoding[] DefaultEncodings = new VncEncoding[]
+        {
+            VncEncoding.Tight,
+            VncEncoding.Zrle,
+            VncEncoding.Zlib,
+            VncEncoding.Hextile,
+            VncEncoding.CopyRect,
+            VncEncoding.Raw,
+        };
+
+        private int? jpegQualityLevel;
+        private IReadOnlyList<VncEncoding> encodings;
+
         /// <summary>
         /// Initializes a new instance of the <see cref="VncClientConnectOptions"/> class.
         /// </summary>
@@ -67,6 +88,58 @@ namespace RemoteViewing.Vnc
             set;
         }
 
+        /// <summary>
+        /// Gets or sets the JPEG quality level to request from the server, from 0 (lowest) to 9 (highest).
+        /// </summary>
+        /// <remarks>
+        /// When this is <see langword="null"/>, which is the default, the server is not asked to use JPEG
+        /// compression, and all rectangles are encoded losslessly.
+        /// </remarks>
+        public int? JpegQualityLevel
+        {
+            get
+            {
+                return this.jpegQualityLevel;
+            }
+
+            set
+            {
+                if (value < 0 || value > 9)
+                {
+                    throw new ArgumentOutOfRangeException(nameof(value));
+                }
+
+                this.jpegQualityLevel = value;
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the encodings to offer to the server, in order of preference.
+        /// </summary>
+        /// <remarks>
+        /// When this is <see langword="null"/>, which is the default, all encodings which the client can decode
+        /// are offered. Servers are not required to honour the order, and may always fall back to
+        /// <see cref="VncEncoding.Raw"/>. The encodings are copied when this property is set, so later changes to
+        /// the collection have no effect.
+        /// </remarks>
+        public IReadOnlyList<VncEncoding> Encodings
+        {
+            get
+            {
+                return this.encodings;
+            }
+
+            set
+            {
+                if (value != null && value.Any(e => !DefaultEncodings.Contains(e)))
+                {
+                    throw new ArgumentOutOfRangeException(nameof(value), "The client cannot decode one or more of the encodings.");
+                }
+
+                this.encodings = value != null ? Array.AsReadOnly(value.ToArray()) : null;
+            }
+        }
+
         /// <summary>
         /// Gets or sets a value indicating whether a polling thread should be started and frame buffer updates
         /// are published via events or the frame buffer updates are triggered manually (on demand) by calling the respective functions.
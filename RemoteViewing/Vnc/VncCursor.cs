@@ -0,0 +1,302 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Represents the shape of a cursor, which can be sent to a VNC client so the client can draw the cursor itself.
+    /// </summary>
+    /// <remarks>
+    /// The pixels are stored row by row, using 32 bits per pixel, in the <see cref="VncPixelFormat.RGB32"/> format.
+    /// The fourth byte of each pixel holds the alpha value, which is not premultiplied. This is the same layout as
+    /// a 32-bit ARGB bitmap on little-endian systems. Clients which don't support transparency show the pixels
+    /// which are at least half opaque.
+    /// </remarks>
+    public sealed class VncCursor
+    {
+        private readonly byte[] pixels;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncCursor"/> class.
+        /// </summary>
+        /// <param name="width">
+        /// The width of the cursor.
+        /// </param>
+        /// <param name="height">
+        /// The height of the cursor.
+        /// </param>
+        /// <param name="hotspotX">
+        /// The X coordinate of the pixel of the cursor which is at the position of the pointer.
+        /// </param>
+        /// <param name="hotspotY">
+        /// The Y coordinate of the pixel of the cursor which is at the position of the pointer.
+        /// </param>
+        /// <param name="pixels">
+        /// The pixels of the cursor. The data is copied.
+        /// </param>
+        public VncCursor(int width, int height, int hotspotX, int hotspotY, byte[] pixels)
+        {
+            if (width < 0 || width > ushort.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(width));
+            }
+
+            if (height < 0 || height > ushort.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(height));
+            }
+
+            if (hotspotX < 0 || (hotspotX >= width && width > 0))
+            {
+                throw new ArgumentOutOfRangeException(nameof(hotspotX));
+            }
+
+            if (hotspotY < 0 || (hotspotY >= height && height > 0))
+            {
+                throw new ArgumentOutOfRangeException(nameof(hotspotY));
+            }
+
+            if (pixels == null)
+            {
+                throw new ArgumentNullException(nameof(pixels));
+            }
+
+            if (pixels.Length < width * height * 4)
+            {
+                throw new ArgumentException("The pixel buffer is too small.", nameof(pixels));
+            }
+
+            this.Width = width;
+            this.Height = height;
+            this.HotspotX = hotspotX;
+            this.HotspotY = hotspotY;
+            this.pixels = new byte[width * height * 4];
+            Buffer.BlockCopy(pixels, 0, this.pixels, 0, this.pixels.Length);
+        }
+
+        /// <summary>
+        /// Gets a cursor which is not visible.
+        /// </summary>
+        public static VncCursor Hidden
+        { get; } = new VncCursor(0, 0, 0, 0, new byte[0]);
+
+        /// <summary>
+        /// Gets the width of the cursor.
+        /// </summary>
+        public int Width
+        {
+            get;
+        }
+
+        /// <summary>
+        /// Gets the height of the cursor.
+        /// </summary>
+        public int Height
+        {
+            get;
+        }
+
+        /// <summary>
+        /// Gets the X coordinate of the hotspot of the cursor.
+        /// </summary>
+        public int HotspotX
+        {
+            get;
+        }
+
+        /// <summary>
+        /// Gets the Y coordinate of the hotspot of the cursor.
+        /// </summary>
+        public int HotspotY
+        {
+            get;
+        }
+
+        /// <summary>
+        /// Gets the pixels of the cursor.
+        /// </summary>
+        public ReadOnlyMemory<byte> Pixels => this.pixels;
+
+        /// <summary>
+        /// Gets the region of the framebuffer which is covered by the cursor, when the pointer is at a given position.
+        /// </summary>
+        /// <param name="x">
+        /// The X coordinate of the pointer.
+        /// </param>
+        /// <param name="y">
+        /// The Y coordinate of the pointer.
+        /// </param>
+        /// <returns>
+        /// The region covered by the cursor. The region may extend beyond the framebuffer.
+        /// </returns>
+        public VncRectangle GetBounds(int x, int y)
+        {
+            return new VncRectangle(x - this.HotspotX, y - this.HotspotY, this.Width, this.Height);
+        }
+
+        /// <summary>
+        /// Encodes the cursor for the <see cref="VncEncoding.RichCursor"/> pseudo-encoding: the pixels, in the
+        /// pixel format of the client, followed by a bitmask which indicates which pixels are visible.
+        /// </summary>
+        /// <param name="pixelFormat">
+        /// The pixel format of the client.
+        /// </param>
+        /// <returns>
+        /// The encoded cursor.
+        /// </returns>
+        internal byte[] EncodeRichCursor(VncPixelFormat pixelFormat)
+        {
+            int bpp = pixelFormat.BytesPerPixel;
+            int maskStride = (this.Width + 7) / 8;
+            var data = new byte[(this.Width * this.Height * bpp) + (maskStride * this.Height)];
+
+            if (data.Length == 0)
+            {
+                return data;
+            }
+
+            VncPixelFormat.Copy(
+                this.pixels,
+                this.Width,
+                this.Width * 4,
+                VncPixelFormat.RGB32,
+                new VncRectangle(0, 0, this.Width, this.Height),
+                data,
+                this.Width,
+                this.Width * bpp,
+                pixelFormat);
+
+            int mask = this.Width * this.Height * bpp;
+
+            for (int y = 0; y < this.Height; y++)
+            {
+                for (int x = 0; x < this.Width; x++)
+                {
+                    if (this.IsVisible(x, y))
+                    {
+                        data[mask + (y * maskStride) + (x / 8)] |= (byte)(0x80 >> (x % 8));
+                    }
+                }
+            }
+
+            return data;
+        }
+
+        /// <summary>
+        /// Encodes the cursor for the <see cref="VncEncoding.CursorWithAlpha"/> pseudo-encoding: the encoding of
+        /// the pixel data (raw), followed by the pixels in RGBA byte order, with premultiplied alpha.
+        /// </summary>
+        /// <returns>
+        /// The encoded cursor.
+        /// </returns>
+        internal byte[] EncodeCursorWithAlpha()
+        {
+            var data = new byte[4 + (this.Width * this.Height * 4)];
+            VncUtility.EncodeUInt32BE(data, 0, (uint)VncEncoding.Raw);
+
+            for (int i = 0; i < this.Width * this.Height * 4; i += 4)
+            {
+                int alpha = this.pixels[i + 3];
+                data[4 + i] = (byte)((this.pixels[i + 2] * alpha) / 255);
+                data[4 + i + 1] = (byte)((this.pixels[i + 1] * alpha) / 255);
+                data[4 + i + 2] = (byte)((this.pixels[i] * alpha) / 255);
+                data[4 + i + 3] = (byte)alpha;
+            }
+
+            return data;
+        }
+
+        /// <summary>
+        /// Draws the cursor onto a rectangle of pixel data. Only the pixels which are at least half opaque are drawn.
+        /// </summary>
+        /// <param name="buffer">
+        /// The pixel data of the rectangle.
+        /// </param>
+        /// <param name="region">
+        /// The region of the framebuffer which is held by <paramref name="buffer"/>.
+        /// </param>
+        /// <param name="stride">
+        /// The stride of <paramref name="buffer"/>.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format of <paramref name="buffer"/>.
+        /// </param>
+        /// <param name="x">
+        /// The X coordinate of the pointer.
+        /// </param>
+        /// <param name="y">
+        /// The Y coordinate of the pointer.
+        /// </param>
+        internal void Draw(byte[] buffer, VncRectangle region, int stride, VncPixelFormat pixelFormat, int x, int y)
+        {
+            var bounds = this.GetBounds(x, y);
+            var overlap = VncRectangle.Intersect(bounds, region);
+
+            if (overlap.IsEmpty)
+            {
+                return;
+            }
+
+            int bpp = pixelFormat.BytesPerPixel;
+            var converted = new byte[overlap.Width * bpp];
+
+            for (int row = overlap.Y; row < overlap.Y + overlap.Height; row++)
+            {
+                var source = new VncRectangle(overlap.X - bounds.X, row - bounds.Y, overlap.Width, 1);
+
+                VncPixelFormat.Copy(
+                    this.pixels,
+                    this.Width,
+                    this.Width * 4,
+                    VncPixelFormat.RGB32,
+                    source,
+                    converted,
+                    overlap.Width,
+                    overlap.Width * bpp,
+                    pixelFormat);
+
+                int offset = ((row - region.Y) * stride) + ((overlap.X - region.X) * bpp);
+
+                for (int column = 0; column < overlap.Width; column++)
+                {
+                    if (this.IsVisible(source.X + column, source.Y))
+                    {
+                        Buffer.BlockCopy(converted, column * bpp, buffer, offset + (column * bpp), bpp);
+                    }
+                }
+            }
+        }
+
+        private bool IsVisible(int x, int y)
+        {
+            return this.pixels[(((y * this.Width) + x) * 4) + 3] >= 0x80;
+        }
+    }
+}
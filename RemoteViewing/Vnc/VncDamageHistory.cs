@@ -0,0 +1,189 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Generic;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Keeps track of the regions which have changed in the most recent frames of a framebuffer, so a framebuffer
+    /// source can implement <see cref="IVncFramebufferDamageSource"/>.
+    /// </summary>
+    /// <remarks>
+    /// This class is not thread-safe. Sources typically call its methods while holding the
+    /// <see cref="VncFramebuffer.SyncRoot"/> of their framebuffer.
+    /// </remarks>
+    public sealed class VncDamageHistory
+    {
+        /// <summary>
+        /// The default number of frames for which the damage is remembered.
+        /// </summary>
+        public const int DefaultCapacity = 16;
+
+        private readonly Queue<KeyValuePair<long, VncRectangle[]>> frames = new Queue<KeyValuePair<long, VncRectangle[]>>();
+        private readonly int capacity;
+
+        // The oldest sequence number for which the damage up to the current frame is known.
+        private long oldestSequence;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncDamageHistory"/> class.
+        /// </summary>
+        public VncDamageHistory()
+            : this(DefaultCapacity)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncDamageHistory"/> class.
+        /// </summary>
+        /// <param name="capacity">
+        /// The number of frames for which the damage is remembered. Consumers which have fallen further behind
+        /// must compare the entire framebuffer.
+        /// </param>
+        public VncDamageHistory(int capacity)
+        {
+            if (capacity < 1)
+            {
+                throw new ArgumentOutOfRangeException(nameof(capacity));
+            }
+
+            this.capacity = capacity;
+        }
+
+        /// <summary>
+        /// Gets the sequence number of the most recent frame.
+        /// </summary>
+        public long Sequence
+        {
+            get;
+            private set;
+        }
+
+        /// <summary>
+        /// Records a new frame, in which a single region has changed.
+        /// </summary>
+        /// <param name="region">
+        /// The region which has changed.
+        /// </param>
+        public void Add(VncRectangle region)
+        {
+            this.Add(new VncRectangle[] { region });
+        }
+
+        /// <summary>
+        /// Records a new frame, in which a number of regions have changed. If no regions have changed,
+        /// no frame is recorded.
+        /// </summary>
+        /// <param name="regions">
+        /// The regions which have changed.
+        /// </param>
+        public void Add(IEnumerable<VncRectangle> regions)
+        {
+            if (regions == null)
+            {
+                throw new ArgumentNullException(nameof(regions));
+            }
+
+            var damage = new List<VncRectangle>();
+
+            foreach (var region in regions)
+            {
+                if (!region.IsEmpty)
+                {
+                    damage.Add(region);
+                }
+            }
+
+            if (damage.Count == 0)
+            {
+                return;
+            }
+
+            this.Sequence++;
+            this.frames.Enqueue(new KeyValuePair<long, VncRectangle[]>(this.Sequence, damage.ToArray()));
+
+            if (this.frames.Count > this.capacity)
+            {
+                this.oldestSequence = this.frames.Dequeue().Key;
+            }
+        }
+
+        /// <summary>
+        /// Records a new frame, for which it is not known which regions have changed. Consumers will compare
+        /// the entire framebuffer.
+        /// </summary>
+        public void AddUnknown()
+        {
+            this.Sequence++;
+            this.frames.Clear();
+            this.oldestSequence = this.Sequence;
+        }
+
+        /// <summary>
+        /// Gets the regions which have changed since an earlier frame.
+        /// </summary>
+        /// <param name="sequence">
+        /// The sequence number of the earlier frame.
+        /// </param>
+        /// <param name="damage">
+        /// A collection to which the regions which have changed are added.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the regions which have changed since <paramref name="sequence"/> are known;
+        /// otherwise, <see langword="false"/>.
+        /// </returns>
+        /// <seealso cref="IVncFramebufferDamageSource.TryGetDamage(long, ICollection{VncRectangle})"/>
+        public bool TryGetDamage(long sequence, ICollection<VncRectangle> damage)
+        {
+            if (damage == null)
+            {
+                throw new ArgumentNullException(nameof(damage));
+            }
+
+            if (sequence < this.oldestSequence || sequence > this.Sequence)
+            {
+                return false;
+            }
+
+            foreach (var frame in this.frames)
+            {
+                if (frame.Key > sequence)
+                {
+                    foreach (var region in frame.Value)
+                    {
+                        damage.Add(region);
+                    }
+                }
+            }
+
+            return true;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System.Collections.Generic;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Reads the damage reported by an <see cref="IVncFramebufferDamageSource"/> on behalf of a consumer which keeps
+    /// its own copy of the framebuffer, and remembers up to which frame that copy is up to date.
+    /// </summary>
+    internal sealed class VncDamageReader
+    {
+        private IVncFramebufferDamageSource source;
+        private long sequence = -1;
+
+        /// <summary>
+        /// Gets the regions which have changed, as determined by the last call to <see cref="Read"/>.
+        /// </summary>
+        public List<VncRectangle> Damage
+        { get; } = new List<VncRectangle>();
+
+        /// <summary>
+        /// Gets the regions which have changed since the previous call, and marks the consumer as being up to date
+        /// with the current frame. The caller must hold the <see cref="VncFramebuffer.SyncRoot"/> of the framebuffer,
+        /// and must bring its copy up to date with (at least) the regions in <see cref="Damage"/>.
+        /// </summary>
+        /// <param name="source">
+        /// The framebuffer source.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if <see cref="Damage"/> contains the regions which have changed (if any);
+        /// <see langword="false"/> if the damage is not known, and the entire framebuffer must be compared.
+        /// </returns>
+        public bool Read(IVncFramebufferDamageSource source)
+        {
+            this.Damage.Clear();
+
+            if (source != this.source)
+            {
+                this.source = source;
+                this.sequence = -1;
+            }
+
+            if (source == null)
+            {
+                return false;
+            }
+
+            long sequence = source.FrameSequence;
+            bool isKnown = this.sequence >= 0
+                && (sequence == this.sequence || source.TryGetDamage(this.sequence, this.Damage));
+
+            this.sequence = sequence;
+            return isKnown;
+        }
+
+        /// <summary>
+        /// Forgets up to which frame the consumer is up to date; the next call to <see cref="Read"/> will return
+        /// <see langword="false"/>.
+        /// </summary>
+        public void Reset()
+        {
+            this.sequence = -1;
+        }
+    }
+}
@@ -0,0 +1,277 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.IO;
+using System.IO.Compression;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Inflates a zlib stream which is received in chunks, such as the zlib streams used by the Zlib, ZRLE and
+    /// Tight encodings.
+    /// </summary>
+    /// <remarks>
+    /// The compressed data is received straight into a buffer which is reused for the lifetime of the stream,
+    /// and the inflater reads from that buffer; so decoding a rectangle does not allocate any memory once
+    /// the buffers have grown to their working size.
+    /// </remarks>
+    internal sealed class VncInflater : IDisposable
+    {
+        private readonly Input input = new Input();
+        private byte[] output = new byte[0x1000];
+        private int outputOffset;
+        private int outputCount;
+        private DeflateStream inflater;
+
+        /// <summary>
+        /// Resets the zlib stream, so that the next chunk of data is the start of a new zlib stream.
+        /// </summary>
+        public void Reset()
+        {
+            this.inflater?.Dispose();
+            this.inflater = null;
+            this.input.Clear();
+            this.outputOffset = 0;
+            this.outputCount = 0;
+        }
+
+        /// <summary>
+        /// Receives a chunk of compressed data.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="VncStream"/> from which to read the compressed data.
+        /// </param>
+        /// <param name="count">
+        /// The number of compressed bytes to read.
+        /// </param>
+        public void Receive(VncStream stream, int count)
+        {
+            this.input.Receive(stream, count);
+
+            if (this.inflater == null)
+            {
+                // Zlib has a two-byte header.
+                VncStream.SanityCheck(count >= 2);
+                this.input.Skip(2);
+                this.inflater = new DeflateStream(this.input, CompressionMode.Decompress, true);
+            }
+        }
+
+        /// <summary>
+        /// Reads a single byte of decompressed data.
+        /// </summary>
+        /// <returns>
+        /// The byte which was read.
+        /// </returns>
+        public byte ReadByte()
+        {
+            if (this.outputCount == 0)
+            {
+                this.Fill(1);
+            }
+
+            this.outputCount--;
+            return this.output[this.outputOffset++];
+        }
+
+        /// <summary>
+        /// Reads decompressed data.
+        /// </summary>
+        /// <param name="buffer">
+        /// The buffer into which to read the decompressed data.
+        /// </param>
+        /// <param name="offset">
+        /// The offset in <paramref name="buffer"/> at which to store the data.
+        /// </param>
+        /// <param name="count">
+        /// The number of bytes to read.
+        /// </param>
+        public void Read(byte[] buffer, int offset, int count)
+        {
+            int buffered = Math.Min(count, this.outputCount);
+            Buffer.BlockCopy(this.output, this.outputOffset, buffer, offset, buffered);
+            this.outputOffset += buffered;
+            this.outputCount -= buffered;
+            offset += buffered;
+            count -= buffered;
+
+            if (count >= this.output.Length)
+            {
+                // Large reads, such as the pixel data of a rectangle, are inflated straight into the target buffer.
+                while (count > 0)
+                {
+                    int bytes = this.Inflate(buffer, offset, count);
+                    offset += bytes;
+                    count -= bytes;
+                }
+            }
+            else if (count > 0)
+            {
+                this.Fill(count);
+                Buffer.BlockCopy(this.output, this.outputOffset, buffer, offset, count);
+                this.outputOffset += count;
+                this.outputCount -= count;
+            }
+        }
+
+        /// <inheritdoc/>
+        public void Dispose()
+        {
+            this.inflater?.Dispose();
+            this.inflater = null;
+        }
+
+        private void Fill(int count)
+        {
+            // Move any data which is left to the start of the buffer, and inflate until it holds at least count bytes.
+            Buffer.BlockCopy(this.output, this.outputOffset, this.output, 0, this.outputCount);
+            this.outputOffset = 0;
+
+            while (this.outputCount < count)
+            {
+                this.outputCount += this.Inflate(this.output, this.outputCount, this.output.Length - this.outputCount);
+            }
+        }
+
+        private int Inflate(byte[] buffer, int offset, int count)
+        {
+            VncStream.Require(
+                this.inflater != null,
+                "No data compressed.",
+                VncFailureReason.UnrecognizedProtocolElement);
+
+            int bytes = 0;
+
+            try
+            {
+                bytes = this.inflater.Read(buffer, offset, count);
+            }
+            catch (InvalidDataException)
+            {
+                VncStream.Require(
+                    false,
+                    "Bad data compressed.",
+                    VncFailureReason.UnrecognizedProtocolElement);
+            }
+
+            VncStream.Require(
+                bytes > 0,
+                "No data compressed.",
+                VncFailureReason.UnrecognizedProtocolElement);
+
+            return bytes;
+        }
+
+        /// <summary>
+        /// The input of the <see cref="DeflateStream"/>, which holds the compressed data which has been received
+        /// but not yet inflated.
+        /// </summary>
+        private sealed class Input : Stream
+        {
+            private byte[] buffer = new byte[0];
+            private int offset;
+            private int count;
+
+            public override bool CanRead => true;
+
+            public override bool CanSeek => false;
+
+            public override bool CanWrite => false;
+
+            public override long Length => throw new NotSupportedException();
+
+            public override long Position
+            {
+                get => throw new NotSupportedException();
+                set => throw new NotSupportedException();
+            }
+
+            public void Clear()
+            {
+                this.offset = 0;
+                this.count = 0;
+            }
+
+            public void Receive(VncStream stream, int count)
+            {
+                // Data which hasn't been consumed by the inflater yet is kept, and the new data is appended.
+                if (this.offset + this.count + count > this.buffer.Length)
+                {
+                    var buffer = this.buffer;
+
+                    if (this.count + count > buffer.Length)
+                    {
+                        buffer = new byte[Math.Max(this.count + count, 2 * buffer.Length)];
+                    }
+
+                    Buffer.BlockCopy(this.buffer, this.offset, buffer, 0, this.count);
+                    this.buffer = buffer;
+                    this.offset = 0;
+                }
+
+                stream.Receive(this.buffer, this.offset + this.count, count);
+                this.count += count;
+            }
+
+            public void Skip(int count)
+            {
+                this.offset += count;
+                this.count -= count;
+            }
+
+            public override int Read(byte[] buffer, int offset, int count)
+            {
+                count = Math.Min(count, this.count);
+                Buffer.BlockCopy(this.buffer, this.offset, buffer, offset, count);
+                this.offset += count;
+                this.count -= count;
+                return count;
+            }
+
+            public override void Flush()
+            {
+            }
+
+            public override long Seek(long offset, SeekOrigin origin)
+            {
+                throw new NotSupportedException();
+            }
+
+            public override void SetLength(long value)
+            {
+                throw new NotSupportedException();
+            }
+
+            public override void Write(byte[] buffer, int offset, int count)
+            {
+                throw new NotSupportedException();
+            }
+        }
+    }
+}
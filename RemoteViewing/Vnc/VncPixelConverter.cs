@@ -0,0 +1,469 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using System;
+using System.Collections.Concurrent;
+#if NET5_0_OR_GREATER
+using System.Runtime.CompilerServices;
+using System.Runtime.Intrinsics;
+using System.Runtime.Intrinsics.Arm;
+using System.Runtime.Intrinsics.X86;
+#endif
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Converts rows of pixels from one <see cref="VncPixelFormat"/> to another.
+    /// </summary>
+    /// <remarks>
+    /// <para>
+    /// Converters are created once for every pair of pixel formats, and cached. The constructor selects the
+    /// fastest kernel which supports the pair:
+    /// </para>
+    /// <list type="bullet">
+    /// <item>
+    /// when both formats are 32-bit with 8-bit, byte-aligned channels (for example, RGB32 to BGR32, or a
+    /// change in endianness), the bytes of each pixel are shuffled, 4 pixels at a time;
+    /// </item>
+    /// <item>
+    /// when the source is a little-endian 32-bit format, and the target has fewer bits per channel (for example,
+    /// RGB565 or BGR233), the channels are shifted, masked and packed, 4 pixels at a time;
+    /// </item>
+    /// <item>
+    /// all other pairs use lookup tables, one pixel at a time.
+    /// </item>
+    /// </list>
+    /// <para>
+    /// The vectorized kernels are only available on .NET 5.0 or later. The lookup tables are used to convert
+    /// the pixels which are left over at the end of each row, and are exact, so all kernels produce
+    /// the same output.
+    /// </para>
+    /// </remarks>
+    internal sealed unsafe class VncPixelConverter
+    {
+        private static readonly ConcurrentDictionary<Key, VncPixelConverter> Converters = new ConcurrentDictionary<Key, VncPixelConverter>();
+
+        private readonly int sourceBytesPerPixel;
+        private readonly int targetBytesPerPixel;
+        private readonly bool sourceIsLittleEndian;
+        private readonly bool targetIsLittleEndian;
+
+        private readonly int redShift;
+        private readonly uint redMax;
+        private readonly uint[] red;
+        private readonly int greenShift;
+        private readonly uint greenMax;
+        private readonly uint[] green;
+        private readonly int blueShift;
+        private readonly uint blueMax;
+        private readonly uint[] blue;
+
+#if NET5_0_OR_GREATER
+        private readonly bool canShuffle;
+        private readonly bool canPack;
+        private readonly Vector128<byte> shuffleMask;
+        private readonly Vector128<byte> packMask;
+        private readonly Vector128<uint> redRightShift;
+        private readonly Vector128<uint> redMask;
+        private readonly Vector128<uint> redLeftShift;
+        private readonly Vector128<uint> greenRightShift;
+        private readonly Vector128<uint> greenMask;
+        private readonly Vector128<uint> greenLeftShift;
+        private readonly Vector128<uint> blueRightShift;
+        private readonly Vector128<uint> blueMask;
+        private readonly Vector128<uint> blueLeftShift;
+#endif
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="VncPixelConverter"/> class.
+        /// </summary>
+        /// <param name="sourceFormat">
+        /// The format of the source pixels.
+        /// </param>
+        /// <param name="targetFormat">
+        /// The format of the target pixels.
+        /// </param>
+        public VncPixelConverter(VncPixelFormat sourceFormat, VncPixelFormat targetFormat)
+        {
+            if (sourceFormat == null)
+            {
+                throw new ArgumentNullException(nameof(sourceFormat));
+            }
+
+            if (targetFormat == null)
+            {
+                throw new ArgumentNullException(nameof(targetFormat));
+            }
+
+            if (sourceFormat.IsPalettized || targetFormat.IsPalettized)
+            {
+                throw new NotSupportedException("Converting palettized pixels is not supported.");
+            }
+
+            this.sourceBytesPerPixel = sourceFormat.BytesPerPixel;
+            this.targetBytesPerPixel = targetFormat.BytesPerPixel;
+            this.sourceIsLittleEndian = sourceFormat.IsLittleEndian;
+            this.targetIsLittleEndian = targetFormat.IsLittleEndian;
+
+            this.redShift = sourceFormat.RedShift;
+            this.redMax = sourceFormat.RedMax;
+            this.red = CreateTable(sourceFormat.RedBits, targetFormat.RedBits, targetFormat.RedShift);
+            this.greenShift = sourceFormat.GreenShift;
+            this.greenMax = sourceFormat.GreenMax;
+            this.green = CreateTable(sourceFormat.GreenBits, targetFormat.GreenBits, targetFormat.GreenShift);
+            this.blueShift = sourceFormat.BlueShift;
+            this.blueMax = sourceFormat.BlueMax;
+            this.blue = CreateTable(sourceFormat.BlueBits, targetFormat.BlueBits, targetFormat.BlueShift);
+
+#if NET5_0_OR_GREATER
+            if (IsByteAligned(sourceFormat) && IsByteAligned(targetFormat))
+            {
+                var mask = new byte[16];
+
+                for (int i = 0; i < mask.Length; i++)
+                {
+                    mask[i] = 0x80;
+                }
+
+                for (int i = 0; i < 16; i += 4)
+                {
+                    mask[i + GetByteIndex(targetFormat, targetFormat.RedShift)] = (byte)(i + GetByteIndex(sourceFormat, sourceFormat.RedShift));
+                    mask[i + GetByteIndex(targetFormat, targetFormat.GreenShift)] = (byte)(i + GetByteIndex(sourceFormat, sourceFormat.GreenShift));
+                    mask[i + GetByteIndex(targetFormat, targetFormat.BlueShift)] = (byte)(i + GetByteIndex(sourceFormat, sourceFormat.BlueShift));
+                }
+
+                this.canShuffle = Ssse3.IsSupported || AdvSimd.Arm64.IsSupported;
+                this.shuffleMask = Vector128.Create(mask[0], mask[1], mask[2], mask[3], mask[4], mask[5], mask[6], mask[7], mask[8], mask[9], mask[10], mask[11], mask[12], mask[13], mask[14], mask[15]);
+            }
+            else if (sourceFormat.BitsPerPixel == 32
+                && sourceFormat.IsLittleEndian
+                && targetFormat.RedBits <= sourceFormat.RedBits
+                && targetFormat.GreenBits <= sourceFormat.GreenBits
+                && targetFormat.BlueBits <= sourceFormat.BlueBits)
+            {
+                // Pack the low bytes of 4 32-bit values into 4 pixels, in the byte order of the target.
+                var mask = new byte[16];
+
+                for (int i = 0; i < mask.Length; i++)
+                {
+                    mask[i] = 0x80;
+                }
+
+                for (int i = 0; i < 4; i++)
+                {
+                    for (int b = 0; b < this.targetBytesPerPixel; b++)
+                    {
+                        int index = this.targetIsLittleEndian ? b : this.targetBytesPerPixel - 1 - b;
+                        mask[(i * this.targetBytesPerPixel) + index] = (byte)((i * 4) + b);
+                    }
+                }
+
+                this.canPack = Ssse3.IsSupported;
+                this.packMask = Vector128.Create(mask[0], mask[1], mask[2], mask[3], mask[4], mask[5], mask[6], mask[7], mask[8], mask[9], mask[10], mask[11], mask[12], mask[13], mask[14], mask[15]);
+
+                // Each channel is shifted right, so that the bits which are kept end up in the least significant
+                // bits, masked, and shifted left into place. PSRLD and PSLLD read the shift count from the lower
+                // 64 bits of a vector.
+                this.redRightShift = Vector128.CreateScalar((uint)(sourceFormat.RedShift + sourceFormat.RedBits - targetFormat.RedBits));
+                this.redMask = Vector128.Create((uint)targetFormat.RedMax);
+                this.redLeftShift = Vector128.CreateScalar((uint)targetFormat.RedShift);
+                this.greenRightShift = Vector128.CreateScalar((uint)(sourceFormat.GreenShift + sourceFormat.GreenBits - targetFormat.GreenBits));
+                this.greenMask = Vector128.Create((uint)targetFormat.GreenMax);
+                this.greenLeftShift = Vector128.CreateScalar((uint)targetFormat.GreenShift);
+                this.blueRightShift = Vector128.CreateScalar((uint)(sourceFormat.BlueShift + sourceFormat.BlueBits - targetFormat.BlueBits));
+                this.blueMask = Vector128.Create((uint)targetFormat.BlueMax);
+                this.blueLeftShift = Vector128.CreateScalar((uint)targetFormat.BlueShift);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Gets a <see cref="VncPixelConverter"/> which converts pixels from one format to another.
+        /// </summary>
+        /// <param name="sourceFormat">
+        /// The format of the source pixels.
+        /// </param>
+        /// <param name="targetFormat">
+        /// The format of the target pixels.
+        /// </param>
+        /// <returns>
+        /// A cached <see cref="VncPixelConverter"/>.
+        /// </returns>
+        public static VncPixelConverter Get(VncPixelFormat sourceFormat, VncPixelFormat targetFormat)
+        {
+            var key = new Key(sourceFormat, targetFormat);
+
+            if (!Converters.TryGetValue(key, out var converter))
+            {
+                converter = Converters.GetOrAdd(key, new VncPixelConverter(sourceFormat, targetFormat));
+            }
+
+            return converter;
+        }
+
+        /// <summary>
+        /// Converts a row of pixels.
+        /// </summary>
+        /// <param name="source">
+        /// A pointer to the first source pixel.
+        /// </param>
+        /// <param name="target">
+        /// A pointer to the first target pixel.
+        /// </param>
+        /// <param name="count">
+        /// The number of pixels to convert.
+        /// </param>
+        public void Convert(byte* source, byte* target, int count)
+        {
+            int i = 0;
+
+#if NET5_0_OR_GREATER
+            if (this.canShuffle)
+            {
+                for (; i + 4 <= count; i += 4)
+                {
+                    var value = Unsafe.ReadUnaligned<Vector128<byte>>(source + (4 * i));
+
+                    var shuffled = Ssse3.IsSupported
+                        ? Ssse3.Shuffle(value, this.shuffleMask)
+                        : AdvSimd.Arm64.VectorTableLookup(value, this.shuffleMask);
+
+                    Unsafe.WriteUnaligned(target + (4 * i), shuffled);
+                }
+            }
+            else if (this.canPack)
+            {
+                for (; i + 4 <= count; i += 4)
+                {
+                    var value = Unsafe.ReadUnaligned<Vector128<uint>>(source + (4 * i));
+
+                    var pixels = Sse2.Or(
+                        Sse2.Or(
+                            Pack(value, this.redRightShift, this.redMask, this.redLeftShift),
+                            Pack(value, this.greenRightShift, this.greenMask, this.greenLeftShift)),
+                        Pack(value, this.blueRightShift, this.blueMask, this.blueLeftShift));
+
+                    var packed = Ssse3.Shuffle(pixels.AsByte(), this.packMask);
+
+                    switch (this.targetBytesPerPixel)
+                    {
+                        case 1:
+                            Unsafe.WriteUnaligned(target + i, packed.AsUInt32().ToScalar());
+                            break;
+
+                        case 2:
+                            Unsafe.WriteUnaligned(target + (2 * i), packed.AsUInt64().ToScalar());
+                            break;
+
+                        default:
+                            Unsafe.WriteUnaligned(target + (4 * i), packed);
+                            break;
+                    }
+                }
+            }
+#endif
+
+            source += i * this.sourceBytesPerPixel;
+            target += i * this.targetBytesPerPixel;
+
+            for (; i < count; i++)
+            {
+                uint pixel = this.Read(source);
+
+                this.Write(
+                    target,
+                    this.red[(pixel >> this.redShift) & this.redMax]
+                    | this.green[(pixel >> this.greenShift) & this.greenMax]
+                    | this.blue[(pixel >> this.blueShift) & this.blueMax]);
+
+                source += this.sourceBytesPerPixel;
+                target += this.targetBytesPerPixel;
+            }
+        }
+
+        /// <summary>
+        /// Scales a color value from one number of bits to another.
+        /// </summary>
+        /// <param name="value">
+        /// The color value.
+        /// </param>
+        /// <param name="fromBits">
+        /// The number of bits in <paramref name="value"/>.
+        /// </param>
+        /// <param name="toBits">
+        /// The number of bits in the scaled value.
+        /// </param>
+        /// <returns>
+        /// The scaled value. When reducing the number of bits, the least significant bits are dropped;
+        /// when increasing the number of bits, the value is repeated, so that the maximum value of the
+        /// source maps to the maximum value of the target.
+        /// </returns>
+        internal static uint Scale(uint value, int fromBits, int toBits)
+        {
+            if (fromBits == 0 || toBits == 0)
+            {
+                return 0;
+            }
+
+            if (toBits <= fromBits)
+            {
+                return value >> (fromBits - toBits);
+            }
+
+            uint scaled = 0;
+
+            for (int shift = toBits - fromBits; shift > -fromBits; shift -= fromBits)
+            {
+                scaled |= shift >= 0 ? value << shift : value >> -shift;
+            }
+
+            return scaled;
+        }
+
+        private static uint[] CreateTable(int sourceBits, int targetBits, int targetShift)
+        {
+            var table = new uint[1 << sourceBits];
+
+            for (uint i = 0; i < table.Length; i++)
+            {
+                table[i] = Scale(i, sourceBits, targetBits) << targetShift;
+            }
+
+            return table;
+        }
+
+#if NET5_0_OR_GREATER
+        private static bool IsByteAligned(VncPixelFormat format)
+        {
+            return format.BitsPerPixel == 32
+                && format.RedBits == 8 && format.RedShift % 8 == 0
+                && format.GreenBits == 8 && format.GreenShift % 8 == 0
+                && format.BlueBits == 8 && format.BlueShift % 8 == 0;
+        }
+
+        private static int GetByteIndex(VncPixelFormat format, int shift)
+        {
+            return format.IsLittleEndian ? shift / 8 : 3 - (shift / 8);
+        }
+
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        private static Vector128<uint> Pack(Vector128<uint> value, Vector128<uint> rightShift, Vector128<uint> mask, Vector128<uint> leftShift)
+        {
+            return Sse2.ShiftLeftLogical(Sse2.And(Sse2.ShiftRightLogical(value, rightShift), mask), leftShift);
+        }
+#endif
+
+        private uint Read(byte* source)
+        {
+            switch (this.sourceBytesPerPixel)
+            {
+                case 1:
+                    return *source;
+
+                case 2:
+                    return this.sourceIsLittleEndian
+                        ? (uint)(source[0] | (source[1] << 8))
+                        : (uint)((source[0] << 8) | source[1]);
+
+                default:
+                    return this.sourceIsLittleEndian
+                        ? (uint)(source[0] | (source[1] << 8) | (source[2] << 16) | (source[3] << 24))
+                        : (uint)((source[0] << 24) | (source[1] << 16) | (source[2] << 8) | source[3]);
+            }
+        }
+
+        private void Write(byte* target, uint pixel)
+        {
+            switch (this.targetBytesPerPixel)
+            {
+                case 1:
+                    target[0] = (byte)pixel;
+                    break;
+
+                case 2:
+                    if (this.targetIsLittleEndian)
+                    {
+                        target[0] = (byte)pixel;
+                        target[1] = (byte)(pixel >> 8);
+                    }
+                    else
+                    {
+                        target[0] = (byte)(pixel >> 8);
+                        target[1] = (byte)pixel;
+                    }
+
+                    break;
+
+                default:
+                    if (this.targetIsLittleEndian)
+                    {
+                        target[0] = (byte)pixel;
+                        target[1] = (byte)(pixel >> 8);
+                        target[2] = (byte)(pixel >> 16);
+                        target[3] = (byte)(pixel >> 24);
+                    }
+                    else
+                    {
+                        target[0] = (byte)(pixel >> 24);
+                        target[1] = (byte)(pixel >> 16);
+                        target[2] = (byte)(pixel >> 8);
+                        target[3] = (byte)pixel;
+                    }
+
+                    break;
+            }
+        }
+
+        private struct Key : IEquatable<Key>
+        {
+            private readonly VncPixelFormat sourceFormat;
+            private readonly VncPixelFormat targetFormat;
+
+            public Key(VncPixelFormat sourceFormat, VncPixelFormat targetFormat)
+            {
+                this.sourceFormat = sourceFormat;
+                this.targetFormat = targetFormat;
+            }
+
+            public bool Equals(Key other)
+            {
+                return this.sourceFormat.Equals(other.sourceFormat) && this.targetFormat.Equals(other.targetFormat);
+            }
+
+            public override bool Equals(object obj)
+            {
+                return obj is Key other && this.Equals(other);
+            }
+
+            public override int GetHashCode()
+            {
+                return (this.sourceFormat.GetHashCode() * 31) ^ this.targetFormat.GetHashCode();
+            }
+        }
+    }
+}
@@ -48,7 +48,7 @@ namespace RemoteViewing.Vnc
         /// Initializes a new instance of the <see cref="VncPixelFormat"/> class.
         /// </summary>
         /// <param name="bitsPerPixel">The number of bits used to store a pixel. Currently, this must be 8, 16, or 32.</param>
-        /// <param name="bitDepth">The bit depth of the pixel. Currently, this must be 24.</param>
+        /// <param name="bitDepth">The bit depth of the pixel; that is, the number of useful bits in a pixel. For true color pixels, this must be at least the total number of bits used to represent red, green and blue.</param>
         /// <param name="redBits">The number of bits used to represent red.</param>
         /// <param name="redShift">The number of bits left the red value is shifted.</param>
         /// <param name="greenBits">The number of bits used to represent green.</param>
@@ -74,7 +74,7 @@ namespace RemoteViewing.Vnc
                 throw new ArgumentOutOfRangeException(nameof(bitsPerPixel));
             }
 
-            if (bitDepth != 6 && bitDepth != 24)
+            if (bitDepth < 1 || bitDepth > 32)
             {
                 throw new ArgumentOutOfRangeException(nameof(bitDepth));
             }
@@ -94,6 +94,11 @@ namespace RemoteViewing.Vnc
                 throw new ArgumentOutOfRangeException(nameof(blueBits));
             }
 
+            if (!isPalettized && redBits + greenBits + blueBits > bitDepth)
+            {
+                throw new ArgumentOutOfRangeException(nameof(bitDepth));
+            }
+
             this.BitsPerPixel = bitsPerPixel;
             this.BytesPerPixel = bitsPerPixel / 8;
             this.BitDepth = bitDepth;
@@ -259,32 +264,41 @@ namespace RemoteViewing.Vnc
                 return;
             }
 
+            if (sourceFormat == null)
+            {
+                throw new ArgumentNullException(nameof(sourceFormat));
+            }
+
+            if (targetFormat == null)
+            {
+                throw new ArgumentNullException(nameof(targetFormat));
+            }
+
             int x = sourceRectangle.X, w = sourceRectangle.Width;
             int y = sourceRectangle.Y, h = sourceRectangle.Height;
 
-            if (sourceFormat.Equals(targetFormat))
+            if (x < 0 || y < 0 || (((long)(y + h - 1) * sourceStride) + ((long)(x + w) * sourceFormat.BytesPerPixel)) > source.Length)
             {
-                if (sourceRectangle.Width == sourceWidth
-                    && sourceWidth == targetWidth
-                    && sourceStride == targetStride)
-                {
-                    int sourceStart = sourceStride * y;
-                    int length = targetStride * h;
-
-                    Buffer.BlockCopy(source, sourceStart, target, 0, length);
-                }
-                else
-                {
-                    for (int iy = 0; iy < h; iy++)
-                    {
-                        int sourceStart = (sourceStride * (iy + y)) + (x * sourceFormat.BitsPerPixel / 8);
-                        int targetStart = targetStride * iy;
+                throw new ArgumentOutOfRangeException(nameof(sourceRectangle));
+            }
 
-                        int length = w * sourceFormat.BitsPerPixel / 8;
+            if (targetX < 0 || targetY < 0 || (((long)(targetY + h - 1) * targetStride) + ((long)(targetX + w) * targetFormat.BytesPerPixel)) > target.Length)
+            {
+                throw new ArgumentOutOfRangeException(nameof(target));
+            }
 
-                        Buffer.BlockCopy(source, sourceStart, target, targetStart, length);
-                    }
-                }
+            fixed (byte* sourceData = source)
+            fixed (byte* targetData = target)
+            {
+                Copy(
+                    sourceData + (y * sourceStride) + (x * sourceFormat.BytesPerPixel),
+                    sourceStride,
+                    sourceFormat,
+                    targetData + (targetY * targetStride) + (targetX * targetFormat.BytesPerPixel),
+                    targetStride,
+                    targetFormat,
+                    w,
+                    h);
             }
         }
 
@@ -348,32 +362,7 @@ namespace RemoteViewing.Vnc
             var sourceData = (byte*)(void*)source + (y * sourceStride) + (x * sourceFormat.BytesPerPixel);
             var targetData = (byte*)(void*)target + (targetY * targetStride) + (targetX * targetFormat.BytesPerPixel);
 
-            if (sourceFormat.Equals(targetFormat))
-            {
-                for (int iy = 0; iy < h; iy++)
-                {
-                    if (sourceFormat.BytesPerPixel == 4)
-                    {
-                        uint* sourceDataX0 = (uint*)sourceData, targetDataX0 = (uint*)targetData;
-                        for (int ix = 0; ix < w; ix++)
-                        {
-                            *targetDataX0++ = *sourceDataX0++;
-                        }
-                    }
-                    else
-                    {
-                        int bytes = w * sourceFormat.BytesPerPixel;
-                        byte* sourceDataX0 = (byte*)sourceData, targetDataX0 = (byte*)targetData;
-                        for (int ib = 0; ib < bytes; ib++)
-                        {
-                            *targetDataX0++ = *sourceDataX0++;
-                        }
-                    }
-
-                    sourceData += sourceStride;
-                    targetData += targetStride;
-                }
-            }
+            Copy(sourceData, sourceStride, sourceFormat, targetData, targetStride, targetFormat, w, h);
         }
 
         /// <summary>
@@ -439,7 +428,13 @@ namespace RemoteViewing.Vnc
         /// <inheritdoc />
         public override int GetHashCode()
         {
-            return this.BitsPerPixel ^ this.RedBits;
+            return this.BitsPerPixel
+                ^ (this.BitDepth << 6)
+                ^ (this.RedBits << 11) ^ (this.RedShift << 16)
+                ^ (this.GreenBits << 21) ^ (this.GreenShift << 26)
+                ^ (this.BlueBits << 1) ^ (this.BlueShift << 8)
+                ^ (this.IsLittleEndian ? 0x40000000 : 0)
+                ^ (this.IsPalettized ? unchecked((int)0x80000000) : 0);
         }
 
         /// <inheritdoc/>
@@ -510,6 +505,52 @@ namespace RemoteViewing.Vnc
             buffer[offset + 12] = (byte)this.BlueShift;
         }
 
+        /// <summary>
+        /// Copies pixels, one row at a time. Rows are copied as-is when both formats are the same;
+        /// otherwise, they are converted by a cached <see cref="VncPixelConverter"/>.
+        /// </summary>
+        private static unsafe void Copy(
+            byte* sourceData,
+            int sourceStride,
+            VncPixelFormat sourceFormat,
+            byte* targetData,
+            int targetStride,
+            VncPixelFormat targetFormat,
+            int width,
+            int height)
+        {
+            if (sourceFormat.Equals(targetFormat))
+            {
+                long length = (long)width * sourceFormat.BytesPerPixel;
+
+                if (length == sourceStride && length == targetStride)
+                {
+                    Buffer.MemoryCopy(sourceData, targetData, length * height, length * height);
+                    return;
+                }
+
+                for (int iy = 0; iy < height; iy++)
+                {
+                    Buffer.MemoryCopy(sourceData, targetData, length, length);
+
+                    sourceData += sourceStride;
+                    targetData += targetStride;
+                }
+            }
+            else
+            {
+                var converter = VncPixelConverter.Get(sourceFormat, targetFormat);
+
+                for (int iy = 0; iy < height; iy++)
+                {
+                    converter.Convert(sourceData, targetData, width);
+
+                    sourceData += sourceStride;
+                    targetData += targetStride;
+                }
+            }
+        }
+
         private static int BitsFromMax(int max)
         {
             if (max == 0 || (max & (max + 1)) != 0)
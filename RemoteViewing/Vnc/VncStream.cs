@@ -30,6 +30,8 @@ using System;
 using System.IO;
 using System.Text;
 using System.Text.RegularExpressions;
+using System.Threading;
+using System.Threading.Tasks;
 
 namespace RemoteViewing.Vnc
 {
@@ -38,6 +40,9 @@ namespace RemoteViewing.Vnc
     /// </summary>
     internal sealed class VncStream
     {
+        // Used to receive integers without allocating; reads only ever happen on a single thread.
+        private readonly byte[] receiveBuffer = new byte[4];
+
         /// <summary>
         /// Initializes a new instance of the <see cref="VncStream"/> class.
         /// </summary>
@@ -161,6 +166,26 @@ namespace RemoteViewing.Vnc
             Require(condition, "Sanity check failed.", Vnc.VncFailureReason.SanityCheckFailed);
         }
 
+        /// <summary>
+        /// Sends any data which has been buffered by the stream to the remote party.
+        /// </summary>
+        public void Flush()
+        {
+            lock (this.SyncRoot)
+            {
+                try
+                {
+                    this.Stream?.Flush();
+                }
+                catch (ObjectDisposedException)
+                {
+                }
+                catch (IOException)
+                {
+                }
+            }
+        }
+
         /// <summary>
         /// Closes the current stream and releases any resources
         /// associated with the current stream.
@@ -217,6 +242,48 @@ namespace RemoteViewing.Vnc
             }
         }
 
+        /// <summary>
+        /// Asynchronously reads a sequence of bytes from the current stream and advances the position within the
+        /// stream by the number of bytes read.
+        /// </summary>
+        /// <param name="count">
+        /// The number of bytes to read.
+        /// </param>
+        /// <param name="cancellationToken">
+        /// A <see cref="CancellationToken"/> which can be used to cancel the asynchronous operation.
+        /// </param>
+        /// <returns>
+        /// A <see cref="byte"/> array containing the bytes that have been read.
+        /// </returns>
+        public async Task<byte[]> ReceiveAsync(int count, CancellationToken cancellationToken)
+        {
+            var buffer = new byte[count];
+
+            for (int i = 0; i < count;)
+            {
+                int bytes = await this.Stream.ReadAsync(buffer, i, count - i, cancellationToken).ConfigureAwait(false);
+                Require(bytes > 0, "Lost connection.", VncFailureReason.NetworkError);
+                i += bytes;
+            }
+
+            return buffer;
+        }
+
+        /// <summary>
+        /// Asynchronously reads a byte from the stream and advances the position within the stream by one byte.
+        /// </summary>
+        /// <param name="cancellationToken">
+        /// A <see cref="CancellationToken"/> which can be used to cancel the asynchronous operation.
+        /// </param>
+        /// <returns>
+        /// The byte which was read.
+        /// </returns>
+        public async Task<byte> ReceiveByteAsync(CancellationToken cancellationToken)
+        {
+            var buffer = await this.ReceiveAsync(1, cancellationToken).ConfigureAwait(false);
+            return buffer[0];
+        }
+
         /// <summary>
         /// Reads a byte from the stream and advances the position within the stream by one byte.
         /// </summary>
@@ -273,7 +340,8 @@ namespace RemoteViewing.Vnc
         /// </returns>
         public ushort ReceiveUInt16BE()
         {
-            return VncUtility.DecodeUInt16BE(this.Receive(2), 0);
+            this.Receive(this.receiveBuffer, 0, 2);
+            return VncUtility.DecodeUInt16BE(this.receiveBuffer, 0);
         }
 
         /// <summary>
@@ -285,7 +353,8 @@ namespace RemoteViewing.Vnc
         /// </returns>
         public uint ReceiveUInt32BE()
         {
-            return VncUtility.DecodeUInt32BE(this.Receive(4), 0);
+            this.Receive(this.receiveBuffer, 0, 4);
+            return VncUtility.DecodeUInt32BE(this.receiveBuffer, 0);
         }
 
         /// <summary>
@@ -296,19 +365,21 @@ namespace RemoteViewing.Vnc
         /// </returns>
         public Version ReceiveVersion()
         {
-            var version = Encoding.ASCII.GetString(this.Receive(12));
-            var versionRegex = Regex.Match(
-                    version,
-                    @"^RFB (?<maj>[0-9]{3})\.(?<min>[0-9]{3})\n",
-                    RegexOptions.Singleline | RegexOptions.CultureInvariant);
-            Require(
-                versionRegex.Success,
-                "Not using VNC protocol.",
-                VncFailureReason.WrongKindOfServer);
+            return ParseVersion(this.Receive(12));
+        }
 
-            int major = int.Parse(versionRegex.Groups["maj"].Value);
-            int minor = int.Parse(versionRegex.Groups["min"].Value);
-            return new Version(major, minor);
+        /// <summary>
+        /// Asynchronously receives version information from the stream.
+        /// </summary>
+        /// <param name="cancellationToken">
+        /// A <see cref="CancellationToken"/> which can be used to cancel the asynchronous operation.
+        /// </param>
+        /// <returns>
+        /// The <see cref="Version"/>.
+        /// </returns>
+        public async Task<Version> ReceiveVersionAsync(CancellationToken cancellationToken)
+        {
+            return ParseVersion(await this.ReceiveAsync(12, cancellationToken).ConfigureAwait(false));
         }
 
         /// <summary>
@@ -446,5 +517,22 @@ namespace RemoteViewing.Vnc
         {
             this.SendString(string.Format("RFB {0:000}.{1:000}\n", version.Major, version.Minor));
         }
+
+        private static Version ParseVersion(byte[] buffer)
+        {
+            var version = Encoding.ASCII.GetString(buffer);
+            var versionRegex = Regex.Match(
+                    version,
+                    @"^RFB (?<maj>[0-9]{3})\.(?<min>[0-9]{3})\n",
+                    RegexOptions.Singleline | RegexOptions.CultureInvariant);
+            Require(
+                versionRegex.Success,
+                "Not using VNC protocol.",
+                VncFailureReason.WrongKindOfServer);
+
+            int major = int.Parse(versionRegex.Groups["maj"].Value);
+            int minor = int.Parse(versionRegex.Groups["min"].Value);
+            return new Version(major, minor);
+        }
     }
 }
@@ -55,6 +55,32 @@ namespace RemoteViewing.Vnc
             return scratch;
         }
 
+        /// <summary>
+        /// Gets the number of bytes taken by the pixels of a rectangle received from the remote party.
+        /// </summary>
+        /// <param name="width">
+        /// The width of the rectangle.
+        /// </param>
+        /// <param name="height">
+        /// The height of the rectangle.
+        /// </param>
+        /// <param name="bytesPerPixel">
+        /// The number of bytes per pixel.
+        /// </param>
+        /// <returns>
+        /// The number of bytes taken by the pixels of the rectangle.
+        /// </returns>
+        /// <exception cref="VncException">
+        /// The size of the rectangle can't be represented as an <see cref="int"/>.
+        /// </exception>
+        public static int GetRectangleSize(int width, int height, int bytesPerPixel)
+        {
+            // The dimensions are chosen by the remote party, so make sure the size doesn't overflow.
+            long size = (long)width * height * bytesPerPixel;
+            VncStream.SanityCheck(width >= 0 && height >= 0 && size <= int.MaxValue);
+            return (int)size;
+        }
+
         /// <summary>
         /// Decodes a <see cref="ushort"/> from a byte-array, in big-endian encoding.
         /// </summary>
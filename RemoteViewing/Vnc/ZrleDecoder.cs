@@ -0,0 +1,256 @@
+﻿#region License
+/*
+RemoteViewing VNC Client/Server Library for .NET
+Copyright (c) 2020 Quamotion bvba
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#endregion
+
+using RemoteViewing.Vnc.Server;
+using System;
+
+namespace RemoteViewing.Vnc
+{
+    /// <summary>
+    /// Decodes rectangles which have been encoded using the ZRLE (Zlib Run-Length Encoding) encoding.
+    /// </summary>
+    /// <remarks>
+    /// The rectangle is divided in 64x64 tiles, which are compressed using a single zlib stream that is kept alive
+    /// for the duration of the session. The tiles are decoded as they are inflated, straight into the pixel buffer.
+    /// </remarks>
+    /// <seealso href="https://github.com/rfbproto/rfbproto/blob/master/rfbproto.rst#zrle-encoding"/>
+    internal sealed class ZrleDecoder : IDisposable
+    {
+        /// <summary>
+        /// The width and height of a tile.
+        /// </summary>
+        internal const int TileSize = 64;
+
+        private readonly VncInflater inflater = new VncInflater();
+        private readonly byte[] palette = new byte[127 * 4];
+        private byte[] pixels = new byte[0];
+
+        /// <summary>
+        /// Resets the zlib stream. Call this method when starting a new session.
+        /// </summary>
+        public void Reset()
+        {
+            this.inflater.Reset();
+        }
+
+        /// <summary>
+        /// Receives and decodes a rectangle.
+        /// </summary>
+        /// <param name="stream">
+        /// The <see cref="VncStream"/> from which to read the rectangle.
+        /// </param>
+        /// <param name="pixelFormat">
+        /// The pixel format of the framebuffer.
+        /// </param>
+        /// <param name="width">
+        /// The width of the rectangle.
+        /// </param>
+        /// <param name="height">
+        /// The height of the rectangle.
+        /// </param>
+        /// <returns>
+        /// A buffer which holds the pixels of the rectangle, in the framebuffer pixel format. The buffer is reused
+        /// by the next call to this method.
+        /// </returns>
+        public byte[] Decode(VncStream stream, VncPixelFormat pixelFormat, int width, int height)
+        {
+            int bytesPerPixel = pixelFormat.BytesPerPixel;
+            int size = VncUtility.GetRectangleSize(width, height, bytesPerPixel);
+            var pixels = VncUtility.AllocateScratch(size, ref this.pixels);
+
+            int length = (int)stream.ReceiveUInt32BE();
+            VncStream.SanityCheck(length >= 0 && length < 0x10000000);
+            this.inflater.Receive(stream, length);
+
+            TrleEncoder.GetCompressedPixelFormat(pixelFormat, out int compressedPixelSize, out int compressedPixelOffset);
+
+            // When a CPIXEL is smaller than a PIXEL, the bytes which are not part of the CPIXEL are 0.
+            if (compressedPixelSize != bytesPerPixel)
+            {
+                Array.Clear(pixels, 0, size);
+                Array.Clear(this.palette, 0, this.palette.Length);
+            }
+
+            for (int ty = 0; ty < height; ty += TileSize)
+            {
+                int th = Math.Min(TileSize, height - ty);
+
+                for (int tx = 0; tx < width; tx += TileSize)
+                {
+                    int tw = Math.Min(TileSize, width - tx);
+                    this.DecodeTile(pixels, bytesPerPixel * ((ty * width) + tx), bytesPerPixel * width, tw, th, bytesPerPixel, compressedPixelSize, compressedPixelOffset);
+                }
+            }
+
+            return pixels;
+        }
+
+        /// <inheritdoc/>
+        public void Dispose()
+        {
+            this.inflater.Dispose();
+        }
+
+        private void DecodeTile(byte[] pixels, int offset, int stride, int width, int height, int bytesPerPixel, int compressedPixelSize, int compressedPixelOffset)
+        {
+            int subencoding = this.inflater.ReadByte();
+
+            if (subencoding == 0)
+            {
+                // Raw CPIXELs.
+                for (int y = 0; y < height; y++)
+                {
+                    for (int x = 0; x < width; x++)
+                    {
+                        this.inflater.Read(pixels, offset + (y * stride) + (x * bytesPerPixel) + compressedPixelOffset, compressedPixelSize);
+                    }
+                }
+            }
+            else if (subencoding == 1)
+            {
+                // A solid tile.
+                this.ReadPalette(1, bytesPerPixel, compressedPixelSize, compressedPixelOffset);
+                this.Fill(pixels, offset, stride, width, bytesPerPixel, 0, width * height, 0);
+            }
+            else if (subencoding <= 16)
+            {
+                // A packed palette: 1, 2 or 4 bits per pixel, and each row is padded to a whole number of bytes.
+                int paletteSize = subencoding;
+                int bits = paletteSize == 2 ? 1 : paletteSize <= 4 ? 2 : 4;
+                int mask = (1 << bits) - 1;
+
+                this.ReadPalette(paletteSize, bytesPerPixel, compressedPixelSize, compressedPixelOffset);
+
+                for (int y = 0; y < height; y++)
+                {
+                    int value = 0;
+                    int available = 0;
+
+                    for (int x = 0; x < width; x++)
+                    {
+                        if (available == 0)
+                        {
+                            value = this.inflater.ReadByte();
+                            available = 8;
+                        }
+
+                        available -= bits;
+                        int index = (value >> available) & mask;
+
+                        VncStream.Require(
+                            index < paletteSize,
+                            "Invalid palette index.",
+                            VncFailureReason.UnrecognizedProtocolElement);
+
+                        Buffer.BlockCopy(this.palette, index * bytesPerPixel, pixels, offset + (y * stride) + (x * bytesPerPixel), bytesPerPixel);
+                    }
+                }
+            }
+            else if (subencoding == 128)
+            {
+                // Plain RLE: runs of CPIXELs.
+                for (int i = 0; i < width * height;)
+                {
+                    this.ReadPalette(1, bytesPerPixel, compressedPixelSize, compressedPixelOffset);
+                    int runLength = this.ReadRunLength((width * height) - i);
+
+                    this.Fill(pixels, offset, stride, width, bytesPerPixel, i, runLength, 0);
+                    i += runLength;
+                }
+            }
+            else if (subencoding >= 130)
+            {
+                // Palette RLE: runs of palette indices. The top bit of the index indicates whether it is followed by a run length.
+                int paletteSize = subencoding - 128;
+                this.ReadPalette(paletteSize, bytesPerPixel, compressedPixelSize, compressedPixelOffset);
+
+                for (int i = 0; i < width * height;)
+                {
+                    int index = this.inflater.ReadByte();
+                    int runLength = (index & 0x80) != 0 ? this.ReadRunLength((width * height) - i) : 1;
+                    index &= 0x7F;
+
+                    VncStream.Require(
+                        index < paletteSize,
+                        "Invalid palette index.",
+                        VncFailureReason.UnrecognizedProtocolElement);
+
+                    this.Fill(pixels, offset, stride, width, bytesPerPixel, i, runLength, index);
+                    i += runLength;
+                }
+            }
+            else
+            {
+                VncStream.Require(
+                    false,
+                    "Unsupported ZRLE subencoding.",
+                    VncFailureReason.UnrecognizedProtocolElement);
+            }
+        }
+
+        private void ReadPalette(int count, int bytesPerPixel, int compressedPixelSize, int compressedPixelOffset)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                this.inflater.Read(this.palette, (i * bytesPerPixel) + compressedPixelOffset, compressedPixelSize);
+            }
+        }
+
+        private int ReadRunLength(int maximum)
+        {
+            // The run length is one more than the sum of the bytes; a byte of 255 indicates another byte follows.
+            int runLength = 1;
+            byte value;
+
+            do
+            {
+                value = this.inflater.ReadByte();
+                runLength += value;
+            }
+            while (value == 255);
+
+            VncStream.Require(
+                runLength <= maximum,
+                "Invalid run length.",
+                VncFailureReason.UnrecognizedProtocolElement);
+
+            return runLength;
+        }
+
+        private void Fill(byte[] pixels, int offset, int stride, int width, int bytesPerPixel, int start, int count, int index)
+        {
+            // Fills count pixels of the tile, starting at the pixel with index start, in row-major order.
+            for (int i = start; i < start + count; i++)
+            {
+                int x = i % width;
+                int y = i / width;
+                Buffer.BlockCopy(this.palette, index * bytesPerPixel, pixels, offset + (y * stride) + (x * bytesPerPixel), bytesPerPixel);
+            }
+        }
+    }
+}